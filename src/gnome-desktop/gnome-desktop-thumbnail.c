@@ -129,6 +129,8 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include "gnome-desktop-thumbnail.h"
@@ -789,6 +791,225 @@ thumbnail_failed_path (const char *uri)
   return path;
 }
 
+/* Cached thumbnails are validated from the Thumb::URI and Thumb::MTime text
+ * chunks, which come before the image data. Read the chunks up to there
+ * instead of decoding the whole image, looking up a thumbnail only needs a
+ * few KB of it.
+ */
+#define PNG_HEADER_READ_SIZE 4096
+#define PNG_HEADER_MAX_SIZE (64 * 1024)
+
+static const guint8 png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+typedef enum
+{
+  PNG_TEXT_READ,
+  PNG_TEXT_INVALID,
+  /* The text is compressed, or the header is unusually large */
+  PNG_TEXT_NEEDS_DECODE
+} PngTextResult;
+
+static guint32
+png_read_uint32 (const guint8 *data)
+{
+  return ((guint32) data[0] << 24) | ((guint32) data[1] << 16) |
+         ((guint32) data[2] << 8) | (guint32) data[3];
+}
+
+/* Reads from @fd until @buffer holds at least @size bytes. */
+static gboolean
+png_header_ensure (int         fd,
+                   GByteArray *buffer,
+                   gsize       size)
+{
+  guint8 data[PNG_HEADER_READ_SIZE];
+  gssize n_read;
+
+  while (buffer->len < size)
+    {
+      n_read = read (fd, data, sizeof (data));
+      if (n_read < 0 && errno == EINTR)
+        continue;
+      if (n_read <= 0)
+        return FALSE;
+
+      g_byte_array_append (buffer, data, n_read);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+png_text_keyword_is_wanted (const char *keyword)
+{
+  return strcmp (keyword, "Thumb::URI") == 0 ||
+         strcmp (keyword, "Thumb::MTime") == 0;
+}
+
+/* Stores the text of a tEXt or uncompressed iTXt chunk with one of the
+ * keywords we look for. The first chunk with a given keyword wins.
+ */
+static PngTextResult
+png_read_text_chunk (const char    *type,
+                     const guint8  *data,
+                     guint32        length,
+                     char         **thumb_uri,
+                     char         **thumb_mtime)
+{
+  const guint8 *keyword_end;
+  const guint8 *text;
+  const guint8 *end;
+  char *keyword;
+  char **value;
+  int i;
+
+  end = data + length;
+  keyword_end = memchr (data, '\0', length);
+  if (keyword_end == NULL)
+    return PNG_TEXT_READ;
+
+  keyword = (char *) data;
+  if (!png_text_keyword_is_wanted (keyword))
+    return PNG_TEXT_READ;
+
+  if (strcmp (type, "zTXt") == 0)
+    return PNG_TEXT_NEEDS_DECODE;
+
+  text = keyword_end + 1;
+  if (strcmp (type, "iTXt") == 0)
+    {
+      /* Compression flag and method, then the language tag and the
+       * translated keyword.
+       */
+      if (end - text < 2)
+        return PNG_TEXT_INVALID;
+      if (text[0] != 0)
+        return PNG_TEXT_NEEDS_DECODE;
+      text += 2;
+
+      for (i = 0; i < 2; i++)
+        {
+          text = memchr (text, '\0', end - text);
+          if (text == NULL)
+            return PNG_TEXT_INVALID;
+          text++;
+        }
+    }
+
+  value = strcmp (keyword, "Thumb::URI") == 0 ? thumb_uri : thumb_mtime;
+  if (*value == NULL)
+    *value = g_strndup ((const char *) text, end - text);
+
+  return PNG_TEXT_READ;
+}
+
+static PngTextResult
+read_thumbnail_png_text (const char  *path,
+                         char       **thumb_uri,
+                         char       **thumb_mtime)
+{
+  GByteArray *buffer;
+  PngTextResult result;
+  gsize offset;
+  guint32 length;
+  char type[5];
+  int fd;
+
+  *thumb_uri = NULL;
+  *thumb_mtime = NULL;
+
+  fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd == -1)
+    return PNG_TEXT_INVALID;
+
+  buffer = g_byte_array_sized_new (PNG_HEADER_READ_SIZE);
+  result = PNG_TEXT_INVALID;
+
+  offset = sizeof (png_signature);
+  if (!png_header_ensure (fd, buffer, offset) ||
+      memcmp (buffer->data, png_signature, offset) != 0)
+    goto out;
+
+  for (;;)
+    {
+      if (!png_header_ensure (fd, buffer, offset + 8))
+        goto out;
+
+      length = png_read_uint32 (buffer->data + offset);
+      memcpy (type, buffer->data + offset + 4, 4);
+      type[4] = '\0';
+
+      /* Text chunks may also follow the image data, so only stop here
+       * when both keys have been seen.
+       */
+      if (strcmp (type, "IDAT") == 0 || strcmp (type, "IEND") == 0)
+        {
+          if (*thumb_uri != NULL && *thumb_mtime != NULL)
+            result = PNG_TEXT_READ;
+          else
+            result = PNG_TEXT_NEEDS_DECODE;
+          goto out;
+        }
+
+      if (length > G_MAXINT32)
+        goto out;
+
+      /* Chunk data and CRC */
+      if (offset + 8 + length + 4 > PNG_HEADER_MAX_SIZE)
+        {
+          result = PNG_TEXT_NEEDS_DECODE;
+          goto out;
+        }
+
+      if (!png_header_ensure (fd, buffer, offset + 8 + length + 4))
+        goto out;
+
+      if (strcmp (type, "tEXt") == 0 ||
+          strcmp (type, "zTXt") == 0 ||
+          strcmp (type, "iTXt") == 0)
+        {
+          result = png_read_text_chunk (type, buffer->data + offset + 8, length,
+                                        thumb_uri, thumb_mtime);
+          if (result != PNG_TEXT_READ)
+            goto out;
+          result = PNG_TEXT_INVALID;
+        }
+
+      offset += 8 + length + 4;
+    }
+
+ out:
+  if (result != PNG_TEXT_READ)
+    {
+      g_clear_pointer (thumb_uri, g_free);
+      g_clear_pointer (thumb_mtime, g_free);
+    }
+  g_byte_array_unref (buffer);
+  close (fd);
+
+  return result;
+}
+
+static gboolean
+thumbnail_text_is_valid (const char *thumb_uri,
+                         const char *thumb_mtime_str,
+                         const char *uri,
+                         time_t      mtime)
+{
+  time_t thumb_mtime;
+
+  if (g_strcmp0 (uri, thumb_uri) != 0)
+    return FALSE;
+
+  if (!thumb_mtime_str)
+    return FALSE;
+  thumb_mtime = atol (thumb_mtime_str);
+  if (mtime != thumb_mtime)
+    return FALSE;
+
+  return TRUE;
+}
+
 static char *
 validate_thumbnail_path (char                      *path,
                          const char                *uri,
@@ -796,16 +1017,34 @@ validate_thumbnail_path (char                      *path,
                          GnomeDesktopThumbnailSize  size)
 {
   GdkPixbuf *pixbuf;
+  char *thumb_uri;
+  char *thumb_mtime;
+  gboolean valid;
+
+  valid = FALSE;
+  switch (read_thumbnail_png_text (path, &thumb_uri, &thumb_mtime))
+    {
+    case PNG_TEXT_READ:
+      valid = thumbnail_text_is_valid (thumb_uri, thumb_mtime, uri, mtime);
+      g_free (thumb_uri);
+      g_free (thumb_mtime);
+      break;
+
+    case PNG_TEXT_NEEDS_DECODE:
+      pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+      valid = pixbuf != NULL && gnome_desktop_thumbnail_is_valid (pixbuf, uri, mtime);
+      g_clear_object (&pixbuf);
+      break;
+
+    case PNG_TEXT_INVALID:
+      break;
+    }
 
-  pixbuf = gdk_pixbuf_new_from_file (path, NULL);
-  if (pixbuf == NULL ||
-      !gnome_desktop_thumbnail_is_valid (pixbuf, uri, mtime)) {
+  if (!valid) {
       g_free (path);
       return NULL;
   }
 
-  g_clear_object (&pixbuf);
-
   return path;
 }
 
@@ -1283,19 +1522,7 @@ gnome_desktop_thumbnail_is_valid (GdkPixbuf          *pixbuf,
 				  const char         *uri,
 				  time_t              mtime)
 {
-  const char *thumb_uri, *thumb_mtime_str;
-  time_t thumb_mtime;
-
-  thumb_uri = gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::URI");
-  if (g_strcmp0 (uri, thumb_uri) != 0)
-    return FALSE;
-
-  thumb_mtime_str = gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::MTime");
-  if (!thumb_mtime_str)
-    return FALSE;
-  thumb_mtime = atol (thumb_mtime_str);
-  if (mtime != thumb_mtime)
-    return FALSE;
-
-  return TRUE;
+  return thumbnail_text_is_valid (gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::URI"),
+                                  gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::MTime"),
+                                  uri, mtime);
 }
@@ -48,6 +48,7 @@
 #include "nautilus-file-operations.h"
 #include "nautilus-file-undo-manager.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-filename-index.h"
 #include "nautilus-freedesktop-dbus.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-icon-info.h"
@@ -1308,6 +1309,9 @@ nautilus_application_startup_common (NautilusApplication *self)
     /* initialize preferences and create the global GSettings objects */
     nautilus_global_preferences_init ();
 
+    /* Load the file name index before the first search or file change */
+    nautilus_filename_index_init_default ();
+
     /* initialize nautilus modules */
     nautilus_profile_start ("Modules");
     nautilus_module_setup ();
@@ -4526,6 +4526,76 @@ nautilus_canvas_container_get_first_visible_icon (NautilusCanvasContainer *conta
     return best_icon ? best_icon->data : NULL;
 }
 
+/**
+ * nautilus_canvas_container_get_visible_icons:
+ * @container: An canvas container widget.
+ *
+ * Get the icons on screen, followed by those within a screen worth above
+ * and below them.
+ *
+ * Return value: A GList of the programmer-specified data associated to each
+ * icon. The caller is expected to free the list when it is not needed anymore.
+ **/
+GList *
+nautilus_canvas_container_get_visible_icons (NautilusCanvasContainer *container)
+{
+    GtkAdjustment *vadj;
+    GtkAllocation allocation;
+    double min_y, max_y;
+    double margin;
+    double x0, y0, x1, y1;
+    GList *node;
+    GList *visible;
+    GList *around;
+    NautilusCanvasIcon *icon;
+
+    g_return_val_if_fail (NAUTILUS_IS_CANVAS_CONTAINER (container), NULL);
+
+    vadj = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (container));
+    gtk_widget_get_allocation (GTK_WIDGET (container), &allocation);
+
+    min_y = gtk_adjustment_get_value (vadj);
+    max_y = min_y + allocation.height;
+
+    x0 = 0;
+    eel_canvas_c2w (EEL_CANVAS (container),
+                    x0, min_y, &x0, &min_y);
+    x0 = 0;
+    eel_canvas_c2w (EEL_CANVAS (container),
+                    x0, max_y, &x0, &max_y);
+    margin = max_y - min_y;
+
+    visible = NULL;
+    around = NULL;
+    for (node = g_list_last (container->details->icons); node != NULL; node = node->prev)
+    {
+        icon = node->data;
+
+        if (!icon_is_positioned (icon))
+        {
+            continue;
+        }
+
+        eel_canvas_item_get_bounds (EEL_CANVAS_ITEM (icon->item),
+                                    &x0, &y0, &x1, &y1);
+        eel_canvas_item_i2w (EEL_CANVAS_ITEM (icon->item)->parent,
+                             &x0, &y0);
+        eel_canvas_item_i2w (EEL_CANVAS_ITEM (icon->item)->parent,
+                             &x1, &y1);
+
+        if (y1 >= min_y && y0 <= max_y)
+        {
+            visible = g_list_prepend (visible, icon->data);
+        }
+        else if (y1 >= min_y - margin && y0 <= max_y + margin)
+        {
+            around = g_list_prepend (around, icon->data);
+        }
+    }
+
+    return g_list_concat (visible, around);
+}
+
 NautilusCanvasIconData *
 nautilus_canvas_container_get_focused_icon (NautilusCanvasContainer *container)
 {
@@ -229,6 +229,7 @@ void              nautilus_canvas_container_reveal                        (Nauti
 									   NautilusCanvasIconData       *data);
 gboolean          nautilus_canvas_container_is_empty                      (NautilusCanvasContainer  *container);
 NautilusCanvasIconData *nautilus_canvas_container_get_first_visible_icon        (NautilusCanvasContainer  *container);
+GList            *nautilus_canvas_container_get_visible_icons             (NautilusCanvasContainer  *container);
 NautilusCanvasIconData *nautilus_canvas_container_get_focused_icon              (NautilusCanvasContainer  *container);
 GdkRectangle      *nautilus_canvas_container_get_icon_bounding_box          (NautilusCanvasContainer  *container,
 									     NautilusCanvasIconData       *data);
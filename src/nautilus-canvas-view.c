@@ -264,6 +264,9 @@ update_sort_criterion (NautilusCanvasView  *canvas_view,
     }
 
     canvas_view->sort = overrided_sort_criterion;
+
+    /* Sorting by size needs more than the files on screen */
+    nautilus_files_view_update_visible_files (NAUTILUS_FILES_VIEW (canvas_view));
 }
 
 static void
@@ -1484,6 +1487,26 @@ canvas_view_get_first_visible_file (NautilusFilesView *view)
     return NULL;
 }
 
+static GList *
+canvas_view_get_visible_files (NautilusFilesView *view)
+{
+    NautilusCanvasView *canvas_view;
+    GList *files;
+
+    canvas_view = NAUTILUS_CANVAS_VIEW (view);
+
+    /* Sorting by size needs the item count of every folder */
+    if (canvas_view->sort != NULL &&
+        canvas_view->sort->sort_type == NAUTILUS_FILE_SORT_BY_SIZE)
+    {
+        return NULL;
+    }
+
+    files = nautilus_canvas_container_get_visible_icons (get_canvas_container (canvas_view));
+
+    return nautilus_file_list_ref (files);
+}
+
 static void
 canvas_view_scroll_to_file (NautilusFilesView *view,
                             const char        *uri)
@@ -1577,6 +1600,7 @@ nautilus_canvas_view_class_init (NautilusCanvasViewClass *klass)
     nautilus_files_view_class->widget_to_file_operation_position = nautilus_canvas_view_widget_to_file_operation_position;
     nautilus_files_view_class->get_view_id = nautilus_canvas_view_get_id;
     nautilus_files_view_class->get_first_visible_file = canvas_view_get_first_visible_file;
+    nautilus_files_view_class->get_visible_files = canvas_view_get_visible_files;
     nautilus_files_view_class->scroll_to_file = canvas_view_scroll_to_file;
     nautilus_files_view_class->reveal_for_selection_context_menu = nautilus_canvas_view_reveal_for_selection_context_menu;
 }
@@ -0,0 +1,862 @@
+/* nautilus-copy-journal.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-copy-journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "nautilus-file-utilities.h"
+
+/* The journal is a text file. A header names the operation, the destination
+ * and the files, one per line:
+ *
+ *   nautilus-copy-journal 1
+ *   copy
+ *   dest <uri>
+ *   src <uri>
+ *
+ * followed by a record per line:
+ *
+ *   d <shared> <rest>      a file done with, the first <shared> bytes of its
+ *                          uri are the same as in the previous d record
+ *   p <offset> <size> <mtime> <uri> <dest uri>
+ *                          a partial copy
+ *
+ * Files in a folder are done with one after the other, so most of every uri
+ * is shared with the one before.
+ */
+#define JOURNAL_MAGIC "nautilus-copy-journal 1"
+#define JOURNAL_PREFIX "copy-"
+#define JOURNAL_SYNC_INTERVAL (5 * G_USEC_PER_SEC)
+/* Nothing resumes the journals left behind by itself, so they are dropped
+ * when they get old, or when there are too many of them.
+ */
+#define JOURNAL_MAX_AGE (7 * G_TIME_SPAN_DAY)
+#define JOURNAL_MAX_UNFINISHED 16
+#define PARTIAL_SUFFIX ".partial"
+
+typedef struct
+{
+    GFile *dest;
+    goffset offset;
+    goffset size;
+    gint64 mtime;
+} JournalPartial;
+
+struct _NautilusCopyJournal
+{
+    char *path;
+    int fd;
+    /* On the destination file system, to sync it */
+    int dest_fd;
+    gboolean is_move;
+    GList *files;
+    GFile *destination;
+    /* Uris of the files done with in an earlier run */
+    GHashTable *done;
+    /* Source uri -> JournalPartial */
+    GHashTable *partials;
+    /* Records not written out yet */
+    GString *pending;
+    char *last_done_uri;
+    gint64 last_sync_time;
+};
+
+/* Paths of the journals in use in this process */
+G_LOCK_DEFINE_STATIC (open_journals);
+static GHashTable *open_journals = NULL;
+
+static char *
+get_journal_directory (void)
+{
+    return g_build_filename (g_get_user_data_dir (), "nautilus", "copy-journals", NULL);
+}
+
+static void
+journal_partial_free (JournalPartial *partial)
+{
+    g_object_unref (partial->dest);
+    g_free (partial);
+}
+
+static gboolean
+journal_register (const char  *path,
+                  GError     **error)
+{
+    gboolean registered;
+
+    G_LOCK (open_journals);
+
+    if (open_journals == NULL)
+    {
+        open_journals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    registered = g_hash_table_add (open_journals, g_strdup (path));
+
+    G_UNLOCK (open_journals);
+
+    if (!registered)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                     "The copy journal %s is in use", path);
+    }
+
+    return registered;
+}
+
+static void
+journal_unregister (const char *path)
+{
+    G_LOCK (open_journals);
+    g_hash_table_remove (open_journals, path);
+    G_UNLOCK (open_journals);
+}
+
+static NautilusCopyJournal *
+journal_new (const char *path,
+             int         fd,
+             GList      *files,
+             GFile      *destination,
+             gboolean    is_move)
+{
+    NautilusCopyJournal *journal;
+    g_autofree char *dest_path = NULL;
+
+    journal = g_new0 (NautilusCopyJournal, 1);
+    journal->path = g_strdup (path);
+    journal->fd = fd;
+    journal->is_move = is_move;
+    journal->files = files;
+    journal->destination = destination;
+    journal->done = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    journal->partials = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify) journal_partial_free);
+    journal->pending = g_string_new (NULL);
+    journal->last_sync_time = g_get_monotonic_time ();
+
+    dest_path = g_file_get_path (destination);
+    journal->dest_fd = dest_path != NULL ?
+                       open (dest_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+
+    return journal;
+}
+
+static void
+journal_free (NautilusCopyJournal *journal)
+{
+    if (journal->fd >= 0)
+    {
+        close (journal->fd);
+    }
+    if (journal->dest_fd >= 0)
+    {
+        close (journal->dest_fd);
+    }
+
+    g_list_free_full (journal->files, g_object_unref);
+    g_object_unref (journal->destination);
+    g_hash_table_destroy (journal->done);
+    g_hash_table_destroy (journal->partials);
+    g_string_free (journal->pending, TRUE);
+    g_free (journal->last_done_uri);
+    g_free (journal->path);
+    g_free (journal);
+}
+
+typedef struct
+{
+    char *path;
+    gint64 mtime;
+} UnfinishedJournal;
+
+static void
+unfinished_journal_free (UnfinishedJournal *unfinished)
+{
+    g_free (unfinished->path);
+    g_free (unfinished);
+}
+
+/* Newest first */
+static gint
+compare_unfinished_journals (gconstpointer a,
+                             gconstpointer b)
+{
+    const UnfinishedJournal *journal_a = a;
+    const UnfinishedJournal *journal_b = b;
+
+    return journal_a->mtime < journal_b->mtime ? 1 :
+           journal_a->mtime > journal_b->mtime ? -1 : 0;
+}
+
+static gboolean
+is_partial_file (GFile *file)
+{
+    g_autofree char *name = NULL;
+
+    name = g_file_get_basename (file);
+
+    return name != NULL && name[0] == '.' && g_str_has_suffix (name, PARTIAL_SUFFIX);
+}
+
+/* Removes the journal at @path along with the partial copies it kept */
+static void
+remove_unfinished (const char *path)
+{
+    g_autoptr (GFile) location = NULL;
+    NautilusCopyJournal *journal;
+    GHashTableIter iter;
+    JournalPartial *partial;
+
+    location = g_file_new_for_path (path);
+    journal = nautilus_copy_journal_load (location, NULL);
+    if (journal == NULL)
+    {
+        g_unlink (path);
+        return;
+    }
+
+    g_hash_table_iter_init (&iter, journal->partials);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &partial))
+    {
+        /* Older journals have the destination itself */
+        if (is_partial_file (partial->dest))
+        {
+            g_file_delete (partial->dest, NULL, NULL);
+        }
+    }
+
+    nautilus_copy_journal_close (journal, TRUE);
+}
+
+/* Returns the UnfinishedJournals not in use, newest first, after removing
+ * those too old or too many to keep.
+ */
+static GList *
+list_and_prune_unfinished (void)
+{
+    g_autofree char *directory = NULL;
+    GDir *dir;
+    const char *name;
+    GList *journals;
+    GList *l, *next;
+    gint64 now;
+    guint n_kept;
+
+    directory = get_journal_directory ();
+    dir = g_dir_open (directory, 0, NULL);
+    if (dir == NULL)
+    {
+        return NULL;
+    }
+
+    journals = NULL;
+
+    G_LOCK (open_journals);
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        UnfinishedJournal *unfinished;
+        GStatBuf stat_buf;
+        char *path;
+
+        if (!g_str_has_prefix (name, JOURNAL_PREFIX))
+        {
+            continue;
+        }
+
+        path = g_build_filename (directory, name, NULL);
+        if ((open_journals != NULL && g_hash_table_contains (open_journals, path)) ||
+            g_stat (path, &stat_buf) < 0)
+        {
+            g_free (path);
+            continue;
+        }
+
+        unfinished = g_new0 (UnfinishedJournal, 1);
+        unfinished->path = path;
+        unfinished->mtime = (gint64) stat_buf.st_mtime * G_USEC_PER_SEC;
+        journals = g_list_prepend (journals, unfinished);
+    }
+    G_UNLOCK (open_journals);
+
+    g_dir_close (dir);
+
+    journals = g_list_sort (journals, compare_unfinished_journals);
+
+    now = g_get_real_time ();
+    n_kept = 0;
+    for (l = journals; l != NULL; l = next)
+    {
+        UnfinishedJournal *unfinished = l->data;
+
+        next = l->next;
+        if (n_kept < JOURNAL_MAX_UNFINISHED && now - unfinished->mtime < JOURNAL_MAX_AGE)
+        {
+            n_kept++;
+            continue;
+        }
+
+        remove_unfinished (unfinished->path);
+        unfinished_journal_free (unfinished);
+        journals = g_list_delete_link (journals, l);
+    }
+
+    return journals;
+}
+
+NautilusCopyJournal *
+nautilus_copy_journal_new (GList     *files,
+                           GFile     *destination,
+                           gboolean   is_move,
+                           GError   **error)
+{
+    g_autofree char *directory = NULL;
+    g_autofree char *path = NULL;
+    g_autofree char *dest_uri = NULL;
+    g_autoptr (GString) header = NULL;
+    NautilusCopyJournal *journal;
+    GList *l;
+    int errsv;
+    int fd;
+
+    g_return_val_if_fail (files != NULL, NULL);
+    g_return_val_if_fail (G_IS_FILE (destination), NULL);
+
+    directory = get_journal_directory ();
+    if (g_mkdir_with_parents (directory, 0700) < 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not create %s: %s", directory, g_strerror (errsv));
+        return NULL;
+    }
+
+    /* Keeps what is left behind in check */
+    g_list_free_full (list_and_prune_unfinished (),
+                      (GDestroyNotify) unfinished_journal_free);
+
+    path = g_build_filename (directory, JOURNAL_PREFIX "XXXXXX", NULL);
+    fd = g_mkstemp_full (path, O_WRONLY | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not create a copy journal: %s", g_strerror (errsv));
+        return NULL;
+    }
+
+    dest_uri = g_file_get_uri (destination);
+    header = g_string_new (JOURNAL_MAGIC "\n");
+    g_string_append_printf (header, "%s\ndest %s\n", is_move ? "move" : "copy", dest_uri);
+    for (l = files; l != NULL; l = l->next)
+    {
+        g_autofree char *uri = NULL;
+
+        uri = g_file_get_uri (l->data);
+        g_string_append_printf (header, "src %s\n", uri);
+    }
+
+    if (nautilus_write_all (fd, header->str, header->len, -1) != 0 || fdatasync (fd) < 0)
+    {
+        errsv = errno;
+        close (fd);
+        g_unlink (path);
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not write %s: %s", path, g_strerror (errsv));
+        return NULL;
+    }
+
+    journal_register (path, NULL);
+    journal = journal_new (path, fd,
+                           g_list_copy_deep (files, (GCopyFunc) g_object_ref, NULL),
+                           g_object_ref (destination),
+                           is_move);
+
+    return journal;
+}
+
+static gboolean
+parse_done_record (const char  *line,
+                   const char  *last_uri,
+                   char       **uri)
+{
+    guint64 shared;
+    char *end;
+
+    shared = g_ascii_strtoull (line, &end, 10);
+    if (end == line || *end != ' ' ||
+        shared > (last_uri != NULL ? strlen (last_uri) : 0))
+    {
+        return FALSE;
+    }
+
+    *uri = g_malloc (shared + strlen (end + 1) + 1);
+    if (shared > 0)
+    {
+        memcpy (*uri, last_uri, shared);
+    }
+    strcpy (*uri + shared, end + 1);
+
+    return TRUE;
+}
+
+static gboolean
+parse_partial_record (const char      *line,
+                      char           **uri,
+                      JournalPartial **partial)
+{
+    g_auto (GStrv) fields = NULL;
+    char *end;
+    gint64 numbers[3];
+    int i;
+
+    fields = g_strsplit (line, " ", 5);
+    if (g_strv_length (fields) != 5)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        numbers[i] = g_ascii_strtoll (fields[i], &end, 10);
+        if (end == fields[i] || *end != '\0')
+        {
+            return FALSE;
+        }
+    }
+
+    *uri = g_strdup (fields[3]);
+    *partial = g_new0 (JournalPartial, 1);
+    (*partial)->offset = numbers[0];
+    (*partial)->size = numbers[1];
+    (*partial)->mtime = numbers[2];
+    (*partial)->dest = g_file_new_for_uri (fields[4]);
+
+    return TRUE;
+}
+
+NautilusCopyJournal *
+nautilus_copy_journal_load (GFile   *location,
+                            GError **error)
+{
+    g_autofree char *path = NULL;
+    g_autofree char *contents = NULL;
+    g_autoptr (GFile) destination = NULL;
+    g_autoptr (GHashTable) done = NULL;
+    g_autoptr (GHashTable) partials = NULL;
+    g_autofree char *last_done_uri = NULL;
+    NautilusCopyJournal *journal;
+    GList *files;
+    gboolean is_move;
+    gboolean valid;
+    gsize length;
+    gsize complete_length;
+    char *line;
+    char *end;
+    guint n_lines;
+    int errsv;
+    int fd;
+
+    g_return_val_if_fail (G_IS_FILE (location), NULL);
+
+    path = g_file_get_path (location);
+    if (path == NULL)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "Copy journals are local files");
+        return NULL;
+    }
+
+    if (!g_file_get_contents (path, &contents, &length, error))
+    {
+        return NULL;
+    }
+
+    done = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    partials = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify) journal_partial_free);
+    files = NULL;
+    is_move = FALSE;
+    valid = TRUE;
+    n_lines = 0;
+
+    /* A line cut short by a crash is left out, and dropped below */
+    for (line = contents;
+         valid && (end = memchr (line, '\n', length - (line - contents))) != NULL;
+         line = end + 1)
+    {
+        *end = '\0';
+
+        if (n_lines == 0)
+        {
+            valid = strcmp (line, JOURNAL_MAGIC) == 0;
+        }
+        else if (n_lines == 1)
+        {
+            is_move = strcmp (line, "move") == 0;
+            valid = is_move || strcmp (line, "copy") == 0;
+        }
+        else if (g_str_has_prefix (line, "dest ") && destination == NULL)
+        {
+            destination = g_file_new_for_uri (line + strlen ("dest "));
+        }
+        else if (g_str_has_prefix (line, "src ") && destination != NULL &&
+                 g_hash_table_size (done) == 0 && g_hash_table_size (partials) == 0)
+        {
+            files = g_list_prepend (files, g_file_new_for_uri (line + strlen ("src ")));
+        }
+        else if (g_str_has_prefix (line, "d ") && files != NULL)
+        {
+            char *uri;
+
+            valid = parse_done_record (line + strlen ("d "), last_done_uri, &uri);
+            if (valid)
+            {
+                g_hash_table_remove (partials, uri);
+                g_free (last_done_uri);
+                last_done_uri = g_strdup (uri);
+                g_hash_table_add (done, uri);
+            }
+        }
+        else if (g_str_has_prefix (line, "p ") && files != NULL)
+        {
+            JournalPartial *partial;
+            char *uri;
+
+            valid = parse_partial_record (line + strlen ("p "), &uri, &partial);
+            if (valid)
+            {
+                g_hash_table_replace (partials, uri, partial);
+            }
+        }
+        else
+        {
+            valid = FALSE;
+        }
+
+        n_lines++;
+    }
+    complete_length = line - contents;
+
+    if (!valid || files == NULL)
+    {
+        g_list_free_full (files, g_object_unref);
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "%s is not a valid copy journal", path);
+        return NULL;
+    }
+
+    if (!journal_register (path, error))
+    {
+        g_list_free_full (files, g_object_unref);
+        return NULL;
+    }
+
+    fd = open (path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0 || (complete_length < length && ftruncate (fd, complete_length) < 0))
+    {
+        errsv = errno;
+        if (fd >= 0)
+        {
+            close (fd);
+        }
+        journal_unregister (path);
+        g_list_free_full (files, g_object_unref);
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not open %s: %s", path, g_strerror (errsv));
+        return NULL;
+    }
+
+    journal = journal_new (path, fd,
+                           g_list_reverse (files),
+                           g_steal_pointer (&destination),
+                           is_move);
+    g_hash_table_destroy (journal->done);
+    journal->done = g_steal_pointer (&done);
+    g_hash_table_destroy (journal->partials);
+    journal->partials = g_steal_pointer (&partials);
+    journal->last_done_uri = g_steal_pointer (&last_done_uri);
+
+    return journal;
+}
+
+void
+nautilus_copy_journal_close (NautilusCopyJournal *journal,
+                             gboolean             finished)
+{
+    g_return_if_fail (journal != NULL);
+
+    if (finished)
+    {
+        g_unlink (journal->path);
+    }
+    else
+    {
+        nautilus_copy_journal_sync (journal);
+    }
+
+    journal_unregister (journal->path);
+    journal_free (journal);
+}
+
+GFile *
+nautilus_copy_journal_get_partial_file (GFile *dest)
+{
+    g_autoptr (GFile) parent = NULL;
+    g_autofree char *name = NULL;
+    g_autofree char *partial_name = NULL;
+
+    g_return_val_if_fail (G_IS_FILE (dest), NULL);
+
+    parent = g_file_get_parent (dest);
+    name = g_file_get_basename (dest);
+    if (parent == NULL || name == NULL ||
+        strlen (name) + strlen ("." PARTIAL_SUFFIX) > NAME_MAX)
+    {
+        return NULL;
+    }
+
+    partial_name = g_strconcat (".", name, PARTIAL_SUFFIX, NULL);
+
+    return g_file_get_child (parent, partial_name);
+}
+
+GList *
+nautilus_copy_journal_list_unfinished (void)
+{
+    GList *journals;
+    GList *l;
+
+    journals = list_and_prune_unfinished ();
+    for (l = journals; l != NULL; l = l->next)
+    {
+        UnfinishedJournal *unfinished = l->data;
+
+        l->data = g_file_new_for_path (unfinished->path);
+        unfinished_journal_free (unfinished);
+    }
+
+    return journals;
+}
+
+GFile *
+nautilus_copy_journal_get_location (NautilusCopyJournal *journal)
+{
+    g_return_val_if_fail (journal != NULL, NULL);
+
+    return g_file_new_for_path (journal->path);
+}
+
+GList *
+nautilus_copy_journal_get_files (NautilusCopyJournal *journal)
+{
+    g_return_val_if_fail (journal != NULL, NULL);
+
+    return journal->files;
+}
+
+GFile *
+nautilus_copy_journal_get_destination (NautilusCopyJournal *journal)
+{
+    g_return_val_if_fail (journal != NULL, NULL);
+
+    return journal->destination;
+}
+
+gboolean
+nautilus_copy_journal_get_is_move (NautilusCopyJournal *journal)
+{
+    g_return_val_if_fail (journal != NULL, FALSE);
+
+    return journal->is_move;
+}
+
+gboolean
+nautilus_copy_journal_is_done (NautilusCopyJournal *journal,
+                               GFile               *file)
+{
+    g_autofree char *uri = NULL;
+
+    g_return_val_if_fail (journal != NULL, FALSE);
+
+    if (g_hash_table_size (journal->done) == 0)
+    {
+        return FALSE;
+    }
+
+    uri = g_file_get_uri (file);
+
+    return g_hash_table_contains (journal->done, uri);
+}
+
+static void
+journal_maybe_sync (NautilusCopyJournal *journal)
+{
+    if (g_get_monotonic_time () - journal->last_sync_time >= JOURNAL_SYNC_INTERVAL)
+    {
+        nautilus_copy_journal_sync (journal);
+    }
+}
+
+void
+nautilus_copy_journal_add_done (NautilusCopyJournal *journal,
+                                GFile               *file)
+{
+    char *uri;
+    gsize shared;
+
+    g_return_if_fail (journal != NULL);
+
+    uri = g_file_get_uri (file);
+
+    shared = 0;
+    if (journal->last_done_uri != NULL)
+    {
+        while (uri[shared] != '\0' && uri[shared] == journal->last_done_uri[shared])
+        {
+            shared++;
+        }
+    }
+
+    g_string_append_printf (journal->pending, "d %" G_GSIZE_FORMAT " %s\n",
+                            shared, uri + shared);
+
+    g_hash_table_remove (journal->partials, uri);
+    g_free (journal->last_done_uri);
+    journal->last_done_uri = uri;
+
+    journal_maybe_sync (journal);
+}
+
+gboolean
+nautilus_copy_journal_get_partial (NautilusCopyJournal  *journal,
+                                   GFile                *file,
+                                   GFile               **dest,
+                                   goffset              *offset,
+                                   goffset              *size,
+                                   gint64               *mtime)
+{
+    g_autofree char *uri = NULL;
+    JournalPartial *partial;
+
+    g_return_val_if_fail (journal != NULL, FALSE);
+
+    if (g_hash_table_size (journal->partials) == 0)
+    {
+        return FALSE;
+    }
+
+    uri = g_file_get_uri (file);
+    partial = g_hash_table_lookup (journal->partials, uri);
+    if (partial == NULL)
+    {
+        return FALSE;
+    }
+
+    if (dest != NULL)
+    {
+        *dest = g_object_ref (partial->dest);
+    }
+    if (offset != NULL)
+    {
+        *offset = partial->offset;
+    }
+    if (size != NULL)
+    {
+        *size = partial->size;
+    }
+    if (mtime != NULL)
+    {
+        *mtime = partial->mtime;
+    }
+
+    return TRUE;
+}
+
+void
+nautilus_copy_journal_set_partial (NautilusCopyJournal *journal,
+                                   GFile               *file,
+                                   GFile               *dest,
+                                   goffset              offset,
+                                   goffset              size,
+                                   gint64               mtime)
+{
+    g_autofree char *dest_uri = NULL;
+    JournalPartial *partial;
+    char *uri;
+
+    g_return_if_fail (journal != NULL);
+
+    uri = g_file_get_uri (file);
+    dest_uri = g_file_get_uri (dest);
+
+    g_string_append_printf (journal->pending,
+                            "p %" G_GOFFSET_FORMAT " %" G_GOFFSET_FORMAT " %" G_GINT64_FORMAT " %s %s\n",
+                            offset, size, mtime, uri, dest_uri);
+
+    partial = g_new0 (JournalPartial, 1);
+    partial->dest = g_object_ref (dest);
+    partial->offset = offset;
+    partial->size = size;
+    partial->mtime = mtime;
+    g_hash_table_replace (journal->partials, uri, partial);
+
+    journal_maybe_sync (journal);
+}
+
+void
+nautilus_copy_journal_sync (NautilusCopyJournal *journal)
+{
+    g_return_if_fail (journal != NULL);
+
+    journal->last_sync_time = g_get_monotonic_time ();
+
+    if (journal->pending->len == 0 || journal->fd < 0)
+    {
+        g_string_truncate (journal->pending, 0);
+        return;
+    }
+
+    /* The files must be on disk before the records saying so */
+#ifdef HAVE_SYNCFS
+    if (journal->dest_fd >= 0)
+    {
+        syncfs (journal->dest_fd);
+    }
+#else
+    sync ();
+#endif
+
+    if (nautilus_write_all (journal->fd, journal->pending->str, journal->pending->len, -1) != 0 ||
+        fdatasync (journal->fd) < 0)
+    {
+        /* Whatever made it is still good, the job just can't be resumed
+         * from any later.
+         */
+        g_warning ("Could not write the copy journal %s: %s",
+                   journal->path, g_strerror (errno));
+        close (journal->fd);
+        journal->fd = -1;
+    }
+
+    g_string_truncate (journal->pending, 0);
+}
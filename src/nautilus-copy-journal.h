@@ -0,0 +1,91 @@
+/* nautilus-copy-journal.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A copy or move to a local folder keeps a journal of the files it is done
+ * with, and of how far it got into the large file it is copying, so that it
+ * can be resumed after it was cancelled or killed. The journals live in the
+ * user data folder until their job finishes, or until they are pruned, see
+ * nautilus_copy_journal_list_unfinished().
+ *
+ * Records are written out every few seconds, after the destination file
+ * system is synced, so a record never gets to disk before the data it
+ * describes.
+ *
+ * A journal is only used from one thread at a time.
+ */
+
+typedef struct _NautilusCopyJournal NautilusCopyJournal;
+
+NautilusCopyJournal *nautilus_copy_journal_new             (GList                *files,
+                                                            GFile                *destination,
+                                                            gboolean              is_move,
+                                                            GError              **error);
+NautilusCopyJournal *nautilus_copy_journal_load            (GFile                *location,
+                                                            GError              **error);
+/* Closes the journal, and removes it if @finished. */
+void                 nautilus_copy_journal_close           (NautilusCopyJournal  *journal,
+                                                            gboolean              finished);
+
+/* Returns the journals left behind by jobs that did not finish, newest
+ * first. Those older than a week, and all but the 16 newest, are removed
+ * along with their partial copies.
+ */
+GList               *nautilus_copy_journal_list_unfinished (void);
+
+GFile               *nautilus_copy_journal_get_location    (NautilusCopyJournal  *journal);
+GList               *nautilus_copy_journal_get_files       (NautilusCopyJournal  *journal);
+GFile               *nautilus_copy_journal_get_destination (NautilusCopyJournal  *journal);
+gboolean             nautilus_copy_journal_get_is_move     (NautilusCopyJournal  *journal);
+
+/* Whether @file was done with in an earlier run. */
+gboolean             nautilus_copy_journal_is_done         (NautilusCopyJournal  *journal,
+                                                            GFile                *file);
+void                 nautilus_copy_journal_add_done        (NautilusCopyJournal  *journal,
+                                                            GFile                *file);
+
+/* A partial copy of @file into @dest, good up to @offset when @file had
+ * @size and @mtime. @dest is the partial file of the destination, see
+ * nautilus_copy_journal_get_partial_file().
+ */
+gboolean             nautilus_copy_journal_get_partial     (NautilusCopyJournal  *journal,
+                                                            GFile                *file,
+                                                            GFile               **dest,
+                                                            goffset              *offset,
+                                                            goffset              *size,
+                                                            gint64               *mtime);
+void                 nautilus_copy_journal_set_partial     (NautilusCopyJournal  *journal,
+                                                            GFile                *file,
+                                                            GFile                *dest,
+                                                            goffset               offset,
+                                                            goffset               size,
+                                                            gint64                mtime);
+
+/* Where a copy to @dest is written until it is complete, so that a copy
+ * left partial is never mistaken for the file: a hidden file next to it.
+ * Returns NULL if the name would be too long.
+ */
+GFile               *nautilus_copy_journal_get_partial_file (GFile                *dest);
+
+/* Writes the pending records out now. */
+void                 nautilus_copy_journal_sync            (NautilusCopyJournal  *journal);
+
+G_END_DECLS
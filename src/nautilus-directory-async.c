@@ -35,16 +35,110 @@
 #include "nautilus-metadata.h"
 #include "nautilus-profile.h"
 #include "nautilus-signaller.h"
+#include "nautilus-thumbnail-cache.h"
+#include "nautilus-thumbnails.h"
 
 /* turn this on to check if async. job calls are balanced */
 #if 0
 #define DEBUG_ASYNC_JOBS
 #endif
 
-#define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
+/* Number of files asked for per g_file_enumerator_next_files_async ()
+ * round trip. Each file system starts at ENUMERATION_INITIAL_BATCH and
+ * adapts within these bounds, so that a batch takes at most
+ * ENUMERATION_BATCH_WAIT to arrive, which gets the first files of a slow
+ * mount on screen quickly, and at most ENUMERATION_BATCH_DISPATCH to
+ * handle on the main thread.
+ */
+#define ENUMERATION_MIN_BATCH 16
+#define ENUMERATION_INITIAL_BATCH 100
+#define ENUMERATION_MAX_BATCH 4096
+#define ENUMERATION_BATCH_WAIT (200 * G_TIME_SPAN_MILLISECOND)
+#define ENUMERATION_BATCH_DISPATCH (8 * G_TIME_SPAN_MILLISECOND)
+
+/* Pending file infos are queued in chunks of this many, and turned into
+ * files for at most DEQUEUE_PENDING_TIME_SLICE per idle callback, checking
+ * the time every DEQUEUE_PENDING_CHECK_INTERVAL files.
+ */
+#define PENDING_FILE_INFO_CHUNK_SIZE 256
+#define DEQUEUE_PENDING_TIME_SLICE (10 * G_TIME_SPAN_MILLISECOND)
+#define DEQUEUE_PENDING_CHECK_INTERVAL 32
+
+/* Number of directories a deep count enumerates at the same time. */
+#define DEEP_COUNT_MAX_ENUMERATORS 4
+
+/* Number of thumbnails of a directory read and decoded at the same
+ * time, on worker threads.
+ */
+#define THUMBNAIL_MAX_LOADS 4
+
+/* Async. jobs are scheduled in one pool per file system. Each pool
+ * starts out allowing ASYNC_JOB_POOL_INITIAL_JOBS jobs at a time and
+ * adapts that limit, within the bounds below, to how quickly its jobs
+ * complete. A slow network mount thus throttles itself without starving
+ * directories on other file systems.
+ */
+#define ASYNC_JOB_POOL_MIN_JOBS 2
+#define ASYNC_JOB_POOL_INITIAL_JOBS 10
+#define ASYNC_JOB_POOL_MAX_JOBS 32
+
+/* Average job latencies (in microseconds) below which a saturated pool
+ * may grow, and above which it shrinks.
+ */
+#define ASYNC_JOB_FAST_LATENCY (20 * G_TIME_SPAN_MILLISECOND)
+#define ASYNC_JOB_SLOW_LATENCY (400 * G_TIME_SPAN_MILLISECOND)
+
+/* Background jobs (deep counts) never take more than this share of a pool,
+ * so foreground work for visible windows always finds a free slot.
+ */
+#define ASYNC_JOB_BACKGROUND_SHARE 2
+
+/* What files are enumerated for. Handling a batch of files on the main
+ * thread costs very different amounts for each of these.
+ */
+typedef enum
+{
+    ENUMERATION_DIRECTORY_LOAD,
+    ENUMERATION_DIRECTORY_COUNT,
+    ENUMERATION_DEEP_COUNT,
+    ENUMERATION_MIME_LIST,
+    ENUMERATION_LAST
+} EnumerationKind;
+
+struct AsyncJobPool
+{
+    char *id;
+    int job_count;
+    int background_job_count;
+    int max_jobs;
+    GTimeSpan average_latency;
+    /* Directories waiting for a slot, in FIFO order. */
+    GQueue waiting[ASYNC_JOB_CLASS_LAST];
+
+    /* Average cost per enumerated file, in nanoseconds, of waiting for
+     * the file system and of handling the file on the main thread.
+     */
+    gint64 enumeration_wait_per_file;
+    gint64 enumeration_dispatch_per_file[ENUMERATION_LAST];
+    /* Totals, reported through nautilus-profile. */
+    guint64 enumeration_batches;
+    guint64 enumeration_files;
+};
+
+/* The round trips of one enumeration. */
+typedef struct
+{
+    AsyncJobPool *pool;
+    EnumerationKind kind;
+    int size;
+    gint64 request_time;
+    gint64 dispatch_start;
 
-/* Keep async. jobs down to this number for all directories. */
-#define MAX_ASYNC_JOBS 10
+    int n_batches;
+    int n_files;
+    GTimeSpan wait_time;
+    GTimeSpan dispatch_time;
+} EnumerationBatch;
 
 struct ThumbnailState
 {
@@ -75,6 +169,7 @@ struct DirectoryLoadState
     GHashTable *load_mime_list_hash;
     NautilusFile *load_directory_file;
     int load_file_count;
+    EnumerationBatch batch;
 };
 
 struct MimeListState
@@ -84,6 +179,7 @@ struct MimeListState
     GCancellable *cancellable;
     GFileEnumerator *enumerator;
     GHashTable *mime_list_hash;
+    EnumerationBatch batch;
 };
 
 struct GetInfoState
@@ -106,19 +202,36 @@ struct DirectoryCountState
     GCancellable *cancellable;
     GFileEnumerator *enumerator;
     int file_count;
+    EnumerationBatch batch;
 };
 
 struct DeepCountState
 {
     NautilusDirectory *directory;
     GCancellable *cancellable;
-    GFileEnumerator *enumerator;
-    GFile *deep_count_location;
-    GList *deep_count_subdirectories;
-    GArray *seen_deep_count_inodes;
+    /* Directories still to be enumerated, shared by all enumerators. */
+    GQueue subdirectories;
+    /* DeepCountInode of the hard linked files counted so far. */
+    GHashTable *seen_inodes;
+    int n_enumerators;
     char *fs_id;
 };
 
+/* One of the enumerations a deep count runs at the same time. */
+typedef struct
+{
+    DeepCountState *state;
+    GFile *location;
+    GFileEnumerator *enumerator;
+    EnumerationBatch batch;
+} DeepCountEnumerator;
+
+typedef struct
+{
+    guint32 device;
+    guint64 inode;
+} DeepCountInode;
+
 
 
 typedef struct
@@ -144,6 +257,11 @@ typedef struct
     gboolean monitor_hidden_files;     /* defines whether "all" includes hidden files */
     gconstpointer client;
     Request request;
+    /* The files the client shows, with some around them. The slow
+     * attributes, see request_follows_viewport(), are only loaded for
+     * those. NULL means all. The files are not referenced, only
+     * compared. */
+    GHashTable *viewport;
 } Monitor;
 
 typedef struct
@@ -157,16 +275,18 @@ typedef struct
 typedef gboolean (*RequestCheck) (Request);
 typedef gboolean (*FileCheck) (NautilusFile *);
 
-/* Current number of async. jobs. */
-static int async_job_count;
-static GHashTable *waiting_directories;
+/* One AsyncJobPool per file system. There are only ever a handful of
+ * them, and waking up directories may add new ones, so keep them in an
+ * array rather than a hash table.
+ */
+static GPtrArray *async_job_pools;
 #ifdef DEBUG_ASYNC_JOBS
 static GHashTable *async_jobs;
 #endif
 
 /* Forward declarations for functions that need them. */
-static void     deep_count_load (DeepCountState *state,
-                                 GFile          *location);
+static void     deep_count_load (DeepCountEnumerator *enumerator,
+                                 GFile               *location);
 static gboolean request_is_satisfied (NautilusDirectory *directory,
                                       NautilusFile      *file,
                                       Request            request);
@@ -329,33 +449,456 @@ nautilus_directory_verify_request_counts (NautilusDirectory *directory)
 }
 #endif
 
+static const char *
+async_job_get_name (RequestType job)
+{
+    switch (job)
+    {
+        case REQUEST_DEEP_COUNT:
+        {
+            return "deep count";
+        }
+
+        case REQUEST_DIRECTORY_COUNT:
+        {
+            return "directory count";
+        }
+
+        case REQUEST_FILE_INFO:
+        {
+            return "file info";
+        }
+
+        case REQUEST_FILE_LIST:
+        {
+            return "file list";
+        }
+
+        case REQUEST_MIME_LIST:
+        {
+            return "MIME list";
+        }
+
+        case REQUEST_EXTENSION_INFO:
+        {
+            return "extension info";
+        }
+
+        case REQUEST_THUMBNAIL:
+        {
+            return "thumbnail";
+        }
+
+        case REQUEST_MOUNT:
+        {
+            return "mount";
+        }
+
+        case REQUEST_FILESYSTEM_INFO:
+        {
+            return "filesystem info";
+        }
+
+        default:
+        {
+            g_assert_not_reached ();
+        }
+    }
+
+    return NULL;
+}
+
+static AsyncJobClass
+async_job_get_class (RequestType job)
+{
+    /* Deep counts walk whole subtrees on behalf of the properties
+     * window and must not hold up what the views are showing.
+     */
+    return job == REQUEST_DEEP_COUNT ? ASYNC_JOB_CLASS_BACKGROUND : ASYNC_JOB_CLASS_FOREGROUND;
+}
+
+/* Whether the duration of a job says something about the file system
+ * rather than about the amount of work asked for. Loading a file list or
+ * a deep count legitimately takes long on a big directory, and a single
+ * thumbnail job covers a whole burst of loads.
+ */
+static gboolean
+async_job_measures_latency (RequestType job)
+{
+    return job == REQUEST_FILE_INFO ||
+           job == REQUEST_DIRECTORY_COUNT ||
+           job == REQUEST_FILESYSTEM_INFO;
+}
+
+static AsyncJobPool *
+async_job_pool_get (const char *id)
+{
+    AsyncJobPool *pool;
+    guint i;
+
+    if (async_job_pools == NULL)
+    {
+        async_job_pools = g_ptr_array_new ();
+    }
+
+    for (i = 0; i < async_job_pools->len; i++)
+    {
+        pool = g_ptr_array_index (async_job_pools, i);
+        if (strcmp (pool->id, id) == 0)
+        {
+            return pool;
+        }
+    }
+
+    pool = g_new0 (AsyncJobPool, 1);
+    pool->id = g_strdup (id);
+    pool->max_jobs = ASYNC_JOB_POOL_INITIAL_JOBS;
+    for (i = 0; i < ASYNC_JOB_CLASS_LAST; i++)
+    {
+        g_queue_init (&pool->waiting[i]);
+    }
+    g_ptr_array_add (async_job_pools, pool);
+
+    return pool;
+}
+
+static gboolean
+async_job_directory_is_idle (NautilusDirectory *directory)
+{
+    int i;
+
+    if (directory->details->async_job_count > 0)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < ASYNC_JOB_CLASS_LAST; i++)
+    {
+        if (directory->details->async_job_waiting_link[i] != NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Return the pool the jobs of a directory are scheduled in. The file system
+ * id of a directory is only known once its own file info has been read, so
+ * until then jobs are scheduled by URI scheme. The pool of a directory only
+ * changes while it has no jobs running or waiting, which keeps the
+ * accounting of each pool balanced.
+ */
+static AsyncJobPool *
+async_job_pool_for_directory (NautilusDirectory *directory)
+{
+    NautilusFile *file;
+    const char *filesystem_id;
+    char *scheme;
+
+    if (directory->details->async_job_pool != NULL &&
+        !async_job_directory_is_idle (directory))
+    {
+        return directory->details->async_job_pool;
+    }
+
+    file = directory->details->as_file;
+    filesystem_id = file != NULL ? eel_ref_str_peek (file->details->filesystem_id) : NULL;
+    if (filesystem_id != NULL)
+    {
+        directory->details->async_job_pool = async_job_pool_get (filesystem_id);
+    }
+    else
+    {
+        scheme = g_file_get_uri_scheme (directory->details->location);
+        directory->details->async_job_pool = async_job_pool_get (scheme != NULL ? scheme : "");
+        g_free (scheme);
+    }
+
+    return directory->details->async_job_pool;
+}
+
+static gboolean
+async_job_pool_has_slot (AsyncJobPool  *pool,
+                         AsyncJobClass  job_class)
+{
+    if (pool->job_count >= pool->max_jobs)
+    {
+        return FALSE;
+    }
+
+    if (job_class == ASYNC_JOB_CLASS_BACKGROUND &&
+        pool->background_job_count >= MAX (1, pool->max_jobs / ASYNC_JOB_BACKGROUND_SHARE))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+async_job_pool_enqueue (AsyncJobPool      *pool,
+                        NautilusDirectory *directory,
+                        AsyncJobClass      job_class)
+{
+    if (directory->details->async_job_waiting_link[job_class] != NULL)
+    {
+        return;
+    }
+
+    g_queue_push_tail (&pool->waiting[job_class], directory);
+    directory->details->async_job_waiting_link[job_class] = g_queue_peek_tail_link (&pool->waiting[job_class]);
+}
+
+static void
+async_job_pool_dequeue (AsyncJobPool      *pool,
+                        NautilusDirectory *directory)
+{
+    int i;
+
+    for (i = 0; i < ASYNC_JOB_CLASS_LAST; i++)
+    {
+        if (directory->details->async_job_waiting_link[i] != NULL)
+        {
+            g_queue_delete_link (&pool->waiting[i],
+                                 directory->details->async_job_waiting_link[i]);
+            directory->details->async_job_waiting_link[i] = NULL;
+        }
+    }
+}
+
+/* Grow a pool that keeps completing jobs quickly while all of its slots
+ * are in use, and shrink one whose jobs are slow to complete.
+ */
+static void
+async_job_pool_adapt (AsyncJobPool *pool,
+                      GTimeSpan     latency)
+{
+    if (pool->average_latency == 0)
+    {
+        pool->average_latency = latency;
+    }
+    else
+    {
+        pool->average_latency = (7 * pool->average_latency + latency) / 8;
+    }
+
+    if (pool->average_latency > ASYNC_JOB_SLOW_LATENCY &&
+        pool->max_jobs > ASYNC_JOB_POOL_MIN_JOBS)
+    {
+        pool->max_jobs -= 1;
+        DEBUG ("shrinking job pool %s to %d", pool->id, pool->max_jobs);
+    }
+    else if (pool->average_latency < ASYNC_JOB_FAST_LATENCY &&
+             pool->job_count >= pool->max_jobs &&
+             pool->max_jobs < ASYNC_JOB_POOL_MAX_JOBS)
+    {
+        pool->max_jobs += 1;
+        DEBUG ("growing job pool %s to %d", pool->id, pool->max_jobs);
+    }
+}
+
+static const char *
+enumeration_kind_get_name (EnumerationKind kind)
+{
+    switch (kind)
+    {
+        case ENUMERATION_DIRECTORY_LOAD:
+        {
+            return "directory load";
+        }
+
+        case ENUMERATION_DIRECTORY_COUNT:
+        {
+            return "directory count";
+        }
+
+        case ENUMERATION_DEEP_COUNT:
+        {
+            return "deep count";
+        }
+
+        case ENUMERATION_MIME_LIST:
+        {
+            return "mime list";
+        }
+
+        default:
+        {
+            g_assert_not_reached ();
+        }
+    }
+
+    return NULL;
+}
+
+static void
+enumeration_batch_init (EnumerationBatch  *batch,
+                        NautilusDirectory *directory,
+                        EnumerationKind    kind)
+{
+    batch->pool = async_job_pool_for_directory (directory);
+    batch->kind = kind;
+}
+
+static int
+enumeration_batch_get_next_size (EnumerationBatch *batch)
+{
+    AsyncJobPool *pool;
+    gint64 dispatch_per_file;
+    gint64 size;
+
+    pool = batch->pool;
+    dispatch_per_file = pool->enumeration_dispatch_per_file[batch->kind];
+
+    if (pool->enumeration_wait_per_file == 0 && dispatch_per_file == 0)
+    {
+        return ENUMERATION_INITIAL_BATCH;
+    }
+
+    size = ENUMERATION_MAX_BATCH;
+    if (pool->enumeration_wait_per_file > 0)
+    {
+        size = MIN (size, ENUMERATION_BATCH_WAIT * 1000 / pool->enumeration_wait_per_file);
+    }
+    if (dispatch_per_file > 0)
+    {
+        size = MIN (size, ENUMERATION_BATCH_DISPATCH * 1000 / dispatch_per_file);
+    }
+
+    /* Don't jump to a huge batch on the strength of a single one. */
+    if (batch->size > 0)
+    {
+        size = MIN (size, 2 * batch->size);
+    }
+
+    return CLAMP (size, ENUMERATION_MIN_BATCH, ENUMERATION_MAX_BATCH);
+}
+
+static void
+enumeration_batch_request (EnumerationBatch    *batch,
+                           GFileEnumerator     *enumerator,
+                           int                  io_priority,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    batch->size = enumeration_batch_get_next_size (batch);
+    batch->request_time = g_get_monotonic_time ();
+
+    g_file_enumerator_next_files_async (enumerator,
+                                        batch->size,
+                                        io_priority,
+                                        cancellable,
+                                        callback,
+                                        user_data);
+}
+
+static void
+update_average_per_file (gint64    *average,
+                         GTimeSpan  elapsed,
+                         guint      n_files)
+{
+    gint64 per_file;
+
+    per_file = MAX (elapsed * 1000 / n_files, 1);
+    if (*average == 0)
+    {
+        *average = per_file;
+    }
+    else
+    {
+        *average = (3 * *average + per_file) / 4;
+    }
+}
+
+/* Call when a batch of @n_files arrived, before handling it. */
+static void
+enumeration_batch_received (EnumerationBatch *batch,
+                            guint             n_files)
+{
+    GTimeSpan wait;
+
+    batch->dispatch_start = g_get_monotonic_time ();
+    wait = batch->dispatch_start - batch->request_time;
+
+    batch->n_batches += 1;
+    batch->n_files += n_files;
+    batch->wait_time += wait;
+    batch->pool->enumeration_batches += 1;
+    batch->pool->enumeration_files += n_files;
+
+    if (n_files > 0)
+    {
+        update_average_per_file (&batch->pool->enumeration_wait_per_file, wait, n_files);
+    }
+}
+
+/* Call when the batch of @n_files has been handled. */
+static void
+enumeration_batch_dispatched (EnumerationBatch *batch,
+                              guint             n_files)
+{
+    GTimeSpan dispatch;
+
+    dispatch = g_get_monotonic_time () - batch->dispatch_start;
+    batch->dispatch_time += dispatch;
+
+    if (n_files > 0)
+    {
+        update_average_per_file (&batch->pool->enumeration_dispatch_per_file[batch->kind],
+                                 dispatch, n_files);
+    }
+}
+
+static void
+enumeration_batch_finish (EnumerationBatch *batch)
+{
+    DEBUG ("%s in job pool %s: %d files in %d batches (last %d), "
+           "%" G_GINT64_FORMAT " us waiting, %" G_GINT64_FORMAT " us dispatching",
+           enumeration_kind_get_name (batch->kind), batch->pool->id,
+           batch->n_files, batch->n_batches, batch->size,
+           batch->wait_time, batch->dispatch_time);
+
+    nautilus_profile_msg ("Enumeration %s in %s: %d files in %d batches (last %d), "
+                          "%" G_GINT64_FORMAT " us waiting, %" G_GINT64_FORMAT " us dispatching, "
+                          "%" G_GUINT64_FORMAT " files in %" G_GUINT64_FORMAT " batches in total",
+                          enumeration_kind_get_name (batch->kind), batch->pool->id,
+                          batch->n_files, batch->n_batches, batch->size,
+                          batch->wait_time, batch->dispatch_time,
+                          batch->pool->enumeration_files, batch->pool->enumeration_batches);
+}
+
 /* Start a job. This is really just a way of limiting the number of
  * async. requests that we issue at any given time. Without this, the
  * number of requests is unbounded.
  */
 static gboolean
 async_job_start (NautilusDirectory *directory,
-                 const char        *job)
+                 RequestType        job)
 {
+    AsyncJobPool *pool;
+    AsyncJobClass job_class;
 #ifdef DEBUG_ASYNC_JOBS
     char *key;
 #endif
 
-    DEBUG ("starting %s in %p", job, directory->details->location);
+    DEBUG ("starting %s in %p", async_job_get_name (job), directory->details->location);
 
-    g_assert (async_job_count >= 0);
-    g_assert (async_job_count <= MAX_ASYNC_JOBS);
+    pool = async_job_pool_for_directory (directory);
+    job_class = async_job_get_class (job);
 
-    if (async_job_count >= MAX_ASYNC_JOBS)
-    {
-        if (waiting_directories == NULL)
-        {
-            waiting_directories = g_hash_table_new (NULL, NULL);
-        }
+    g_assert (pool->job_count >= 0);
 
-        g_hash_table_insert (waiting_directories,
-                             directory,
-                             directory);
+    /* Queue up behind directories that have been waiting longer, unless
+     * this one was just woken up to take a free slot.
+     */
+    if (!async_job_pool_has_slot (pool, job_class) ||
+        (!g_queue_is_empty (&pool->waiting[job_class]) &&
+         directory->details->async_job_waiting_link[job_class] == NULL &&
+         !directory->details->async_job_waking_up))
+    {
+        async_job_pool_enqueue (pool, directory, job_class);
 
         return FALSE;
     }
@@ -368,45 +911,57 @@ async_job_start (NautilusDirectory *directory,
             async_jobs = g_hash_table_new (g_str_hash, g_str_equal);
         }
         uri = nautilus_directory_get_uri (directory);
-        key = g_strconcat (uri, ": ", job, NULL);
+        key = g_strconcat (uri, ": ", async_job_get_name (job), NULL);
         if (g_hash_table_lookup (async_jobs, key) != NULL)
         {
             g_warning ("same job twice: %s in %s",
-                       job, uri);
+                       async_job_get_name (job), uri);
         }
         g_free (uri);
         g_hash_table_insert (async_jobs, key, directory);
     }
 #endif
 
-    async_job_count += 1;
+    pool->job_count += 1;
+    if (job_class == ASYNC_JOB_CLASS_BACKGROUND)
+    {
+        pool->background_job_count += 1;
+    }
+    directory->details->async_job_count += 1;
+    directory->details->async_job_start_time[job] = g_get_monotonic_time ();
+
     return TRUE;
 }
 
 /* End a job. */
 static void
 async_job_end (NautilusDirectory *directory,
-               const char        *job)
+               RequestType        job)
 {
+    AsyncJobPool *pool;
 #ifdef DEBUG_ASYNC_JOBS
     char *key;
     gpointer table_key, value;
 #endif
 
-    DEBUG ("stopping %s in %p", job, directory->details->location);
+    DEBUG ("stopping %s in %p", async_job_get_name (job), directory->details->location);
 
-    g_assert (async_job_count > 0);
+    pool = directory->details->async_job_pool;
+
+    g_assert (pool != NULL);
+    g_assert (pool->job_count > 0);
+    g_assert (directory->details->async_job_count > 0);
 
 #ifdef DEBUG_ASYNC_JOBS
     {
         char *uri;
         uri = nautilus_directory_get_uri (directory);
         g_assert (async_jobs != NULL);
-        key = g_strconcat (uri, ": ", job, NULL);
+        key = g_strconcat (uri, ": ", async_job_get_name (job), NULL);
         if (!g_hash_table_lookup_extended (async_jobs, key, &table_key, &value))
         {
             g_warning ("ending job we didn't start: %s in %s",
-                       job, uri);
+                       async_job_get_name (job), uri);
         }
         else
         {
@@ -418,33 +973,40 @@ async_job_end (NautilusDirectory *directory,
     }
 #endif
 
-    async_job_count -= 1;
-}
-
-/* Helper to get one value from a hash table. */
-static void
-get_one_value_callback (gpointer key,
-                        gpointer value,
-                        gpointer callback_data)
-{
-    gpointer *returned_value;
+    if (async_job_measures_latency (job))
+    {
+        async_job_pool_adapt (pool,
+                              g_get_monotonic_time () - directory->details->async_job_start_time[job]);
+    }
 
-    returned_value = callback_data;
-    *returned_value = value;
+    pool->job_count -= 1;
+    if (async_job_get_class (job) == ASYNC_JOB_CLASS_BACKGROUND)
+    {
+        pool->background_job_count -= 1;
+    }
+    directory->details->async_job_count -= 1;
 }
 
-/* return a single value from a hash table. */
-static gpointer
-get_one_value (GHashTable *table)
+static void
+async_job_pool_wake_up (AsyncJobPool *pool)
 {
-    gpointer value;
+    NautilusDirectory *directory;
+    int i;
 
-    value = NULL;
-    if (table != NULL)
+    /* Foreground waiters get the free slots first. */
+    for (i = 0; i < ASYNC_JOB_CLASS_LAST; i++)
     {
-        g_hash_table_foreach (table, get_one_value_callback, &value);
+        while (async_job_pool_has_slot (pool, i) &&
+               !g_queue_is_empty (&pool->waiting[i]))
+        {
+            directory = g_queue_pop_head (&pool->waiting[i]);
+            directory->details->async_job_waiting_link[i] = NULL;
+
+            directory->details->async_job_waking_up = TRUE;
+            nautilus_directory_async_state_changed (directory);
+            directory->details->async_job_waking_up = FALSE;
+        }
     }
-    return value;
 }
 
 /* Wake up directories that are "blocked" as long as there are job
@@ -454,27 +1016,17 @@ static void
 async_job_wake_up (void)
 {
     static gboolean already_waking_up = FALSE;
-    gpointer value;
-
-    g_assert (async_job_count >= 0);
-    g_assert (async_job_count <= MAX_ASYNC_JOBS);
+    guint i;
 
-    if (already_waking_up)
+    if (already_waking_up || async_job_pools == NULL)
     {
         return;
     }
 
     already_waking_up = TRUE;
-    while (async_job_count < MAX_ASYNC_JOBS)
+    for (i = 0; i < async_job_pools->len; i++)
     {
-        value = get_one_value (waiting_directories);
-        if (value == NULL)
-        {
-            break;
-        }
-        g_hash_table_remove (waiting_directories, value);
-        nautilus_directory_async_state_changed
-            (NAUTILUS_DIRECTORY (value));
+        async_job_pool_wake_up (g_ptr_array_index (async_job_pools, i));
     }
     already_waking_up = FALSE;
 }
@@ -504,7 +1056,7 @@ deep_count_cancel (NautilusDirectory *directory)
         directory->details->deep_count_in_progress = NULL;
         directory->details->deep_count_file = NULL;
 
-        async_job_end (directory, "deep count");
+        async_job_end (directory, REQUEST_DEEP_COUNT);
     }
 }
 
@@ -517,15 +1069,55 @@ mime_list_cancel (NautilusDirectory *directory)
     }
 }
 
+static ThumbnailState *
+thumbnail_load_for_file (NautilusDirectory *directory,
+                         NautilusFile      *file)
+{
+    GList *node;
+    ThumbnailState *state;
+
+    for (node = directory->details->thumbnails_in_progress; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->file == file)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
+/* Forget about a load that is done or cancelled. */
+static void
+thumbnail_load_remove (NautilusDirectory *directory,
+                       ThumbnailState    *state)
+{
+    directory->details->thumbnails_in_progress =
+        g_list_remove (directory->details->thumbnails_in_progress, state);
+
+    /* All the loads of a directory share one async. job. */
+    if (directory->details->thumbnails_in_progress == NULL)
+    {
+        async_job_end (directory, REQUEST_THUMBNAIL);
+    }
+}
+
+static void
+thumbnail_load_cancel (NautilusDirectory *directory,
+                       ThumbnailState    *state)
+{
+    g_cancellable_cancel (state->cancellable);
+    state->directory = NULL;
+    thumbnail_load_remove (directory, state);
+}
+
 static void
 thumbnail_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->thumbnail_state != NULL)
+    while (directory->details->thumbnails_in_progress != NULL)
     {
-        g_cancellable_cancel (directory->details->thumbnail_state->cancellable);
-        directory->details->thumbnail_state->directory = NULL;
-        directory->details->thumbnail_state = NULL;
-        async_job_end (directory, "thumbnail");
+        thumbnail_load_cancel (directory, directory->details->thumbnails_in_progress->data);
     }
 }
 
@@ -537,7 +1129,7 @@ mount_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (directory->details->mount_state->cancellable);
         directory->details->mount_state->directory = NULL;
         directory->details->mount_state = NULL;
-        async_job_end (directory, "mount");
+        async_job_end (directory, REQUEST_MOUNT);
     }
 }
 
@@ -551,7 +1143,7 @@ file_info_cancel (NautilusDirectory *directory)
         directory->details->get_info_in_progress = NULL;
         directory->details->get_info_file = NULL;
 
-        async_job_end (directory, "file info");
+        async_job_end (directory, REQUEST_FILE_INFO);
     }
 }
 
@@ -633,6 +1225,7 @@ remove_monitor_link (NautilusDirectory *directory,
                                         monitor->request);
         directory->details->monitor_list =
             g_list_remove_link (directory->details->monitor_list, link);
+        g_clear_pointer (&monitor->viewport, g_hash_table_destroy);
         g_free (monitor);
         g_list_free_1 (link);
     }
@@ -749,6 +1342,7 @@ nautilus_directory_monitor_add_internal (NautilusDirectory         *directory,
     monitor->monitor_hidden_files = monitor_hidden_files;
     monitor->client = client;
     monitor->request = nautilus_directory_set_up_request (file_attributes);
+    monitor->viewport = NULL;
 
     if (file == NULL)
     {
@@ -801,6 +1395,81 @@ nautilus_directory_monitor_add_internal (NautilusDirectory         *directory,
     nautilus_profile_end (NULL);
 }
 
+/* Same as nautilus_directory_monitor_add_internal() for each of @files, which
+ * are all in @directory, but looks up the monitors to replace in one pass
+ * and kicks off the I/O once.
+ */
+void
+nautilus_directory_monitor_add_files (NautilusDirectory      *directory,
+                                      GList                  *files,
+                                      gconstpointer           client,
+                                      gboolean                monitor_hidden_files,
+                                      NautilusFileAttributes  file_attributes)
+{
+    g_autoptr (GHashTable) existing = NULL;
+    Monitor *monitor;
+    Request request;
+    GList *link;
+    GList *l;
+
+    g_assert (NAUTILUS_IS_DIRECTORY (directory));
+
+    if (files == NULL)
+    {
+        return;
+    }
+
+    /* File -> link of its monitor for this client */
+    existing = g_hash_table_new (NULL, NULL);
+    for (l = directory->details->monitor_list; l != NULL; l = l->next)
+    {
+        monitor = l->data;
+        if (monitor->client == client && monitor->file != NULL)
+        {
+            g_hash_table_insert (existing, monitor->file, l);
+        }
+    }
+
+    request = nautilus_directory_set_up_request (file_attributes);
+    for (l = files; l != NULL; l = l->next)
+    {
+        g_assert (NAUTILUS_FILE (l->data)->details->directory == directory);
+
+        link = g_hash_table_lookup (existing, l->data);
+        remove_monitor_link (directory, link);
+
+        monitor = g_new (Monitor, 1);
+        monitor->file = l->data;
+        monitor->monitor_hidden_files = monitor_hidden_files;
+        monitor->client = client;
+        monitor->request = request;
+        monitor->viewport = NULL;
+        directory->details->monitor_list =
+            g_list_prepend (directory->details->monitor_list, monitor);
+        request_counter_add_request (directory->details->monitor_counters,
+                                     monitor->request);
+        g_hash_table_insert (existing, l->data, directory->details->monitor_list);
+
+        nautilus_directory_add_file_to_work_queue (directory, l->data);
+    }
+
+    if (directory->details->monitor == NULL)
+    {
+        directory->details->monitor = nautilus_monitor_directory (directory->details->location);
+    }
+
+    if (REQUEST_WANTS_TYPE (request, REQUEST_FILE_INFO) &&
+        directory->details->mime_db_monitor == 0)
+    {
+        directory->details->mime_db_monitor =
+            g_signal_connect_object (nautilus_signaller_get_current (),
+                                     "mime-data-changed",
+                                     G_CALLBACK (mime_db_changed_callback), directory, 0);
+    }
+
+    nautilus_directory_async_state_changed (directory);
+}
+
 static void
 set_file_unconfirmed (NautilusFile *file,
                       gboolean      unconfirmed)
@@ -820,10 +1489,12 @@ set_file_unconfirmed (NautilusFile *file,
     if (unconfirmed)
     {
         directory->details->confirmed_file_count--;
+        directory->details->unconfirmed_file_count++;
     }
     else
     {
         directory->details->confirmed_file_count++;
+        directory->details->unconfirmed_file_count--;
     }
 }
 
@@ -865,70 +1536,167 @@ should_skip_file (NautilusDirectory *directory,
     return FALSE;
 }
 
+typedef struct
+{
+    guint head;
+    guint tail;
+    GFileInfo *infos[PENDING_FILE_INFO_CHUNK_SIZE];
+} PendingFileInfoChunk;
+
+static void
+push_pending_file_info (NautilusDirectory *directory,
+                        GFileInfo         *info)
+{
+    PendingFileInfoChunk *chunk;
+    GFileInfo **slot;
+    const char *name;
+
+    if (directory->details->pending_file_info_slots == NULL)
+    {
+        directory->details->pending_file_info_slots = g_hash_table_new (g_str_hash, g_str_equal);
+    }
+
+    name = g_file_info_get_name (info);
+
+    /* Reported again before it was handled, the newer info wins. */
+    slot = g_hash_table_lookup (directory->details->pending_file_info_slots, name);
+    if (slot != NULL)
+    {
+        g_hash_table_remove (directory->details->pending_file_info_slots, name);
+        g_object_unref (*slot);
+        *slot = g_object_ref (info);
+        g_hash_table_insert (directory->details->pending_file_info_slots,
+                             (gpointer) g_file_info_get_name (info), slot);
+        return;
+    }
+
+    chunk = g_queue_peek_tail (&directory->details->pending_file_info);
+    if (chunk == NULL || chunk->tail == PENDING_FILE_INFO_CHUNK_SIZE)
+    {
+        chunk = g_new (PendingFileInfoChunk, 1);
+        chunk->head = 0;
+        chunk->tail = 0;
+        g_queue_push_tail (&directory->details->pending_file_info, chunk);
+    }
+
+    slot = &chunk->infos[chunk->tail++];
+    *slot = g_object_ref (info);
+    g_hash_table_insert (directory->details->pending_file_info_slots,
+                         (gpointer) name, slot);
+    directory->details->pending_file_info_count++;
+}
+
+/* Returns the oldest pending info, which the caller has to unref, or
+ * %NULL if there is none.
+ */
+static GFileInfo *
+pop_pending_file_info (NautilusDirectory *directory)
+{
+    PendingFileInfoChunk *chunk;
+    GFileInfo *info;
+
+    chunk = g_queue_peek_head (&directory->details->pending_file_info);
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+
+    info = chunk->infos[chunk->head++];
+    if (chunk->head == chunk->tail)
+    {
+        /* Also when the chunk isn't full, it's the only one left then. */
+        g_free (g_queue_pop_head (&directory->details->pending_file_info));
+    }
+
+    g_hash_table_remove (directory->details->pending_file_info_slots,
+                         g_file_info_get_name (info));
+    directory->details->pending_file_info_count--;
+
+    return info;
+}
+
+void
+nautilus_directory_clear_pending_file_info (NautilusDirectory *directory)
+{
+    GFileInfo *info;
+
+    while ((info = pop_pending_file_info (directory)) != NULL)
+    {
+        g_object_unref (info);
+    }
+
+    g_clear_pointer (&directory->details->pending_file_info_slots, g_hash_table_destroy);
+}
+
+/* If we are done loading, then we assume that any unconfirmed
+ * files are gone. The count saves walking the whole file list when
+ * all files were confirmed, which is the usual case.
+ */
+static GList *
+mark_unconfirmed_files_gone (NautilusDirectory *directory,
+                             GList             *changed_files)
+{
+    GList *node, *next;
+    NautilusFile *file;
+
+    for (node = directory->details->file_list;
+         node != NULL && directory->details->unconfirmed_file_count > 0;
+         node = next)
+    {
+        file = NAUTILUS_FILE (node->data);
+        next = node->next;
+
+        if (file->details->unconfirmed)
+        {
+            nautilus_file_ref (file);
+            changed_files = g_list_prepend (changed_files, file);
+
+            nautilus_file_mark_gone (file);
+        }
+    }
+
+    return changed_files;
+}
+
 static gboolean
 dequeue_pending_idle_callback (gpointer callback_data)
 {
     NautilusDirectory *directory;
-    GList *pending_file_info;
-    GList *node, *next;
     NautilusFile *file;
     GList *changed_files, *added_files;
     GFileInfo *file_info;
-    const char *mimetype, *name;
-    DirectoryLoadState *dir_load_state;
+    const char *name;
+    gint64 deadline;
+    guint n_handled;
 
     directory = NAUTILUS_DIRECTORY (callback_data);
 
     nautilus_directory_ref (directory);
 
-    nautilus_profile_start ("nitems %d", g_list_length (directory->details->pending_file_info));
+    nautilus_profile_start ("nitems %u", directory->details->pending_file_info_count);
 
     directory->details->dequeue_pending_idle_id = 0;
 
-    /* Handle the files in the order we saw them. */
-    pending_file_info = g_list_reverse (directory->details->pending_file_info);
-    directory->details->pending_file_info = NULL;
-
     /* If we are no longer monitoring, then throw away these. */
     if (!nautilus_directory_is_file_list_monitored (directory))
     {
+        nautilus_directory_clear_pending_file_info (directory);
         nautilus_directory_async_state_changed (directory);
-        goto drain;
+        goto done;
     }
 
     added_files = NULL;
     changed_files = NULL;
 
-    dir_load_state = directory->details->directory_load_in_progress;
-
-    /* Build a list of NautilusFile objects. */
-    for (node = pending_file_info; node != NULL; node = node->next)
+    /* Build a list of NautilusFile objects, in the order we saw them,
+     * until the time slice is used up.
+     */
+    deadline = g_get_monotonic_time () + DEQUEUE_PENDING_TIME_SLICE;
+    n_handled = 0;
+    while ((file_info = pop_pending_file_info (directory)) != NULL)
     {
-        file_info = node->data;
-
         name = g_file_info_get_name (file_info);
 
-        /* Update the file count. */
-        /* FIXME bugzilla.gnome.org 45063: This could count a
-         * file twice if we get it from both load_directory
-         * and from new_files_callback. Not too hard to fix by
-         * moving this into the actual callback instead of
-         * waiting for the idle function.
-         */
-        if (dir_load_state &&
-            !should_skip_file (directory, file_info))
-        {
-            dir_load_state->load_file_count += 1;
-
-            /* Add the MIME type to the set. */
-            mimetype = g_file_info_get_content_type (file_info);
-            if (mimetype != NULL)
-            {
-                istr_set_insert (dir_load_state->load_mime_list_hash,
-                                 mimetype);
-            }
-        }
-
         /* check if the file already exists */
         file = nautilus_directory_find_file_by_name (directory, name);
         if (file != NULL)
@@ -961,66 +1729,46 @@ dequeue_pending_idle_callback (gpointer callback_data)
             file->details->is_added = TRUE;
             added_files = g_list_prepend (added_files, file);
         }
-    }
 
-    /* If we are done loading, then we assume that any unconfirmed
-     * files are gone.
-     */
-    if (directory->details->directory_loaded)
-    {
-        for (node = directory->details->file_list;
-             node != NULL; node = next)
-        {
-            file = NAUTILUS_FILE (node->data);
-            next = node->next;
+        g_object_unref (file_info);
 
-            if (file->details->unconfirmed)
-            {
-                nautilus_file_ref (file);
-                changed_files = g_list_prepend (changed_files, file);
-
-                nautilus_file_mark_gone (file);
-            }
+        n_handled++;
+        if (n_handled % DEQUEUE_PENDING_CHECK_INTERVAL == 0 &&
+            g_get_monotonic_time () > deadline)
+        {
+            break;
         }
     }
 
+    if (directory->details->pending_file_info_count == 0 &&
+        directory->details->directory_loaded)
+    {
+        changed_files = mark_unconfirmed_files_gone (directory, changed_files);
+    }
+
     /* Send the changed and added signals. */
     nautilus_directory_emit_change_signals (directory, changed_files);
     nautilus_file_list_free (changed_files);
     nautilus_directory_emit_files_added (directory, added_files);
     nautilus_file_list_free (added_files);
 
-    if (directory->details->directory_loaded &&
-        !directory->details->directory_loaded_sent_notification)
+    if (directory->details->pending_file_info_count > 0)
+    {
+        /* Let the main loop breathe, and come back for the rest. */
+        nautilus_directory_schedule_dequeue_pending (directory);
+    }
+    else if (directory->details->directory_loaded &&
+             !directory->details->directory_loaded_sent_notification)
     {
         /* Send the done_loading signal. */
         nautilus_directory_emit_done_loading (directory);
 
-        if (dir_load_state)
-        {
-            file = dir_load_state->load_directory_file;
-
-            file->details->directory_count = dir_load_state->load_file_count;
-            file->details->directory_count_is_up_to_date = TRUE;
-            file->details->got_directory_count = TRUE;
-
-            file->details->got_mime_list = TRUE;
-            file->details->mime_list_is_up_to_date = TRUE;
-            g_list_free_full (file->details->mime_list, g_free);
-            file->details->mime_list = istr_set_get_as_list
-                                           (dir_load_state->load_mime_list_hash);
-
-            nautilus_file_changed (file);
-        }
-
         nautilus_directory_async_state_changed (directory);
 
         directory->details->directory_loaded_sent_notification = TRUE;
     }
 
-drain:
-    g_list_free_full (pending_file_info, g_object_unref);
-
+done:
     /* Get the state machine running again. */
     nautilus_directory_async_state_changed (directory);
 
@@ -1061,12 +1809,36 @@ directory_load_one (NautilusDirectory *directory,
     }
 
     /* Arrange for the "loading" part of the work. */
-    g_object_ref (info);
-    directory->details->pending_file_info
-        = g_list_prepend (directory->details->pending_file_info, info);
+    push_pending_file_info (directory, info);
     nautilus_directory_schedule_dequeue_pending (directory);
 }
 
+/* Count the files as the enumerator returns them, rather than when they
+ * are dequeued, so that files which are also reported by the monitor
+ * while loading are not counted twice.
+ */
+static void
+directory_load_count_one (DirectoryLoadState *state,
+                          GFileInfo          *info)
+{
+    const char *mimetype;
+
+    if (g_file_info_get_name (info) == NULL ||
+        should_skip_file (state->directory, info))
+    {
+        return;
+    }
+
+    state->load_file_count += 1;
+
+    /* Add the MIME type to the set. */
+    mimetype = g_file_info_get_content_type (info);
+    if (mimetype != NULL)
+    {
+        istr_set_insert (state->load_mime_list_hash, mimetype);
+    }
+}
+
 static void
 directory_load_cancel (NautilusDirectory *directory)
 {
@@ -1086,7 +1858,7 @@ directory_load_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (state->cancellable);
         state->directory = NULL;
         directory->details->directory_load_in_progress = NULL;
-        async_job_end (directory, "file list");
+        async_job_end (directory, REQUEST_FILE_LIST);
     }
 }
 
@@ -1101,11 +1873,7 @@ file_list_cancel (NautilusDirectory *directory)
         directory->details->dequeue_pending_idle_id = 0;
     }
 
-    if (directory->details->pending_file_info != NULL)
-    {
-        g_list_free_full (directory->details->pending_file_info, g_object_unref);
-        directory->details->pending_file_info = NULL;
-    }
+    nautilus_directory_clear_pending_file_info (directory);
 }
 
 static void
@@ -1113,6 +1881,8 @@ directory_load_done (NautilusDirectory *directory,
                      GError            *error)
 {
     GList *node;
+    DirectoryLoadState *state;
+    NautilusFile *file;
 
     nautilus_profile_start (NULL);
     g_object_ref (directory);
@@ -1120,6 +1890,24 @@ directory_load_done (NautilusDirectory *directory,
     directory->details->directory_loaded = TRUE;
     directory->details->directory_loaded_sent_notification = FALSE;
 
+    state = directory->details->directory_load_in_progress;
+    if (state != NULL)
+    {
+        file = state->load_directory_file;
+
+        file->details->directory_count = state->load_file_count;
+        file->details->directory_count_is_up_to_date = TRUE;
+        file->details->got_directory_count = TRUE;
+
+        file->details->got_mime_list = TRUE;
+        file->details->mime_list_is_up_to_date = TRUE;
+        g_list_free_full (file->details->mime_list, g_free);
+        file->details->mime_list = istr_set_get_as_list
+                                       (state->load_mime_list_hash);
+
+        nautilus_file_changed (file);
+    }
+
     if (error != NULL)
     {
         /* The load did not complete successfully. This means
@@ -1137,29 +1925,89 @@ directory_load_done (NautilusDirectory *directory,
         nautilus_directory_emit_load_error (directory, error);
     }
 
-    /* Call the idle function right away. */
-    if (directory->details->dequeue_pending_idle_id != 0)
+    /* Call the idle function right away. It only handles a time slice
+     * worth of pending files, and schedules itself again for the rest.
+     */
+    if (directory->details->dequeue_pending_idle_id != 0)
+    {
+        g_source_remove (directory->details->dequeue_pending_idle_id);
+    }
+    dequeue_pending_idle_callback (directory);
+
+    directory_load_cancel (directory);
+
+    g_object_unref (directory);
+    nautilus_profile_end (NULL);
+}
+
+void
+nautilus_directory_monitor_remove_internal (NautilusDirectory *directory,
+                                            NautilusFile      *file,
+                                            gconstpointer      client)
+{
+    g_assert (NAUTILUS_IS_DIRECTORY (directory));
+    g_assert (file == NULL || NAUTILUS_IS_FILE (file));
+    g_assert (client != NULL);
+
+    remove_monitor (directory, file, client);
+
+    if (directory->details->monitor != NULL
+        && directory->details->monitor_list == NULL)
+    {
+        nautilus_monitor_cancel (directory->details->monitor);
+        directory->details->monitor = NULL;
+    }
+
+    /* Nobody shows the folder any more, don't keep the thumbnailers busy
+     * with its files. */
+    if (file == NULL && directory->details->monitor_list == NULL)
     {
-        g_source_remove (directory->details->dequeue_pending_idle_id);
+        nautilus_thumbnail_remove_directory_from_queue (directory);
     }
-    dequeue_pending_idle_callback (directory);
 
-    directory_load_cancel (directory);
+    /* XXX - do we need to remove anything from the work queue? */
 
-    g_object_unref (directory);
-    nautilus_profile_end (NULL);
+    nautilus_directory_async_state_changed (directory);
 }
 
+/* Same as nautilus_directory_monitor_remove_internal() for each of @files,
+ * which are all in @directory.
+ */
 void
-nautilus_directory_monitor_remove_internal (NautilusDirectory *directory,
-                                            NautilusFile      *file,
-                                            gconstpointer      client)
+nautilus_directory_monitor_remove_files (NautilusDirectory *directory,
+                                         GList             *files,
+                                         gconstpointer      client)
 {
+    g_autoptr (GHashTable) removed = NULL;
+    Monitor *monitor;
+    GList *node;
+    GList *next;
+    GList *l;
+
     g_assert (NAUTILUS_IS_DIRECTORY (directory));
-    g_assert (file == NULL || NAUTILUS_IS_FILE (file));
     g_assert (client != NULL);
 
-    remove_monitor (directory, file, client);
+    if (files == NULL)
+    {
+        return;
+    }
+
+    removed = g_hash_table_new (NULL, NULL);
+    for (l = files; l != NULL; l = l->next)
+    {
+        g_hash_table_add (removed, l->data);
+    }
+
+    for (node = directory->details->monitor_list; node != NULL; node = next)
+    {
+        next = node->next;
+        monitor = node->data;
+        if (monitor->client == client && monitor->file != NULL &&
+            g_hash_table_remove (removed, monitor->file))
+        {
+            remove_monitor_link (directory, node);
+        }
+    }
 
     if (directory->details->monitor != NULL
         && directory->details->monitor_list == NULL)
@@ -1168,8 +2016,6 @@ nautilus_directory_monitor_remove_internal (NautilusDirectory *directory,
         directory->details->monitor = NULL;
     }
 
-    /* XXX - do we need to remove anything from the work queue? */
-
     nautilus_directory_async_state_changed (directory);
 }
 
@@ -1608,6 +2454,7 @@ nautilus_async_destroying_file (NautilusFile *file)
     GList *node, *next;
     ReadyCallback *callback;
     Monitor *monitor;
+    ThumbnailState *thumbnail_state;
 
     directory = file->details->directory;
     changed = FALSE;
@@ -1676,10 +2523,10 @@ nautilus_async_destroying_file (NautilusFile *file)
         changed = TRUE;
     }
 
-    if (directory->details->thumbnail_state != NULL &&
-        directory->details->thumbnail_state->file == file)
+    thumbnail_state = thumbnail_load_for_file (directory, file);
+    if (thumbnail_state != NULL)
     {
-        directory->details->thumbnail_state->file = NULL;
+        thumbnail_state->file = NULL;
         changed = TRUE;
     }
 
@@ -1760,7 +2607,7 @@ static gboolean
 lacks_thumbnail (NautilusFile *file)
 {
     return nautilus_file_should_show_thumbnail (file) &&
-           file->details->thumbnail_path != NULL &&
+           nautilus_file_peek_extra_details (file)->thumbnail_path != NULL &&
            !file->details->thumbnail_is_up_to_date;
 }
 
@@ -2071,6 +2918,7 @@ more_files_callback (GObject      *source_object,
     GError *error;
     GList *files, *l;
     GFileInfo *info;
+    guint n_files;
 
     state = user_data;
 
@@ -2089,27 +2937,33 @@ more_files_callback (GObject      *source_object,
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
                                                  res, &error);
+    n_files = g_list_length (files);
+    enumeration_batch_received (&state->batch, n_files);
 
     for (l = files; l != NULL; l = l->next)
     {
         info = l->data;
+        directory_load_count_one (state, info);
         directory_load_one (directory, info);
         g_object_unref (info);
     }
 
+    enumeration_batch_dispatched (&state->batch, n_files);
+
     if (files == NULL)
     {
+        enumeration_batch_finish (&state->batch);
         directory_load_done (directory, error);
         directory_load_state_free (state);
     }
     else
     {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            more_files_callback,
-                                            state);
+        enumeration_batch_request (&state->batch,
+                                   state->enumerator,
+                                   G_PRIORITY_DEFAULT,
+                                   state->cancellable,
+                                   more_files_callback,
+                                   state);
     }
 
     nautilus_directory_unref (directory);
@@ -2154,12 +3008,12 @@ enumerate_children_callback (GObject      *source_object,
     else
     {
         state->enumerator = enumerator;
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            more_files_callback,
-                                            state);
+        enumeration_batch_request (&state->batch,
+                                   state->enumerator,
+                                   G_PRIORITY_DEFAULT,
+                                   state->cancellable,
+                                   more_files_callback,
+                                   state);
     }
 }
 
@@ -2183,7 +3037,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
         return;
     }
 
-    if (!async_job_start (directory, "file list"))
+    if (!async_job_start (directory, REQUEST_FILE_LIST))
     {
         return;
     }
@@ -2195,6 +3049,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
     state->cancellable = g_cancellable_new ();
     state->load_mime_list_hash = istr_set_new ();
     state->load_file_count = 0;
+    enumeration_batch_init (&state->batch, directory, ENUMERATION_DIRECTORY_LOAD);
 
     g_assert (directory->details->location != NULL);
     state->load_directory_file =
@@ -2339,6 +3194,28 @@ monitor_includes_file (const Monitor *monitor,
                                       monitor->monitor_hidden_files);
 }
 
+/* What is only worth loading for the files on screen */
+static gboolean
+request_follows_viewport (RequestType request_type)
+{
+    switch (request_type)
+    {
+        case REQUEST_DEEP_COUNT:
+        case REQUEST_DIRECTORY_COUNT:
+        case REQUEST_MIME_LIST:
+        case REQUEST_EXTENSION_INFO:
+        case REQUEST_THUMBNAIL:
+        {
+            return TRUE;
+        }
+
+        default:
+        {
+            return FALSE;
+        }
+    }
+}
+
 static gboolean
 is_needy (NautilusFile *file,
           FileCheck     check_missing,
@@ -2385,7 +3262,10 @@ is_needy (NautilusFile *file,
             monitor = node->data;
             if (REQUEST_WANTS_TYPE (monitor->request, request_type_wanted))
             {
-                if (monitor_includes_file (monitor, file))
+                if (monitor_includes_file (monitor, file) &&
+                    (monitor->viewport == NULL ||
+                     !request_follows_viewport (request_type_wanted) ||
+                     g_hash_table_contains (monitor->viewport, file)))
                 {
                     return TRUE;
                 }
@@ -2470,7 +3350,7 @@ count_children_done (NautilusDirectory *directory,
     nautilus_file_changed (count_file);
 
     /* Start up the next one. */
-    async_job_end (directory, "directory count");
+    async_job_end (directory, REQUEST_DIRECTORY_COUNT);
     nautilus_directory_async_state_changed (directory);
 }
 
@@ -2500,6 +3380,7 @@ count_more_files_callback (GObject      *source_object,
     NautilusDirectory *directory;
     GError *error;
     GList *files;
+    guint n_files;
 
     state = user_data;
     directory = state->directory;
@@ -2508,7 +3389,7 @@ count_more_files_callback (GObject      *source_object,
     {
         /* Operation was cancelled. Bail out */
 
-        async_job_end (directory, "directory count");
+        async_job_end (directory, REQUEST_DIRECTORY_COUNT);
         nautilus_directory_async_state_changed (directory);
 
         directory_count_state_free (state);
@@ -2522,23 +3403,28 @@ count_more_files_callback (GObject      *source_object,
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
                                                  res, &error);
+    n_files = g_list_length (files);
+    enumeration_batch_received (&state->batch, n_files);
 
     state->file_count += count_non_skipped_files (files);
 
+    enumeration_batch_dispatched (&state->batch, n_files);
+
     if (files == NULL)
     {
+        enumeration_batch_finish (&state->batch);
         count_children_done (directory, state->count_file,
                              TRUE, state->file_count);
         directory_count_state_free (state);
     }
     else
     {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            count_more_files_callback,
-                                            state);
+        enumeration_batch_request (&state->batch,
+                                   state->enumerator,
+                                   G_PRIORITY_DEFAULT,
+                                   state->cancellable,
+                                   count_more_files_callback,
+                                   state);
     }
 
     g_list_free_full (files, g_object_unref);
@@ -2566,7 +3452,7 @@ count_children_callback (GObject      *source_object,
         /* Operation was cancelled. Bail out */
         directory = state->directory;
 
-        async_job_end (directory, "directory count");
+        async_job_end (directory, REQUEST_DIRECTORY_COUNT);
         nautilus_directory_async_state_changed (directory);
 
         directory_count_state_free (state);
@@ -2590,12 +3476,12 @@ count_children_callback (GObject      *source_object,
     else
     {
         state->enumerator = enumerator;
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            count_more_files_callback,
-                                            state);
+        enumeration_batch_request (&state->batch,
+                                   state->enumerator,
+                                   G_PRIORITY_DEFAULT,
+                                   state->cancellable,
+                                   count_more_files_callback,
+                                   state);
     }
 }
 
@@ -2631,7 +3517,7 @@ directory_count_start (NautilusDirectory *directory,
         return;
     }
 
-    if (!async_job_start (directory, "directory count"))
+    if (!async_job_start (directory, REQUEST_DIRECTORY_COUNT))
     {
         return;
     }
@@ -2641,6 +3527,7 @@ directory_count_start (NautilusDirectory *directory,
     state->count_file = file;
     state->directory = nautilus_directory_ref (directory);
     state->cancellable = g_cancellable_new ();
+    enumeration_batch_init (&state->batch, directory, ENUMERATION_DIRECTORY_COUNT);
 
     directory->details->count_in_progress = state;
 
@@ -2664,50 +3551,62 @@ directory_count_start (NautilusDirectory *directory,
     g_object_unref (location);
 }
 
-static inline gboolean
-seen_inode (DeepCountState *state,
-            GFileInfo      *info)
+static guint
+deep_count_inode_hash (gconstpointer key)
 {
-    guint64 inode, inode2;
-    guint i;
+    const DeepCountInode *inode = key;
 
-    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    return g_int64_hash (&inode->inode) ^ (inode->device * 16777619u);
+}
 
-    if (inode != 0)
-    {
-        for (i = 0; i < state->seen_deep_count_inodes->len; i++)
-        {
-            inode2 = g_array_index (state->seen_deep_count_inodes, guint64, i);
-            if (inode == inode2)
-            {
-                return TRUE;
-            }
-        }
-    }
+static gboolean
+deep_count_inode_equal (gconstpointer a,
+                        gconstpointer b)
+{
+    const DeepCountInode *inode_a = a;
+    const DeepCountInode *inode_b = b;
 
-    return FALSE;
+    return inode_a->inode == inode_b->inode &&
+           inode_a->device == inode_b->device;
 }
 
-static inline void
-mark_inode_as_seen (DeepCountState *state,
-                    GFileInfo      *info)
+/* Whether @info is another link to a file that was already counted.
+ * Only files with several links can be, so only those are remembered.
+ */
+static gboolean
+deep_count_is_seen_link (DeepCountState *state,
+                         GFileInfo      *info)
 {
-    guint64 inode;
+    DeepCountInode *inode;
+    guint64 inode_number;
+
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY ||
+        g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) <= 1)
+    {
+        return FALSE;
+    }
 
-    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
-    if (inode != 0)
+    inode_number = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    if (inode_number == 0)
     {
-        g_array_append_val (state->seen_deep_count_inodes, inode);
+        return FALSE;
     }
+
+    inode = g_new (DeepCountInode, 1);
+    inode->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+    inode->inode = inode_number;
+
+    return !g_hash_table_add (state->seen_inodes, inode);
 }
 
 static void
-deep_count_one (DeepCountState *state,
-                GFileInfo      *info)
+deep_count_one (DeepCountEnumerator *enumerator,
+                GFileInfo           *info)
 {
+    DeepCountState *state;
     NautilusFile *file;
     GFile *subdir;
-    gboolean is_seen_inode;
+    gboolean is_seen_link;
     const char *fs_id;
 
     if (should_skip_file (NULL, info))
@@ -2715,11 +3614,8 @@ deep_count_one (DeepCountState *state,
         return;
     }
 
-    is_seen_inode = seen_inode (state, info);
-    if (!is_seen_inode)
-    {
-        mark_inode_as_seen (state, info);
-    }
+    state = enumerator->state;
+    is_seen_link = deep_count_is_seen_link (state, info);
 
     file = state->directory->details->deep_count_file;
 
@@ -2733,9 +3629,8 @@ deep_count_one (DeepCountState *state,
         if (g_strcmp0 (fs_id, state->fs_id) == 0)
         {
             /* only if it is on the same filesystem */
-            subdir = g_file_get_child (state->deep_count_location, g_file_info_get_name (info));
-            state->deep_count_subdirectories = g_list_prepend
-                                                   (state->deep_count_subdirectories, subdir);
+            subdir = g_file_get_child (enumerator->location, g_file_info_get_name (info));
+            g_queue_push_head (&state->subdirectories, subdir);
         }
     }
     else
@@ -2745,7 +3640,7 @@ deep_count_one (DeepCountState *state,
     }
 
     /* Count the size. */
-    if (!is_seen_inode && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+    if (!is_seen_link && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
     {
         file->details->deep_size += g_file_info_get_size (info);
     }
@@ -2754,58 +3649,103 @@ deep_count_one (DeepCountState *state,
 static void
 deep_count_state_free (DeepCountState *state)
 {
-    if (state->enumerator)
+    g_assert (state->n_enumerators == 0);
+
+    g_object_unref (state->cancellable);
+    g_queue_foreach (&state->subdirectories, (GFunc) g_object_unref, NULL);
+    g_queue_clear (&state->subdirectories);
+    g_hash_table_destroy (state->seen_inodes);
+    g_free (state->fs_id);
+    g_free (state);
+}
+
+/* Start enumerating waiting subdirectories, as long as there are
+ * enumerators left.
+ */
+static void
+deep_count_start_enumerators (DeepCountState *state)
+{
+    DeepCountEnumerator *enumerator;
+    GFile *location;
+
+    while (state->n_enumerators < DEEP_COUNT_MAX_ENUMERATORS &&
+           !g_queue_is_empty (&state->subdirectories))
     {
-        if (!g_file_enumerator_is_closed (state->enumerator))
+        enumerator = g_new0 (DeepCountEnumerator, 1);
+        enumerator->state = state;
+        enumeration_batch_init (&enumerator->batch, state->directory, ENUMERATION_DEEP_COUNT);
+        state->n_enumerators += 1;
+
+        location = g_queue_pop_head (&state->subdirectories);
+        deep_count_load (enumerator, location);
+        g_object_unref (location);
+    }
+}
+
+/* Returns TRUE if @enumerator was the last one of its deep count. */
+static gboolean
+deep_count_enumerator_free (DeepCountEnumerator *enumerator)
+{
+    DeepCountState *state;
+
+    state = enumerator->state;
+
+    if (enumerator->enumerator)
+    {
+        if (!g_file_enumerator_is_closed (enumerator->enumerator))
         {
-            g_file_enumerator_close_async (state->enumerator,
+            g_file_enumerator_close_async (enumerator->enumerator,
                                            0, NULL, NULL, NULL);
         }
-        g_object_unref (state->enumerator);
-    }
-    g_object_unref (state->cancellable);
-    if (state->deep_count_location)
-    {
-        g_object_unref (state->deep_count_location);
+        g_object_unref (enumerator->enumerator);
     }
-    g_list_free_full (state->deep_count_subdirectories, g_object_unref);
-    g_array_free (state->seen_deep_count_inodes, TRUE);
-    g_free (state->fs_id);
-    g_free (state);
+    g_clear_object (&enumerator->location);
+    g_free (enumerator);
+
+    state->n_enumerators -= 1;
+
+    return state->n_enumerators == 0;
 }
 
 static void
-deep_count_next_dir (DeepCountState *state)
+deep_count_next_dir (DeepCountEnumerator *enumerator)
 {
     GFile *location;
     NautilusFile *file;
     NautilusDirectory *directory;
+    DeepCountState *state;
     gboolean done;
 
+    state = enumerator->state;
     directory = state->directory;
 
-    g_object_unref (state->deep_count_location);
-    state->deep_count_location = NULL;
+    g_clear_object (&enumerator->location);
 
     done = FALSE;
     file = directory->details->deep_count_file;
 
-    if (state->deep_count_subdirectories != NULL)
+    if (!g_queue_is_empty (&state->subdirectories))
     {
         /* Work on a new directory. */
-        location = state->deep_count_subdirectories->data;
-        state->deep_count_subdirectories = g_list_remove
-                                               (state->deep_count_subdirectories, location);
-        deep_count_load (state, location);
+        location = g_queue_pop_head (&state->subdirectories);
+        deep_count_load (enumerator, location);
         g_object_unref (location);
+
+        deep_count_start_enumerators (state);
     }
     else
     {
-        file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
-        directory->details->deep_count_file = NULL;
-        directory->details->deep_count_in_progress = NULL;
-        deep_count_state_free (state);
-        done = TRUE;
+        enumeration_batch_finish (&enumerator->batch);
+
+        /* The other enumerators may still find more directories. */
+        if (deep_count_enumerator_free (enumerator))
+        {
+            file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
+            directory->details->deep_count_file = NULL;
+            directory->details->deep_count_in_progress = NULL;
+            deep_count_state_free (state);
+            done = TRUE;
+        }
     }
 
     nautilus_file_updated_deep_count_in_progress (file);
@@ -2813,7 +3753,7 @@ deep_count_next_dir (DeepCountState *state)
     if (done)
     {
         nautilus_file_changed (file);
-        async_job_end (directory, "deep count");
+        async_job_end (directory, REQUEST_DEEP_COUNT);
         nautilus_directory_async_state_changed (directory);
     }
 }
@@ -2823,17 +3763,23 @@ deep_count_more_files_callback (GObject      *source_object,
                                 GAsyncResult *res,
                                 gpointer      user_data)
 {
+    DeepCountEnumerator *enumerator;
     DeepCountState *state;
     NautilusDirectory *directory;
     GList *files, *l;
     GFileInfo *info;
+    guint n_files;
 
-    state = user_data;
+    enumerator = user_data;
+    state = enumerator->state;
 
     if (state->directory == NULL)
     {
         /* Operation was cancelled. Bail out */
-        deep_count_state_free (state);
+        if (deep_count_enumerator_free (enumerator))
+        {
+            deep_count_state_free (state);
+        }
         return;
     }
 
@@ -2842,32 +3788,39 @@ deep_count_more_files_callback (GObject      *source_object,
     g_assert (directory->details->deep_count_in_progress != NULL);
     g_assert (directory->details->deep_count_in_progress == state);
 
-    files = g_file_enumerator_next_files_finish (state->enumerator,
+    files = g_file_enumerator_next_files_finish (enumerator->enumerator,
                                                  res, NULL);
+    n_files = g_list_length (files);
+    enumeration_batch_received (&enumerator->batch, n_files);
 
     for (l = files; l != NULL; l = l->next)
     {
         info = l->data;
-        deep_count_one (state, info);
+        deep_count_one (enumerator, info);
         g_object_unref (info);
     }
 
+    enumeration_batch_dispatched (&enumerator->batch, n_files);
+
     if (files == NULL)
     {
-        g_file_enumerator_close_async (state->enumerator, 0, NULL, NULL, NULL);
-        g_object_unref (state->enumerator);
-        state->enumerator = NULL;
+        g_file_enumerator_close_async (enumerator->enumerator, 0, NULL, NULL, NULL);
+        g_object_unref (enumerator->enumerator);
+        enumerator->enumerator = NULL;
 
-        deep_count_next_dir (state);
+        deep_count_next_dir (enumerator);
     }
     else
     {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_LOW,
-                                            state->cancellable,
-                                            deep_count_more_files_callback,
-                                            state);
+        enumeration_batch_request (&enumerator->batch,
+                                   enumerator->enumerator,
+                                   G_PRIORITY_LOW,
+                                   state->cancellable,
+                                   deep_count_more_files_callback,
+                                   enumerator);
+
+        /* Put idle enumerators to work on the directories just found. */
+        deep_count_start_enumerators (state);
     }
 
     g_list_free (files);
@@ -2880,62 +3833,70 @@ deep_count_callback (GObject      *source_object,
                      GAsyncResult *res,
                      gpointer      user_data)
 {
+    DeepCountEnumerator *enumerator;
     DeepCountState *state;
-    GFileEnumerator *enumerator;
+    GFileEnumerator *file_enumerator;
     NautilusFile *file;
 
-    state = user_data;
+    enumerator = user_data;
+    state = enumerator->state;
+
+    file_enumerator = g_file_enumerate_children_finish (G_FILE (source_object), res, NULL);
 
     if (state->directory == NULL)
     {
         /* Operation was cancelled. Bail out */
-        deep_count_state_free (state);
+        g_clear_object (&file_enumerator);
+        if (deep_count_enumerator_free (enumerator))
+        {
+            deep_count_state_free (state);
+        }
         return;
     }
 
     file = state->directory->details->deep_count_file;
 
-    enumerator = g_file_enumerate_children_finish (G_FILE (source_object), res, NULL);
-
-    if (enumerator == NULL)
+    if (file_enumerator == NULL)
     {
         file->details->deep_unreadable_count += 1;
 
-        deep_count_next_dir (state);
+        deep_count_next_dir (enumerator);
     }
     else
     {
-        state->enumerator = enumerator;
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_LOW,
-                                            state->cancellable,
-                                            deep_count_more_files_callback,
-                                            state);
+        enumerator->enumerator = file_enumerator;
+        enumeration_batch_request (&enumerator->batch,
+                                   enumerator->enumerator,
+                                   G_PRIORITY_LOW,
+                                   state->cancellable,
+                                   deep_count_more_files_callback,
+                                   enumerator);
     }
 }
 
 
 static void
-deep_count_load (DeepCountState *state,
-                 GFile          *location)
+deep_count_load (DeepCountEnumerator *enumerator,
+                 GFile               *location)
 {
-    state->deep_count_location = g_object_ref (location);
+    enumerator->location = g_object_ref (location);
 
     DEBUG ("load_directory called to get deep file count for %p", location);
-    g_file_enumerate_children_async (state->deep_count_location,
+    g_file_enumerate_children_async (enumerator->location,
                                      G_FILE_ATTRIBUTE_STANDARD_NAME ","
                                      G_FILE_ATTRIBUTE_STANDARD_TYPE ","
                                      G_FILE_ATTRIBUTE_STANDARD_SIZE ","
                                      G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
                                      G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","
                                      G_FILE_ATTRIBUTE_ID_FILESYSTEM ","
-                                     G_FILE_ATTRIBUTE_UNIX_INODE,
+                                     G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+                                     G_FILE_ATTRIBUTE_UNIX_INODE ","
+                                     G_FILE_ATTRIBUTE_UNIX_NLINK,
                                      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,     /* flags */
                                      G_PRIORITY_LOW,     /* prio */
-                                     state->cancellable,
+                                     enumerator->state->cancellable,
                                      deep_count_callback,
-                                     state);
+                                     enumerator);
 }
 
 static void
@@ -2974,13 +3935,23 @@ deep_count_got_info (GObject      *source_object,
     DeepCountState *state = (DeepCountState *) user_data;
 
     info = g_file_query_info_finish (file, res, NULL);
+
+    if (state->directory == NULL)
+    {
+        /* Operation was cancelled. Bail out */
+        g_clear_object (&info);
+        deep_count_state_free (state);
+        return;
+    }
+
     if (info != NULL)
     {
         id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
         state->fs_id = g_strdup (id);
         g_object_unref (info);
     }
-    deep_count_load (state, file);
+    g_queue_push_head (&state->subdirectories, g_object_ref (file));
+    deep_count_start_enumerators (state);
 }
 
 static void
@@ -3013,7 +3984,7 @@ deep_count_start (NautilusDirectory *directory,
         return;
     }
 
-    if (!async_job_start (directory, "deep count"))
+    if (!async_job_start (directory, REQUEST_DEEP_COUNT))
     {
         return;
     }
@@ -3029,7 +4000,10 @@ deep_count_start (NautilusDirectory *directory,
     state = g_new0 (DeepCountState, 1);
     state->directory = directory;
     state->cancellable = g_cancellable_new ();
-    state->seen_deep_count_inodes = g_array_new (FALSE, TRUE, sizeof (guint64));
+    g_queue_init (&state->subdirectories);
+    state->seen_inodes = g_hash_table_new_full (deep_count_inode_hash,
+                                                deep_count_inode_equal,
+                                                g_free, NULL);
     state->fs_id = NULL;
 
     directory->details->deep_count_in_progress = state;
@@ -3122,7 +4096,7 @@ mime_list_done (MimeListState *state,
     nautilus_file_changed (file);
 
     /* Start up the next one. */
-    async_job_end (directory, "MIME list");
+    async_job_end (directory, REQUEST_MIME_LIST);
     nautilus_directory_async_state_changed (directory);
 }
 
@@ -3155,6 +4129,7 @@ mime_list_callback (GObject      *source_object,
     GError *error;
     GList *files, *l;
     GFileInfo *info;
+    guint n_files;
 
     state = user_data;
     directory = state->directory;
@@ -3164,7 +4139,7 @@ mime_list_callback (GObject      *source_object,
         /* Operation was cancelled. Bail out */
         directory->details->mime_list_in_progress = NULL;
 
-        async_job_end (directory, "MIME list");
+        async_job_end (directory, REQUEST_MIME_LIST);
         nautilus_directory_async_state_changed (directory);
 
         mime_list_state_free (state);
@@ -3178,6 +4153,8 @@ mime_list_callback (GObject      *source_object,
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
                                                  res, &error);
+    n_files = g_list_length (files);
+    enumeration_batch_received (&state->batch, n_files);
 
     for (l = files; l != NULL; l = l->next)
     {
@@ -3186,19 +4163,22 @@ mime_list_callback (GObject      *source_object,
         g_object_unref (info);
     }
 
+    enumeration_batch_dispatched (&state->batch, n_files);
+
     if (files == NULL)
     {
+        enumeration_batch_finish (&state->batch);
         mime_list_done (state, error != NULL);
         mime_list_state_free (state);
     }
     else
     {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            mime_list_callback,
-                                            state);
+        enumeration_batch_request (&state->batch,
+                                   state->enumerator,
+                                   G_PRIORITY_DEFAULT,
+                                   state->cancellable,
+                                   mime_list_callback,
+                                   state);
     }
 
     g_list_free (files);
@@ -3227,7 +4207,7 @@ list_mime_enum_callback (GObject      *source_object,
         directory = state->directory;
         directory->details->mime_list_in_progress = NULL;
 
-        async_job_end (directory, "MIME list");
+        async_job_end (directory, REQUEST_MIME_LIST);
         nautilus_directory_async_state_changed (directory);
 
         mime_list_state_free (state);
@@ -3249,12 +4229,12 @@ list_mime_enum_callback (GObject      *source_object,
     else
     {
         state->enumerator = enumerator;
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            mime_list_callback,
-                                            state);
+        enumeration_batch_request (&state->batch,
+                                   state->enumerator,
+                                   G_PRIORITY_DEFAULT,
+                                   state->cancellable,
+                                   mime_list_callback,
+                                   state);
     }
 }
 
@@ -3294,7 +4274,7 @@ mime_list_start (NautilusDirectory *directory,
         return;
     }
 
-    if (!async_job_start (directory, "MIME list"))
+    if (!async_job_start (directory, REQUEST_MIME_LIST))
     {
         return;
     }
@@ -3305,6 +4285,7 @@ mime_list_start (NautilusDirectory *directory,
     state->directory = nautilus_directory_ref (directory);
     state->cancellable = g_cancellable_new ();
     state->mime_list_hash = istr_set_new ();
+    enumeration_batch_init (&state->batch, directory, ENUMERATION_MIME_LIST);
 
     directory->details->mime_list_in_progress = state;
 
@@ -3391,7 +4372,7 @@ query_info_callback (GObject      *source_object,
     nautilus_file_changed (get_info_file);
     nautilus_file_unref (get_info_file);
 
-    async_job_end (directory, "file info");
+    async_job_end (directory, REQUEST_FILE_INFO);
     nautilus_directory_async_state_changed (directory);
 
     nautilus_directory_unref (directory);
@@ -3444,7 +4425,7 @@ file_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "file info"))
+    if (!async_job_start (directory, REQUEST_FILE_INFO))
     {
         return;
     }
@@ -3479,18 +4460,11 @@ thumbnail_done (NautilusDirectory *directory,
 {
     const char *thumb_mtime_str;
     time_t thumb_mtime = 0;
+    NautilusFileExtraDetails *extra;
 
     file->details->thumbnail_is_up_to_date = TRUE;
-    if (file->details->thumbnail)
-    {
-        g_object_unref (file->details->thumbnail);
-        file->details->thumbnail = NULL;
-    }
-    if (file->details->scaled_thumbnail)
-    {
-        g_object_unref (file->details->scaled_thumbnail);
-        file->details->scaled_thumbnail = NULL;
-    }
+    file->details->thumbnail_is_loaded = FALSE;
+    extra = nautilus_file_get_extra_details (file);
 
     if (pixbuf)
     {
@@ -3503,13 +4477,16 @@ thumbnail_done (NautilusDirectory *directory,
         if (thumb_mtime == 0 ||
             thumb_mtime == file->details->mtime)
         {
-            file->details->thumbnail = g_object_ref (pixbuf);
-            file->details->thumbnail_mtime = thumb_mtime;
+            /* Keyed by the mtime of the file, like thumbnail_start() looks
+             * it up, also when the thumbnail doesn't say. */
+            nautilus_thumbnail_cache_insert (extra->thumbnail_path, file->details->mtime,
+                                             0, 0, pixbuf);
+            file->details->thumbnail_is_loaded = TRUE;
+            extra->thumbnail_mtime = file->details->mtime;
         }
         else
         {
-            g_free (file->details->thumbnail_path);
-            file->details->thumbnail_path = NULL;
+            g_clear_pointer (&extra->thumbnail_path, g_free);
         }
     }
 
@@ -3519,11 +4496,15 @@ thumbnail_done (NautilusDirectory *directory,
 static void
 thumbnail_stop (NautilusDirectory *directory)
 {
+    GList *node, *next;
+    ThumbnailState *state;
     NautilusFile *file;
 
-    if (directory->details->thumbnail_state != NULL)
+    for (node = directory->details->thumbnails_in_progress; node != NULL; node = next)
     {
-        file = directory->details->thumbnail_state->file;
+        next = node->next;
+        state = node->data;
+        file = state->file;
 
         if (file != NULL)
         {
@@ -3533,12 +4514,12 @@ thumbnail_stop (NautilusDirectory *directory)
                           lacks_thumbnail,
                           REQUEST_THUMBNAIL))
             {
-                return;
+                continue;
             }
         }
 
-        /* The link info is not wanted, so stop it. */
-        thumbnail_cancel (directory);
+        /* The thumbnail is not wanted, so stop loading it. */
+        thumbnail_load_cancel (directory, state);
     }
 }
 
@@ -3644,45 +4625,67 @@ get_pixbuf_for_content (goffset  file_len,
 }
 
 
+/* Runs on a worker thread, so that neither reading nor decoding the
+ * thumbnail holds up the main loop.
+ */
+static void
+thumbnail_load_thread_func (GTask        *task,
+                            gpointer      source_object,
+                            gpointer      task_data,
+                            GCancellable *cancellable)
+{
+    const char *path;
+    char *file_contents;
+    gsize file_size;
+    GdkPixbuf *pixbuf;
+
+    path = task_data;
+    pixbuf = NULL;
+
+    if (!g_cancellable_is_cancelled (cancellable) &&
+        g_file_get_contents (path, &file_contents, &file_size, NULL))
+    {
+        pixbuf = get_pixbuf_for_content (file_size, file_contents);
+        g_free (file_contents);
+    }
+
+    g_task_return_pointer (task, pixbuf, g_object_unref);
+}
+
 static void
-thumbnail_read_callback (GObject      *source_object,
+thumbnail_load_callback (GObject      *source_object,
                          GAsyncResult *res,
                          gpointer      user_data)
 {
     ThumbnailState *state;
-    gsize file_size;
-    char *file_contents;
-    gboolean result;
     NautilusDirectory *directory;
     GdkPixbuf *pixbuf;
 
     state = user_data;
+    pixbuf = g_task_propagate_pointer (G_TASK (res), NULL);
 
     if (state->directory == NULL)
     {
         /* Operation was cancelled. Bail out */
+        g_clear_object (&pixbuf);
         thumbnail_state_free (state);
         return;
     }
 
     directory = nautilus_directory_ref (state->directory);
 
-    result = g_file_load_contents_finish (G_FILE (source_object),
-                                          res,
-                                          &file_contents, &file_size,
-                                          NULL, NULL);
+    thumbnail_load_remove (directory, state);
 
-    pixbuf = NULL;
-    if (result)
+    if (state->file != NULL)
     {
-        pixbuf = get_pixbuf_for_content (file_size, file_contents);
-        g_free (file_contents);
+        thumbnail_got_pixbuf (directory, state->file, pixbuf);
+    }
+    else
+    {
+        /* The file went away meanwhile. */
+        g_clear_object (&pixbuf);
+        nautilus_directory_async_state_changed (directory);
     }
-
-    state->directory->details->thumbnail_state = NULL;
-    async_job_end (state->directory, "thumbnail");
-
-    thumbnail_got_pixbuf (state->directory, state->file, pixbuf);
 
     thumbnail_state_free (state);
 
@@ -3694,25 +4697,45 @@ thumbnail_start (NautilusDirectory *directory,
                  NautilusFile      *file,
                  gboolean          *doing_io)
 {
-    GFile *location;
     ThumbnailState *state;
+    GdkPixbuf *pixbuf;
+    GTask *task;
 
-    if (directory->details->thumbnail_state != NULL)
+    if (!is_needy (file,
+                   lacks_thumbnail,
+                   REQUEST_THUMBNAIL))
     {
-        *doing_io = TRUE;
         return;
     }
 
-    if (!is_needy (file,
-                   lacks_thumbnail,
-                   REQUEST_THUMBNAIL))
+    if (thumbnail_load_for_file (directory, file) != NULL)
     {
+        /* Already loading, go on with the next files meanwhile. */
+        return;
+    }
+
+    /* Another view, or an earlier visit of the folder, may have loaded
+     * it already. */
+    pixbuf = nautilus_thumbnail_cache_lookup (nautilus_file_peek_extra_details (file)->thumbnail_path,
+                                              file->details->mtime, 0, 0);
+    if (pixbuf != NULL)
+    {
+        thumbnail_got_pixbuf (directory, file, pixbuf);
         return;
     }
-    *doing_io = TRUE;
 
-    if (!async_job_start (directory, "thumbnail"))
+    if (directory->details->thumbnails_in_progress == NULL)
+    {
+        if (!async_job_start (directory, REQUEST_THUMBNAIL))
+        {
+            *doing_io = TRUE;
+            return;
+        }
+    }
+    else if (g_list_length (directory->details->thumbnails_in_progress) >= THUMBNAIL_MAX_LOADS)
     {
+        /* Wait for one of the loads to finish. */
+        *doing_io = TRUE;
         return;
     }
 
@@ -3721,15 +4744,19 @@ thumbnail_start (NautilusDirectory *directory,
     state->file = file;
     state->cancellable = g_cancellable_new ();
 
-    location = g_file_new_for_path (file->details->thumbnail_path);
+    directory->details->thumbnails_in_progress =
+        g_list_prepend (directory->details->thumbnails_in_progress, state);
 
-    directory->details->thumbnail_state = state;
-
-    g_file_load_contents_async (location,
-                                state->cancellable,
-                                thumbnail_read_callback,
-                                state);
-    g_object_unref (location);
+    /* Unlike the other attributes, the file is not kept on the work
+     * queue while its thumbnail loads, so that the next files can
+     * start loading theirs.
+     */
+    task = g_task_new (NULL, state->cancellable, thumbnail_load_callback, state);
+    g_task_set_task_data (task,
+                          g_strdup (nautilus_file_peek_extra_details (file)->thumbnail_path),
+                          g_free);
+    g_task_run_in_thread (task, thumbnail_load_thread_func);
+    g_object_unref (task);
 }
 
 static void
@@ -3775,7 +4802,7 @@ got_mount (MountState *state,
     directory = nautilus_directory_ref (state->directory);
 
     state->directory->details->mount_state = NULL;
-    async_job_end (state->directory, "mount");
+    async_job_end (state->directory, REQUEST_MOUNT);
 
     file = nautilus_file_ref (state->file);
 
@@ -3894,7 +4921,7 @@ mount_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "mount"))
+    if (!async_job_start (directory, REQUEST_MOUNT))
     {
         return;
     }
@@ -3947,7 +4974,7 @@ filesystem_info_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (directory->details->filesystem_info_state->cancellable);
         directory->details->filesystem_info_state->directory = NULL;
         directory->details->filesystem_info_state = NULL;
-        async_job_end (directory, "filesystem info");
+        async_job_end (directory, REQUEST_FILESYSTEM_INFO);
     }
 }
 
@@ -3997,7 +5024,7 @@ got_filesystem_info (FilesystemInfoState *state,
     directory = nautilus_directory_ref (state->directory);
 
     state->directory->details->filesystem_info_state = NULL;
-    async_job_end (state->directory, "filesystem info");
+    async_job_end (state->directory, REQUEST_FILESYSTEM_INFO);
 
     file = nautilus_file_ref (state->file);
 
@@ -4075,7 +5102,7 @@ filesystem_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "filesystem info"))
+    if (!async_job_start (directory, REQUEST_FILESYSTEM_INFO))
     {
         return;
     }
@@ -4122,7 +5149,7 @@ extension_info_cancel (NautilusDirectory *directory)
         directory->details->extension_info_provider = NULL;
         directory->details->extension_info_idle = 0;
 
-        async_job_end (directory, "extension info");
+        async_job_end (directory, REQUEST_EXTENSION_INFO);
     }
 }
 
@@ -4185,7 +5212,7 @@ info_provider_idle_callback (gpointer user_data)
     else
     {
         NautilusFile *file;
-        async_job_end (directory, "extension info");
+        async_job_end (directory, REQUEST_EXTENSION_INFO);
 
         file = directory->details->extension_info_file;
 
@@ -4242,7 +5269,7 @@ extension_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
-    if (!async_job_start (directory, "extension info"))
+    if (!async_job_start (directory, REQUEST_EXTENSION_INFO))
     {
         return;
     }
@@ -4267,7 +5294,7 @@ extension_info_start (NautilusDirectory *directory,
         result == NAUTILUS_OPERATION_FAILED)
     {
         finish_info_provider (directory, file, provider);
-        async_job_end (directory, "extension info");
+        async_job_end (directory, REQUEST_EXTENSION_INFO);
     }
     else
     {
@@ -4404,9 +5431,9 @@ nautilus_directory_cancel (NautilusDirectory *directory)
     filesystem_info_cancel (directory);
 
     /* We aren't waiting for anything any more. */
-    if (waiting_directories != NULL)
+    if (directory->details->async_job_pool != NULL)
     {
-        g_hash_table_remove (waiting_directories, directory);
+        async_job_pool_dequeue (directory->details->async_job_pool, directory);
     }
 
     /* Check if any directories should wake up. */
@@ -4459,10 +5486,12 @@ static void
 cancel_thumbnail_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-    if (directory->details->thumbnail_state != NULL &&
-        directory->details->thumbnail_state->file == file)
+    ThumbnailState *state;
+
+    state = thumbnail_load_for_file (directory, file);
+    if (state != NULL)
     {
-        thumbnail_cancel (directory);
+        thumbnail_load_cancel (directory, state);
     }
 }
 
@@ -4602,6 +5631,90 @@ add_all_files_to_work_queue (NautilusDirectory *directory)
     }
 }
 
+/* Let @file, which is likely on screen, go first among the files that
+ * wait for their slower attributes, such as thumbnails.
+ */
+void
+nautilus_directory_prioritize_file (NautilusDirectory *directory,
+                                    NautilusFile      *file)
+{
+    g_return_if_fail (file->details->directory == directory);
+
+    nautilus_file_queue_move_to_head (directory->details->low_priority_queue,
+                                      file);
+}
+
+/* Restricts the slow attributes @client monitors the whole directory for to
+ * @files, and loads them first. The work for the files which are no longer
+ * in it is cancelled. %NULL lifts the restriction.
+ */
+void
+nautilus_directory_monitor_set_viewport (NautilusDirectory *directory,
+                                         gconstpointer      client,
+                                         GList             *files)
+{
+    GList *node;
+    Monitor *monitor;
+    GHashTable *viewport;
+    NautilusFile *file;
+
+    g_assert (NAUTILUS_IS_DIRECTORY (directory));
+
+    node = find_monitor (directory, NULL, client);
+    if (node == NULL)
+    {
+        return;
+    }
+    monitor = node->data;
+
+    if (files == NULL)
+    {
+        if (monitor->viewport != NULL)
+        {
+            g_clear_pointer (&monitor->viewport, g_hash_table_destroy);
+            add_all_files_to_work_queue (directory);
+            nautilus_directory_async_state_changed (directory);
+        }
+        return;
+    }
+
+    /* Walk backwards so that the first file ends up first */
+    viewport = g_hash_table_new (NULL, NULL);
+    for (node = g_list_last (files); node != NULL; node = node->prev)
+    {
+        file = NAUTILUS_FILE (node->data);
+        if (file->details->directory != directory)
+        {
+            continue;
+        }
+
+        g_hash_table_add (viewport, file);
+
+        /* It was skipped while it was off screen */
+        if (monitor->viewport != NULL &&
+            !g_hash_table_contains (monitor->viewport, file))
+        {
+            /* Coming back on screen is a reason to load a thumbnail that
+             * was dropped from the cache again */
+            file->details->thumbnail_was_evicted = FALSE;
+            nautilus_directory_add_file_to_work_queue (directory, file);
+        }
+
+        nautilus_file_queue_move_to_head (directory->details->high_priority_queue,
+                                          file);
+        nautilus_file_queue_move_to_head (directory->details->low_priority_queue,
+                                          file);
+        nautilus_file_queue_move_to_head (directory->details->extension_queue,
+                                          file);
+    }
+
+    g_clear_pointer (&monitor->viewport, g_hash_table_destroy);
+    monitor->viewport = viewport;
+
+    /* Stops the work for the files that went away */
+    nautilus_directory_async_state_changed (directory);
+}
+
 void
 nautilus_directory_remove_file_from_work_queue (NautilusDirectory *directory,
                                                 NautilusFile      *file)
@@ -38,6 +38,7 @@ typedef struct MimeListState MimeListState;
 typedef struct ThumbnailState ThumbnailState;
 typedef struct MountState MountState;
 typedef struct FilesystemInfoState FilesystemInfoState;
+typedef struct AsyncJobPool AsyncJobPool;
 
 typedef enum {
 	REQUEST_DEEP_COUNT,
@@ -59,6 +60,13 @@ typedef gint32 RequestCounter[REQUEST_TYPE_LAST];
 #define REQUEST_WANTS_TYPE(request, type) ((request) & (1<<(type)))
 #define REQUEST_SET_TYPE(request, type) (request) |= (1<<(type))
 
+/* Async. jobs for visible views come before background work. */
+typedef enum {
+	ASYNC_JOB_CLASS_FOREGROUND,
+	ASYNC_JOB_CLASS_BACKGROUND,
+	ASYNC_JOB_CLASS_LAST
+} AsyncJobClass;
+
 struct NautilusDirectoryDetails
 {
 	/* The location. */
@@ -94,8 +102,15 @@ struct NautilusDirectoryDetails
 	gboolean directory_loaded_sent_notification;
 	DirectoryLoadState *directory_load_in_progress;
 
-	GList *pending_file_info; /* list of GnomeVFSFileInfo's that are pending */
+	/* GFileInfos waiting to be turned into files, oldest first, in
+	 * chunks of fixed size. A name that is reported again before it was
+	 * handled replaces the earlier info in its slot.
+	 */
+	GQueue pending_file_info;
+	GHashTable *pending_file_info_slots;
+	guint pending_file_info_count;
 	int confirmed_file_count;
+	int unconfirmed_file_count;
         guint dequeue_pending_idle_id;
 
 	GList *new_files_in_progress; /* list of NewFilesState * */
@@ -115,12 +130,19 @@ struct NautilusDirectoryDetails
 	NautilusOperationHandle *extension_info_in_progress;
 	guint extension_info_idle;
 
-	ThumbnailState *thumbnail_state;
+	GList *thumbnails_in_progress; /* list of ThumbnailState * */
 
 	MountState *mount_state;
 
 	FilesystemInfoState *filesystem_info_state;
 
+	/* Scheduling of the async. jobs above, see async_job_start() */
+	AsyncJobPool *async_job_pool;
+	int async_job_count;
+	GList *async_job_waiting_link[ASYNC_JOB_CLASS_LAST];
+	gboolean async_job_waking_up;
+	gint64 async_job_start_time[REQUEST_TYPE_LAST];
+
 	GList *file_operations_in_progress; /* list of FileOperation * */
 };
 
@@ -150,9 +172,17 @@ void               nautilus_directory_monitor_add_internal            (NautilusD
 								       NautilusFileAttributes     attributes,
 								       NautilusDirectoryCallback  callback,
 								       gpointer                   callback_data);
+void               nautilus_directory_monitor_add_files               (NautilusDirectory         *directory,
+								       GList                     *files,
+								       gconstpointer              client,
+								       gboolean                   monitor_hidden_files,
+								       NautilusFileAttributes     attributes);
 void               nautilus_directory_monitor_remove_internal         (NautilusDirectory         *directory,
 								       NautilusFile              *file,
 								       gconstpointer              client);
+void               nautilus_directory_monitor_remove_files            (NautilusDirectory         *directory,
+								       GList                     *files,
+								       gconstpointer              client);
 void               nautilus_directory_get_info_for_new_files          (NautilusDirectory         *directory,
 								       GList                     *vfs_uris);
 NautilusFile *     nautilus_directory_get_existing_corresponding_file (NautilusDirectory         *directory);
@@ -164,6 +194,7 @@ gboolean           nautilus_directory_has_active_request_for_file     (NautilusD
 void               nautilus_directory_remove_file_monitor_link        (NautilusDirectory         *directory,
 								       GList                     *link);
 void               nautilus_directory_schedule_dequeue_pending        (NautilusDirectory         *directory);
+void               nautilus_directory_clear_pending_file_info         (NautilusDirectory         *directory);
 void               nautilus_directory_stop_monitoring_file_list       (NautilusDirectory         *directory);
 void               nautilus_directory_cancel                          (NautilusDirectory         *directory);
 void               nautilus_async_destroying_file                     (NautilusFile              *file);
@@ -218,6 +249,11 @@ void               nautilus_directory_add_file_to_work_queue          (NautilusD
 								       NautilusFile *file);
 void               nautilus_directory_remove_file_from_work_queue     (NautilusDirectory *directory,
 								       NautilusFile *file);
+void               nautilus_directory_prioritize_file                 (NautilusDirectory *directory,
+								       NautilusFile *file);
+void               nautilus_directory_monitor_set_viewport            (NautilusDirectory *directory,
+								       gconstpointer client,
+								       GList *files);
 
 
 /* debugging functions */
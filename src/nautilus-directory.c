@@ -209,7 +209,7 @@ nautilus_directory_finalize (GObject *object)
     g_assert (directory->details->directory_load_in_progress == NULL);
     g_assert (directory->details->count_in_progress == NULL);
     g_assert (directory->details->dequeue_pending_idle_id == 0);
-    g_list_free_full (directory->details->pending_file_info, g_object_unref);
+    nautilus_directory_clear_pending_file_info (directory);
 
     G_OBJECT_CLASS (nautilus_directory_parent_class)->finalize (object);
 }
@@ -901,6 +901,10 @@ nautilus_directory_add_file (NautilusDirectory *directory,
     add_to_hash_table (directory, file, node);
 
     directory->details->confirmed_file_count++;
+    if (file->details->unconfirmed)
+    {
+        directory->details->unconfirmed_file_count++;
+    }
 
     add_to_work_queue = FALSE;
     if (nautilus_directory_is_file_list_monitored (directory))
@@ -948,6 +952,10 @@ nautilus_directory_remove_file (NautilusDirectory *directory,
     {
         directory->details->confirmed_file_count--;
     }
+    else
+    {
+        directory->details->unconfirmed_file_count--;
+    }
 
     /* Unref if we are monitoring. */
     if (nautilus_directory_is_file_list_monitored (directory))
@@ -1778,6 +1786,23 @@ nautilus_directory_file_monitor_remove (NautilusDirectory *directory,
         (directory, client);
 }
 
+void
+nautilus_directory_file_monitor_set_viewport (NautilusDirectory *directory,
+                                              gconstpointer      client,
+                                              GList             *files)
+{
+    NautilusDirectoryClass *klass;
+
+    g_return_if_fail (NAUTILUS_IS_DIRECTORY (directory));
+    g_return_if_fail (client != NULL);
+
+    klass = NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (directory));
+    if (klass->file_monitor_set_viewport != NULL)
+    {
+        klass->file_monitor_set_viewport (directory, client, files);
+    }
+}
+
 void
 nautilus_directory_force_reload (NautilusDirectory *directory)
 {
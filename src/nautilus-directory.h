@@ -123,6 +123,9 @@ typedef struct
 					  gpointer                   callback_data);
 	void     (* file_monitor_remove) (NautilusDirectory         *directory,
 					  gconstpointer              client);
+	void     (* file_monitor_set_viewport) (NautilusDirectory   *directory,
+						gconstpointer        client,
+						GList               *files);
 	void     (* force_reload)        (NautilusDirectory         *directory);
 	gboolean (* are_all_files_seen)  (NautilusDirectory         *directory);
 	gboolean (* is_not_empty)        (NautilusDirectory         *directory);
@@ -208,6 +211,14 @@ void               nautilus_directory_file_monitor_add         (NautilusDirector
 								gpointer                   callback_data);
 void               nautilus_directory_file_monitor_remove      (NautilusDirectory         *directory,
 								gconstpointer              client);
+/* Tells which files the client shows, with some around them to scroll to.
+ * Slow attributes, such as item counts, thumbnails and extension info, are
+ * then only loaded for those, and first. %NULL means all the files, for
+ * instance to sort them by size.
+ */
+void               nautilus_directory_file_monitor_set_viewport (NautilusDirectory        *directory,
+								 gconstpointer             client,
+								 GList                    *files);
 void               nautilus_directory_force_reload             (NautilusDirectory         *directory);
 
 /* Get a list of all files currently known in the directory. */
@@ -29,11 +29,20 @@
 #include <locale.h>
 #include <math.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <stdlib.h>
+#include <dirent.h>
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 #include "nautilus-file-operations.h"
 
+#include "nautilus-copy-journal.h"
 #include "nautilus-file-changes-queue.h"
 #include "nautilus-lib-self-check-functions.h"
 
@@ -79,6 +88,44 @@ typedef struct
     gboolean delete_all;
 } CommonJob;
 
+typedef struct
+{
+    GThreadPool *pool;
+    GCancellable *cancellable;
+    guint max_pending;
+    /* CopyFileTask, in the order they were queued */
+    GQueue tasks;
+    GMutex mutex;
+    GCond cond;
+    /* Written by the workers, not yet added to the transfer info */
+    goffset num_bytes;
+} CopyFilePool;
+
+typedef struct
+{
+    GThread *thread;
+    GCancellable *cancellable;
+    GList *files;
+    GFile *dest;
+    GMutex mutex;
+    GCond cond;
+    /* CopyScanListing, in the order the copy needs them */
+    GQueue listings;
+    guint n_queued_files;
+    /* Uris of the folders listed so far */
+    GHashTable *listed;
+    int num_files;
+    goffset num_bytes;
+    gboolean finished;
+    gboolean stopped;
+
+    /* Only used in the job thread */
+    int synced_num_files;
+    goffset synced_num_bytes;
+    gboolean verified;
+    guint n_unlisted;
+} CopyScan;
+
 typedef struct
 {
     CommonJob common;
@@ -88,6 +135,11 @@ typedef struct
     GFile *fake_display_source;
     GHashTable *debuting_files;
     gchar *target_name;
+    CopyFilePool *file_pool;
+    CopyScan *scan;
+    NautilusCopyJournal *journal;
+    /* Of the job to resume */
+    GFile *journal_location;
     NautilusCopyCallback done_callback;
     gpointer done_callback_data;
 } CopyMoveJob;
@@ -1876,6 +1928,461 @@ delete_file_recursively (GFile          *file,
     return success;
 }
 
+/* Folders on a local filesystem are deleted with unlinkat() relative to the
+ * fd of their parent, without going through GFile for every file. The first
+ * levels of a folder are walked in the job thread, and the subfolders below
+ * them are handed to a pool of worker threads. Errors are queued and passed
+ * to the callback in the job thread, so prompts come up there as before.
+ * Only the top-level files and the errors go through the callback, the
+ * files deleted inside folders are just counted.
+ */
+#define DELETE_SPLIT_DEPTH 2
+#define MAX_DELETE_THREADS 8
+
+typedef void (*DeleteCountCallback) (int      num_files,
+                                     gpointer callback_data);
+
+typedef struct
+{
+    GThreadPool *pool;
+    GCancellable *cancellable;
+    GMutex mutex;
+    GCond cond;
+    guint n_pending;
+    /* DeleteFailure */
+    GQueue failures;
+    /* Deleted but not passed to the count callback yet */
+    gint num_files;
+} DeleteEngine;
+
+typedef struct
+{
+    char *path;
+    GError *error;
+} DeleteFailure;
+
+static gboolean delete_local_children (DeleteEngine *engine,
+                                       int           dir_fd,
+                                       const char   *path,
+                                       int           depth,
+                                       GQueue       *deferred);
+
+static void
+delete_engine_add_failure (DeleteEngine *engine,
+                           const char   *path,
+                           const char   *name,
+                           int           errsv)
+{
+    DeleteFailure *failure;
+
+    failure = g_new0 (DeleteFailure, 1);
+    failure->path = name != NULL ? g_build_filename (path, name, NULL) : g_strdup (path);
+    failure->error = g_error_new_literal (G_IO_ERROR,
+                                          g_io_error_from_errno (errsv),
+                                          g_strerror (errsv));
+
+    g_mutex_lock (&engine->mutex);
+    g_queue_push_tail (&engine->failures, failure);
+    g_cond_broadcast (&engine->cond);
+    g_mutex_unlock (&engine->mutex);
+}
+
+static void
+delete_engine_push (DeleteEngine *engine,
+                    char         *path)
+{
+    g_mutex_lock (&engine->mutex);
+    engine->n_pending++;
+    g_mutex_unlock (&engine->mutex);
+
+    g_thread_pool_push (engine->pool, path, NULL);
+}
+
+/* With @deferred, the subfolders at the split depth are deleted by the
+ * pool, and the ones above it are only emptied and added to @deferred, to
+ * be removed once the pool is done.
+ */
+static gboolean
+delete_local_subfolder (DeleteEngine *engine,
+                        int           parent_fd,
+                        const char   *parent_path,
+                        const char   *name,
+                        int           depth,
+                        GQueue       *deferred)
+{
+    g_autofree char *path = NULL;
+    int fd;
+
+    path = g_build_filename (parent_path, name, NULL);
+
+    if (deferred != NULL && depth >= DELETE_SPLIT_DEPTH)
+    {
+        delete_engine_push (engine, g_steal_pointer (&path));
+        return TRUE;
+    }
+
+    fd = openat (parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+    {
+        delete_engine_add_failure (engine, path, NULL, errno);
+        return FALSE;
+    }
+
+    if (!delete_local_children (engine, fd, path, depth, deferred))
+    {
+        return FALSE;
+    }
+
+    if (deferred != NULL)
+    {
+        /* Deeper folders come first */
+        g_queue_push_tail (deferred, g_steal_pointer (&path));
+        return TRUE;
+    }
+
+    if (unlinkat (parent_fd, name, AT_REMOVEDIR) < 0)
+    {
+        delete_engine_add_failure (engine, path, NULL, errno);
+        return FALSE;
+    }
+
+    g_atomic_int_inc (&engine->num_files);
+
+    return TRUE;
+}
+
+/* Takes ownership of @dir_fd. */
+static gboolean
+delete_local_children (DeleteEngine *engine,
+                       int           dir_fd,
+                       const char   *path,
+                       int           depth,
+                       GQueue       *deferred)
+{
+    DIR *dir;
+    struct dirent *entry;
+    gboolean success;
+    int errsv;
+
+    dir = fdopendir (dir_fd);
+    if (dir == NULL)
+    {
+        delete_engine_add_failure (engine, path, NULL, errno);
+        close (dir_fd);
+        return FALSE;
+    }
+
+    success = TRUE;
+
+    while (!g_cancellable_is_cancelled (engine->cancellable))
+    {
+        errno = 0;
+        entry = readdir (dir);
+        if (entry == NULL)
+        {
+            if (errno != 0)
+            {
+                delete_engine_add_failure (engine, path, NULL, errno);
+                success = FALSE;
+            }
+            break;
+        }
+
+        if (strcmp (entry->d_name, ".") == 0 ||
+            strcmp (entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        if (entry->d_type != DT_DIR)
+        {
+            if (unlinkat (dirfd (dir), entry->d_name, 0) == 0)
+            {
+                g_atomic_int_inc (&engine->num_files);
+                continue;
+            }
+
+            errsv = errno;
+            if (entry->d_type != DT_UNKNOWN ||
+                (errsv != EISDIR && errsv != EPERM))
+            {
+                delete_engine_add_failure (engine, path, entry->d_name, errsv);
+                success = FALSE;
+                continue;
+            }
+        }
+
+        success = delete_local_subfolder (engine, dirfd (dir), path,
+                                          entry->d_name, depth + 1,
+                                          deferred) && success;
+    }
+
+    closedir (dir);
+
+    return success && !g_cancellable_is_cancelled (engine->cancellable);
+}
+
+static void
+delete_engine_task_run (gpointer data,
+                        gpointer user_data)
+{
+    g_autofree char *path = data;
+    DeleteEngine *engine;
+    int fd;
+
+    engine = user_data;
+
+    if (!g_cancellable_is_cancelled (engine->cancellable))
+    {
+        fd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0)
+        {
+            delete_engine_add_failure (engine, path, NULL, errno);
+        }
+        else if (delete_local_children (engine, fd, path, 0, NULL))
+        {
+            if (rmdir (path) < 0)
+            {
+                delete_engine_add_failure (engine, path, NULL, errno);
+            }
+            else
+            {
+                g_atomic_int_inc (&engine->num_files);
+            }
+        }
+    }
+
+    g_mutex_lock (&engine->mutex);
+    engine->n_pending--;
+    g_cond_broadcast (&engine->cond);
+    g_mutex_unlock (&engine->mutex);
+}
+
+static DeleteEngine *
+delete_engine_new (GCancellable *cancellable)
+{
+    DeleteEngine *engine;
+    guint n_threads;
+
+    n_threads = CLAMP (g_get_num_processors (), 2, MAX_DELETE_THREADS);
+
+    engine = g_new0 (DeleteEngine, 1);
+    engine->cancellable = g_object_ref (cancellable);
+    g_queue_init (&engine->failures);
+    g_mutex_init (&engine->mutex);
+    g_cond_init (&engine->cond);
+    engine->pool = g_thread_pool_new (delete_engine_task_run, engine, n_threads, FALSE, NULL);
+
+    return engine;
+}
+
+static void
+delete_engine_free (DeleteEngine *engine)
+{
+    g_assert (engine->n_pending == 0);
+    g_assert (g_queue_is_empty (&engine->failures));
+
+    g_thread_pool_free (engine->pool, FALSE, TRUE);
+    g_object_unref (engine->cancellable);
+    g_mutex_clear (&engine->mutex);
+    g_cond_clear (&engine->cond);
+    g_free (engine);
+}
+
+static void
+delete_engine_flush_count (DeleteEngine        *engine,
+                           DeleteCountCallback  count_callback,
+                           gpointer             callback_data)
+{
+    int num_files;
+
+    num_files = g_atomic_int_get (&engine->num_files);
+    if (num_files == 0)
+    {
+        return;
+    }
+
+    g_atomic_int_add (&engine->num_files, -num_files);
+
+    if (count_callback)
+    {
+        count_callback (num_files, callback_data);
+    }
+}
+
+/* Waits for the pool, passing the errors and the counts on as they come. */
+static gboolean
+delete_engine_wait (DeleteEngine        *engine,
+                    DeleteCallback       callback,
+                    DeleteCountCallback  count_callback,
+                    gpointer             callback_data)
+{
+    DeleteFailure *failure;
+    GQueue failures;
+    gint64 end_time;
+    gboolean success;
+    gboolean done;
+
+    success = TRUE;
+
+    do
+    {
+        end_time = g_get_monotonic_time () + PROGRESS_NOTIFY_INTERVAL;
+
+        g_mutex_lock (&engine->mutex);
+        while (engine->n_pending > 0 && g_queue_is_empty (&engine->failures))
+        {
+            if (!g_cond_wait_until (&engine->cond, &engine->mutex, end_time))
+            {
+                break;
+            }
+        }
+        done = engine->n_pending == 0;
+        failures = engine->failures;
+        g_queue_init (&engine->failures);
+        g_mutex_unlock (&engine->mutex);
+
+        delete_engine_flush_count (engine, count_callback, callback_data);
+
+        while ((failure = g_queue_pop_head (&failures)) != NULL)
+        {
+            if (callback)
+            {
+                g_autoptr (GFile) file = NULL;
+
+                file = g_file_new_for_path (failure->path);
+                callback (file, failure->error, callback_data);
+            }
+            success = FALSE;
+
+            g_error_free (failure->error);
+            g_free (failure->path);
+            g_free (failure);
+        }
+    }
+    while (!done);
+
+    return success;
+}
+
+static void
+delete_engine_report_path (const char     *path,
+                           int             errsv,
+                           DeleteCallback  callback,
+                           gpointer        callback_data)
+{
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GError) error = NULL;
+
+    if (callback == NULL)
+    {
+        return;
+    }
+
+    file = g_file_new_for_path (path);
+    if (errsv != 0)
+    {
+        error = g_error_new_literal (G_IO_ERROR,
+                                     g_io_error_from_errno (errsv),
+                                     g_strerror (errsv));
+    }
+
+    callback (file, error, callback_data);
+}
+
+/* Deletes the local @file and everything in it, or only what is in it if
+ * @delete_file is %FALSE.
+ */
+static gboolean
+delete_local_file_recursively (DeleteEngine        *engine,
+                               GFile               *file,
+                               gboolean             delete_file,
+                               DeleteCallback       callback,
+                               DeleteCountCallback  count_callback,
+                               gpointer             callback_data)
+{
+    g_autofree char *path = NULL;
+    GQueue deferred = G_QUEUE_INIT;
+    char *dir_path;
+    gboolean success;
+    int errsv;
+    int fd;
+
+    path = g_file_get_path (file);
+
+    errsv = 0;
+    if (delete_file)
+    {
+        if (unlink (path) == 0)
+        {
+            delete_engine_report_path (path, 0, callback, callback_data);
+            return TRUE;
+        }
+        errsv = errno;
+    }
+
+    fd = -1;
+    if (!delete_file || errsv == EISDIR || errsv == EPERM)
+    {
+        fd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0 && (!delete_file || errno != ENOTDIR))
+        {
+            errsv = errno;
+        }
+    }
+
+    if (fd < 0)
+    {
+        delete_engine_report_path (path, errsv, callback, callback_data);
+        return FALSE;
+    }
+
+    success = delete_local_children (engine, fd, path, 0, &deferred);
+    success = delete_engine_wait (engine, callback, count_callback, callback_data) && success;
+
+    while ((dir_path = g_queue_pop_head (&deferred)) != NULL)
+    {
+        errsv = rmdir (dir_path) == 0 ? 0 : errno;
+        if (errsv == 0)
+        {
+            g_atomic_int_inc (&engine->num_files);
+        }
+        else if (success || errsv != ENOTEMPTY)
+        {
+            /* A folder left behind by an error reported already is
+             * expected, anything else is not.
+             */
+            delete_engine_report_path (dir_path, errsv, callback, callback_data);
+            success = FALSE;
+        }
+        g_free (dir_path);
+    }
+
+    delete_engine_flush_count (engine, count_callback, callback_data);
+
+    if (!delete_file)
+    {
+        return success;
+    }
+
+    errsv = rmdir (path) == 0 ? 0 : errno;
+    if (errsv == 0)
+    {
+        delete_engine_report_path (path, 0, callback, callback_data);
+    }
+    else if (success || errsv != ENOTEMPTY)
+    {
+        delete_engine_report_path (path, errsv, callback, callback_data);
+        success = FALSE;
+    }
+    else if (count_callback)
+    {
+        count_callback (1, callback_data);
+    }
+
+    return success;
+}
+
 typedef struct
 {
     CommonJob *job;
@@ -1970,6 +2477,16 @@ file_deleted_callback (GFile    *file,
     }
 }
 
+static void
+files_deleted_callback (int      num_files,
+                        gpointer callback_data)
+{
+    DeleteData *data = callback_data;
+
+    data->transfer_info->num_files += num_files;
+    report_delete_progress (data->job, data->source_info, data->transfer_info);
+}
+
 static void
 delete_files (CommonJob *job,
               GList     *files,
@@ -1980,6 +2497,7 @@ delete_files (CommonJob *job,
     SourceInfo source_info;
     TransferInfo transfer_info;
     DeleteData data;
+    DeleteEngine *engine;
 
     if (job_aborted (job))
     {
@@ -2004,6 +2522,8 @@ delete_files (CommonJob *job,
     data.source_info = &source_info;
     data.transfer_info = &transfer_info;
 
+    engine = NULL;
+
     for (l = files;
          l != NULL && !job_aborted (job);
          l = l->next)
@@ -2018,15 +2538,35 @@ delete_files (CommonJob *job,
             continue;
         }
 
-        success = delete_file_recursively (file, job->cancellable,
-                                           file_deleted_callback,
-                                           &data);
+        if (g_file_is_native (file))
+        {
+            if (engine == NULL)
+            {
+                engine = delete_engine_new (job->cancellable);
+            }
+
+            success = delete_local_file_recursively (engine, file, TRUE,
+                                                     file_deleted_callback,
+                                                     files_deleted_callback,
+                                                     &data);
+        }
+        else
+        {
+            success = delete_file_recursively (file, job->cancellable,
+                                               file_deleted_callback,
+                                               &data);
+        }
 
         if (!success)
         {
             (*files_skipped)++;
         }
     }
+
+    if (engine != NULL)
+    {
+        delete_engine_free (engine);
+    }
 }
 
 #pragma GCC diagnostic push
@@ -3727,12 +4267,477 @@ retry:
     g_object_unref (fsinfo);
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-static void
-report_copy_progress (CopyMoveJob  *copy_job,
-                      SourceInfo   *source_info,
-                      TransferInfo *transfer_info)
+/* Copies don't wait for the whole source tree to be counted: a scanner thread
+ * walks it in the same order as the copy, and hands over the children of each
+ * folder it lists so that the copy doesn't read the folder again. The totals
+ * are refined as the scan goes on. The scanner never asks the user anything;
+ * a folder it fails to read is read by the copy itself, which reports the
+ * error as usual.
+ */
+#define MAX_SCAN_QUEUED_FILES 16384
+#define SCAN_HEAD_START (G_USEC_PER_SEC / 2)
+
+typedef struct
+{
+    char *uri;
+    /* GFileInfo of the children */
+    GQueue infos;
+    /* The scanner could not read the folder */
+    gboolean failed;
+} CopyScanListing;
+
+static void
+copy_scan_listing_free (CopyScanListing *listing)
+{
+    g_queue_foreach (&listing->infos, (GFunc) g_object_unref, NULL);
+    g_queue_clear (&listing->infos);
+    g_free (listing->uri);
+    g_free (listing);
+}
+
+static gboolean
+copy_scan_is_stopped (CopyScan *scan)
+{
+    return g_atomic_int_get (&scan->stopped) ||
+           g_cancellable_is_cancelled (scan->cancellable);
+}
+
+/* Drops the listing at the head of the queue, with the mutex held */
+static void
+copy_scan_drop_head (CopyScan *scan)
+{
+    CopyScanListing *listing;
+
+    listing = g_queue_pop_head (&scan->listings);
+    scan->n_queued_files -= g_queue_get_length (&listing->infos);
+    copy_scan_listing_free (listing);
+}
+
+static void
+copy_scan_count (CopyScan *scan,
+                 int       num_files,
+                 goffset   num_bytes)
+{
+    g_mutex_lock (&scan->mutex);
+    scan->num_files += num_files;
+    scan->num_bytes += num_bytes;
+    g_mutex_unlock (&scan->mutex);
+}
+
+/* Takes the children in @infos, or marks the listing as failed if it is NULL */
+static void
+copy_scan_push (CopyScan *scan,
+                GFile    *dir,
+                GQueue   *infos,
+                int       num_files,
+                goffset   num_bytes)
+{
+    CopyScanListing *listing;
+    guint n_files;
+    gint64 end_time;
+
+    listing = g_new0 (CopyScanListing, 1);
+    listing->uri = g_file_get_uri (dir);
+    if (infos != NULL)
+    {
+        listing->infos = *infos;
+        g_queue_init (infos);
+    }
+    else
+    {
+        listing->failed = TRUE;
+    }
+    n_files = g_queue_get_length (&listing->infos);
+
+    g_mutex_lock (&scan->mutex);
+
+    while (!copy_scan_is_stopped (scan) &&
+           scan->n_queued_files > 0 &&
+           scan->n_queued_files + n_files > MAX_SCAN_QUEUED_FILES)
+    {
+        end_time = g_get_monotonic_time () + PROGRESS_NOTIFY_INTERVAL;
+        g_cond_wait_until (&scan->cond, &scan->mutex, end_time);
+    }
+
+    scan->num_files += num_files;
+    scan->num_bytes += num_bytes;
+    g_hash_table_add (scan->listed, g_strdup (listing->uri));
+
+    if (copy_scan_is_stopped (scan))
+    {
+        copy_scan_listing_free (listing);
+    }
+    else
+    {
+        g_queue_push_tail (&scan->listings, listing);
+        scan->n_queued_files += n_files;
+        g_cond_broadcast (&scan->cond);
+    }
+
+    g_mutex_unlock (&scan->mutex);
+}
+
+static void
+copy_scan_dir (CopyScan   *scan,
+               GFile      *dir,
+               GHashTable *scanned)
+{
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GError *error;
+    GQueue infos = G_QUEUE_INIT;
+    GList *subdirs, *l;
+    int num_files;
+    goffset num_bytes;
+
+    enumerator = g_file_enumerate_children (dir,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            scan->cancellable,
+                                            NULL);
+    if (enumerator == NULL)
+    {
+        copy_scan_push (scan, dir, NULL, 0, 0);
+        return;
+    }
+
+    subdirs = NULL;
+    num_files = 0;
+    num_bytes = 0;
+    error = NULL;
+    while (!copy_scan_is_stopped (scan) &&
+           (info = g_file_enumerator_next_file (enumerator, scan->cancellable, &error)) != NULL)
+    {
+        g_autoptr (GFile) file = NULL;
+        g_autofree char *file_uri = NULL;
+
+        file = g_file_enumerator_get_child (enumerator, info);
+        file_uri = g_file_get_uri (file);
+
+        if (!g_hash_table_contains (scanned, file_uri))
+        {
+            g_hash_table_add (scanned, g_steal_pointer (&file_uri));
+
+            num_files++;
+            num_bytes += g_file_info_get_size (info);
+
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+            {
+                subdirs = g_list_prepend (subdirs, g_steal_pointer (&file));
+            }
+        }
+
+        /* The copy needs all of them, even the ones counted already */
+        g_queue_push_tail (&infos, info);
+    }
+    g_file_enumerator_close (enumerator, scan->cancellable, NULL);
+    g_object_unref (enumerator);
+
+    if (error != NULL)
+    {
+        g_error_free (error);
+
+        g_queue_foreach (&infos, (GFunc) g_object_unref, NULL);
+        g_queue_clear (&infos);
+        g_list_free_full (subdirs, g_object_unref);
+
+        copy_scan_push (scan, dir, NULL, num_files, num_bytes);
+        return;
+    }
+
+    copy_scan_push (scan, dir, &infos, num_files, num_bytes);
+
+    /* Depth first, in the order the copy will get to them */
+    subdirs = g_list_reverse (subdirs);
+    for (l = subdirs; l != NULL && !copy_scan_is_stopped (scan); l = l->next)
+    {
+        copy_scan_dir (scan, l->data, scanned);
+    }
+    g_list_free_full (subdirs, g_object_unref);
+}
+
+static gpointer
+copy_scan_thread_func (gpointer data)
+{
+    CopyScan *scan;
+    GHashTable *scanned;
+    GFileInfo *info;
+    GList *l;
+
+    scan = data;
+    scanned = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    for (l = scan->files; l != NULL && !copy_scan_is_stopped (scan); l = l->next)
+    {
+        g_autofree char *file_uri = NULL;
+
+        info = g_file_query_info (l->data,
+                                  G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                  scan->cancellable,
+                                  NULL);
+        if (info == NULL)
+        {
+            /* Don't keep the copy waiting in case it is a folder */
+            copy_scan_push (scan, l->data, NULL, 0, 0);
+            continue;
+        }
+
+        file_uri = g_file_get_uri (l->data);
+        if (!g_hash_table_contains (scanned, file_uri))
+        {
+            g_hash_table_add (scanned, g_steal_pointer (&file_uri));
+
+            copy_scan_count (scan, 1, g_file_info_get_size (info));
+
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+            {
+                copy_scan_dir (scan, l->data, scanned);
+            }
+        }
+        g_object_unref (info);
+    }
+
+    g_hash_table_destroy (scanned);
+
+    g_mutex_lock (&scan->mutex);
+    scan->finished = TRUE;
+    g_cond_broadcast (&scan->cond);
+    g_mutex_unlock (&scan->mutex);
+
+    return NULL;
+}
+
+static CopyScan *
+copy_scan_new (CopyMoveJob *job,
+               GFile       *dest)
+{
+    CopyScan *scan;
+
+    scan = g_new0 (CopyScan, 1);
+    scan->cancellable = g_object_ref (job->common.cancellable);
+    scan->files = g_list_copy_deep (job->files, (GCopyFunc) g_object_ref, NULL);
+    scan->dest = g_object_ref (dest);
+    g_mutex_init (&scan->mutex);
+    g_cond_init (&scan->cond);
+    g_queue_init (&scan->listings);
+    scan->listed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    scan->thread = g_thread_new ("nautilus-copy-scan", copy_scan_thread_func, scan);
+
+    return scan;
+}
+
+static void
+copy_scan_free (CopyScan *scan)
+{
+    g_mutex_lock (&scan->mutex);
+    g_atomic_int_set (&scan->stopped, TRUE);
+    g_cond_broadcast (&scan->cond);
+    g_mutex_unlock (&scan->mutex);
+
+    g_thread_join (scan->thread);
+
+    while (!g_queue_is_empty (&scan->listings))
+    {
+        copy_scan_drop_head (scan);
+    }
+    g_hash_table_destroy (scan->listed);
+    g_list_free_full (scan->files, g_object_unref);
+    g_object_unref (scan->dest);
+    g_object_unref (scan->cancellable);
+    g_mutex_clear (&scan->mutex);
+    g_cond_clear (&scan->cond);
+    g_free (scan);
+}
+
+/* With the mutex held */
+static void
+copy_scan_sync_totals (CopyScan   *scan,
+                       SourceInfo *source_info)
+{
+    source_info->num_files += scan->num_files - scan->synced_num_files;
+    source_info->num_bytes += scan->num_bytes - scan->synced_num_bytes;
+    scan->synced_num_files = scan->num_files;
+    scan->synced_num_bytes = scan->num_bytes;
+}
+
+/* Gives the scanner a head start, so that small copies are counted in full
+ * before they begin, like they used to be.
+ */
+static void
+copy_scan_wait (CopyMoveJob *copy_job,
+                SourceInfo  *source_info)
+{
+    CopyScan *scan;
+    CommonJob *job;
+    gint64 start_time;
+    gint64 report_time;
+
+    scan = copy_job->scan;
+    job = (CommonJob *) copy_job;
+
+    report_preparing_count_progress (job, source_info);
+
+    start_time = g_get_monotonic_time ();
+
+    g_mutex_lock (&scan->mutex);
+    while (!scan->finished && !job_aborted (job) &&
+           g_get_monotonic_time () < start_time + SCAN_HEAD_START)
+    {
+        report_time = MIN (g_get_monotonic_time () + PROGRESS_NOTIFY_INTERVAL,
+                           start_time + SCAN_HEAD_START);
+        while (!scan->finished && g_get_monotonic_time () < report_time)
+        {
+            g_cond_wait_until (&scan->cond, &scan->mutex, report_time);
+        }
+
+        copy_scan_sync_totals (scan, source_info);
+
+        g_mutex_unlock (&scan->mutex);
+        report_preparing_count_progress (job, source_info);
+        g_mutex_lock (&scan->mutex);
+    }
+    copy_scan_sync_totals (scan, source_info);
+    scan->verified = scan->finished;
+    g_mutex_unlock (&scan->mutex);
+
+    report_preparing_count_progress (job, source_info);
+}
+
+/* Adds what the scanner counted since last time to the totals. Once the scan
+ * is over, the destination is checked again for the space that is still
+ * needed, if the copy started before knowing it.
+ */
+static void
+copy_scan_update_totals (CopyMoveJob  *copy_job,
+                         SourceInfo   *source_info,
+                         TransferInfo *transfer_info)
+{
+    CopyScan *scan;
+    gboolean verify;
+
+    scan = copy_job->scan;
+    if (scan == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (&scan->mutex);
+    copy_scan_sync_totals (scan, source_info);
+    verify = scan->finished && !scan->verified;
+    scan->verified = scan->finished;
+    g_mutex_unlock (&scan->mutex);
+
+    if (verify && !job_aborted ((CommonJob *) copy_job))
+    {
+        verify_destination ((CommonJob *) copy_job,
+                            scan->dest,
+                            NULL,
+                            MAX (source_info->num_bytes - transfer_info->num_bytes, 0));
+    }
+}
+
+/* Returns the children of @dir as listed by the scanner, or NULL if the copy
+ * has to read the folder itself.
+ */
+static CopyScanListing *
+copy_scan_take_listing (CopyMoveJob *copy_job,
+                        GFile       *dir)
+{
+    CopyScan *scan;
+    CopyScanListing *listing;
+    GList *link;
+    g_autofree char *uri = NULL;
+    gint64 end_time;
+
+    scan = copy_job->scan;
+
+    /* Nothing below a folder the scanner did not list was scanned */
+    if (scan == NULL || scan->n_unlisted > 0)
+    {
+        return NULL;
+    }
+
+    uri = g_file_get_uri (dir);
+    listing = NULL;
+
+    g_mutex_lock (&scan->mutex);
+    while (!job_aborted ((CommonJob *) copy_job))
+    {
+        for (link = g_queue_peek_head_link (&scan->listings); link != NULL; link = link->next)
+        {
+            if (g_strcmp0 (((CopyScanListing *) link->data)->uri, uri) == 0)
+            {
+                break;
+            }
+        }
+
+        if (link != NULL)
+        {
+            /* The copy gets to the folders in the order they were listed,
+             * so the ones queued before this one were skipped.
+             */
+            while (g_queue_peek_head_link (&scan->listings) != link)
+            {
+                copy_scan_drop_head (scan);
+            }
+
+            listing = g_queue_pop_head (&scan->listings);
+            scan->n_queued_files -= g_queue_get_length (&listing->infos);
+            g_cond_broadcast (&scan->cond);
+            break;
+        }
+
+        /* Listed twice in the selection, or already dropped */
+        if (scan->finished || g_hash_table_contains (scan->listed, uri))
+        {
+            break;
+        }
+
+        /* Not listed yet, so everything queued comes before it */
+        while (!g_queue_is_empty (&scan->listings))
+        {
+            copy_scan_drop_head (scan);
+        }
+        g_cond_broadcast (&scan->cond);
+
+        end_time = g_get_monotonic_time () + PROGRESS_NOTIFY_INTERVAL;
+        g_cond_wait_until (&scan->cond, &scan->mutex, end_time);
+    }
+    g_mutex_unlock (&scan->mutex);
+
+    if (listing != NULL && listing->failed)
+    {
+        g_clear_pointer (&listing, copy_scan_listing_free);
+    }
+
+    return listing;
+}
+
+static GFileInfo *
+copy_scan_listing_next_file (CopyScanListing  *listing,
+                             GFileEnumerator  *enumerator,
+                             GCancellable     *cancellable,
+                             GError          **error)
+{
+    if (listing != NULL)
+    {
+        return g_queue_pop_head (&listing->infos);
+    }
+
+    return g_file_enumerator_next_file (enumerator, cancellable, error);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+static void
+report_copy_progress (CopyMoveJob  *copy_job,
+                      SourceInfo   *source_info,
+                      TransferInfo *transfer_info)
 {
     int files_left;
     goffset total_size;
@@ -4571,56 +5576,911 @@ retry:
         details = NULL;
         basename = get_basename (src);
 
-        if (IS_IO_ERROR (error, PERMISSION_DENIED))
+        if (IS_IO_ERROR (error, PERMISSION_DENIED))
+        {
+            secondary = g_strdup_printf (_("The folder “%s” cannot be copied because you do not "
+                                           "have permissions to create it in the destination."),
+                                         basename);
+        }
+        else
+        {
+            secondary = g_strdup_printf (_("There was an error creating the folder “%s”."),
+                                         basename);
+            details = error->message;
+        }
+
+        response = run_warning (job,
+                                primary,
+                                secondary,
+                                details,
+                                FALSE,
+                                CANCEL, SKIP, RETRY,
+                                NULL);
+
+        g_error_free (error);
+
+        if (response == 0 || response == GTK_RESPONSE_DELETE_EVENT)
+        {
+            abort_job (job);
+        }
+        else if (response == 1)
+        {
+            /* Skip: Do Nothing  */
+        }
+        else if (response == 2)
+        {
+            goto retry;
+        }
+        else
+        {
+            g_assert_not_reached ();
+        }
+        return CREATE_DEST_DIR_FAILED;
+    }
+    nautilus_file_changes_queue_file_added (*dest);
+
+    if (job->undo_info != NULL)
+    {
+        nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
+                                                            src, *dest);
+    }
+
+    return CREATE_DEST_DIR_SUCCESS;
+}
+
+/* Local copies don't go through g_file_copy(), which reads and writes the
+ * whole file in userspace on older versions of GLib. The file is cloned if
+ * the file system supports reflinks, otherwise copied in the kernel with
+ * copy_file_range(), and holes are kept as holes. Anything unusual, like
+ * symbolic links, replacing files or errors opening the files, is left to
+ * g_file_copy() so that the errors are the same as before.
+ */
+#define LOCAL_COPY_CHUNK_SIZE (8 * 1024 * 1024)
+#define LOCAL_COPY_BUFFER_SIZE (256 * 1024)
+
+/* Large files are checkpointed in the journal of the job every so often,
+ * so that a resumed job continues them where they were left.
+ */
+#define COPY_CHECKPOINT_MIN_SIZE (64 * 1024 * 1024)
+#define COPY_CHECKPOINT_INTERVAL (256 * 1024 * 1024)
+
+typedef struct
+{
+    NautilusCopyJournal *journal;
+    GFile *src;
+    GFile *dest;
+    /* A partial copy into the partial file of dest was recorded */
+    gboolean partial;
+    /* Where the copy starts, and the size and mtime the source had */
+    off_t offset;
+    off_t size;
+    gint64 mtime;
+    gboolean saved;
+} CopyCheckpoint;
+
+static CopyCheckpoint *
+copy_checkpoint_init (CopyCheckpoint      *checkpoint,
+                      NautilusCopyJournal *journal,
+                      GFile               *src,
+                      GFile               *dest)
+{
+    g_autoptr (GFile) partial_dest = NULL;
+    g_autoptr (GFile) partial_file = NULL;
+    goffset offset;
+    goffset size;
+
+    if (journal == NULL)
+    {
+        return NULL;
+    }
+
+    memset (checkpoint, 0, sizeof (CopyCheckpoint));
+    checkpoint->journal = journal;
+    checkpoint->src = src;
+    checkpoint->dest = dest;
+
+    partial_file = nautilus_copy_journal_get_partial_file (dest);
+    if (partial_file != NULL &&
+        nautilus_copy_journal_get_partial (journal, src, &partial_dest,
+                                           &offset, &size, &checkpoint->mtime) &&
+        g_file_equal (partial_dest, partial_file))
+    {
+        checkpoint->partial = TRUE;
+        checkpoint->offset = offset;
+        checkpoint->size = size;
+    }
+
+    return checkpoint;
+}
+
+static void
+copy_checkpoint_save (CopyCheckpoint *checkpoint,
+                      int             dest_fd,
+                      off_t           offset)
+{
+    g_autoptr (GFile) partial_file = NULL;
+    struct stat dest_stat;
+
+    if (checkpoint == NULL || checkpoint->size < COPY_CHECKPOINT_MIN_SIZE)
+    {
+        return;
+    }
+
+    /* Written to the partial file, see copy_local_file() */
+    partial_file = nautilus_copy_journal_get_partial_file (checkpoint->dest);
+    if (partial_file == NULL)
+    {
+        return;
+    }
+
+    /* A hole skipped at the end is not in the file yet */
+    if (fstat (dest_fd, &dest_stat) < 0 ||
+        (dest_stat.st_size < offset && ftruncate (dest_fd, offset) < 0))
+    {
+        return;
+    }
+
+    nautilus_copy_journal_set_partial (checkpoint->journal,
+                                       checkpoint->src, partial_file,
+                                       offset, checkpoint->size, checkpoint->mtime);
+    nautilus_copy_journal_sync (checkpoint->journal);
+    checkpoint->saved = TRUE;
+}
+
+/* Opens the partial copy left by an earlier run, emptied if it can't be
+ * continued.
+ */
+static int
+copy_checkpoint_open_partial (CopyCheckpoint *checkpoint,
+                              const char     *dest_path)
+{
+    struct stat dest_stat;
+    int fd;
+
+    fd = open (dest_path, O_WRONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (fstat (fd, &dest_stat) < 0 || !S_ISREG (dest_stat.st_mode))
+    {
+        close (fd);
+        return -1;
+    }
+
+    if (dest_stat.st_size < checkpoint->offset)
+    {
+        checkpoint->offset = 0;
+    }
+
+    if (checkpoint->offset == 0 && ftruncate (fd, 0) < 0)
+    {
+        close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Returns 0 or an errno value. @size is updated if the file turns out to be
+ * shorter than it was when it was opened. The copy starts at the offset of
+ * @checkpoint, if any.
+ */
+static int
+copy_local_file_data (int                     src_fd,
+                      int                     dest_fd,
+                      off_t                  *size,
+                      CopyCheckpoint         *checkpoint,
+                      GCancellable           *cancellable,
+                      GFileProgressCallback   progress_callback,
+                      gpointer                progress_data)
+{
+    g_autofree char *buffer = NULL;
+    gboolean use_copy_file_range;
+    gboolean use_seek_data;
+    off_t offset;
+    off_t data_end;
+    off_t checkpoint_offset;
+    gsize length;
+    ssize_t n;
+    int errsv;
+
+    offset = checkpoint != NULL ? checkpoint->offset : 0;
+
+#ifdef FICLONE
+    if (offset == 0 && ioctl (dest_fd, FICLONE, src_fd) == 0)
+    {
+        if (progress_callback != NULL)
+        {
+            progress_callback (*size, *size, progress_data);
+        }
+        return 0;
+    }
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+    use_copy_file_range = TRUE;
+#else
+    use_copy_file_range = FALSE;
+#endif
+#ifdef SEEK_DATA
+    use_seek_data = TRUE;
+#else
+    use_seek_data = FALSE;
+#endif
+
+    checkpoint_offset = offset;
+    while (offset < *size)
+    {
+        data_end = *size;
+#ifdef SEEK_DATA
+        if (use_seek_data)
+        {
+            off_t data_start;
+
+            data_start = lseek (src_fd, offset, SEEK_DATA);
+            if (data_start < 0 && errno == ENXIO)
+            {
+                /* Only a hole is left, the truncate below makes it */
+                break;
+            }
+            else if (data_start < 0)
+            {
+                use_seek_data = FALSE;
+            }
+            else
+            {
+                offset = data_start;
+                data_end = lseek (src_fd, offset, SEEK_HOLE);
+                if (data_end < 0 || data_end > *size)
+                {
+                    data_end = *size;
+                }
+            }
+        }
+#endif
+
+        while (offset < data_end)
+        {
+            if (g_cancellable_is_cancelled (cancellable))
+            {
+                copy_checkpoint_save (checkpoint, dest_fd, offset);
+                return ECANCELED;
+            }
+
+            length = MIN (data_end - offset, (off_t) LOCAL_COPY_CHUNK_SIZE);
+            n = -1;
+
+#ifdef HAVE_COPY_FILE_RANGE
+            if (use_copy_file_range)
+            {
+                off_t src_offset;
+                off_t dest_offset;
+
+                src_offset = offset;
+                dest_offset = offset;
+                n = copy_file_range (src_fd, &src_offset, dest_fd, &dest_offset, length, 0);
+                errsv = errno;
+                if (n < 0 && errsv == EINTR)
+                {
+                    continue;
+                }
+                /* Not supported between these files, or a pseudo file
+                 * system that claims a size but doesn't copy anything.
+                 */
+                if ((n < 0 && (errsv == ENOSYS || errsv == EXDEV || errsv == EINVAL ||
+                               errsv == EOPNOTSUPP || errsv == EBADF)) ||
+                    (n == 0 && offset == 0))
+                {
+                    use_copy_file_range = FALSE;
+                }
+                else if (n < 0)
+                {
+                    return errsv;
+                }
+            }
+#endif
+
+            if (!use_copy_file_range)
+            {
+                if (buffer == NULL)
+                {
+                    buffer = g_malloc (LOCAL_COPY_BUFFER_SIZE);
+                }
+
+                n = pread (src_fd, buffer, MIN (length, LOCAL_COPY_BUFFER_SIZE), offset);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return errno;
+                }
+
+                errsv = nautilus_write_all (dest_fd, buffer, n, offset);
+                if (errsv != 0)
+                {
+                    return errsv;
+                }
+            }
+
+            if (n == 0)
+            {
+                /* The file got shorter */
+                *size = offset;
+                break;
+            }
+
+            offset += n;
+
+            if (progress_callback != NULL)
+            {
+                progress_callback (offset, *size, progress_data);
+            }
+
+            if (offset - checkpoint_offset >= COPY_CHECKPOINT_INTERVAL)
+            {
+                copy_checkpoint_save (checkpoint, dest_fd, offset);
+                checkpoint_offset = offset;
+            }
+        }
+    }
+
+    /* Trailing holes, and the size if the file was truncated meanwhile */
+    if (ftruncate (dest_fd, *size) < 0)
+    {
+        return errno;
+    }
+
+    if (progress_callback != NULL)
+    {
+        progress_callback (*size, *size, progress_data);
+    }
+
+    return 0;
+}
+
+/* Gives the complete copy at @partial_path the name @dest_path, unless
+ * something took it meanwhile. Returns 0 or an errno value.
+ */
+static int
+rename_partial_file (const char *partial_path,
+                     const char *dest_path)
+{
+    struct stat dest_stat;
+
+    if (link (partial_path, dest_path) == 0)
+    {
+        unlink (partial_path);
+        return 0;
+    }
+
+    if (errno == EEXIST)
+    {
+        return EEXIST;
+    }
+
+    /* Without hard links, the name is checked right before instead */
+    if (lstat (dest_path, &dest_stat) == 0)
+    {
+        return EEXIST;
+    }
+
+    return rename (partial_path, dest_path) < 0 ? errno : 0;
+}
+
+/* Fails with G_IO_ERROR_NOT_SUPPORTED if g_file_copy() has to be used. */
+static gboolean
+copy_local_file (GFile                  *src,
+                 GFile                  *dest,
+                 GFileCopyFlags          flags,
+                 CopyCheckpoint         *checkpoint,
+                 GCancellable           *cancellable,
+                 GFileProgressCallback   progress_callback,
+                 gpointer                progress_data,
+                 GError                **error)
+{
+    g_autoptr (GFile) partial_file = NULL;
+    g_autofree char *src_path = NULL;
+    g_autofree char *dest_path = NULL;
+    g_autofree char *partial_path = NULL;
+    const char *write_path;
+    struct stat src_stat;
+    struct stat dest_stat;
+    off_t size;
+    int src_fd;
+    int dest_fd;
+    int open_flags;
+    int errsv;
+
+    src_path = g_file_get_path (src);
+    dest_path = g_file_get_path (dest);
+
+    if (src_path == NULL || dest_path == NULL ||
+        (flags & (G_FILE_COPY_OVERWRITE | G_FILE_COPY_BACKUP)) != 0)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "Not a plain local copy");
+        return FALSE;
+    }
+
+    open_flags = O_RDONLY | O_CLOEXEC;
+    if (flags & G_FILE_COPY_NOFOLLOW_SYMLINKS)
+    {
+        open_flags |= O_NOFOLLOW;
+    }
+
+    src_fd = open (src_path, open_flags);
+    if (src_fd < 0)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "Could not open the source");
+        return FALSE;
+    }
+
+    /* Files in pseudo file systems often claim to be empty, let GIO read
+     * those until the end.
+     */
+    if (fstat (src_fd, &src_stat) < 0 || !S_ISREG (src_stat.st_mode) ||
+        src_stat.st_size == 0)
+    {
+        close (src_fd);
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "Not a regular file with data");
+        return FALSE;
+    }
+
+    /* A copy that may be left partial is written to a hidden file next to
+     * the destination, and only gets its name once complete.
+     */
+    if (checkpoint != NULL &&
+        (checkpoint->partial || src_stat.st_size >= COPY_CHECKPOINT_MIN_SIZE))
+    {
+        partial_file = nautilus_copy_journal_get_partial_file (dest);
+        partial_path = partial_file != NULL ? g_file_get_path (partial_file) : NULL;
+    }
+    write_path = partial_path != NULL ? partial_path : dest_path;
+
+    /* Fails the same as creating the destination below would */
+    if (partial_path != NULL && lstat (dest_path, &dest_stat) == 0)
+    {
+        close (src_fd);
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                             g_strerror (EEXIST));
+        return FALSE;
+    }
+
+    dest_fd = -1;
+    if (checkpoint != NULL)
+    {
+        /* Continued only if the source is the same as back then */
+        if (checkpoint->size != src_stat.st_size ||
+            checkpoint->mtime != src_stat.st_mtime)
+        {
+            checkpoint->offset = 0;
+        }
+        checkpoint->size = src_stat.st_size;
+        checkpoint->mtime = src_stat.st_mtime;
+
+        if (checkpoint->partial && partial_path != NULL)
+        {
+            dest_fd = copy_checkpoint_open_partial (checkpoint, partial_path);
+        }
+        if (dest_fd < 0)
+        {
+            checkpoint->offset = 0;
+        }
+    }
+
+    /* Private until the permissions are copied below. A partial file left
+     * by another run is ours to replace.
+     */
+    if (dest_fd < 0)
+    {
+        dest_fd = open (write_path,
+                        O_WRONLY | O_CREAT | O_CLOEXEC |
+                        (partial_path != NULL ? O_TRUNC | O_NOFOLLOW : O_EXCL),
+                        (flags & G_FILE_COPY_TARGET_DEFAULT_PERMS) ? 0666 : 0600);
+    }
+    if (dest_fd < 0)
+    {
+        errsv = errno;
+        close (src_fd);
+
+        if (errsv == EEXIST)
+        {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                                 g_strerror (errsv));
+        }
+        else
+        {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                 "Could not create the destination");
+        }
+        return FALSE;
+    }
+
+    size = src_stat.st_size;
+    errsv = copy_local_file_data (src_fd, dest_fd, &size, checkpoint, cancellable,
+                                  progress_callback, progress_data);
+
+    if (errsv == 0 && !(flags & G_FILE_COPY_TARGET_DEFAULT_PERMS) &&
+        fchmod (dest_fd, src_stat.st_mode & 07777) < 0)
+    {
+        errsv = errno;
+    }
+
+    close (src_fd);
+    if (close (dest_fd) < 0 && errsv == 0)
+    {
+        errsv = errno;
+    }
+
+    if (errsv == 0 && partial_path != NULL)
+    {
+        errsv = rename_partial_file (partial_path, dest_path);
+    }
+
+    if (errsv != 0)
+    {
+        /* Unless it can be continued */
+        if (errsv != ECANCELED || checkpoint == NULL || !checkpoint->saved)
+        {
+            unlink (write_path);
+        }
+
+        if (errsv == ECANCELED)
+        {
+            g_cancellable_set_error_if_cancelled (cancellable, error);
+        }
+        else
+        {
+            g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                                 g_strerror (errsv));
+        }
+        return FALSE;
+    }
+
+    /* Same as g_file_copy(), failing to copy metadata is not a hard error */
+    g_file_copy_attributes (src, dest,
+                            flags & (G_FILE_COPY_NOFOLLOW_SYMLINKS |
+                                     G_FILE_COPY_ALL_METADATA |
+                                     G_FILE_COPY_TARGET_DEFAULT_PERMS),
+                            cancellable, NULL);
+
+    return TRUE;
+}
+
+static gboolean
+copy_file (GFile                  *src,
+           GFile                  *dest,
+           GFileCopyFlags          flags,
+           CopyCheckpoint         *checkpoint,
+           GCancellable           *cancellable,
+           GFileProgressCallback   progress_callback,
+           gpointer                progress_data,
+           GError                **error)
+{
+    g_autoptr (GFile) partial_file = NULL;
+    GError *local_error = NULL;
+
+    if (copy_local_file (src, dest, flags, checkpoint, cancellable,
+                         progress_callback, progress_data, &local_error))
+    {
+        return TRUE;
+    }
+
+    if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    {
+        g_propagate_error (error, local_error);
+        return FALSE;
+    }
+    g_error_free (local_error);
+
+    /* The partial copy from an earlier run is of no use to GIO */
+    if (checkpoint != NULL && checkpoint->partial)
+    {
+        partial_file = nautilus_copy_journal_get_partial_file (dest);
+        if (partial_file != NULL)
+        {
+            g_file_delete (partial_file, NULL, NULL);
+        }
+    }
+
+    return g_file_copy (src, dest, flags, cancellable,
+                        progress_callback, progress_data, error);
+}
+
+/* Regular files in a folder being copied are handed to a pool of worker
+ * threads, so that the per-file latency of small files overlaps. Anything
+ * that may need the user stays in the job thread: a file the workers fail to
+ * copy, for instance because it already exists, is copied again there, and
+ * the pending files are finished before a folder or any other file is
+ * handled, so prompts come up in the same order as before.
+ */
+#define MAX_COPY_THREADS 16
+#define PENDING_COPIES_PER_THREAD 8
+
+typedef struct
+{
+    CopyFilePool *pool;
+    GFile *src;
+    GFile *dest;
+    GFileCopyFlags flags;
+    goffset last_size;
+    gboolean done;
+    gboolean success;
+} CopyFileTask;
+
+static void
+copy_file_task_free (CopyFileTask *task)
+{
+    g_object_unref (task->src);
+    g_object_unref (task->dest);
+    g_free (task);
+}
+
+static void
+copy_file_task_progress_callback (goffset  current_num_bytes,
+                                  goffset  total_num_bytes,
+                                  gpointer user_data)
+{
+    CopyFileTask *task;
+    CopyFilePool *pool;
+
+    task = user_data;
+    pool = task->pool;
+
+    if (current_num_bytes > task->last_size)
+    {
+        g_mutex_lock (&pool->mutex);
+        pool->num_bytes += current_num_bytes - task->last_size;
+        g_mutex_unlock (&pool->mutex);
+
+        task->last_size = current_num_bytes;
+    }
+}
+
+static void
+copy_file_task_run (gpointer data,
+                    gpointer user_data)
+{
+    CopyFileTask *task;
+    CopyFilePool *pool;
+    gboolean success;
+
+    task = data;
+    pool = user_data;
+
+    /* The error is reported when copying again in the job thread. */
+    success = copy_file (task->src, task->dest,
+                         task->flags,
+                         NULL,
+                         pool->cancellable,
+                         copy_file_task_progress_callback,
+                         task,
+                         NULL);
+
+    g_mutex_lock (&pool->mutex);
+    if (!success)
+    {
+        /* Counted again by the retry, if any */
+        pool->num_bytes -= task->last_size;
+    }
+    task->success = success;
+    task->done = TRUE;
+    g_cond_broadcast (&pool->cond);
+    g_mutex_unlock (&pool->mutex);
+}
+
+/* Since this happens on a thread we can't use the global prefs object */
+static guint
+get_max_copy_threads (void)
+{
+    GSettings *prefs;
+    guint n_threads;
+
+    prefs = g_settings_new ("org.gnome.nautilus.preferences");
+    n_threads = g_settings_get_uint (prefs, NAUTILUS_PREFERENCES_COPY_THREADS);
+    g_object_unref (prefs);
+
+    if (n_threads == 0)
+    {
+        n_threads = g_get_num_processors ();
+    }
+
+    return CLAMP (n_threads, 1, MAX_COPY_THREADS);
+}
+
+static CopyFilePool *
+copy_file_pool_new (CopyMoveJob *job,
+                    GFile       *dest)
+{
+    CopyFilePool *pool;
+    guint n_threads;
+    GList *l;
+
+    /* Remote backends may not cope with concurrent operations, and the
+     * copies would only queue up on the daemon connection anyway.
+     */
+    if (!g_file_is_native (dest))
+    {
+        return NULL;
+    }
+    for (l = job->files; l != NULL; l = l->next)
+    {
+        if (!g_file_is_native (l->data))
+        {
+            return NULL;
+        }
+    }
+
+    n_threads = get_max_copy_threads ();
+    if (n_threads < 2)
+    {
+        return NULL;
+    }
+
+    pool = g_new0 (CopyFilePool, 1);
+    pool->cancellable = g_object_ref (job->common.cancellable);
+    pool->max_pending = n_threads * PENDING_COPIES_PER_THREAD;
+    g_queue_init (&pool->tasks);
+    g_mutex_init (&pool->mutex);
+    g_cond_init (&pool->cond);
+    pool->pool = g_thread_pool_new (copy_file_task_run, pool, n_threads, FALSE, NULL);
+
+    return pool;
+}
+
+static void
+copy_file_pool_free (CopyFilePool *pool)
+{
+    g_assert (g_queue_is_empty (&pool->tasks));
+
+    g_thread_pool_free (pool->pool, FALSE, TRUE);
+    g_object_unref (pool->cancellable);
+    g_mutex_clear (&pool->mutex);
+    g_cond_clear (&pool->cond);
+    g_free (pool);
+}
+
+static gboolean
+copy_file_pool_can_copy (CopyMoveJob *copy_job,
+                         GFile       *src,
+                         GFileInfo   *info)
+{
+    /* Large files are left to the job thread to be checkpointed, and
+     * files from an earlier run to be skipped or continued there.
+     */
+    return copy_job->file_pool != NULL &&
+           copy_job->target_name == NULL &&
+           g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR &&
+           !should_skip_file ((CommonJob *) copy_job, src) &&
+           (copy_job->journal == NULL ||
+            (g_file_info_get_size (info) < COPY_CHECKPOINT_MIN_SIZE &&
+             !nautilus_copy_journal_is_done (copy_job->journal, src) &&
+             !nautilus_copy_journal_get_partial (copy_job->journal, src,
+                                                 NULL, NULL, NULL, NULL)));
+}
+
+static void
+copy_file_pool_push (CopyMoveJob *copy_job,
+                     GFile       *src,
+                     GFile       *dest_dir,
+                     gboolean     same_fs,
+                     const char  *dest_fs_type,
+                     gboolean     readonly_source_fs)
+{
+    CopyFilePool *pool;
+    CopyFileTask *task;
+
+    pool = copy_job->file_pool;
+
+    task = g_new0 (CopyFileTask, 1);
+    task->pool = pool;
+    task->src = g_object_ref (src);
+    task->dest = get_target_file (src, dest_dir, dest_fs_type, same_fs);
+    task->flags = G_FILE_COPY_NOFOLLOW_SYMLINKS;
+    if (readonly_source_fs)
+    {
+        task->flags |= G_FILE_COPY_TARGET_DEFAULT_PERMS;
+    }
+
+    g_queue_push_tail (&pool->tasks, task);
+    g_thread_pool_push (pool->pool, task, NULL);
+}
+
+/* Waits for the oldest pending copies until at most @max_pending are left,
+ * reporting the progress of the workers meanwhile. The arguments after
+ * @max_pending are the ones the copies were queued with.
+ */
+static void
+copy_file_pool_finish (CopyMoveJob   *copy_job,
+                       guint          max_pending,
+                       GFile         *dest_dir,
+                       gboolean       same_fs,
+                       char         **dest_fs_type,
+                       SourceInfo    *source_info,
+                       TransferInfo  *transfer_info,
+                       gboolean      *skipped_file,
+                       gboolean       readonly_source_fs)
+{
+    CopyFilePool *pool;
+    CopyFileTask *task;
+    CommonJob *job;
+    gboolean local_skipped_file;
+    gint64 end_time;
+
+    pool = copy_job->file_pool;
+    job = (CommonJob *) copy_job;
+
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    while (g_queue_get_length (&pool->tasks) > max_pending)
+    {
+        task = g_queue_pop_head (&pool->tasks);
+
+        g_mutex_lock (&pool->mutex);
+        while (!task->done)
         {
-            secondary = g_strdup_printf (_("The folder “%s” cannot be copied because you do not "
-                                           "have permissions to create it in the destination."),
-                                         basename);
+            end_time = g_get_monotonic_time () + PROGRESS_NOTIFY_INTERVAL;
+            if (!g_cond_wait_until (&pool->cond, &pool->mutex, end_time))
+            {
+                transfer_info->num_bytes += pool->num_bytes;
+                pool->num_bytes = 0;
+
+                g_mutex_unlock (&pool->mutex);
+                report_copy_progress (copy_job, source_info, transfer_info);
+                g_mutex_lock (&pool->mutex);
+            }
         }
-        else
+        transfer_info->num_bytes += pool->num_bytes;
+        pool->num_bytes = 0;
+        g_mutex_unlock (&pool->mutex);
+
+        if (task->success)
         {
-            secondary = g_strdup_printf (_("There was an error creating the folder “%s”."),
-                                         basename);
-            details = error->message;
-        }
+            transfer_info->num_files++;
+            report_copy_progress (copy_job, source_info, transfer_info);
 
-        response = run_warning (job,
-                                primary,
-                                secondary,
-                                details,
-                                FALSE,
-                                CANCEL, SKIP, RETRY,
-                                NULL);
+            nautilus_file_changes_queue_file_added (task->dest);
 
-        g_error_free (error);
+            if (copy_job->journal != NULL)
+            {
+                nautilus_copy_journal_add_done (copy_job->journal, task->src);
+            }
 
-        if (response == 0 || response == GTK_RESPONSE_DELETE_EVENT)
-        {
-            abort_job (job);
-        }
-        else if (response == 1)
-        {
-            /* Skip: Do Nothing  */
+            if (job->undo_info != NULL)
+            {
+                nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
+                                                                    task->src, task->dest);
+            }
         }
-        else if (response == 2)
+        else if (job_aborted (job))
         {
-            goto retry;
+            *skipped_file = TRUE;
         }
         else
         {
-            g_assert_not_reached ();
+            copy_move_file (copy_job, task->src, dest_dir, same_fs, FALSE, dest_fs_type,
+                            source_info, transfer_info, NULL, FALSE, &local_skipped_file,
+                            readonly_source_fs);
+
+            if (local_skipped_file)
+            {
+                source_info_remove_file_from_count (task->src, job, source_info);
+                report_copy_progress (copy_job, source_info, transfer_info);
+                *skipped_file = TRUE;
+            }
         }
-        return CREATE_DEST_DIR_FAILED;
-    }
-    nautilus_file_changes_queue_file_added (*dest);
 
-    if (job->undo_info != NULL)
-    {
-        nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
-                                                            src, *dest);
+        copy_file_task_free (task);
     }
-
-    return CREATE_DEST_DIR_SUCCESS;
 }
 
 /* a return value of FALSE means retry, i.e.
@@ -4646,6 +6506,7 @@ copy_move_directory (CopyMoveJob   *copy_job,
     GError *error;
     GFile *src_file;
     GFileEnumerator *enumerator;
+    CopyScanListing *listing;
     char *primary, *secondary, *details;
     char *dest_fs_type;
     int response;
@@ -4692,37 +6553,75 @@ copy_move_directory (CopyMoveJob   *copy_job,
     dest_fs_type = NULL;
 
     skip_error = should_skip_readdir_error (job, src);
+
+    listing = copy_scan_take_listing (copy_job, src);
+    copy_scan_update_totals (copy_job, source_info, transfer_info);
+    if (listing == NULL && copy_job->scan != NULL)
+    {
+        copy_job->scan->n_unlisted++;
+    }
 retry:
     error = NULL;
-    enumerator = g_file_enumerate_children (src,
-                                            G_FILE_ATTRIBUTE_STANDARD_NAME,
-                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                            job->cancellable,
-                                            &error);
-    if (enumerator)
+    enumerator = NULL;
+    if (listing == NULL)
+    {
+        enumerator = g_file_enumerate_children (src,
+                                                G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                                G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                job->cancellable,
+                                                &error);
+    }
+    if (listing != NULL || enumerator != NULL)
     {
         error = NULL;
 
         while (!job_aborted (job) &&
-               (info = g_file_enumerator_next_file (enumerator, job->cancellable, skip_error ? NULL : &error)) != NULL)
+               (info = copy_scan_listing_next_file (listing, enumerator, job->cancellable,
+                                                    skip_error ? NULL : &error)) != NULL)
         {
             src_file = g_file_get_child (src,
                                          g_file_info_get_name (info));
-            copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
-                            source_info, transfer_info, NULL, FALSE, &local_skipped_file,
-                            readonly_source_fs);
 
-            if (local_skipped_file)
+            if (copy_file_pool_can_copy (copy_job, src_file, info))
             {
-                source_info_remove_file_from_count (src_file, job, source_info);
-                report_copy_progress (copy_job, source_info, transfer_info);
+                copy_file_pool_push (copy_job, src_file, *dest, same_fs, dest_fs_type,
+                                     readonly_source_fs);
+                copy_file_pool_finish (copy_job, copy_job->file_pool->max_pending,
+                                       *dest, same_fs, &dest_fs_type,
+                                       source_info, transfer_info, &local_skipped_file,
+                                       readonly_source_fs);
+            }
+            else
+            {
+                copy_file_pool_finish (copy_job, 0,
+                                       *dest, same_fs, &dest_fs_type,
+                                       source_info, transfer_info, &local_skipped_file,
+                                       readonly_source_fs);
+                copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
+                                source_info, transfer_info, NULL, FALSE, &local_skipped_file,
+                                readonly_source_fs);
+
+                if (local_skipped_file)
+                {
+                    source_info_remove_file_from_count (src_file, job, source_info);
+                    report_copy_progress (copy_job, source_info, transfer_info);
+                }
             }
 
             g_object_unref (src_file);
             g_object_unref (info);
         }
-        g_file_enumerator_close (enumerator, job->cancellable, NULL);
-        g_object_unref (enumerator);
+        copy_file_pool_finish (copy_job, 0,
+                               *dest, same_fs, &dest_fs_type,
+                               source_info, transfer_info, &local_skipped_file,
+                               readonly_source_fs);
+        if (enumerator != NULL)
+        {
+            g_file_enumerator_close (enumerator, job->cancellable, NULL);
+            g_object_unref (enumerator);
+        }
 
         if (error && IS_IO_ERROR (error, CANCELLED))
         {
@@ -4913,6 +6812,15 @@ skip:
         *skipped_file = TRUE;
     }
 
+    if (listing != NULL)
+    {
+        copy_scan_listing_free (listing);
+    }
+    else if (copy_job->scan != NULL)
+    {
+        copy_job->scan->n_unlisted--;
+    }
+
     g_free (dest_fs_type);
     return TRUE;
 }
@@ -5048,6 +6956,89 @@ get_target_file_for_display_name (GFile       *dir,
     return dest;
 }
 
+/* Counts a file done with in an earlier run of the job. */
+static void
+copy_job_count_done_file (CopyMoveJob  *copy_job,
+                          GFile        *src,
+                          SourceInfo   *source_info,
+                          TransferInfo *transfer_info)
+{
+    g_autoptr (GFileInfo) info = NULL;
+
+    info = g_file_query_info (src,
+                              G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                              NULL, NULL);
+    if (info != NULL)
+    {
+        transfer_info->num_bytes += g_file_info_get_size (info);
+    }
+    transfer_info->num_files++;
+
+    report_copy_progress (copy_job, source_info, transfer_info);
+}
+
+/* Journals are kept for copies and moves into a local folder. A duplicate
+ * or a copy under another name would pick new names when resumed, so those
+ * are not. Neither are the ones small enough to be counted in full before
+ * they start, they are over before they would be worth resuming.
+ */
+#define JOURNAL_MIN_BYTES (64 * 1024 * 1024)
+#define JOURNAL_MIN_FILES 1000
+
+static void
+copy_job_start_journal (CopyMoveJob *copy_job,
+                        SourceInfo  *source_info)
+{
+    g_autoptr (GError) error = NULL;
+    gboolean counted;
+
+    if (copy_job->journal != NULL ||
+        copy_job->destination == NULL ||
+        copy_job->target_name != NULL ||
+        !g_file_is_native (copy_job->destination))
+    {
+        return;
+    }
+
+    counted = TRUE;
+    if (copy_job->scan != NULL)
+    {
+        g_mutex_lock (&copy_job->scan->mutex);
+        counted = copy_job->scan->finished;
+        g_mutex_unlock (&copy_job->scan->mutex);
+    }
+
+    if (counted &&
+        source_info->num_bytes < JOURNAL_MIN_BYTES &&
+        source_info->num_files < JOURNAL_MIN_FILES)
+    {
+        return;
+    }
+
+    copy_job->journal = nautilus_copy_journal_new (copy_job->files,
+                                                   copy_job->destination,
+                                                   copy_job->is_move,
+                                                   &error);
+    if (copy_job->journal == NULL)
+    {
+        g_warning ("Could not start a journal, the operation can't be resumed: %s",
+                   error->message);
+    }
+}
+
+/* Removes the journal if the job got to the end, even with files skipped. */
+static void
+copy_job_finish_journal (CopyMoveJob *copy_job)
+{
+    if (copy_job->journal != NULL)
+    {
+        nautilus_copy_journal_close (copy_job->journal,
+                                     !job_aborted ((CommonJob *) copy_job));
+        copy_job->journal = NULL;
+    }
+}
+
 /* Debuting files is non-NULL only for toplevel items */
 static void
 copy_move_file (CopyMoveJob   *copy_job,
@@ -5074,6 +7065,8 @@ copy_move_file (CopyMoveJob   *copy_job,
     gboolean res;
     int unique_name_nr;
     gboolean handled_invalid_filename;
+    CopyCheckpoint checkpoint_data;
+    CopyCheckpoint *checkpoint;
 
     job = (CommonJob *) copy_job;
 
@@ -5085,6 +7078,13 @@ copy_move_file (CopyMoveJob   *copy_job,
         return;
     }
 
+    if (copy_job->journal != NULL &&
+        nautilus_copy_journal_is_done (copy_job->journal, src))
+    {
+        copy_job_count_done_file (copy_job, src, source_info, transfer_info);
+        return;
+    }
+
     unique_name_nr = 1;
 
     /* another file in the same directory might have handled the invalid
@@ -5210,23 +7210,48 @@ retry:
     pdata.source_info = source_info;
     pdata.transfer_info = transfer_info;
 
+    checkpoint = copy_checkpoint_init (&checkpoint_data, copy_job->journal, src, dest);
+
     if (copy_job->is_move)
     {
-        res = g_file_move (src, dest,
-                           flags,
-                           job->cancellable,
-                           copy_file_progress_callback,
-                           &pdata,
-                           &error);
+        res = FALSE;
+
+        /* Across file systems the file is copied and deleted here rather
+         * than by GIO, so that large files are checkpointed.
+         */
+        if (checkpoint == NULL || !checkpoint->partial)
+        {
+            res = g_file_move (src, dest,
+                               checkpoint != NULL ? flags | G_FILE_COPY_NO_FALLBACK_FOR_MOVE : flags,
+                               job->cancellable,
+                               copy_file_progress_callback,
+                               &pdata,
+                               &error);
+        }
+
+        if (!res && checkpoint != NULL &&
+            (checkpoint->partial || IS_IO_ERROR (error, NOT_SUPPORTED)))
+        {
+            g_clear_error (&error);
+            res = copy_file (src, dest,
+                             flags | G_FILE_COPY_ALL_METADATA,
+                             checkpoint,
+                             job->cancellable,
+                             copy_file_progress_callback,
+                             &pdata,
+                             &error) &&
+                  g_file_delete (src, job->cancellable, &error);
+        }
     }
     else
     {
-        res = g_file_copy (src, dest,
-                           flags,
-                           job->cancellable,
-                           copy_file_progress_callback,
-                           &pdata,
-                           &error);
+        res = copy_file (src, dest,
+                         flags,
+                         checkpoint,
+                         job->cancellable,
+                         copy_file_progress_callback,
+                         &pdata,
+                         &error);
     }
 
     if (res)
@@ -5265,6 +7290,11 @@ retry:
             nautilus_file_changes_queue_file_added (dest);
         }
 
+        if (copy_job->journal != NULL)
+        {
+            nautilus_copy_journal_add_done (copy_job->journal, src);
+        }
+
         if (job->undo_info != NULL)
         {
             nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
@@ -5620,6 +7650,8 @@ copy_files (CopyMoveJob  *job,
         }
         if (dest)
         {
+            copy_scan_update_totals (job, source_info, transfer_info);
+
             skipped_file = FALSE;
             copy_move_file (job, src, dest,
                             same_fs, unique_names,
@@ -5666,6 +7698,7 @@ copy_task_done (GObject      *source_object,
     g_free (job->target_name);
 
     g_clear_object (&job->fake_display_source);
+    g_clear_object (&job->journal_location);
 
     finalize_common ((CommonJob *) job);
 
@@ -5733,15 +7766,6 @@ nautilus_file_operations_copy (GTask        *task,
 
     nautilus_progress_info_start (job->common.progress);
 
-    scan_sources (job->files,
-                  &source_info,
-                  common,
-                  OP_KIND_COPY);
-    if (job_aborted (common))
-    {
-        return;
-    }
-
     if (job->destination)
     {
         dest = g_object_ref (job->destination);
@@ -5754,22 +7778,40 @@ nautilus_file_operations_copy (GTask        *task,
         dest = g_file_get_parent (job->files->data);
     }
 
+    memset (&source_info, 0, sizeof (source_info));
+    source_info.op = OP_KIND_COPY;
+
+    job->scan = copy_scan_new (job, dest);
+    copy_scan_wait (job, &source_info);
+    if (job_aborted (common))
+    {
+        goto out;
+    }
+
     verify_destination (&job->common,
                         dest,
                         &dest_fs_id,
                         source_info.num_bytes);
-    g_object_unref (dest);
     if (job_aborted (common))
     {
-        return;
+        goto out;
     }
 
     g_timer_start (job->common.time);
 
+    job->file_pool = copy_file_pool_new (job, dest);
+    copy_job_start_journal (job, &source_info);
+
     memset (&transfer_info, 0, sizeof (transfer_info));
     copy_files (job,
                 dest_fs_id,
                 &source_info, &transfer_info);
+
+out:
+    g_clear_pointer (&job->file_pool, copy_file_pool_free);
+    g_clear_pointer (&job->scan, copy_scan_free);
+    copy_job_finish_journal (job);
+    g_object_unref (dest);
 }
 
 void
@@ -6184,11 +8226,21 @@ move_files_prepare (CopyMoveJob  *job,
             same_fs = has_fs_id (src, dest_fs_id);
         }
 
-        move_file_prepare (job, src, job->destination,
-                           same_fs, dest_fs_type,
-                           job->debuting_files,
-                           fallbacks,
-                           left);
+        /* Partly copied across file systems in an earlier run */
+        if (job->journal != NULL &&
+            nautilus_copy_journal_get_partial (job->journal, src, NULL, NULL, NULL, NULL))
+        {
+            *fallbacks = g_list_prepend (*fallbacks,
+                                         move_copy_file_callback_new (src, FALSE));
+        }
+        else
+        {
+            move_file_prepare (job, src, job->destination,
+                               same_fs, dest_fs_type,
+                               job->debuting_files,
+                               fallbacks,
+                               left);
+        }
         report_preparing_move_progress (job, total, --left);
         i++;
     }
@@ -6426,6 +8478,12 @@ nautilus_file_operations_move (GTask        *task,
         goto aborted;
     }
 
+    /* Renames are done already, only copies can be resumed */
+    if (fallbacks != NULL)
+    {
+        copy_job_start_journal (job, &source_info);
+    }
+
     memset (&transfer_info, 0, sizeof (transfer_info));
     move_files (job,
                 fallbacks,
@@ -6433,9 +8491,119 @@ nautilus_file_operations_move (GTask        *task,
                 &source_info, &transfer_info);
 
 aborted:
+    copy_job_finish_journal (job);
     g_list_free_full (fallbacks, g_free);
 }
 
+static void
+nautilus_file_operations_resume (GTask        *task,
+                                 gpointer      source_object,
+                                 gpointer      task_data,
+                                 GCancellable *cancellable)
+{
+    CopyMoveJob *job;
+    CommonJob *common;
+    g_autoptr (GError) error = NULL;
+    GList *l;
+
+    job = task_data;
+    common = &job->common;
+
+    job->journal = nautilus_copy_journal_load (job->journal_location, &error);
+    if (job->journal == NULL)
+    {
+        run_error (common,
+                   g_strdup (_("The operation can’t be resumed.")),
+                   g_strdup (_("There was an error reading what was done already.")),
+                   error->message,
+                   FALSE,
+                   CANCEL,
+                   NULL);
+        abort_job (common);
+        return;
+    }
+
+    job->is_move = nautilus_copy_journal_get_is_move (job->journal);
+    job->destination = g_object_ref (nautilus_copy_journal_get_destination (job->journal));
+    nautilus_progress_info_set_destination (common->progress, job->destination);
+
+    for (l = nautilus_copy_journal_get_files (job->journal); l != NULL; l = l->next)
+    {
+        /* Whatever was moved is gone from the source */
+        if (job->is_move && !g_file_query_exists (l->data, NULL))
+        {
+            continue;
+        }
+        job->files = g_list_prepend (job->files, g_object_ref (l->data));
+    }
+    job->files = g_list_reverse (job->files);
+
+    if (job->files == NULL)
+    {
+        copy_job_finish_journal (job);
+        return;
+    }
+
+    /* The folders copied before are there already */
+    common->merge_all = TRUE;
+
+    if (job->is_move)
+    {
+        nautilus_file_operations_move (task, source_object, task_data, cancellable);
+    }
+    else
+    {
+        nautilus_file_operations_copy (task, source_object, task_data, cancellable);
+    }
+}
+
+static CopyMoveJob *
+resume_job_setup (GFile                *journal,
+                  GtkWindow            *parent_window,
+                  NautilusCopyCallback  done_callback,
+                  gpointer              done_callback_data)
+{
+    CopyMoveJob *job;
+
+    job = op_job_new (CopyMoveJob, parent_window);
+    job->done_callback = done_callback;
+    job->done_callback_data = done_callback_data;
+    job->journal_location = g_object_ref (journal);
+    job->debuting_files = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal, g_object_unref, NULL);
+
+    return job;
+}
+
+void
+nautilus_file_operations_resume_sync (GFile *journal)
+{
+    GTask *task;
+    CopyMoveJob *job;
+
+    job = resume_job_setup (journal, NULL, NULL, NULL);
+    task = g_task_new (NULL, job->common.cancellable, NULL, job);
+    g_task_set_task_data (task, job, NULL);
+    g_task_run_in_thread_sync (task, nautilus_file_operations_resume);
+    g_object_unref (task);
+    copy_task_done (NULL, NULL, job);
+}
+
+void
+nautilus_file_operations_resume_async (GFile                *journal,
+                                       GtkWindow            *parent_window,
+                                       NautilusCopyCallback  done_callback,
+                                       gpointer              done_callback_data)
+{
+    GTask *task;
+    CopyMoveJob *job;
+
+    job = resume_job_setup (journal, parent_window, done_callback, done_callback_data);
+    task = g_task_new (NULL, job->common.cancellable, copy_task_done, job);
+    g_task_set_task_data (task, job, NULL);
+    g_task_run_in_thread (task, nautilus_file_operations_resume);
+    g_object_unref (task);
+}
+
 static void
 report_preparing_link_progress (CopyMoveJob *link_job,
                                 int          total,
@@ -7699,6 +9867,34 @@ delete_trash_file (CommonJob *job,
     }
 }
 
+/* The trash backend picks up the changes in the home trash on its own, so
+ * its contents can be deleted directly. The files go first, an info file
+ * left behind without its file is ignored.
+ */
+static void
+empty_home_trash (CommonJob *job)
+{
+    const char *dirs[] = { "files", "info" };
+    g_autofree char *trash_path = NULL;
+    DeleteEngine *engine;
+    guint i;
+
+    trash_path = g_build_filename (g_get_user_data_dir (), "Trash", NULL);
+    engine = delete_engine_new (job->cancellable);
+
+    for (i = 0; i < G_N_ELEMENTS (dirs) && !job_aborted (job); i++)
+    {
+        g_autofree char *path = NULL;
+        g_autoptr (GFile) dir = NULL;
+
+        path = g_build_filename (trash_path, dirs[i], NULL);
+        dir = g_file_new_for_path (path);
+        delete_local_file_recursively (engine, dir, FALSE, NULL, NULL, NULL);
+    }
+
+    delete_engine_free (engine);
+}
+
 static void
 empty_trash_task_done (GObject      *source_object,
                        GAsyncResult *res,
@@ -7748,6 +9944,10 @@ empty_trash_thread_func (GTask        *task,
              l != NULL && !job_aborted (common);
              l = l->next)
         {
+            if (g_file_has_uri_scheme (l->data, "trash"))
+            {
+                empty_home_trash (common);
+            }
             delete_trash_file (common, l->data, FALSE, TRUE);
         }
     }
@@ -130,6 +130,13 @@ void nautilus_file_operations_move_async (GList                *files,
 void nautilus_file_operations_move_sync (GList                *files,
                                          GFile                *target_dir);
 
+/* Resumes a copy or move that did not finish, from its journal. */
+void nautilus_file_operations_resume_async (GFile                *journal,
+                                            GtkWindow            *parent_window,
+                                            NautilusCopyCallback  done_callback,
+                                            gpointer              done_callback_data);
+void nautilus_file_operations_resume_sync (GFile                *journal);
+
 void nautilus_file_operations_duplicate (GList                *files,
 					 GtkWindow            *parent_window,
 					 NautilusCopyCallback  done_callback,
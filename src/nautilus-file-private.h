@@ -40,6 +40,38 @@ typedef enum {
 	UNKNOWN
 } Knowledge;
 
+/* Details that most files never have. They live in a separate block
+ * that is only allocated the first time one of them is set, to keep
+ * the file objects small in large folders.
+ */
+typedef struct
+{
+	/* The pixbufs themselves live in the thumbnail cache */
+	char *thumbnail_path;
+	time_t thumbnail_mtime;
+
+	char *trash_orig_path;
+	time_t trash_time; /* 0 is unknown */
+
+	/* The following is for file operations in progress. There are
+	 * normally only a few of these.
+	 */
+	GList *operations_in_progress;
+
+	/* Emblems provided by extensions */
+	GList *extension_emblems;
+	GList *pending_extension_emblems;
+
+	/* Attributes provided by extensions */
+	GHashTable *extension_attributes;
+	GHashTable *pending_extension_attributes;
+
+	gchar *fts_snippet;
+
+	guint64 free_space; /* (guint64)-1 for unknown */
+	time_t free_space_read; /* The time free_space was updated, or 0 for never */
+} NautilusFileExtraDetails;
+
 struct NautilusFileDetails
 {
 	NautilusDirectory *directory;
@@ -51,7 +83,8 @@ struct NautilusFileDetails
 
 	eel_ref_str display_name;
 	char *display_name_collation_key;
-	char *directory_name_collation_key;
+	eel_ref_str directory_name_collation_key; /* shared by the files of a directory */
+	eel_ref_str type_collation_key; /* NULL if there is no type description */
 	eel_ref_str edit_name;
 
 	goffset size; /* -1 is unknown */
@@ -73,7 +106,7 @@ struct NautilusFileDetails
 	
 	eel_ref_str mime_type;
 	
-	char *selinux_context;
+	eel_ref_str selinux_context;
 	char *description;
 	
 	GError *get_info_error;
@@ -86,13 +119,6 @@ struct NautilusFileDetails
 	goffset deep_size;
 
 	GIcon *icon;
-	
-	char *thumbnail_path;
-	GdkPixbuf *thumbnail;
-	time_t thumbnail_mtime;
-
-	GdkPixbuf *scaled_thumbnail;
-	double thumbnail_scale;
 
 	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
 
@@ -105,28 +131,16 @@ struct NautilusFileDetails
 	 */
 	eel_ref_str filesystem_id;
 
-	char *trash_orig_path;
-
-	/* The following is for file operations in progress. Since
-	 * there are normally only a few of these, we can move them to
-	 * a separate hash table or something if required to keep the
-	 * file objects small.
-	 */
-	GList *operations_in_progress;
-
 	/* NautilusInfoProviders that need to be run for this file */
 	GList *pending_info_providers;
 
-	/* Emblems provided by extensions */
-	GList *extension_emblems;
-	GList *pending_extension_emblems;
-
-	/* Attributes provided by extensions */
-	GHashTable *extension_attributes;
-	GHashTable *pending_extension_attributes;
-
 	GHashTable *metadata;
 
+	/* NULL until one of the rarely used details is set, see
+	 * nautilus_file_get_extra_details().
+	 */
+	NautilusFileExtraDetails *extra;
+
 	/* Mount for mountpoint or the references GMount for a "mountable" */
 	GMount *mount;
 	
@@ -165,10 +179,17 @@ struct NautilusFileDetails
 	eel_boolean_bit got_custom_activation_uri     : 1;
 
 	eel_boolean_bit thumbnail_is_up_to_date       : 1;
+	eel_boolean_bit thumbnail_is_loaded           : 1;
 	eel_boolean_bit thumbnailing_failed           : 1;
+	/* Loaded again after being dropped from the thumbnail cache. Not
+	 * loaded again until something asks for it, so that more thumbnails
+	 * on screen than the cache holds don't keep evicting each other. */
+	eel_boolean_bit thumbnail_was_evicted         : 1;
 	
 	eel_boolean_bit is_thumbnailing               : 1;
 
+	eel_boolean_bit type_collation_key_is_up_to_date : 1;
+
 	eel_boolean_bit is_symlink                    : 1;
 	eel_boolean_bit is_mountpoint                 : 1;
 	eel_boolean_bit is_hidden                     : 1;
@@ -197,14 +218,9 @@ struct NautilusFileDetails
 	eel_boolean_bit filesystem_remote             : 1;
 	eel_ref_str     filesystem_type;
 
-	time_t trash_time; /* 0 is unknown */
 	time_t recency; /* 0 is unknown */
 
 	gdouble search_relevance;
-	gchar *fts_snippet;
-
-	guint64 free_space; /* (guint)-1 for unknown */
-	time_t free_space_read; /* The time free_space was updated, or 0 for never */
 };
 
 typedef struct {
@@ -232,6 +248,15 @@ gboolean      nautilus_file_get_date                       (NautilusFile
 							    time_t                 *date);
 void          nautilus_file_updated_deep_count_in_progress (NautilusFile           *file);
 
+/* Never returns NULL, files without extra details share a read-only
+ * block of defaults.
+ */
+const NautilusFileExtraDetails *
+              nautilus_file_peek_extra_details             (NautilusFile           *file);
+/* Allocates the extra details on first use, for writing. */
+NautilusFileExtraDetails *
+              nautilus_file_get_extra_details              (NautilusFile           *file);
+
 
 void          nautilus_file_clear_info                     (NautilusFile           *file);
 /* Compare file's state with a fresh file info struct, return FALSE if
@@ -39,6 +39,7 @@
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 
@@ -1508,3 +1509,42 @@ nautilus_file_system_is_remote (const char *file_system)
 
     return file_system != NULL && g_strv_contains (remote_types, file_system);
 }
+
+int
+nautilus_write_all (int         fd,
+                    const char *buffer,
+                    gsize       length,
+                    goffset     offset)
+{
+    ssize_t n;
+
+    while (length > 0)
+    {
+        if (offset < 0)
+        {
+            n = write (fd, buffer, length);
+        }
+        else
+        {
+            n = pwrite (fd, buffer, length, offset);
+        }
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+
+        buffer += n;
+        length -= n;
+        if (offset >= 0)
+        {
+            offset += n;
+        }
+    }
+
+    return 0;
+}
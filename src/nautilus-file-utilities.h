@@ -143,3 +143,11 @@ NautilusQueryRecursive location_settings_search_get_recursive (void);
 NautilusQueryRecursive location_settings_search_get_recursive_for_location (GFile *location);
 
 gboolean nautilus_file_system_is_remote (const char *file_system);
+
+/* Writes all of @buffer to @fd at @offset, or at the current position if
+ * @offset is negative. Returns 0, or the errno of the write that failed.
+ */
+int nautilus_write_all (int         fd,
+                        const char *buffer,
+                        gsize       length,
+                        goffset     offset);
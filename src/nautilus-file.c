@@ -67,6 +67,7 @@
 #include "nautilus-module.h"
 #include "nautilus-signaller.h"
 #include "nautilus-tag-manager.h"
+#include "nautilus-thumbnail-cache.h"
 #include "nautilus-thumbnails.h"
 #include "nautilus-ui-utilities.h"
 #include "nautilus-vfs-file.h"
@@ -192,8 +193,50 @@ nautilus_file_init (NautilusFile *file)
 
     nautilus_file_clear_info (file);
     nautilus_file_invalidate_extension_info_internal (file);
+}
+
+static const NautilusFileExtraDetails empty_extra_details =
+{
+    .free_space = (guint64) -1,
+};
+
+const NautilusFileExtraDetails *
+nautilus_file_peek_extra_details (NautilusFile *file)
+{
+    if (file->details->extra == NULL)
+    {
+        return &empty_extra_details;
+    }
+
+    return file->details->extra;
+}
+
+NautilusFileExtraDetails *
+nautilus_file_get_extra_details (NautilusFile *file)
+{
+    if (file->details->extra == NULL)
+    {
+        file->details->extra = g_new (NautilusFileExtraDetails, 1);
+        *file->details->extra = empty_extra_details;
+    }
+
+    return file->details->extra;
+}
+
+static void
+extra_details_free (NautilusFileExtraDetails *extra)
+{
+    g_assert (extra->operations_in_progress == NULL);
+
+    g_free (extra->thumbnail_path);
+    g_free (extra->trash_orig_path);
+    g_list_free_full (extra->pending_extension_emblems, g_free);
+    g_list_free_full (extra->extension_emblems, g_free);
+    g_clear_pointer (&extra->pending_extension_attributes, g_hash_table_destroy);
+    g_clear_pointer (&extra->extension_attributes, g_hash_table_destroy);
+    g_free (extra->fts_snippet);
 
-    file->details->free_space = -1;
+    g_free (extra);
 }
 
 static GObject *
@@ -526,8 +569,12 @@ nautilus_file_clear_info (NautilusFile *file)
         file->details->icon = NULL;
     }
 
-    g_free (file->details->thumbnail_path);
-    file->details->thumbnail_path = NULL;
+    if (file->details->extra != NULL)
+    {
+        g_clear_pointer (&file->details->extra->thumbnail_path, g_free);
+        file->details->extra->trash_time = 0;
+    }
+    file->details->thumbnail_is_loaded = FALSE;
     file->details->thumbnailing_failed = FALSE;
 
     file->details->is_symlink = FALSE;
@@ -556,16 +603,18 @@ nautilus_file_clear_info (NautilusFile *file)
     file->details->sort_order = 0;
     file->details->mtime = 0;
     file->details->atime = 0;
-    file->details->trash_time = 0;
     file->details->recency = 0;
     g_free (file->details->symlink_name);
     file->details->symlink_name = NULL;
     eel_ref_str_unref (file->details->mime_type);
     file->details->mime_type = NULL;
-    g_free (file->details->selinux_context);
+    eel_ref_str_unref (file->details->selinux_context);
     file->details->selinux_context = NULL;
     g_free (file->details->description);
     file->details->description = NULL;
+    eel_ref_str_unref (file->details->type_collation_key);
+    file->details->type_collation_key = NULL;
+    file->details->type_collation_key_is_up_to_date = FALSE;
     eel_ref_str_unref (file->details->owner);
     file->details->owner = NULL;
     eel_ref_str_unref (file->details->owner_real);
@@ -592,14 +641,18 @@ nautilus_file_set_directory (NautilusFile      *file,
                              NautilusDirectory *directory)
 {
     char *parent_uri;
+    char *collation_key;
 
     g_clear_object (&file->details->directory);
-    g_free (file->details->directory_name_collation_key);
+    eel_ref_str_unref (file->details->directory_name_collation_key);
 
     file->details->directory = nautilus_directory_ref (directory);
 
+    /* All the files of a directory have the same key, share it. */
     parent_uri = nautilus_file_get_parent_uri (file);
-    file->details->directory_name_collation_key = g_utf8_collate_key_for_filename (parent_uri, -1);
+    collation_key = g_utf8_collate_key_for_filename (parent_uri, -1);
+    file->details->directory_name_collation_key = eel_ref_str_get_unique (collation_key);
+    g_free (collation_key);
     g_free (parent_uri);
 }
 
@@ -845,6 +898,61 @@ nautilus_file_get_by_uri (const char *uri)
     return nautilus_file_get (location);
 }
 
+/* Same as calling nautilus_file_get_by_uri() on each of @uris, in the same
+ * order, but looks each parent folder up once. Search results come in
+ * batches of thousands of files from a handful of folders.
+ */
+GList *
+nautilus_file_get_by_uris (GList *uris)
+{
+    g_autoptr (GHashTable) directories = NULL;
+    GList *files;
+    GList *l;
+
+    directories = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                         g_object_unref, (GDestroyNotify) nautilus_directory_unref);
+    files = NULL;
+    for (l = uris; l != NULL; l = l->next)
+    {
+        g_autoptr (GFile) location = NULL;
+        g_autoptr (GFile) parent = NULL;
+        g_autofree char *basename = NULL;
+        NautilusDirectory *directory;
+        NautilusFile *file;
+
+        location = g_file_new_for_uri (l->data);
+        parent = g_file_get_parent (location);
+        if (parent == NULL)
+        {
+            files = g_list_prepend (files, nautilus_file_get (location));
+            continue;
+        }
+
+        directory = g_hash_table_lookup (directories, parent);
+        if (directory == NULL)
+        {
+            directory = nautilus_directory_get_internal (parent, TRUE);
+            g_hash_table_insert (directories, g_object_ref (parent), directory);
+        }
+
+        basename = g_file_get_basename (location);
+        file = nautilus_directory_find_file_by_name (directory, basename);
+        if (file != NULL)
+        {
+            nautilus_file_ref (file);
+        }
+        else
+        {
+            file = nautilus_file_new_from_filename (directory, basename, FALSE);
+            nautilus_directory_add_file (directory, file);
+        }
+
+        files = g_list_prepend (files, file);
+    }
+
+    return g_list_reverse (files);
+}
+
 gboolean
 nautilus_file_is_self_owned (NautilusFile *file)
 {
@@ -860,8 +968,6 @@ finalize (GObject *object)
 
     file = NAUTILUS_FILE (object);
 
-    g_assert (file->details->operations_in_progress == NULL);
-
     if (file->details->is_thumbnailing)
     {
         uri = nautilus_file_get_uri (file);
@@ -896,32 +1002,23 @@ finalize (GObject *object)
     eel_ref_str_unref (file->details->name);
     eel_ref_str_unref (file->details->display_name);
     g_free (file->details->display_name_collation_key);
-    g_free (file->details->directory_name_collation_key);
+    eel_ref_str_unref (file->details->directory_name_collation_key);
+    eel_ref_str_unref (file->details->type_collation_key);
     eel_ref_str_unref (file->details->edit_name);
     if (file->details->icon)
     {
         g_object_unref (file->details->icon);
     }
-    g_free (file->details->thumbnail_path);
     g_free (file->details->symlink_name);
     eel_ref_str_unref (file->details->mime_type);
     eel_ref_str_unref (file->details->owner);
     eel_ref_str_unref (file->details->owner_real);
     eel_ref_str_unref (file->details->group);
-    g_free (file->details->selinux_context);
+    eel_ref_str_unref (file->details->selinux_context);
     g_free (file->details->description);
     g_free (file->details->activation_uri);
     g_clear_object (&file->details->custom_icon);
 
-    if (file->details->thumbnail)
-    {
-        g_object_unref (file->details->thumbnail);
-    }
-    if (file->details->scaled_thumbnail)
-    {
-        g_object_unref (file->details->scaled_thumbnail);
-    }
-
     if (file->details->mount)
     {
         g_signal_handlers_disconnect_by_func (file->details->mount, file_mount_unmounted, file);
@@ -931,29 +1028,16 @@ finalize (GObject *object)
     eel_ref_str_unref (file->details->filesystem_id);
     eel_ref_str_unref (file->details->filesystem_type);
     file->details->filesystem_type = NULL;
-    g_free (file->details->trash_orig_path);
 
     g_list_free_full (file->details->mime_list, g_free);
-    g_list_free_full (file->details->pending_extension_emblems, g_free);
-    g_list_free_full (file->details->extension_emblems, g_free);
     g_list_free_full (file->details->pending_info_providers, g_object_unref);
 
-    if (file->details->pending_extension_attributes)
-    {
-        g_hash_table_destroy (file->details->pending_extension_attributes);
-    }
-
-    if (file->details->extension_attributes)
-    {
-        g_hash_table_destroy (file->details->extension_attributes);
-    }
-
     if (file->details->metadata)
     {
         metadata_hash_free (file->details->metadata);
     }
 
-    g_free (file->details->fts_snippet);
+    g_clear_pointer (&file->details->extra, extra_details_free);
 
     G_OBJECT_CLASS (nautilus_file_parent_class)->finalize (object);
 }
@@ -1745,6 +1829,7 @@ nautilus_file_operation_new (NautilusFile                  *file,
                              gpointer                       callback_data)
 {
     NautilusFileOperation *op;
+    NautilusFileExtraDetails *extra;
 
     op = g_new0 (NautilusFileOperation, 1);
     op->file = nautilus_file_ref (file);
@@ -1752,8 +1837,8 @@ nautilus_file_operation_new (NautilusFile                  *file,
     op->callback_data = callback_data;
     op->cancellable = g_cancellable_new ();
 
-    op->file->details->operations_in_progress = g_list_prepend
-                                                    (op->file->details->operations_in_progress, op);
+    extra = nautilus_file_get_extra_details (op->file);
+    extra->operations_in_progress = g_list_prepend (extra->operations_in_progress, op);
 
     return op;
 }
@@ -1763,16 +1848,16 @@ nautilus_file_operation_remove (NautilusFileOperation *op)
 {
     GList *l;
     NautilusFile *file;
+    NautilusFileExtraDetails *extra;
 
-    op->file->details->operations_in_progress = g_list_remove
-                                                    (op->file->details->operations_in_progress, op);
-
+    extra = nautilus_file_get_extra_details (op->file);
+    extra->operations_in_progress = g_list_remove (extra->operations_in_progress, op);
 
     for (l = op->files; l != NULL; l = l->next)
     {
         file = NAUTILUS_FILE (l->data);
-        file->details->operations_in_progress = g_list_remove
-                                                    (file->details->operations_in_progress, op);
+        extra = nautilus_file_get_extra_details (file);
+        extra->operations_in_progress = g_list_remove (extra->operations_in_progress, op);
     }
 }
 
@@ -2178,6 +2263,7 @@ real_batch_rename (GList                         *files,
     GError *error;
     GFile *new_file;
     BatchRenameData *data;
+    NautilusFileExtraDetails *extra;
 
     error = NULL;
     old_files = NULL;
@@ -2193,8 +2279,8 @@ real_batch_rename (GList                         *files,
     {
         file = NAUTILUS_FILE (l1->data);
 
-        file->details->operations_in_progress = g_list_prepend (file->details->operations_in_progress,
-                                                                op);
+        extra = nautilus_file_get_extra_details (file);
+        extra->operations_in_progress = g_list_prepend (extra->operations_in_progress, op);
     }
 
     for (l1 = files, l2 = new_names; l1 != NULL && l2 != NULL; l1 = l1->next, l2 = l2->next)
@@ -2291,7 +2377,7 @@ nautilus_file_rename_in_progress (NautilusFile *file)
     GList *node;
     NautilusFileOperation *op;
 
-    for (node = file->details->operations_in_progress; node != NULL; node = node->next)
+    for (node = nautilus_file_peek_extra_details (file)->operations_in_progress; node != NULL; node = node->next)
     {
         op = node->data;
         if (op->is_rename)
@@ -2310,7 +2396,7 @@ nautilus_file_cancel (NautilusFile                  *file,
     GList *node, *next;
     NautilusFileOperation *op;
 
-    for (node = file->details->operations_in_progress; node != NULL; node = next)
+    for (node = nautilus_file_peek_extra_details (file)->operations_in_progress; node != NULL; node = next)
     {
         next = node->next;
         op = node->data;
@@ -2456,6 +2542,7 @@ update_info_internal (NautilusFile *file,
     const char *trash_orig_path;
     const char *group, *owner, *owner_real;
     gboolean free_owner, free_group;
+    const NautilusFileExtraDetails *extra;
 
     if (file->details->is_gone)
     {
@@ -2483,6 +2570,7 @@ update_info_internal (NautilusFile *file,
         changed = TRUE;
     }
     file->details->got_file_info = TRUE;
+    file->details->type_collation_key_is_up_to_date = FALSE;
 
     changed |= nautilus_file_set_display_name (file,
                                                g_file_info_get_display_name (info),
@@ -2774,12 +2862,14 @@ update_info_internal (NautilusFile *file,
 
     atime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS);
     mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    extra = nautilus_file_peek_extra_details (file);
     if (file->details->atime != atime ||
         file->details->mtime != mtime)
     {
-        if (file->details->thumbnail == NULL)
+        if (!file->details->thumbnail_is_loaded)
         {
             file->details->thumbnail_is_up_to_date = FALSE;
+            file->details->thumbnail_was_evicted = FALSE;
         }
 
         changed = TRUE;
@@ -2787,11 +2877,12 @@ update_info_internal (NautilusFile *file,
     file->details->atime = atime;
     file->details->mtime = mtime;
 
-    if (file->details->thumbnail != NULL &&
-        file->details->thumbnail_mtime != 0 &&
-        file->details->thumbnail_mtime != mtime)
+    if (file->details->thumbnail_is_loaded &&
+        extra->thumbnail_mtime != 0 &&
+        extra->thumbnail_mtime != mtime)
     {
         file->details->thumbnail_is_up_to_date = FALSE;
+        file->details->thumbnail_was_evicted = FALSE;
         changed = TRUE;
     }
 
@@ -2808,11 +2899,17 @@ update_info_internal (NautilusFile *file,
     }
 
     thumbnail_path = g_file_info_get_attribute_byte_string (info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH);
-    if (g_strcmp0 (file->details->thumbnail_path, thumbnail_path) != 0)
+    if (g_strcmp0 (nautilus_file_peek_extra_details (file)->thumbnail_path, thumbnail_path) != 0)
     {
+        NautilusFileExtraDetails *writable_extra;
+
         changed = TRUE;
-        g_free (file->details->thumbnail_path);
-        file->details->thumbnail_path = g_strdup (thumbnail_path);
+        writable_extra = nautilus_file_get_extra_details (file);
+        g_free (writable_extra->thumbnail_path);
+        writable_extra->thumbnail_path = g_strdup (thumbnail_path);
+        file->details->thumbnail_is_loaded = FALSE;
+        file->details->thumbnail_is_up_to_date = FALSE;
+        file->details->thumbnail_was_evicted = FALSE;
     }
 
     thumbnailing_failed = g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_THUMBNAILING_FAILED);
@@ -2839,11 +2936,11 @@ update_info_internal (NautilusFile *file,
     }
 
     selinux_context = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_SELINUX_CONTEXT);
-    if (g_strcmp0 (file->details->selinux_context, selinux_context) != 0)
+    if (g_strcmp0 (eel_ref_str_peek (file->details->selinux_context), selinux_context) != 0)
     {
         changed = TRUE;
-        g_free (file->details->selinux_context);
-        file->details->selinux_context = g_strdup (selinux_context);
+        eel_ref_str_unref (file->details->selinux_context);
+        file->details->selinux_context = eel_ref_str_get_unique (selinux_context);
     }
 
     description = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_DESCRIPTION);
@@ -2869,10 +2966,10 @@ update_info_internal (NautilusFile *file,
         g_time_val_from_iso8601 (time_string, &g_trash_time);
         trash_time = g_trash_time.tv_sec;
     }
-    if (file->details->trash_time != trash_time)
+    if (nautilus_file_peek_extra_details (file)->trash_time != trash_time)
     {
         changed = TRUE;
-        file->details->trash_time = trash_time;
+        nautilus_file_get_extra_details (file)->trash_time = trash_time;
     }
 
     recency = g_file_info_get_attribute_int64 (info, G_FILE_ATTRIBUTE_RECENT_MODIFIED);
@@ -2883,11 +2980,14 @@ update_info_internal (NautilusFile *file,
     }
 
     trash_orig_path = g_file_info_get_attribute_byte_string (info, "trash::orig-path");
-    if (g_strcmp0 (file->details->trash_orig_path, trash_orig_path) != 0)
+    if (g_strcmp0 (nautilus_file_peek_extra_details (file)->trash_orig_path, trash_orig_path) != 0)
     {
+        NautilusFileExtraDetails *writable_extra;
+
         changed = TRUE;
-        g_free (file->details->trash_orig_path);
-        file->details->trash_orig_path = g_strdup (trash_orig_path);
+        writable_extra = nautilus_file_get_extra_details (file);
+        g_free (writable_extra->trash_orig_path);
+        writable_extra->trash_orig_path = g_strdup (trash_orig_path);
     }
 
     changed |=
@@ -3162,7 +3262,7 @@ get_time (NautilusFile     *file,
 
         case NAUTILUS_DATE_TYPE_TRASHED:
         {
-            time = file->details->trash_time;
+            time = nautilus_file_peek_extra_details (file)->trash_time;
         }
         break;
 
@@ -3192,96 +3292,69 @@ get_time (NautilusFile     *file,
     return KNOWN;
 }
 
-static int
-compare_directories_by_count (NautilusFile *file_1,
-                              NautilusFile *file_2)
-{
-    /* Sort order:
-     *   Directories with unknown # of items
-     *   Directories with "unknowable" # of items
-     *   Directories with 0 items
-     *   Directories with n items
-     */
-
-    Knowledge count_known_1, count_known_2;
-    guint count_1, count_2;
-
-    count_known_1 = get_item_count (file_1, &count_1);
-    count_known_2 = get_item_count (file_2, &count_2);
-
-    if (count_known_1 > count_known_2)
-    {
-        return -1;
-    }
-    if (count_known_1 < count_known_2)
-    {
-        return +1;
-    }
-
-    /* count_known_1 and count_known_2 are equal now. Check if count
-     * details are UNKNOWABLE or UNKNOWN.
-     */
-    if (count_known_1 == UNKNOWABLE || count_known_1 == UNKNOWN)
-    {
-        return 0;
-    }
+/* Size and time sort keys are packed into a single integer, so comparing
+ * them is one integer comparison: the is-a-file bit, then the inverted
+ * Knowledge (unknown first, as in the order documented on the comparisons
+ * below) and then the value itself.
+ */
+#define SORT_KEY_IS_FILE_SHIFT 63
+#define SORT_KEY_KNOWLEDGE_SHIFT 61
+#define SORT_KEY_VALUE_MAX ((G_GUINT64_CONSTANT (1) << SORT_KEY_KNOWLEDGE_SHIFT) - 1)
 
-    if (count_1 < count_2)
-    {
-        return -1;
-    }
-    if (count_1 > count_2)
+static guint64
+pack_sort_key (gboolean  is_file,
+               Knowledge known,
+               guint64   value)
+{
+    if (known != KNOWN)
     {
-        return +1;
+        value = 0;
     }
 
-    return 0;
+    return ((guint64) (is_file ? 1 : 0) << SORT_KEY_IS_FILE_SHIFT) |
+           ((guint64) (UNKNOWN - known) << SORT_KEY_KNOWLEDGE_SHIFT) |
+           MIN (value, SORT_KEY_VALUE_MAX);
 }
 
 static int
-compare_files_by_size (NautilusFile *file_1,
-                       NautilusFile *file_2)
+compare_sort_keys (guint64 key_1,
+                   guint64 key_2)
 {
-    /* Sort order:
-     *   Files with unknown size.
-     *   Files with "unknowable" size.
-     *   Files with smaller sizes.
-     *   Files with large sizes.
-     */
-
-    Knowledge size_known_1, size_known_2;
-    goffset size_1 = 0, size_2 = 0;
+    return (key_1 > key_2) - (key_1 < key_2);
+}
 
-    size_known_1 = get_size (file_1, &size_1);
-    size_known_2 = get_size (file_2, &size_2);
+static guint64
+get_size_sort_key (NautilusFile *file)
+{
+    Knowledge known;
+    goffset size = 0;
+    guint count = 0;
 
-    if (size_known_1 > size_known_2)
-    {
-        return -1;
-    }
-    if (size_known_1 < size_known_2)
+    if (nautilus_file_is_directory (file))
     {
-        return +1;
+        known = get_item_count (file, &count);
+        return pack_sort_key (FALSE, known, count);
     }
 
-    /* size_known_1 and size_known_2 are equal now. Check if size
-     * details are UNKNOWABLE or UNKNOWN
-     */
-    if (size_known_1 == UNKNOWABLE || size_known_1 == UNKNOWN)
-    {
-        return 0;
-    }
+    known = get_size (file, &size);
+    return pack_sort_key (TRUE, known, MAX (size, 0));
+}
 
-    if (size_1 < size_2)
-    {
-        return -1;
-    }
-    if (size_1 > size_2)
-    {
-        return +1;
-    }
+static guint64
+get_time_sort_key (NautilusFile     *file,
+                   NautilusDateType  type)
+{
+    Knowledge known;
+    time_t time = 0;
+    gint64 value;
 
-    return 0;
+    known = get_time (file, &time, type);
+
+    /* Shift times before the epoch into the unsigned range. */
+    value = CLAMP ((gint64) time, -(gint64) (SORT_KEY_VALUE_MAX / 2),
+                   (gint64) (SORT_KEY_VALUE_MAX / 2));
+
+    return pack_sort_key (FALSE, known, (guint64) (value + (gint64) (SORT_KEY_VALUE_MAX / 2)));
 }
 
 static int
@@ -3289,38 +3362,18 @@ compare_by_size (NautilusFile *file_1,
                  NautilusFile *file_2)
 {
     /* Sort order:
-     *   Directories with n items
-     *   Directories with 0 items
-     *   Directories with "unknowable" # of items
      *   Directories with unknown # of items
-     *   Files with large sizes.
-     *   Files with smaller sizes.
-     *   Files with "unknowable" size.
+     *   Directories with "unknowable" # of items
+     *   Directories with 0 items
+     *   Directories with n items
      *   Files with unknown size.
+     *   Files with "unknowable" size.
+     *   Files with smaller sizes.
+     *   Files with large sizes.
      */
 
-    gboolean is_directory_1, is_directory_2;
-
-    is_directory_1 = nautilus_file_is_directory (file_1);
-    is_directory_2 = nautilus_file_is_directory (file_2);
-
-    if (is_directory_1 && !is_directory_2)
-    {
-        return -1;
-    }
-    if (is_directory_2 && !is_directory_1)
-    {
-        return +1;
-    }
-
-    if (is_directory_1)
-    {
-        return compare_directories_by_count (file_1, file_2);
-    }
-    else
-    {
-        return compare_files_by_size (file_1, file_2);
-    }
+    return compare_sort_keys (get_size_sort_key (file_1),
+                              get_size_sort_key (file_2));
 }
 
 static int
@@ -3402,15 +3455,44 @@ prepend_automatic_keywords (NautilusFile *file,
     return names;
 }
 
+/* The type description depends on the mime type, the permissions and the
+ * file type, which all come from the file info, so update_info_internal()
+ * and nautilus_file_clear_info() invalidate the key.
+ */
+static const char *
+get_type_collation_key (NautilusFile *file)
+{
+    char *type_string;
+    char *collation_key;
+
+    if (!file->details->type_collation_key_is_up_to_date)
+    {
+        eel_ref_str_unref (file->details->type_collation_key);
+        file->details->type_collation_key = NULL;
+
+        /* Most files of a folder share a handful of types, share the keys. */
+        type_string = nautilus_file_get_type_as_string_no_extra_text (file);
+        if (type_string != NULL)
+        {
+            collation_key = g_utf8_collate_key (type_string, -1);
+            file->details->type_collation_key = eel_ref_str_get_unique (collation_key);
+            g_free (collation_key);
+            g_free (type_string);
+        }
+        file->details->type_collation_key_is_up_to_date = TRUE;
+    }
+
+    return file->details->type_collation_key;
+}
+
 static int
 compare_by_type (NautilusFile *file_1,
                  NautilusFile *file_2)
 {
     gboolean is_directory_1;
     gboolean is_directory_2;
-    char *type_string_1;
-    char *type_string_2;
-    int result;
+    const char *key_1;
+    const char *key_2;
 
     /* Directories go first. Then, if mime types are identical,
      * don't bother getting strings (for speed). This assumes
@@ -3443,17 +3525,17 @@ compare_by_type (NautilusFile *file_1,
         return 0;
     }
 
-    type_string_1 = nautilus_file_get_type_as_string_no_extra_text (file_1);
-    type_string_2 = nautilus_file_get_type_as_string_no_extra_text (file_2);
+    key_1 = get_type_collation_key (file_1);
+    key_2 = get_type_collation_key (file_2);
 
-    if (type_string_1 == NULL || type_string_2 == NULL)
+    if (key_1 == NULL || key_2 == NULL)
     {
-        if (type_string_1 != NULL)
+        if (key_1 != NULL)
         {
             return -1;
         }
 
-        if (type_string_2 != NULL)
+        if (key_2 != NULL)
         {
             return 1;
         }
@@ -3461,12 +3543,7 @@ compare_by_type (NautilusFile *file_1,
         return 0;
     }
 
-    result = g_utf8_collate (type_string_1, type_string_2);
-
-    g_free (type_string_1);
-    g_free (type_string_2);
-
-    return result;
+    return strcmp (key_1, key_2);
 }
 
 static int
@@ -3546,42 +3623,8 @@ compare_by_time (NautilusFile     *file_1,
      *   Files with newer times.
      */
 
-    Knowledge time_known_1, time_known_2;
-    time_t time_1, time_2;
-
-    time_1 = 0;
-    time_2 = 0;
-
-    time_known_1 = get_time (file_1, &time_1, type);
-    time_known_2 = get_time (file_2, &time_2, type);
-
-    if (time_known_1 > time_known_2)
-    {
-        return -1;
-    }
-    if (time_known_1 < time_known_2)
-    {
-        return +1;
-    }
-
-    /* Now time_known_1 is equal to time_known_2. Check whether
-     * we failed to get modification times for files
-     */
-    if(time_known_1 == UNKNOWABLE || time_known_1 == UNKNOWN)
-    {
-        return 0;
-    }
-
-    if (time_1 < time_2)
-    {
-        return -1;
-    }
-    if (time_1 > time_2)
-    {
-        return +1;
-    }
-
-    return 0;
+    return compare_sort_keys (get_time_sort_key (file_1, type),
+                              get_time_sort_key (file_2, type));
 }
 
 static int
@@ -3733,131 +3776,610 @@ nautilus_file_compare_for_sort (NautilusFile         *file_1,
                     result = compare_by_full_path (file_1, file_2);
                 }
             }
-            break;
-
-            case NAUTILUS_FILE_SORT_BY_TRASHED_TIME:
+            break;
+
+            case NAUTILUS_FILE_SORT_BY_TRASHED_TIME:
+            {
+                result = compare_by_time (file_1, file_2, NAUTILUS_DATE_TYPE_TRASHED);
+                if (result == 0)
+                {
+                    result = compare_by_full_path (file_1, file_2);
+                }
+            }
+            break;
+
+            case NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE:
+            {
+                result = compare_by_search_relevance (file_1, file_2);
+                if (result == 0)
+                {
+                    result = compare_by_full_path (file_1, file_2);
+
+                    /* ensure alphabetical order for files of the same relevance */
+                    reversed = FALSE;
+                }
+            }
+            break;
+
+            case NAUTILUS_FILE_SORT_BY_RECENCY:
+            {
+                result = compare_by_time (file_1, file_2, NAUTILUS_DATE_TYPE_RECENCY);
+                if (result == 0)
+                {
+                    result = compare_by_full_path (file_1, file_2);
+                }
+            }
+            break;
+
+            default:
+                g_return_val_if_reached (0);
+        }
+
+        if (reversed)
+        {
+            result = -result;
+        }
+    }
+
+    return result;
+}
+
+/* Everything nautilus_file_compare_for_sort() looks at, copied out of the
+ * file on the main thread so that sorting threads never touch the files.
+ */
+typedef struct
+{
+    guint position;
+    gboolean is_directory;
+    gboolean sort_last;
+    gboolean is_starred;
+    int sort_order;
+    guint64 value;
+    gdouble search_relevance;
+    const char *mime_type;
+    const char *type_key;
+    const char *display_name_key;
+    const char *directory_name_key;
+} SortSnapshot;
+
+typedef struct
+{
+    NautilusFileSortType sort_type;
+    gboolean directories_first;
+    gboolean reversed;
+} SortCriteria;
+
+typedef struct
+{
+    SortCriteria *criteria;
+    SortSnapshot **source;
+    SortSnapshot **destination;
+    guint start;
+    guint middle;
+    guint end;
+} SortTask;
+
+#define PARALLEL_SORT_THRESHOLD 20000
+#define PARALLEL_SORT_MAX_THREADS 8
+
+static void
+sort_snapshot_init (SortSnapshot         *snapshot,
+                    NautilusFile         *file,
+                    guint                 position,
+                    NautilusFileSortType  sort_type)
+{
+    const char *name;
+
+    name = nautilus_file_peek_display_name (file);
+
+    snapshot->position = position;
+    snapshot->is_directory = nautilus_file_is_directory (file);
+    snapshot->sort_last = name[0] == SORT_LAST_CHAR1 || name[0] == SORT_LAST_CHAR2;
+    snapshot->is_starred = FALSE;
+    snapshot->sort_order = file->details->sort_order;
+    snapshot->value = 0;
+    snapshot->search_relevance = 0;
+    snapshot->mime_type = eel_ref_str_peek (file->details->mime_type);
+    snapshot->type_key = NULL;
+    snapshot->display_name_key = nautilus_file_peek_display_name_collation_key (file);
+    snapshot->directory_name_key = file->details->directory_name_collation_key;
+
+    switch (sort_type)
+    {
+        case NAUTILUS_FILE_SORT_BY_SIZE:
+        {
+            snapshot->value = get_size_sort_key (file);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_TYPE:
+        {
+            snapshot->type_key = get_type_collation_key (file);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_STARRED:
+        {
+            g_autofree gchar *uri = NULL;
+
+            uri = nautilus_file_get_uri (file);
+            snapshot->is_starred = nautilus_tag_manager_file_is_starred (nautilus_tag_manager_get (),
+                                                                         uri);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_MTIME:
+        {
+            snapshot->value = get_time_sort_key (file, NAUTILUS_DATE_TYPE_MODIFIED);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_ATIME:
+        {
+            snapshot->value = get_time_sort_key (file, NAUTILUS_DATE_TYPE_ACCESSED);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_TRASHED_TIME:
+        {
+            snapshot->value = get_time_sort_key (file, NAUTILUS_DATE_TYPE_TRASHED);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_RECENCY:
+        {
+            snapshot->value = get_time_sort_key (file, NAUTILUS_DATE_TYPE_RECENCY);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE:
+        {
+            snapshot->search_relevance = file->details->search_relevance;
+        }
+        break;
+
+        default:
+        {
+        }
+        break;
+    }
+}
+
+/* The snapshot versions of the compare_by_* functions above. */
+static int
+compare_snapshots_by_display_name (const SortSnapshot *snapshot_1,
+                                   const SortSnapshot *snapshot_2)
+{
+    if (snapshot_1->sort_last && !snapshot_2->sort_last)
+    {
+        return +1;
+    }
+    if (!snapshot_1->sort_last && snapshot_2->sort_last)
+    {
+        return -1;
+    }
+
+    return strcmp (snapshot_1->display_name_key, snapshot_2->display_name_key);
+}
+
+static int
+compare_snapshots_by_full_path (const SortSnapshot *snapshot_1,
+                                const SortSnapshot *snapshot_2)
+{
+    int compare;
+
+    compare = strcmp (snapshot_1->directory_name_key, snapshot_2->directory_name_key);
+    if (compare != 0)
+    {
+        return compare;
+    }
+    return compare_snapshots_by_display_name (snapshot_1, snapshot_2);
+}
+
+static int
+compare_snapshots_by_type (const SortSnapshot *snapshot_1,
+                           const SortSnapshot *snapshot_2)
+{
+    if (snapshot_1->is_directory && snapshot_2->is_directory)
+    {
+        return 0;
+    }
+    if (snapshot_1->is_directory)
+    {
+        return -1;
+    }
+    if (snapshot_2->is_directory)
+    {
+        return +1;
+    }
+
+    if (snapshot_1->mime_type != NULL &&
+        snapshot_2->mime_type != NULL &&
+        strcmp (snapshot_1->mime_type, snapshot_2->mime_type) == 0)
+    {
+        return 0;
+    }
+
+    if (snapshot_1->type_key == NULL || snapshot_2->type_key == NULL)
+    {
+        if (snapshot_1->type_key != NULL)
+        {
+            return -1;
+        }
+        if (snapshot_2->type_key != NULL)
+        {
+            return 1;
+        }
+        return 0;
+    }
+
+    return strcmp (snapshot_1->type_key, snapshot_2->type_key);
+}
+
+/* Must give the same order as nautilus_file_compare_for_sort(). */
+static int
+compare_snapshots (const SortSnapshot *snapshot_1,
+                   const SortSnapshot *snapshot_2,
+                   const SortCriteria *criteria)
+{
+    gboolean reversed;
+    int result;
+
+    reversed = criteria->reversed;
+
+    if (criteria->directories_first &&
+        snapshot_1->is_directory != snapshot_2->is_directory)
+    {
+        return snapshot_1->is_directory ? -1 : +1;
+    }
+
+    if (snapshot_1->sort_order < snapshot_2->sort_order)
+    {
+        return reversed ? 1 : -1;
+    }
+    else if (snapshot_1->sort_order > snapshot_2->sort_order)
+    {
+        return reversed ? -1 : 1;
+    }
+
+    switch (criteria->sort_type)
+    {
+        case NAUTILUS_FILE_SORT_BY_DISPLAY_NAME:
+        {
+            result = compare_snapshots_by_display_name (snapshot_1, snapshot_2);
+            if (result == 0)
+            {
+                result = strcmp (snapshot_1->directory_name_key,
+                                 snapshot_2->directory_name_key);
+            }
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_TYPE:
+        {
+            result = compare_snapshots_by_type (snapshot_1, snapshot_2);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_STARRED:
+        {
+            if (!!snapshot_1->is_starred == !!snapshot_2->is_starred)
+            {
+                result = 0;
+            }
+            else
             {
-                result = compare_by_time (file_1, file_2, NAUTILUS_DATE_TYPE_TRASHED);
-                if (result == 0)
-                {
-                    result = compare_by_full_path (file_1, file_2);
-                }
+                result = snapshot_1->is_starred ? -1 : 1;
             }
-            break;
+        }
+        break;
 
-            case NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE:
+        case NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE:
+        {
+            if (snapshot_1->search_relevance < snapshot_2->search_relevance)
             {
-                result = compare_by_search_relevance (file_1, file_2);
-                if (result == 0)
-                {
-                    result = compare_by_full_path (file_1, file_2);
-
-                    /* ensure alphabetical order for files of the same relevance */
-                    reversed = FALSE;
-                }
+                result = -1;
             }
-            break;
-
-            case NAUTILUS_FILE_SORT_BY_RECENCY:
+            else if (snapshot_1->search_relevance > snapshot_2->search_relevance)
             {
-                result = compare_by_time (file_1, file_2, NAUTILUS_DATE_TYPE_RECENCY);
-                if (result == 0)
-                {
-                    result = compare_by_full_path (file_1, file_2);
-                }
+                result = +1;
             }
-            break;
+            else
+            {
+                result = 0;
 
-            default:
-                g_return_val_if_reached (0);
+                /* ensure alphabetical order for files of the same relevance */
+                reversed = FALSE;
+            }
         }
+        break;
 
-        if (reversed)
+        default:
         {
-            result = -result;
+            result = compare_sort_keys (snapshot_1->value, snapshot_2->value);
         }
+        break;
+    }
+
+    if (result == 0 && criteria->sort_type != NAUTILUS_FILE_SORT_BY_DISPLAY_NAME)
+    {
+        result = compare_snapshots_by_full_path (snapshot_1, snapshot_2);
+    }
+
+    if (reversed)
+    {
+        result = -result;
+    }
+
+    if (result == 0)
+    {
+        /* Keep equal files in their current order. */
+        result = (snapshot_1->position > snapshot_2->position) -
+                 (snapshot_1->position < snapshot_2->position);
     }
 
     return result;
 }
 
-int
-nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
-                                                 NautilusFile *file_2,
-                                                 GQuark        attribute,
-                                                 gboolean      directories_first,
-                                                 gboolean      reversed)
+static gint
+compare_snapshots_func (gconstpointer a,
+                        gconstpointer b,
+                        gpointer      user_data)
 {
-    int result;
+    return compare_snapshots (*((SortSnapshot **) a),
+                              *((SortSnapshot **) b),
+                              user_data);
+}
 
-    if (file_1 == file_2)
+static gpointer
+sort_task_sort_func (gpointer user_data)
+{
+    SortTask *task = user_data;
+
+    g_qsort_with_data (task->source + task->start, task->end - task->start,
+                       sizeof (SortSnapshot *), compare_snapshots_func, task->criteria);
+
+    return NULL;
+}
+
+static gpointer
+sort_task_merge_func (gpointer user_data)
+{
+    SortTask *task = user_data;
+    guint i, j, k;
+
+    i = task->start;
+    j = task->middle;
+    k = task->start;
+    while (i < task->middle && j < task->end)
     {
-        return 0;
+        if (compare_snapshots (task->source[j], task->source[i], task->criteria) < 0)
+        {
+            task->destination[k++] = task->source[j++];
+        }
+        else
+        {
+            task->destination[k++] = task->source[i++];
+        }
+    }
+    while (i < task->middle)
+    {
+        task->destination[k++] = task->source[i++];
+    }
+    while (j < task->end)
+    {
+        task->destination[k++] = task->source[j++];
     }
 
-    /* Convert certain attributes into NautilusFileSortTypes and use
-     * nautilus_file_compare_for_sort()
-     */
+    return NULL;
+}
+
+/* Runs the tasks on their own threads, the last one on the calling one. */
+static void
+run_sort_tasks (SortTask     *tasks,
+                guint         n_tasks,
+                GThreadFunc   func)
+{
+    g_autofree GThread **threads = NULL;
+    guint i;
+
+    threads = g_new0 (GThread *, n_tasks);
+    for (i = 0; i + 1 < n_tasks; i++)
+    {
+        threads[i] = g_thread_new ("nautilus-sort", func, &tasks[i]);
+    }
+
+    func (&tasks[n_tasks - 1]);
+
+    for (i = 0; i + 1 < n_tasks; i++)
+    {
+        g_thread_join (threads[i]);
+    }
+}
+
+/**
+ * nautilus_file_sort_get_new_order:
+ * @files: (array length=n_files): the files to sort
+ * @n_files: the number of files
+ * @sort_type: Sort criterion
+ * @directories_first: Put all directories before any non-directories
+ * @reversed: Reverse the order of the items, except that
+ * the directories_first flag is still respected.
+ *
+ * Sorts @files like nautilus_file_compare_for_sort() would, without
+ * modifying @files. The sort keys are taken on the calling thread and
+ * large arrays are then merge sorted on several threads.
+ *
+ * Return value: (transfer full): an array of @n_files positions where the
+ * element at each new position is the old position of that file, as
+ * expected by gtk_tree_model_rows_reordered().
+ **/
+int *
+nautilus_file_sort_get_new_order (NautilusFile         **files,
+                                  guint                  n_files,
+                                  NautilusFileSortType   sort_type,
+                                  gboolean               directories_first,
+                                  gboolean               reversed)
+{
+    g_autofree SortSnapshot *snapshots = NULL;
+    g_autofree SortSnapshot **source = NULL;
+    g_autofree SortSnapshot **destination = NULL;
+    g_autofree SortTask *tasks = NULL;
+    g_autofree guint *bounds = NULL;
+    SortSnapshot **swap;
+    SortCriteria criteria;
+    guint n_chunks;
+    guint n_tasks;
+    guint i;
+    int *new_order;
+
+    g_return_val_if_fail (sort_type != NAUTILUS_FILE_SORT_NONE, NULL);
+
+    criteria.sort_type = sort_type;
+    criteria.directories_first = directories_first;
+    criteria.reversed = reversed;
+
+    snapshots = g_new (SortSnapshot, n_files);
+    source = g_new (SortSnapshot *, n_files);
+    destination = g_new (SortSnapshot *, n_files);
+    for (i = 0; i < n_files; i++)
+    {
+        sort_snapshot_init (&snapshots[i], files[i], i, sort_type);
+        source[i] = &snapshots[i];
+    }
+
+    n_chunks = 1;
+    if (n_files >= PARALLEL_SORT_THRESHOLD)
+    {
+        n_chunks = MIN (g_get_num_processors (), PARALLEL_SORT_MAX_THREADS);
+        n_chunks = MAX (n_chunks, 1);
+    }
+
+    /* Sort one chunk per thread... */
+    tasks = g_new0 (SortTask, n_chunks);
+    bounds = g_new (guint, n_chunks + 1);
+    for (i = 0; i <= n_chunks; i++)
+    {
+        bounds[i] = (guint) (((guint64) n_files * i) / n_chunks);
+    }
+    for (i = 0; i < n_chunks; i++)
+    {
+        tasks[i].criteria = &criteria;
+        tasks[i].source = source;
+        tasks[i].start = bounds[i];
+        tasks[i].end = bounds[i + 1];
+    }
+    run_sort_tasks (tasks, n_chunks, sort_task_sort_func);
+
+    /* ...then merge pairs of chunks until one is left. */
+    while (n_chunks > 1)
+    {
+        n_tasks = (n_chunks + 1) / 2;
+        for (i = 0; i < n_tasks; i++)
+        {
+            tasks[i].criteria = &criteria;
+            tasks[i].source = source;
+            tasks[i].destination = destination;
+            tasks[i].start = bounds[2 * i];
+            tasks[i].middle = bounds[MIN (2 * i + 1, n_chunks)];
+            tasks[i].end = bounds[MIN (2 * i + 2, n_chunks)];
+        }
+        run_sort_tasks (tasks, n_tasks, sort_task_merge_func);
+
+        for (i = 0; i < n_tasks; i++)
+        {
+            bounds[i] = tasks[i].start;
+        }
+        bounds[n_tasks] = n_files;
+        n_chunks = n_tasks;
+
+        swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    new_order = g_new (int, n_files);
+    for (i = 0; i < n_files; i++)
+    {
+        new_order[i] = source[i]->position;
+    }
+
+    return new_order;
+}
+
+/**
+ * nautilus_file_get_sort_type_for_attribute_q:
+ * @attribute: an attribute quark
+ *
+ * Return value: the #NautilusFileSortType that sorts by @attribute, or
+ * %NAUTILUS_FILE_SORT_NONE if @attribute is sorted by its string value.
+ **/
+NautilusFileSortType
+nautilus_file_get_sort_type_for_attribute_q (GQuark attribute)
+{
     if (attribute == 0 || attribute == attribute_name_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
     }
     else if (attribute == attribute_size_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_SIZE,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_SIZE;
     }
     else if (attribute == attribute_type_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_TYPE,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_TYPE;
     }
     else if (attribute == attribute_starred_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_STARRED,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_STARRED;
     }
     else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q || attribute == attribute_date_modified_with_time_q || attribute == attribute_date_modified_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_MTIME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_MTIME;
     }
     else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q || attribute == attribute_date_accessed_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_ATIME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_ATIME;
     }
     else if (attribute == attribute_trashed_on_q || attribute == attribute_trashed_on_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_TRASHED_TIME,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_TRASHED_TIME;
     }
     else if (attribute == attribute_search_relevance_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE,
-                                               directories_first,
-                                               reversed);
+        return NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE;
     }
     else if (attribute == attribute_recency_q)
+    {
+        return NAUTILUS_FILE_SORT_BY_RECENCY;
+    }
+
+    return NAUTILUS_FILE_SORT_NONE;
+}
+
+int
+nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
+                                                 NautilusFile *file_2,
+                                                 GQuark        attribute,
+                                                 gboolean      directories_first,
+                                                 gboolean      reversed)
+{
+    NautilusFileSortType sort_type;
+    int result;
+
+    if (file_1 == file_2)
+    {
+        return 0;
+    }
+
+    /* Convert certain attributes into NautilusFileSortTypes and use
+     * nautilus_file_compare_for_sort()
+     */
+    sort_type = nautilus_file_get_sort_type_for_attribute_q (attribute);
+    if (sort_type != NAUTILUS_FILE_SORT_NONE)
     {
         return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_RECENCY,
+                                               sort_type,
                                                directories_first,
                                                reversed);
     }
@@ -4498,6 +5020,100 @@ nautilus_file_monitor_remove (NautilusFile  *file,
     NAUTILUS_FILE_CLASS (G_OBJECT_GET_CLASS (file))->monitor_remove (file, client);
 }
 
+/* Files are monitored through their folder, so hand each folder the files
+ * it holds all at once. Returns the files which are not monitored that way,
+ * or are not in a folder.
+ */
+static GList *
+group_files_by_directory (GList       *files,
+                          GHashTable **directories)
+{
+    GList *others;
+    GList *l;
+
+    *directories = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_list_free);
+    others = NULL;
+    for (l = files; l != NULL; l = l->next)
+    {
+        NautilusFile *file;
+        NautilusDirectory *directory;
+        GList *directory_files;
+
+        file = NAUTILUS_FILE (l->data);
+        directory = file->details->directory;
+        if (!NAUTILUS_IS_VFS_FILE (file) || directory == NULL)
+        {
+            others = g_list_prepend (others, file);
+            continue;
+        }
+
+        directory_files = g_hash_table_lookup (*directories, directory);
+        g_hash_table_steal (*directories, directory);
+        g_hash_table_insert (*directories, directory,
+                             g_list_prepend (directory_files, file));
+    }
+
+    return others;
+}
+
+void
+nautilus_file_list_monitor_add (GList                  *files,
+                                gconstpointer           client,
+                                NautilusFileAttributes  attributes)
+{
+    g_autoptr (GHashTable) directories = NULL;
+    GHashTableIter iter;
+    gpointer directory;
+    gpointer directory_files;
+    GList *others;
+    GList *l;
+
+    g_return_if_fail (client != NULL);
+
+    others = group_files_by_directory (files, &directories);
+
+    g_hash_table_iter_init (&iter, directories);
+    while (g_hash_table_iter_next (&iter, &directory, &directory_files))
+    {
+        nautilus_directory_monitor_add_files (directory, directory_files, client,
+                                              TRUE, attributes);
+    }
+
+    for (l = others; l != NULL; l = l->next)
+    {
+        nautilus_file_monitor_add (l->data, client, attributes);
+    }
+    g_list_free (others);
+}
+
+void
+nautilus_file_list_monitor_remove (GList         *files,
+                                   gconstpointer  client)
+{
+    g_autoptr (GHashTable) directories = NULL;
+    GHashTableIter iter;
+    gpointer directory;
+    gpointer directory_files;
+    GList *others;
+    GList *l;
+
+    g_return_if_fail (client != NULL);
+
+    others = group_files_by_directory (files, &directories);
+
+    g_hash_table_iter_init (&iter, directories);
+    while (g_hash_table_iter_next (&iter, &directory, &directory_files))
+    {
+        nautilus_directory_monitor_remove_files (directory, directory_files, client);
+    }
+
+    for (l = others; l != NULL; l = l->next)
+    {
+        nautilus_file_monitor_remove (l->data, client);
+    }
+    g_list_free (others);
+}
+
 gboolean
 nautilus_file_has_activation_uri (NautilusFile *file)
 {
@@ -4734,7 +5350,7 @@ nautilus_file_should_show_thumbnail (NautilusFile *file)
      * of the original file.
      */
     if (nautilus_thumbnail_is_mimetype_limited_by_size (mime_type) &&
-        file->details->thumbnail_path == NULL &&
+        nautilus_file_peek_extra_details (file)->thumbnail_path == NULL &&
         nautilus_file_get_size (file) > cached_thumbnail_limit)
     {
         return FALSE;
@@ -4892,6 +5508,7 @@ static GList *
 nautilus_file_get_keywords (NautilusFile *file)
 {
     GList *keywords, *metadata_keywords;
+    const NautilusFileExtraDetails *extra;
 
     if (file == NULL)
     {
@@ -4900,8 +5517,9 @@ nautilus_file_get_keywords (NautilusFile *file)
 
     g_return_val_if_fail (NAUTILUS_IS_FILE (file), NULL);
 
-    keywords = g_list_copy_deep (file->details->extension_emblems, (GCopyFunc) g_strdup, NULL);
-    keywords = g_list_concat (keywords, g_list_copy_deep (file->details->pending_extension_emblems, (GCopyFunc) g_strdup, NULL));
+    extra = nautilus_file_peek_extra_details (file);
+    keywords = g_list_copy_deep (extra->extension_emblems, (GCopyFunc) g_strdup, NULL);
+    keywords = g_list_concat (keywords, g_list_copy_deep (extra->pending_extension_emblems, (GCopyFunc) g_strdup, NULL));
 
     metadata_keywords = nautilus_file_get_metadata_list (file, NAUTILUS_METADATA_KEY_EMBLEMS);
     clean_up_metadata_keywords (file, &metadata_keywords);
@@ -5125,7 +5743,7 @@ out:
 char *
 nautilus_file_get_thumbnail_path (NautilusFile *file)
 {
-    return g_strdup (file->details->thumbnail_path);
+    return g_strdup (nautilus_file_peek_extra_details (file)->thumbnail_path);
 }
 
 static NautilusIconInfo *
@@ -5136,14 +5754,19 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
 {
     int modified_size;
     GdkPixbuf *pixbuf;
+    GdkPixbuf *thumbnail;
     int w, h, s;
+    int scaled_size;
     double thumb_scale;
     GIcon *gicon;
     NautilusIconInfo *icon;
+    NautilusFileExtraDetails *extra;
 
     icon = NULL;
     gicon = NULL;
     pixbuf = NULL;
+    thumbnail = NULL;
+    extra = file->details->extra;
 
     if (flags & NAUTILUS_FILE_ICON_FLAGS_FORCE_THUMBNAIL_SIZE)
     {
@@ -5154,10 +5777,17 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
         modified_size = size * scale * NAUTILUS_CANVAS_ICON_SIZE_STANDARD / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
     }
 
-    if (file->details->thumbnail)
+    if (file->details->thumbnail_is_loaded)
     {
-        w = gdk_pixbuf_get_width (file->details->thumbnail);
-        h = gdk_pixbuf_get_height (file->details->thumbnail);
+        thumbnail = nautilus_thumbnail_cache_lookup (extra->thumbnail_path,
+                                                     extra->thumbnail_mtime,
+                                                     0, 0);
+    }
+
+    if (thumbnail != NULL)
+    {
+        w = gdk_pixbuf_get_width (thumbnail);
+        h = gdk_pixbuf_get_height (thumbnail);
 
         s = MAX (w, h);
         /* Don't scale up small thumbnails in the standard view */
@@ -5176,20 +5806,21 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
             thumb_scale = (double) NAUTILUS_LIST_ICON_SIZE_SMALL / s;
         }
 
-        if (file->details->thumbnail_scale == thumb_scale &&
-            file->details->scaled_thumbnail != NULL)
-        {
-            pixbuf = file->details->scaled_thumbnail;
-        }
-        else
+        /* The same thumbnail at the same size is shared by all the views
+         * showing it. */
+        scaled_size = MAX (s * thumb_scale, 1);
+        pixbuf = nautilus_thumbnail_cache_lookup (extra->thumbnail_path,
+                                                  extra->thumbnail_mtime,
+                                                  scaled_size, scale);
+        if (pixbuf == NULL)
         {
-            pixbuf = gdk_pixbuf_scale_simple (file->details->thumbnail,
+            pixbuf = gdk_pixbuf_scale_simple (thumbnail,
                                               MAX (w * thumb_scale, 1),
                                               MAX (h * thumb_scale, 1),
                                               GDK_INTERP_BILINEAR);
 
             /* We don't want frames around small icons */
-            if (!gdk_pixbuf_get_has_alpha (file->details->thumbnail) || s >= 128 * scale)
+            if (!gdk_pixbuf_get_has_alpha (thumbnail) || s >= 128 * scale)
             {
                 gboolean use_experimental_views;
 
@@ -5208,15 +5839,30 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
                 }
             }
 
-            g_clear_object (&file->details->scaled_thumbnail);
-            file->details->scaled_thumbnail = pixbuf;
-            file->details->thumbnail_scale = thumb_scale;
+            if (pixbuf != NULL)
+            {
+                nautilus_thumbnail_cache_insert (extra->thumbnail_path,
+                                                 extra->thumbnail_mtime,
+                                                 scaled_size, scale,
+                                                 pixbuf);
+            }
         }
 
+        g_object_unref (thumbnail);
+
         DEBUG ("Returning thumbnailed image, at size %d %d",
                (int) (w * thumb_scale), (int) (h * thumb_scale));
     }
-    else if (file->details->thumbnail_path == NULL &&
+    else if (file->details->thumbnail_is_loaded &&
+             !file->details->thumbnail_was_evicted)
+    {
+        /* It was dropped from the cache to make room for others, load it
+         * again, once. */
+        file->details->thumbnail_is_loaded = FALSE;
+        nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL);
+        file->details->thumbnail_was_evicted = TRUE;
+    }
+    else if (nautilus_file_peek_extra_details (file)->thumbnail_path == NULL &&
              file->details->can_read &&
              !file->details->is_thumbnailing &&
              !file->details->thumbnailing_failed &&
@@ -5224,6 +5870,14 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
     {
         nautilus_create_thumbnail (file);
     }
+    else if (nautilus_file_peek_extra_details (file)->thumbnail_path != NULL &&
+             !file->details->thumbnail_is_up_to_date)
+    {
+        /* The thumbnail is waiting to be loaded. This file is being
+         * shown, so load it before the ones that are not.
+         */
+        nautilus_directory_prioritize_file (file->details->directory, file);
+    }
 
     if (pixbuf != NULL)
     {
@@ -5250,6 +5904,8 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
         g_object_unref (gicon);
     }
 
+    g_clear_object (&pixbuf);
+
     return icon;
 }
 
@@ -5850,7 +6506,7 @@ nautilus_file_get_trash_time (NautilusFile *file)
 {
     g_return_val_if_fail (NAUTILUS_IS_FILE (file), 0);
 
-    return file->details->trash_time;
+    return nautilus_file_peek_extra_details (file)->trash_time;
 }
 
 static void
@@ -5948,13 +6604,17 @@ void
 nautilus_file_set_search_fts_snippet (NautilusFile *file,
                                       const gchar  *fts_snippet)
 {
-    file->details->fts_snippet = g_strdup (fts_snippet);
+    NautilusFileExtraDetails *extra;
+
+    extra = nautilus_file_get_extra_details (file);
+    g_free (extra->fts_snippet);
+    extra->fts_snippet = g_strdup (fts_snippet);
 }
 
 const gchar *
 nautilus_file_get_search_fts_snippet (NautilusFile *file)
 {
-    return file->details->fts_snippet;
+    return nautilus_file_peek_extra_details (file)->fts_snippet;
 }
 
 /**
@@ -7135,6 +7795,7 @@ nautilus_file_get_string_attribute_q (NautilusFile *file,
                                       GQuark        attribute_q)
 {
     char *extension_attribute;
+    const NautilusFileExtraDetails *extra;
 
     if (attribute_q == attribute_name_q)
     {
@@ -7270,16 +7931,17 @@ nautilus_file_get_string_attribute_q (NautilusFile *file,
     }
 
     extension_attribute = NULL;
+    extra = nautilus_file_peek_extra_details (file);
 
-    if (file->details->pending_extension_attributes)
+    if (extra->pending_extension_attributes)
     {
-        extension_attribute = g_hash_table_lookup (file->details->pending_extension_attributes,
+        extension_attribute = g_hash_table_lookup (extra->pending_extension_attributes,
                                                    GINT_TO_POINTER (attribute_q));
     }
 
-    if (extension_attribute == NULL && file->details->extension_attributes)
+    if (extension_attribute == NULL && extra->extension_attributes)
     {
-        extension_attribute = g_hash_table_lookup (file->details->extension_attributes,
+        extension_attribute = g_hash_table_lookup (extra->extension_attributes,
                                                    GINT_TO_POINTER (attribute_q));
     }
 
@@ -7799,9 +8461,9 @@ get_fs_free_cb (GObject      *source_object,
         g_object_unref (info);
     }
 
-    if (file->details->free_space != free_space)
+    if (nautilus_file_peek_extra_details (file)->free_space != free_space)
     {
-        file->details->free_space = free_space;
+        nautilus_file_get_extra_details (file)->free_space = free_space;
         nautilus_file_emit_changed (file);
     }
 
@@ -7821,13 +8483,15 @@ nautilus_file_get_volume_free_space (NautilusFile *file)
     GFile *location;
     char *res;
     time_t now;
+    NautilusFileExtraDetails *extra;
 
+    extra = nautilus_file_get_extra_details (file);
     now = time (NULL);
     /* Update first time and then every 2 seconds */
-    if (file->details->free_space_read == 0 ||
-        (now - file->details->free_space_read) > 2)
+    if (extra->free_space_read == 0 ||
+        (now - extra->free_space_read) > 2)
     {
-        file->details->free_space_read = now;
+        extra->free_space_read = now;
         location = nautilus_file_get_location (file);
         g_file_query_filesystem_info_async (location,
                                             G_FILE_ATTRIBUTE_FILESYSTEM_FREE,
@@ -7838,9 +8502,9 @@ nautilus_file_get_volume_free_space (NautilusFile *file)
     }
 
     res = NULL;
-    if (file->details->free_space != (guint64) - 1)
+    if (extra->free_space != (guint64) - 1)
     {
-        res = g_format_size (file->details->free_space);
+        res = g_format_size (extra->free_space);
     }
 
     return res;
@@ -8227,12 +8891,14 @@ nautilus_file_get_trash_original_file (NautilusFile *file)
 {
     GFile *location;
     NautilusFile *original_file;
+    const char *trash_orig_path;
 
     original_file = NULL;
 
-    if (file->details->trash_orig_path != NULL)
+    trash_orig_path = nautilus_file_peek_extra_details (file)->trash_orig_path;
+    if (trash_orig_path != NULL)
     {
-        location = g_file_new_for_path (file->details->trash_orig_path);
+        location = g_file_new_for_path (trash_orig_path);
         original_file = nautilus_file_get (location);
         g_object_unref (location);
     }
@@ -8509,6 +9175,7 @@ static void
 invalidate_thumbnail (NautilusFile *file)
 {
     file->details->thumbnail_is_up_to_date = FALSE;
+    file->details->thumbnail_was_evicted = FALSE;
 }
 
 static void
@@ -9270,17 +9937,23 @@ nautilus_file_class_init (NautilusFileClass *class)
 void
 nautilus_file_info_providers_done (NautilusFile *file)
 {
-    g_list_free_full (file->details->extension_emblems, g_free);
-    file->details->extension_emblems = file->details->pending_extension_emblems;
-    file->details->pending_extension_emblems = NULL;
+    NautilusFileExtraDetails *extra;
 
-    if (file->details->extension_attributes)
+    extra = file->details->extra;
+    if (extra != NULL)
     {
-        g_hash_table_destroy (file->details->extension_attributes);
-    }
+        g_list_free_full (extra->extension_emblems, g_free);
+        extra->extension_emblems = extra->pending_extension_emblems;
+        extra->pending_extension_emblems = NULL;
+
+        if (extra->extension_attributes)
+        {
+            g_hash_table_destroy (extra->extension_attributes);
+        }
 
-    file->details->extension_attributes = file->details->pending_extension_attributes;
-    file->details->pending_extension_attributes = NULL;
+        extra->extension_attributes = extra->pending_extension_attributes;
+        extra->pending_extension_attributes = NULL;
+    }
 
     nautilus_file_changed (file);
 }
@@ -9506,18 +10179,20 @@ add_emblem (NautilusFileInfo *file_info,
             const char       *emblem_name)
 {
     NautilusFile *file;
+    NautilusFileExtraDetails *extra;
 
     file = NAUTILUS_FILE (file_info);
+    extra = nautilus_file_get_extra_details (file);
 
     if (file->details->pending_info_providers)
     {
-        file->details->pending_extension_emblems = g_list_prepend (file->details->pending_extension_emblems,
-                                                                   g_strdup (emblem_name));
+        extra->pending_extension_emblems = g_list_prepend (extra->pending_extension_emblems,
+                                                           g_strdup (emblem_name));
     }
     else
     {
-        file->details->extension_emblems = g_list_prepend (file->details->extension_emblems,
-                                                           g_strdup (emblem_name));
+        extra->extension_emblems = g_list_prepend (extra->extension_emblems,
+                                                   g_strdup (emblem_name));
     }
 
     nautilus_file_changed (file);
@@ -9540,33 +10215,35 @@ add_string_attribute (NautilusFileInfo *file_info,
                       const char       *value)
 {
     NautilusFile *file;
+    NautilusFileExtraDetails *extra;
 
     file = NAUTILUS_FILE (file_info);
+    extra = nautilus_file_get_extra_details (file);
 
     if (file->details->pending_info_providers != NULL)
     {
         /* Lazily create hashtable */
-        if (file->details->pending_extension_attributes == NULL)
+        if (extra->pending_extension_attributes == NULL)
         {
-            file->details->pending_extension_attributes =
+            extra->pending_extension_attributes =
                 g_hash_table_new_full (g_direct_hash, g_direct_equal,
                                        NULL,
                                        (GDestroyNotify) g_free);
         }
-        g_hash_table_insert (file->details->pending_extension_attributes,
+        g_hash_table_insert (extra->pending_extension_attributes,
                              GINT_TO_POINTER (g_quark_from_string (attribute_name)),
                              g_strdup (value));
     }
     else
     {
-        if (file->details->extension_attributes == NULL)
+        if (extra->extension_attributes == NULL)
         {
-            file->details->extension_attributes =
+            extra->extension_attributes =
                 g_hash_table_new_full (g_direct_hash, g_direct_equal,
                                        NULL,
                                        (GDestroyNotify) g_free);
         }
-        g_hash_table_insert (file->details->extension_attributes,
+        g_hash_table_insert (extra->extension_attributes,
                              GINT_TO_POINTER (g_quark_from_string (attribute_name)),
                              g_strdup (value));
     }
@@ -132,6 +132,7 @@ GType                   nautilus_file_get_type                          (void);
 /* Getting at a single file. */
 NautilusFile *          nautilus_file_get                               (GFile                          *location);
 NautilusFile *          nautilus_file_get_by_uri                        (const char                     *uri);
+GList *                 nautilus_file_get_by_uris                       (GList                          *uris);
 
 /* Get a file only if the nautilus version already exists */
 NautilusFile *          nautilus_file_get_existing                      (GFile                          *location);
@@ -152,6 +153,11 @@ void                    nautilus_file_monitor_add                       (Nautilu
 									 NautilusFileAttributes          attributes);
 void                    nautilus_file_monitor_remove                    (NautilusFile                   *file,
 									 gconstpointer                   client);
+void                    nautilus_file_list_monitor_add                  (GList                          *file_list,
+									 gconstpointer                   client,
+									 NautilusFileAttributes          attributes);
+void                    nautilus_file_list_monitor_remove               (GList                          *file_list,
+									 gconstpointer                   client);
 
 /* Waiting for data that's read asynchronously.
  * This interface currently works only for metadata, but could be expanded
@@ -437,6 +443,12 @@ int                     nautilus_file_compare_for_sort_by_attribute_q   (Nautilu
 									 gboolean                        directories_first,
 									 gboolean                        reversed);
 gboolean                nautilus_file_is_date_sort_attribute_q          (GQuark                          attribute);
+NautilusFileSortType    nautilus_file_get_sort_type_for_attribute_q     (GQuark                          attribute);
+int *                   nautilus_file_sort_get_new_order                (NautilusFile                  **files,
+									 guint                           n_files,
+									 NautilusFileSortType            sort_type,
+									 gboolean                        directories_first,
+									 gboolean                        reversed);
 
 int                     nautilus_file_compare_location                  (NautilusFile                    *file_1,
                                                                          NautilusFile                    *file_2);
@@ -0,0 +1,2050 @@
+/* nautilus-filename-index.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-filename-index.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "nautilus-global-preferences.h"
+#include "nautilus-search-engine-private.h"
+#include "nautilus-search-hit.h"
+#include "nautilus-ui-utilities.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#define INDEX_MAGIC "NAUTFNI"
+#define INDEX_VERSION 1
+#define INDEX_BYTE_ORDER 0x01020304
+/* Set when lower casing "I" does not give "i", as in Turkish. The trigrams
+ * of such an index do not fit the words of other locales and vice versa.
+ */
+#define INDEX_FLAG_DOTLESS_I (1 << 0)
+
+#define NO_INDEX G_MAXUINT32
+/* The string pool is addressed with 32 bits */
+#define MAX_STRINGS_SIZE (G_MAXUINT32 - 1)
+
+/* How often the folders are checked for changes no monitor saw */
+#define CHECK_INTERVAL_SECONDS (10 * 60)
+/* Beyond this many changes in memory, the root is built again */
+#define MAX_OVERLAY_ENTRIES 10000
+/* How often a search checks for cancellation */
+#define CANCEL_CHECK_INTERVAL 4096
+
+#define INDEX_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_ACCESS "," \
+    G_FILE_ATTRIBUTE_ID_FILE
+
+typedef enum
+{
+    ENTRY_DIRECTORY = 1 << 0,
+    ENTRY_HIDDEN = 1 << 1,
+    /* Only in memory, for files removed since the index was built */
+    ENTRY_REMOVED = 1 << 2,
+} EntryFlags;
+
+/* The index file is the header followed by the arrays of folders, entries,
+ * trigrams and postings, and the string pool, in the byte order of the
+ * machine that built it. Folders come breadth first, so a parent always
+ * comes before its children, and the entries of a folder are contiguous.
+ */
+typedef struct
+{
+    gchar magic[8];
+    guint32 byte_order;
+    guint32 version;
+    guint32 flags;
+    guint32 n_dirs;
+    guint32 n_entries;
+    guint32 n_trigrams;
+    guint32 n_postings;
+    guint32 strings_size;
+    guint32 root;               /* Offset of the root path */
+    guint32 padding;
+    gint64 build_time;
+} IndexHeader;
+
+typedef struct
+{
+    guint32 parent;             /* NO_INDEX for the root */
+    guint32 entry;              /* NO_INDEX for the root */
+    guint32 first_entry;
+    guint32 n_entries;
+} IndexDir;
+
+typedef struct
+{
+    guint32 dir;
+    guint32 name;
+    guint32 display_name;
+    guint32 content_type;       /* NO_INDEX if unknown */
+    guint32 flags;
+    guint32 subdir;             /* NO_INDEX unless a folder */
+    gint64 mtime;
+    gint64 atime;
+    guint64 size;
+} IndexEntry;
+
+/* The entries whose folded display name contains the trigram are
+ * postings[first] to postings[first + count - 1], in ascending order.
+ */
+typedef struct
+{
+    guint32 key;
+    guint32 first;
+    guint32 count;
+} IndexTrigram;
+
+typedef struct
+{
+    gint ref_count;
+    GMappedFile *file;
+    const IndexHeader *header;
+    const IndexDir *dirs;
+    const IndexEntry *entries;
+    const IndexTrigram *trigrams;
+    const guint32 *postings;
+    const gchar *strings;
+} IndexSnapshot;
+
+/* Not changed once the mutex is released, searches keep references */
+typedef struct
+{
+    gint ref_count;
+    gchar *path;
+    gchar *display_name;
+    gchar *content_type;
+    gint64 mtime;
+    gint64 atime;
+    guint32 flags;
+    /* Monotonic time of the change */
+    gint64 stamp;
+} OverlayEntry;
+
+typedef struct
+{
+    gchar *path;
+    gchar *index_path;
+    /* NULL until built or loaded */
+    IndexSnapshot *snapshot;
+    /* Whether the snapshot is known to be up to date, it is not searched
+     * otherwise.
+     */
+    gboolean fresh;
+    /* Paths changed since the snapshot was built -> OverlayEntry */
+    GHashTable *overlay;
+    /* Folders the monitors saw a change in -> real time of the last one,
+     * in seconds.
+     */
+    GHashTable *seen_directories;
+    gboolean build_queued;
+} IndexRoot;
+
+typedef enum
+{
+    INDEX_TASK_CHECK,
+    INDEX_TASK_CHANGED,
+    INDEX_TASK_REMOVED,
+    INDEX_TASK_BUILD,
+} IndexTaskType;
+
+typedef struct
+{
+    IndexTaskType type;
+    gchar *path;
+    guint64 sequence;
+} IndexTask;
+
+struct _NautilusFilenameIndex
+{
+    GMutex mutex;
+    GFile *cache_directory;
+    GPtrArray *roots;
+    /* One thread, builds come after the changes queued before them */
+    GThreadPool *pool;
+    GCancellable *cancellable;
+
+    /* Guards the rest, so that changes are queued without waiting for the
+     * mutex. Taken after the mutex when both are needed.
+     */
+    GMutex tasks_mutex;
+    GCond idle_cond;
+    /* The paths of the roots, to tell which changes are of interest */
+    GStrv root_paths;
+    guint n_tasks;
+    guint64 next_sequence;
+};
+
+typedef struct
+{
+    NautilusQueryMatcher *matcher;
+    GList *mime_types;
+    GPtrArray *date_range;
+    NautilusQuerySearchType search_type;
+    gboolean show_hidden;
+    gboolean recursive;
+} SearchFilter;
+
+static NautilusFilenameIndex *default_index = NULL;
+
+static guint32
+get_index_flags (void)
+{
+    g_autofree gchar *lower_i = NULL;
+
+    lower_i = g_utf8_strdown ("I", -1);
+
+    return strcmp (lower_i, "i") == 0 ? 0 : INDEX_FLAG_DOTLESS_I;
+}
+
+static inline guint32
+trigram_key (const gchar *string)
+{
+    return ((guint32) (guchar) string[0] << 16) |
+           ((guint32) (guchar) string[1] << 8) |
+           (guint32) (guchar) string[2];
+}
+
+/* Whether @path is @directory or below it */
+static gboolean
+path_has_prefix (const gchar *path,
+                 const gchar *directory)
+{
+    gsize length;
+
+    length = strlen (directory);
+    if (strncmp (path, directory, length) != 0)
+    {
+        return FALSE;
+    }
+
+    return path[length] == '\0' || path[length] == '/' ||
+           (length > 0 && directory[length - 1] == '/');
+}
+
+static gchar *
+get_index_path (GFile       *cache_directory,
+                const gchar *root_path)
+{
+    g_autofree gchar *checksum = NULL;
+    g_autofree gchar *name = NULL;
+    g_autofree gchar *directory = NULL;
+
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, root_path, -1);
+    name = g_strconcat (checksum, ".idx", NULL);
+    directory = g_file_get_path (cache_directory);
+
+    return g_build_filename (directory, name, NULL);
+}
+
+static IndexSnapshot *
+index_snapshot_ref (IndexSnapshot *snapshot)
+{
+    g_atomic_int_inc (&snapshot->ref_count);
+
+    return snapshot;
+}
+
+static void
+index_snapshot_unref (IndexSnapshot *snapshot)
+{
+    if (snapshot == NULL || !g_atomic_int_dec_and_test (&snapshot->ref_count))
+    {
+        return;
+    }
+
+    g_mapped_file_unref (snapshot->file);
+    g_free (snapshot);
+}
+
+static gboolean
+index_snapshot_validate (IndexSnapshot *snapshot,
+                         gsize          length,
+                         const gchar   *root_path)
+{
+    const IndexHeader *header = snapshot->header;
+    guint64 expected_length;
+    guint32 i;
+
+    expected_length = sizeof (IndexHeader) +
+                      (guint64) header->n_dirs * sizeof (IndexDir) +
+                      (guint64) header->n_entries * sizeof (IndexEntry) +
+                      (guint64) header->n_trigrams * sizeof (IndexTrigram) +
+                      (guint64) header->n_postings * sizeof (guint32) +
+                      header->strings_size;
+    if (expected_length != length ||
+        header->n_dirs == 0 ||
+        header->strings_size == 0 ||
+        snapshot->strings[header->strings_size - 1] != '\0' ||
+        header->root >= header->strings_size ||
+        strcmp (snapshot->strings + header->root, root_path) != 0)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < header->n_dirs; i++)
+    {
+        const IndexDir *dir = &snapshot->dirs[i];
+
+        if ((i == 0) != (dir->parent == NO_INDEX) ||
+            (i > 0 && (dir->parent >= i || dir->entry >= header->n_entries ||
+                       snapshot->entries[dir->entry].dir != dir->parent)) ||
+            (guint64) dir->first_entry + dir->n_entries > header->n_entries)
+        {
+            return FALSE;
+        }
+    }
+
+    for (i = 0; i < header->n_entries; i++)
+    {
+        const IndexEntry *entry = &snapshot->entries[i];
+
+        if (entry->dir >= header->n_dirs ||
+            entry->name >= header->strings_size ||
+            entry->display_name >= header->strings_size ||
+            (entry->content_type != NO_INDEX && entry->content_type >= header->strings_size) ||
+            (entry->subdir != NO_INDEX && (entry->subdir >= header->n_dirs ||
+                                           entry->subdir <= entry->dir)))
+        {
+            return FALSE;
+        }
+    }
+
+    for (i = 0; i < header->n_trigrams; i++)
+    {
+        const IndexTrigram *trigram = &snapshot->trigrams[i];
+
+        if ((guint64) trigram->first + trigram->count > header->n_postings ||
+            (i > 0 && trigram->key <= snapshot->trigrams[i - 1].key))
+        {
+            return FALSE;
+        }
+    }
+
+    for (i = 0; i < header->n_postings; i++)
+    {
+        if (snapshot->postings[i] >= header->n_entries)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static IndexSnapshot *
+index_snapshot_load (const gchar  *index_path,
+                     const gchar  *root_path,
+                     GError      **error)
+{
+    IndexSnapshot *snapshot;
+    GMappedFile *file;
+    const gchar *contents;
+    const IndexHeader *header;
+    gsize length;
+
+    file = g_mapped_file_new (index_path, FALSE, error);
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    contents = g_mapped_file_get_contents (file);
+    length = g_mapped_file_get_length (file);
+    header = (const IndexHeader *) contents;
+    if (length < sizeof (IndexHeader) ||
+        memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+        header->byte_order != INDEX_BYTE_ORDER ||
+        header->version != INDEX_VERSION ||
+        header->flags != get_index_flags ())
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "%s is not a file name index of this version", index_path);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    snapshot = g_new0 (IndexSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->file = file;
+    snapshot->header = header;
+    snapshot->dirs = (const IndexDir *) (contents + sizeof (IndexHeader));
+    snapshot->entries = (const IndexEntry *) (snapshot->dirs + header->n_dirs);
+    snapshot->trigrams = (const IndexTrigram *) (snapshot->entries + header->n_entries);
+    snapshot->postings = (const guint32 *) (snapshot->trigrams + header->n_trigrams);
+    snapshot->strings = (const gchar *) (snapshot->postings + header->n_postings);
+
+    if (!index_snapshot_validate (snapshot, length, root_path))
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "%s is corrupt", index_path);
+        index_snapshot_unref (snapshot);
+        return NULL;
+    }
+
+    return snapshot;
+}
+
+/* Returns the index of the folder at @path, or NO_INDEX if it is not in
+ * the snapshot.
+ */
+static guint32
+index_snapshot_lookup_directory (IndexSnapshot *snapshot,
+                                 const gchar   *root_path,
+                                 const gchar   *path)
+{
+    g_auto (GStrv) components = NULL;
+    const IndexDir *dir;
+    const IndexEntry *entry;
+    guint32 dir_index;
+    guint32 i;
+    guint j;
+
+    if (!path_has_prefix (path, root_path))
+    {
+        return NO_INDEX;
+    }
+
+    dir_index = 0;
+    components = g_strsplit (path + strlen (root_path), "/", -1);
+    for (j = 0; components[j] != NULL && dir_index != NO_INDEX; j++)
+    {
+        if (*components[j] == '\0')
+        {
+            continue;
+        }
+
+        dir = &snapshot->dirs[dir_index];
+        dir_index = NO_INDEX;
+        for (i = dir->first_entry; i < dir->first_entry + dir->n_entries; i++)
+        {
+            entry = &snapshot->entries[i];
+            if (entry->subdir != NO_INDEX &&
+                strcmp (snapshot->strings + entry->name, components[j]) == 0)
+            {
+                dir_index = entry->subdir;
+                break;
+            }
+        }
+    }
+
+    return dir_index;
+}
+
+static gchar *
+index_snapshot_get_path (IndexSnapshot *snapshot,
+                         const gchar   *root_path,
+                         guint32        entry_index)
+{
+    g_autoptr (GPtrArray) names = NULL;
+    const IndexEntry *entry;
+    GString *path;
+    guint i;
+
+    names = g_ptr_array_new ();
+    entry = &snapshot->entries[entry_index];
+    while (TRUE)
+    {
+        g_ptr_array_add (names, (gpointer) (snapshot->strings + entry->name));
+        if (entry->dir == 0)
+        {
+            break;
+        }
+        entry = &snapshot->entries[snapshot->dirs[entry->dir].entry];
+    }
+
+    path = g_string_new (root_path);
+    for (i = names->len; i > 0; i--)
+    {
+        if (path->len == 0 || path->str[path->len - 1] != '/')
+        {
+            g_string_append_c (path, '/');
+        }
+        g_string_append (path, g_ptr_array_index (names, i - 1));
+    }
+
+    return g_string_free (path, FALSE);
+}
+
+typedef struct
+{
+    GArray *dirs;
+    GArray *entries;
+    GByteArray *strings;
+    /* Content type -> offset in strings */
+    GHashTable *content_types;
+    /* G_FILE_ATTRIBUTE_ID_FILE of the folders, against bind mount loops */
+    GHashTable *visited;
+} IndexBuilder;
+
+static guint32
+index_builder_add_string (IndexBuilder *builder,
+                          const gchar  *string)
+{
+    guint32 offset;
+
+    offset = builder->strings->len;
+    g_byte_array_append (builder->strings, (const guint8 *) string, strlen (string) + 1);
+
+    return offset;
+}
+
+static guint32
+index_builder_add_content_type (IndexBuilder *builder,
+                                const gchar  *content_type)
+{
+    gpointer offset;
+
+    if (content_type == NULL)
+    {
+        return NO_INDEX;
+    }
+
+    if (!g_hash_table_lookup_extended (builder->content_types, content_type, NULL, &offset))
+    {
+        offset = GUINT_TO_POINTER (index_builder_add_string (builder, content_type));
+        g_hash_table_insert (builder->content_types, g_strdup (content_type), offset);
+    }
+
+    return GPOINTER_TO_UINT (offset);
+}
+
+static gboolean
+is_hidden_info (GFileInfo *info)
+{
+    return g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
+}
+
+static void
+index_builder_visit_directory (IndexBuilder *builder,
+                               guint32       dir_index,
+                               const gchar  *path,
+                               GQueue       *queue,
+                               GCancellable *cancellable)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    IndexEntry entry;
+    IndexDir dir;
+    GFileInfo *info;
+    const gchar *display_name;
+    const gchar *id;
+
+    g_array_index (builder->dirs, IndexDir, dir_index).first_entry = builder->entries->len;
+
+    location = g_file_new_for_path (path);
+    enumerator = g_file_enumerate_children (location, INDEX_ATTRIBUTES,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            cancellable, NULL);
+    while (enumerator != NULL &&
+           builder->strings->len < MAX_STRINGS_SIZE / 2 &&
+           (info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL)
+    {
+        display_name = g_file_info_get_display_name (info);
+        if (display_name == NULL)
+        {
+            g_object_unref (info);
+            continue;
+        }
+
+        entry.dir = dir_index;
+        entry.name = index_builder_add_string (builder, g_file_info_get_name (info));
+        entry.display_name = index_builder_add_string (builder, display_name);
+        entry.content_type = index_builder_add_content_type (builder, g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE));
+        entry.flags = is_hidden_info (info) ? ENTRY_HIDDEN : 0;
+        entry.subdir = NO_INDEX;
+        entry.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+        entry.atime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS);
+        entry.size = g_file_info_get_size (info);
+
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            entry.flags |= ENTRY_DIRECTORY;
+
+            id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+            if (id == NULL || g_hash_table_add (builder->visited, g_strdup (id)))
+            {
+                dir.parent = dir_index;
+                dir.entry = builder->entries->len;
+                dir.first_entry = 0;
+                dir.n_entries = 0;
+                entry.subdir = builder->dirs->len;
+                g_array_append_val (builder->dirs, dir);
+                g_queue_push_tail (queue, g_build_filename (path, g_file_info_get_name (info), NULL));
+            }
+        }
+
+        g_array_append_val (builder->entries, entry);
+        g_object_unref (info);
+    }
+
+    g_array_index (builder->dirs, IndexDir, dir_index).n_entries =
+        builder->entries->len - g_array_index (builder->dirs, IndexDir, dir_index).first_entry;
+}
+
+static gint
+compare_postings (gconstpointer a,
+                  gconstpointer b)
+{
+    guint64 posting_a = *(const guint64 *) a;
+    guint64 posting_b = *(const guint64 *) b;
+
+    return posting_a < posting_b ? -1 : posting_a > posting_b;
+}
+
+/* Returns the trigrams and their postings, from the (key << 32 | entry)
+ * pairs of all the folded display names sorted.
+ */
+static void
+index_builder_add_trigrams (IndexBuilder *builder,
+                            GArray       *trigrams,
+                            GArray       *postings)
+{
+    g_autoptr (GArray) pairs = NULL;
+    IndexTrigram trigram = { 0, 0, 0 };
+    guint64 pair;
+    guint32 entry;
+    guint32 i;
+    gsize j;
+
+    pairs = g_array_new (FALSE, FALSE, sizeof (guint64));
+    for (i = 0; i < builder->entries->len; i++)
+    {
+        g_autofree gchar *folded = NULL;
+        gsize length;
+
+        folded = nautilus_query_fold_string ((const gchar *) builder->strings->data +
+                                             g_array_index (builder->entries, IndexEntry, i).display_name);
+        length = strlen (folded);
+        for (j = 0; j + 3 <= length; j++)
+        {
+            pair = ((guint64) trigram_key (folded + j) << 32) | i;
+            g_array_append_val (pairs, pair);
+        }
+    }
+
+    qsort (pairs->data, pairs->len, sizeof (guint64), compare_postings);
+
+    for (j = 0; j < pairs->len; j++)
+    {
+        pair = g_array_index (pairs, guint64, j);
+        if (j > 0 && pair == g_array_index (pairs, guint64, j - 1))
+        {
+            continue;
+        }
+
+        if (trigram.count == 0 || trigram.key != pair >> 32)
+        {
+            if (trigram.count > 0)
+            {
+                g_array_append_val (trigrams, trigram);
+            }
+            trigram.key = pair >> 32;
+            trigram.first = postings->len;
+            trigram.count = 0;
+        }
+
+        entry = pair & G_MAXUINT32;
+        g_array_append_val (postings, entry);
+        trigram.count++;
+    }
+
+    if (trigram.count > 0)
+    {
+        g_array_append_val (trigrams, trigram);
+    }
+}
+
+/* Walks @root_path and writes its index to @index_path, replacing the
+ * previous one atomically.
+ */
+static IndexSnapshot *
+index_build (const gchar   *root_path,
+             const gchar   *index_path,
+             GCancellable  *cancellable,
+             GError       **error)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    g_autoptr (GArray) trigrams = NULL;
+    g_autoptr (GArray) postings = NULL;
+    g_autoptr (GByteArray) data = NULL;
+    g_autofree gchar *directory = NULL;
+    GQueue queue = G_QUEUE_INIT;
+    IndexBuilder builder;
+    IndexHeader header;
+    IndexDir root_dir = { NO_INDEX, NO_INDEX, 0, 0 };
+    gchar *path;
+    guint32 dir_index;
+    const gchar *id;
+    gboolean success;
+
+    builder.dirs = g_array_new (FALSE, FALSE, sizeof (IndexDir));
+    builder.entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+    builder.strings = g_byte_array_new ();
+    builder.content_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    builder.visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    memset (&header, 0, sizeof (header));
+    header.root = index_builder_add_string (&builder, root_path);
+    /* Whatever changes from now on may have been missed by the walk */
+    header.build_time = g_get_real_time () / G_USEC_PER_SEC;
+
+    root = g_file_new_for_path (root_path);
+    info = g_file_query_info (root, G_FILE_ATTRIBUTE_ID_FILE, 0, cancellable, NULL);
+    id = info != NULL ? g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE) : NULL;
+    if (id != NULL)
+    {
+        g_hash_table_add (builder.visited, g_strdup (id));
+    }
+
+    g_array_append_val (builder.dirs, root_dir);
+    g_queue_push_tail (&queue, g_strdup (root_path));
+    for (dir_index = 0; (path = g_queue_pop_head (&queue)) != NULL; dir_index++)
+    {
+        if (!g_cancellable_is_cancelled (cancellable))
+        {
+            index_builder_visit_directory (&builder, dir_index, path, &queue, cancellable);
+        }
+        g_free (path);
+    }
+
+    success = !g_cancellable_set_error_if_cancelled (cancellable, error);
+    if (success && builder.strings->len >= MAX_STRINGS_SIZE / 2)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                     "Too many files below %s", root_path);
+        success = FALSE;
+    }
+
+    if (success)
+    {
+        trigrams = g_array_new (FALSE, FALSE, sizeof (IndexTrigram));
+        postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+        index_builder_add_trigrams (&builder, trigrams, postings);
+
+        memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+        header.byte_order = INDEX_BYTE_ORDER;
+        header.version = INDEX_VERSION;
+        header.flags = get_index_flags ();
+        header.n_dirs = builder.dirs->len;
+        header.n_entries = builder.entries->len;
+        header.n_trigrams = trigrams->len;
+        header.n_postings = postings->len;
+        header.strings_size = builder.strings->len;
+
+        data = g_byte_array_new ();
+        g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+        g_byte_array_append (data, (const guint8 *) builder.dirs->data,
+                             builder.dirs->len * sizeof (IndexDir));
+        g_byte_array_append (data, (const guint8 *) builder.entries->data,
+                             builder.entries->len * sizeof (IndexEntry));
+        g_byte_array_append (data, (const guint8 *) trigrams->data,
+                             trigrams->len * sizeof (IndexTrigram));
+        g_byte_array_append (data, (const guint8 *) postings->data,
+                             postings->len * sizeof (guint32));
+        g_byte_array_append (data, builder.strings->data, builder.strings->len);
+
+        directory = g_path_get_dirname (index_path);
+        g_mkdir_with_parents (directory, 0700);
+        success = g_file_set_contents (index_path, (const gchar *) data->data, data->len, error);
+    }
+
+    g_array_unref (builder.dirs);
+    g_array_unref (builder.entries);
+    g_byte_array_unref (builder.strings);
+    g_hash_table_destroy (builder.content_types);
+    g_hash_table_destroy (builder.visited);
+
+    if (!success)
+    {
+        return NULL;
+    }
+
+    return index_snapshot_load (index_path, root_path, error);
+}
+
+static OverlayEntry *
+overlay_entry_ref (OverlayEntry *entry)
+{
+    g_atomic_int_inc (&entry->ref_count);
+
+    return entry;
+}
+
+static void
+overlay_entry_unref (OverlayEntry *entry)
+{
+    if (!g_atomic_int_dec_and_test (&entry->ref_count))
+    {
+        return;
+    }
+
+    g_free (entry->path);
+    g_free (entry->display_name);
+    g_free (entry->content_type);
+    g_free (entry);
+}
+
+static GHashTable *
+overlay_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal,
+                                  NULL, (GDestroyNotify) overlay_entry_unref);
+}
+
+static IndexRoot *
+index_root_new (NautilusFilenameIndex *index,
+                const gchar           *path)
+{
+    IndexRoot *root;
+
+    root = g_new0 (IndexRoot, 1);
+    root->path = g_strdup (path);
+    root->index_path = get_index_path (index->cache_directory, path);
+    root->overlay = overlay_new ();
+    root->seen_directories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    return root;
+}
+
+static void
+index_root_free (IndexRoot *root)
+{
+    index_snapshot_unref (root->snapshot);
+    g_hash_table_destroy (root->overlay);
+    g_hash_table_destroy (root->seen_directories);
+    g_free (root->index_path);
+    g_free (root->path);
+    g_free (root);
+}
+
+/* Must be called with the mutex held */
+static IndexRoot *
+find_root (GPtrArray   *roots,
+           const gchar *path,
+           gboolean     exact)
+{
+    IndexRoot *root;
+    guint i;
+
+    for (i = 0; roots != NULL && i < roots->len; i++)
+    {
+        root = g_ptr_array_index (roots, i);
+        if (exact ? strcmp (root->path, path) == 0 : path_has_prefix (path, root->path))
+        {
+            return root;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+queue_task (NautilusFilenameIndex *index,
+            IndexTaskType          type,
+            const gchar           *path)
+{
+    IndexTask *task;
+
+    task = g_new0 (IndexTask, 1);
+    task->type = type;
+    task->path = g_strdup (path);
+
+    g_mutex_lock (&index->tasks_mutex);
+    task->sequence = index->next_sequence++;
+    index->n_tasks++;
+    g_thread_pool_push (index->pool, task, NULL);
+    g_mutex_unlock (&index->tasks_mutex);
+}
+
+/* Must be called with the mutex held */
+static void
+queue_build (NautilusFilenameIndex *index,
+             IndexRoot             *root)
+{
+    if (!root->build_queued)
+    {
+        root->build_queued = TRUE;
+        queue_task (index, INDEX_TASK_BUILD, root->path);
+    }
+}
+
+static gint
+compare_tasks (gconstpointer a,
+               gconstpointer b,
+               gpointer      user_data)
+{
+    const IndexTask *task_a = a;
+    const IndexTask *task_b = b;
+    gboolean build_a = task_a->type == INDEX_TASK_BUILD;
+    gboolean build_b = task_b->type == INDEX_TASK_BUILD;
+
+    /* Builds take long, changes are applied first and in order */
+    if (build_a != build_b)
+    {
+        return build_a ? 1 : -1;
+    }
+
+    return task_a->sequence < task_b->sequence ? -1 : 1;
+}
+
+/* Must be called with the mutex held */
+static void
+overlay_add (NautilusFilenameIndex *index,
+             IndexRoot             *root,
+             const gchar           *path,
+             GFileInfo             *info)
+{
+    OverlayEntry *entry;
+
+    entry = g_new0 (OverlayEntry, 1);
+    entry->ref_count = 1;
+    entry->path = g_strdup (path);
+    entry->stamp = g_get_monotonic_time ();
+    if (info == NULL)
+    {
+        entry->flags = ENTRY_REMOVED;
+    }
+    else
+    {
+        entry->display_name = g_strdup (g_file_info_get_display_name (info));
+        entry->content_type = g_strdup (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE));
+        entry->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+        entry->atime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS);
+        entry->flags = is_hidden_info (info) ? ENTRY_HIDDEN : 0;
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            entry->flags |= ENTRY_DIRECTORY;
+        }
+    }
+
+    g_hash_table_replace (root->overlay, entry->path, entry);
+
+    if (g_hash_table_size (root->overlay) > MAX_OVERLAY_ENTRIES)
+    {
+        queue_build (index, root);
+    }
+}
+
+/* Must be called with the mutex held */
+static gboolean
+is_directory_in_index (IndexRoot   *root,
+                       const gchar *path)
+{
+    OverlayEntry *entry;
+
+    entry = g_hash_table_lookup (root->overlay, path);
+    if (entry != NULL)
+    {
+        return (entry->flags & ENTRY_DIRECTORY) && !(entry->flags & ENTRY_REMOVED);
+    }
+
+    return root->snapshot != NULL &&
+           index_snapshot_lookup_directory (root->snapshot, root->path, path) != NO_INDEX;
+}
+
+/* Must be called with the mutex held */
+static void
+overlay_remove (NautilusFilenameIndex *index,
+                IndexRoot             *root,
+                const gchar           *path)
+{
+    GHashTableIter iter;
+    OverlayEntry *entry;
+    gboolean is_directory;
+
+    is_directory = is_directory_in_index (root, path);
+
+    /* The contents are gone too */
+    g_hash_table_iter_init (&iter, root->overlay);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+        if (path_has_prefix (entry->path, path))
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    overlay_add (index, root, path, NULL);
+    if (is_directory)
+    {
+        entry = g_hash_table_lookup (root->overlay, path);
+        entry->flags |= ENTRY_DIRECTORY;
+    }
+}
+
+/* Adds the contents of a folder the snapshot does not know about, such as
+ * one moved in from somewhere else.
+ */
+static void
+overlay_add_directory (NautilusFilenameIndex *index,
+                       const gchar           *path)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    GQueue queue = G_QUEUE_INIT;
+    GFileInfo *info;
+    IndexRoot *root;
+    gchar *directory;
+    gchar *child_path;
+
+    g_queue_push_tail (&queue, g_strdup (path));
+    while ((directory = g_queue_pop_head (&queue)) != NULL)
+    {
+        location = g_file_new_for_path (directory);
+        enumerator = g_file_enumerate_children (location, INDEX_ATTRIBUTES,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                index->cancellable, NULL);
+        while (enumerator != NULL &&
+               (info = g_file_enumerator_next_file (enumerator, index->cancellable, NULL)) != NULL)
+        {
+            child_path = g_build_filename (directory, g_file_info_get_name (info), NULL);
+
+            g_mutex_lock (&index->mutex);
+            root = find_root (index->roots, child_path, FALSE);
+            if (root != NULL && !root->build_queued)
+            {
+                overlay_add (index, root, child_path, info);
+                if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+                {
+                    g_queue_push_tail (&queue, g_strdup (child_path));
+                }
+            }
+            g_mutex_unlock (&index->mutex);
+
+            g_free (child_path);
+            g_object_unref (info);
+        }
+
+        g_clear_object (&enumerator);
+        g_clear_object (&location);
+        g_free (directory);
+    }
+}
+
+/* Whether a folder of @snapshot changed since it was built, other than
+ * for the changes in @seen_directories.
+ */
+static gboolean
+has_unseen_changes (IndexSnapshot *snapshot,
+                    const gchar   *root_path,
+                    GHashTable    *seen_directories,
+                    GCancellable  *cancellable)
+{
+    GStatBuf stat_buf;
+    gint64 *seen_time;
+    gboolean changed;
+    gchar *path;
+    guint32 i;
+
+    changed = FALSE;
+    for (i = 0; i < snapshot->header->n_dirs && !changed; i++)
+    {
+        if (i % CANCEL_CHECK_INTERVAL == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            return TRUE;
+        }
+
+        path = i == 0 ? g_strdup (root_path) :
+               index_snapshot_get_path (snapshot, root_path, snapshot->dirs[i].entry);
+        if (g_stat (path, &stat_buf) != 0)
+        {
+            /* Its parent changed too, unless it is the root */
+            changed = i == 0;
+        }
+        else if (stat_buf.st_mtime >= snapshot->header->build_time)
+        {
+            seen_time = g_hash_table_lookup (seen_directories, path);
+            changed = seen_time == NULL || *seen_time < stat_buf.st_mtime;
+        }
+        g_free (path);
+    }
+
+    return changed;
+}
+
+/* Maps what was built last time if needed, and checks that no folder
+ * changed behind the back of the monitors since. The root is built again
+ * otherwise, and not searched until then.
+ */
+static void
+run_check_task (NautilusFilenameIndex *index,
+                IndexTask             *task)
+{
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GHashTable) seen_directories = NULL;
+    g_autofree gchar *index_path = NULL;
+    IndexSnapshot *snapshot;
+    GHashTableIter iter;
+    gpointer path;
+    gpointer seen_time;
+    IndexRoot *root;
+    gboolean fresh;
+
+    snapshot = NULL;
+    seen_directories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, task->path, TRUE);
+    /* A queued build catches up anyway */
+    if (root != NULL && !root->build_queued)
+    {
+        index_path = g_strdup (root->index_path);
+        if (root->snapshot != NULL)
+        {
+            snapshot = index_snapshot_ref (root->snapshot);
+        }
+
+        g_hash_table_iter_init (&iter, root->seen_directories);
+        while (g_hash_table_iter_next (&iter, &path, &seen_time))
+        {
+            g_hash_table_insert (seen_directories, g_strdup (path),
+                                 g_memdup (seen_time, sizeof (gint64)));
+        }
+    }
+    g_mutex_unlock (&index->mutex);
+
+    if (index_path == NULL)
+    {
+        return;
+    }
+
+    if (snapshot == NULL)
+    {
+        snapshot = index_snapshot_load (index_path, task->path, &error);
+        if (snapshot == NULL)
+        {
+            DEBUG ("Building the index of %s: %s", task->path, error->message);
+        }
+    }
+
+    fresh = snapshot != NULL &&
+            !has_unseen_changes (snapshot, task->path, seen_directories, index->cancellable);
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, task->path, TRUE);
+    if (root != NULL)
+    {
+        if (root->snapshot == NULL && snapshot != NULL)
+        {
+            root->snapshot = index_snapshot_ref (snapshot);
+        }
+        /* Unless built again meanwhile */
+        if (root->snapshot == snapshot)
+        {
+            root->fresh = fresh;
+            if (!fresh)
+            {
+                queue_build (index, root);
+            }
+        }
+    }
+    g_mutex_unlock (&index->mutex);
+
+    index_snapshot_unref (snapshot);
+}
+
+static void
+run_build_task (NautilusFilenameIndex *index,
+                IndexTask             *task)
+{
+    g_autoptr (GError) error = NULL;
+    g_autofree gchar *index_path = NULL;
+    IndexSnapshot *snapshot;
+    IndexSnapshot *old_snapshot;
+    GHashTableIter iter;
+    OverlayEntry *entry;
+    IndexRoot *root;
+    gint64 *seen_time;
+    gint64 start;
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, task->path, TRUE);
+    if (root != NULL)
+    {
+        root->build_queued = FALSE;
+        index_path = g_strdup (root->index_path);
+    }
+    g_mutex_unlock (&index->mutex);
+
+    if (index_path == NULL)
+    {
+        return;
+    }
+
+    start = g_get_monotonic_time ();
+    snapshot = index_build (task->path, index_path, index->cancellable, &error);
+    if (snapshot == NULL)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_warning ("Could not index %s: %s", task->path, error->message);
+        }
+        return;
+    }
+
+    DEBUG ("Indexed %u files below %s in %f seconds", snapshot->header->n_entries,
+           task->path, (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC);
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, task->path, TRUE);
+    old_snapshot = NULL;
+    if (root != NULL)
+    {
+        old_snapshot = root->snapshot;
+        root->snapshot = snapshot;
+        root->fresh = TRUE;
+
+        g_hash_table_iter_init (&iter, root->seen_directories);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &seen_time))
+        {
+            if (*seen_time < snapshot->header->build_time)
+            {
+                g_hash_table_iter_remove (&iter);
+            }
+        }
+
+        /* The walk saw the changes from before it started */
+        g_hash_table_iter_init (&iter, root->overlay);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        {
+            if (entry->stamp < start)
+            {
+                g_hash_table_iter_remove (&iter);
+            }
+        }
+    }
+    else
+    {
+        old_snapshot = snapshot;
+    }
+    g_mutex_unlock (&index->mutex);
+
+    index_snapshot_unref (old_snapshot);
+}
+
+static void
+run_change_task (NautilusFilenameIndex *index,
+                 IndexTask             *task)
+{
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    IndexRoot *root;
+    gint64 *seen_time;
+    gboolean add_contents;
+
+    file = g_file_new_for_path (task->path);
+    if (task->type == INDEX_TASK_CHANGED)
+    {
+        info = g_file_query_info (file, INDEX_ATTRIBUTES,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                  index->cancellable, NULL);
+    }
+
+    add_contents = FALSE;
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, task->path, FALSE);
+    if (root != NULL && strcmp (root->path, task->path) != 0)
+    {
+        /* Explains the new modification time of the parent */
+        seen_time = g_new (gint64, 1);
+        *seen_time = g_get_real_time () / G_USEC_PER_SEC;
+        g_hash_table_replace (root->seen_directories, g_path_get_dirname (task->path), seen_time);
+    }
+    /* A queued build catches up anyway */
+    if (root != NULL && !root->build_queued && strcmp (root->path, task->path) != 0)
+    {
+        if (info == NULL)
+        {
+            overlay_remove (index, root, task->path);
+        }
+        else
+        {
+            add_contents = g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
+                           !is_directory_in_index (root, task->path);
+            overlay_add (index, root, task->path, info);
+        }
+    }
+    g_mutex_unlock (&index->mutex);
+
+    if (add_contents)
+    {
+        overlay_add_directory (index, task->path);
+    }
+}
+
+static void
+index_task_func (gpointer data,
+                 gpointer user_data)
+{
+    NautilusFilenameIndex *index = user_data;
+    IndexTask *task = data;
+
+    if (!g_cancellable_is_cancelled (index->cancellable))
+    {
+        if (task->type == INDEX_TASK_CHECK)
+        {
+            run_check_task (index, task);
+        }
+        else if (task->type == INDEX_TASK_BUILD)
+        {
+            run_build_task (index, task);
+        }
+        else
+        {
+            run_change_task (index, task);
+        }
+    }
+
+    g_mutex_lock (&index->tasks_mutex);
+    index->n_tasks--;
+    if (index->n_tasks == 0)
+    {
+        g_cond_broadcast (&index->idle_cond);
+    }
+    g_mutex_unlock (&index->tasks_mutex);
+
+    g_free (task->path);
+    g_free (task);
+}
+
+NautilusFilenameIndex *
+nautilus_filename_index_new (GFile               *cache_directory,
+                             const gchar * const *roots)
+{
+    NautilusFilenameIndex *index;
+
+    g_return_val_if_fail (G_IS_FILE (cache_directory), NULL);
+
+    index = g_new0 (NautilusFilenameIndex, 1);
+    g_mutex_init (&index->mutex);
+    g_mutex_init (&index->tasks_mutex);
+    g_cond_init (&index->idle_cond);
+    index->cache_directory = g_object_ref (cache_directory);
+    index->cancellable = g_cancellable_new ();
+    index->pool = g_thread_pool_new (index_task_func, index, 1, FALSE, NULL);
+    g_thread_pool_set_sort_function (index->pool, compare_tasks, NULL);
+
+    nautilus_filename_index_set_roots (index, roots);
+
+    return index;
+}
+
+void
+nautilus_filename_index_free (NautilusFilenameIndex *index)
+{
+    g_cancellable_cancel (index->cancellable);
+    g_thread_pool_free (index->pool, FALSE, TRUE);
+
+    g_ptr_array_foreach (index->roots, (GFunc) index_root_free, NULL);
+    g_ptr_array_unref (index->roots);
+    g_strfreev (index->root_paths);
+    g_object_unref (index->cancellable);
+    g_object_unref (index->cache_directory);
+    g_mutex_clear (&index->mutex);
+    g_mutex_clear (&index->tasks_mutex);
+    g_cond_clear (&index->idle_cond);
+    g_free (index);
+}
+
+/* Returns NULL unless @root is an absolute path or starts with "~/" */
+static gchar *
+expand_root (const gchar *root)
+{
+    gchar *path;
+    gsize length;
+
+    if (strcmp (root, "~") == 0 || g_str_has_prefix (root, "~/"))
+    {
+        path = g_build_filename (g_get_home_dir (), root + 1, NULL);
+    }
+    else if (g_path_is_absolute (root))
+    {
+        path = g_strdup (root);
+    }
+    else
+    {
+        return NULL;
+    }
+
+    length = strlen (path);
+    while (length > 1 && path[length - 1] == '/')
+    {
+        path[--length] = '\0';
+    }
+
+    return path;
+}
+
+/**
+ * nautilus_filename_index_set_roots:
+ * @index: a #NautilusFilenameIndex
+ * @roots: the absolute paths of the folders to index, "~" stands for the
+ * home folder
+ *
+ * Roots that were indexed before are loaded from the cache in the
+ * background, and only built again if one of their folders changed
+ * meanwhile.
+ */
+void
+nautilus_filename_index_set_roots (NautilusFilenameIndex *index,
+                                   const gchar * const   *roots)
+{
+    GPtrArray *root_paths;
+    GPtrArray *old_roots;
+    IndexRoot *root;
+    gchar *path;
+    guint i;
+
+    root_paths = g_ptr_array_new ();
+
+    g_mutex_lock (&index->mutex);
+    old_roots = index->roots;
+    index->roots = g_ptr_array_new ();
+    for (i = 0; roots != NULL && roots[i] != NULL; i++)
+    {
+        path = expand_root (roots[i]);
+        if (path == NULL)
+        {
+            g_warning ("Not indexing %s, it is not an absolute path", roots[i]);
+            continue;
+        }
+
+        if (find_root (index->roots, path, TRUE) == NULL)
+        {
+            root = find_root (old_roots, path, TRUE);
+            if (root != NULL)
+            {
+                g_ptr_array_remove (old_roots, root);
+            }
+            else
+            {
+                root = index_root_new (index, path);
+                queue_task (index, INDEX_TASK_CHECK, root->path);
+            }
+            g_ptr_array_add (index->roots, root);
+            g_ptr_array_add (root_paths, g_strdup (path));
+        }
+
+        g_free (path);
+    }
+
+    /* The ones left over are not wanted anymore */
+    for (i = 0; old_roots != NULL && i < old_roots->len; i++)
+    {
+        root = g_ptr_array_index (old_roots, i);
+        g_unlink (root->index_path);
+        index_root_free (root);
+    }
+    g_clear_pointer (&old_roots, g_ptr_array_unref);
+
+    g_mutex_lock (&index->tasks_mutex);
+    g_strfreev (index->root_paths);
+    g_ptr_array_add (root_paths, NULL);
+    index->root_paths = (GStrv) g_ptr_array_free (root_paths, FALSE);
+    g_mutex_unlock (&index->tasks_mutex);
+    g_mutex_unlock (&index->mutex);
+}
+
+void
+nautilus_filename_index_rebuild (NautilusFilenameIndex *index)
+{
+    guint i;
+
+    g_mutex_lock (&index->mutex);
+    for (i = 0; i < index->roots->len; i++)
+    {
+        queue_build (index, g_ptr_array_index (index->roots, i));
+    }
+    g_mutex_unlock (&index->mutex);
+}
+
+void
+nautilus_filename_index_check (NautilusFilenameIndex *index)
+{
+    IndexRoot *root;
+    guint i;
+
+    g_mutex_lock (&index->mutex);
+    for (i = 0; i < index->roots->len; i++)
+    {
+        root = g_ptr_array_index (index->roots, i);
+        if (root->snapshot != NULL && !root->build_queued)
+        {
+            queue_task (index, INDEX_TASK_CHECK, root->path);
+        }
+    }
+    g_mutex_unlock (&index->mutex);
+}
+
+void
+nautilus_filename_index_wait (NautilusFilenameIndex *index)
+{
+    g_mutex_lock (&index->tasks_mutex);
+    while (index->n_tasks > 0)
+    {
+        g_cond_wait (&index->idle_cond, &index->tasks_mutex);
+    }
+    g_mutex_unlock (&index->tasks_mutex);
+}
+
+gboolean
+nautilus_filename_index_covers (NautilusFilenameIndex *index,
+                                GFile                 *location)
+{
+    g_autofree gchar *path = NULL;
+    IndexRoot *root;
+    gboolean covers;
+
+    if (index == NULL || !g_file_is_native (location))
+    {
+        return FALSE;
+    }
+
+    path = g_file_get_path (location);
+    if (path == NULL)
+    {
+        return FALSE;
+    }
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, path, FALSE);
+    covers = root != NULL && root->snapshot != NULL && root->fresh;
+    g_mutex_unlock (&index->mutex);
+
+    return covers;
+}
+
+static gdouble
+search_filter_matches (SearchFilter *filter,
+                       const gchar  *display_name,
+                       const gchar  *content_type,
+                       gint64        mtime,
+                       gint64        atime)
+{
+    gdouble match;
+    gboolean found;
+    GList *l;
+
+    match = nautilus_query_matcher_matches_string (filter->matcher, display_name);
+    if (match <= -1)
+    {
+        return -1;
+    }
+
+    if (filter->mime_types != NULL)
+    {
+        found = FALSE;
+        for (l = filter->mime_types; content_type != NULL && l != NULL; l = l->next)
+        {
+            if (g_content_type_is_a (content_type, l->data))
+            {
+                found = TRUE;
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            return -1;
+        }
+    }
+
+    if (filter->date_range != NULL &&
+        !nautilus_file_date_in_between (filter->search_type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS ?
+                                        atime : mtime,
+                                        g_ptr_array_index (filter->date_range, 0),
+                                        g_ptr_array_index (filter->date_range, 1)))
+    {
+        return -1;
+    }
+
+    return match;
+}
+
+static NautilusSearchHit *
+create_hit (const gchar *path,
+            gdouble      match,
+            gint64       mtime)
+{
+    NautilusSearchHit *hit;
+    g_autofree gchar *uri = NULL;
+    g_autoptr (GDateTime) date = NULL;
+
+    uri = g_filename_to_uri (path, NULL, NULL);
+    hit = nautilus_search_hit_new (uri);
+    nautilus_search_hit_set_fts_rank (hit, match);
+    date = g_date_time_new_from_unix_local (mtime);
+    nautilus_search_hit_set_modification_time (hit, date);
+
+    return hit;
+}
+
+/* Returns the smallest posting list of the trigrams the words of @matcher
+ * must contain, or FALSE if every entry has to be checked.
+ */
+static gboolean
+get_candidates (IndexSnapshot         *snapshot,
+                NautilusQueryMatcher  *matcher,
+                const guint32        **candidates,
+                guint32               *n_candidates)
+{
+    const gchar * const *words;
+    const IndexTrigram *trigram;
+    gboolean found;
+    guint32 key;
+    guint32 low;
+    guint32 high;
+    guint32 middle;
+    gsize length;
+    gsize i;
+    guint j;
+
+    words = nautilus_query_matcher_get_words (matcher);
+    found = FALSE;
+    for (j = 0; words != NULL && words[j] != NULL; j++)
+    {
+        length = strlen (words[j]);
+        for (i = 0; i + 3 <= length; i++)
+        {
+            key = trigram_key (words[j] + i);
+            low = 0;
+            high = snapshot->header->n_trigrams;
+            while (low < high)
+            {
+                middle = low + (high - low) / 2;
+                if (snapshot->trigrams[middle].key < key)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+
+            trigram = low < snapshot->header->n_trigrams ? &snapshot->trigrams[low] : NULL;
+            if (trigram == NULL || trigram->key != key)
+            {
+                *candidates = NULL;
+                *n_candidates = 0;
+                return TRUE;
+            }
+
+            if (!found || trigram->count < *n_candidates)
+            {
+                *candidates = snapshot->postings + trigram->first;
+                *n_candidates = trigram->count;
+                found = TRUE;
+            }
+        }
+    }
+
+    return found;
+}
+
+static GList *
+index_snapshot_search (IndexSnapshot *snapshot,
+                       const gchar   *root_path,
+                       GHashTable    *overlay,
+                       const gchar   *path,
+                       SearchFilter  *filter,
+                       GPtrArray     *removed_directories,
+                       GCancellable  *cancellable,
+                       GList         *hits)
+{
+    g_autofree guint8 *inside = NULL;
+    const guint32 *candidates;
+    const IndexEntry *entry;
+    const IndexDir *dir;
+    guint32 n_candidates;
+    guint32 first_entry;
+    guint32 location;
+    guint32 entry_index;
+    guint32 i;
+    gdouble match;
+    gchar *entry_path;
+    gboolean removed;
+    guint j;
+
+    location = index_snapshot_lookup_directory (snapshot, root_path, path);
+    if (location == NO_INDEX)
+    {
+        return hits;
+    }
+
+    /* Which folders the walker would visit: the ones below the location,
+     * unless hidden. Parents come before their children.
+     */
+    inside = g_new0 (guint8, snapshot->header->n_dirs - location);
+    inside[0] = TRUE;
+    for (i = location + 1; filter->recursive && i < snapshot->header->n_dirs; i++)
+    {
+        dir = &snapshot->dirs[i];
+        inside[i - location] = dir->parent >= location && inside[dir->parent - location] &&
+                               (filter->show_hidden ||
+                                !(snapshot->entries[dir->entry].flags & ENTRY_HIDDEN));
+    }
+
+    if (!get_candidates (snapshot, filter->matcher, &candidates, &n_candidates))
+    {
+        candidates = NULL;
+        n_candidates = snapshot->header->n_entries;
+    }
+    first_entry = snapshot->dirs[location].first_entry;
+
+    for (i = 0; i < n_candidates; i++)
+    {
+        if (i % CANCEL_CHECK_INTERVAL == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        entry_index = candidates != NULL ? candidates[i] : i;
+        if (entry_index < first_entry)
+        {
+            continue;
+        }
+
+        entry = &snapshot->entries[entry_index];
+        if (entry->dir < location || !inside[entry->dir - location] ||
+            ((entry->flags & ENTRY_HIDDEN) && !filter->show_hidden))
+        {
+            continue;
+        }
+
+        match = search_filter_matches (filter, snapshot->strings + entry->display_name,
+                                       entry->content_type != NO_INDEX ?
+                                       snapshot->strings + entry->content_type : NULL,
+                                       entry->mtime, entry->atime);
+        if (match <= -1)
+        {
+            continue;
+        }
+
+        entry_path = index_snapshot_get_path (snapshot, root_path, entry_index);
+
+        /* Changed since, the overlay has it if still there */
+        removed = g_hash_table_contains (overlay, entry_path);
+        for (j = 0; !removed && j < removed_directories->len; j++)
+        {
+            removed = path_has_prefix (entry_path, g_ptr_array_index (removed_directories, j));
+        }
+
+        if (!removed)
+        {
+            hits = g_list_prepend (hits, create_hit (entry_path, match, entry->mtime));
+        }
+        g_free (entry_path);
+    }
+
+    return hits;
+}
+
+/* Whether the walker would skip @entry, because it or a folder between
+ * @path and it is hidden.
+ */
+static gboolean
+is_overlay_entry_hidden (OverlayEntry *entry,
+                         const gchar  *path)
+{
+    g_auto (GStrv) components = NULL;
+    gsize length;
+    guint i;
+
+    if (entry->flags & ENTRY_HIDDEN)
+    {
+        return TRUE;
+    }
+
+    components = g_strsplit (entry->path + strlen (path), "/", -1);
+    for (i = 0; components[i] != NULL; i++)
+    {
+        length = strlen (components[i]);
+        if (length > 0 && (components[i][0] == '.' || components[i][length - 1] == '~'))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static GList *
+overlay_search (GHashTable   *overlay,
+                const gchar  *path,
+                SearchFilter *filter,
+                GList        *hits)
+{
+    GHashTableIter iter;
+    OverlayEntry *entry;
+    const gchar *relative_path;
+    gdouble match;
+
+    g_hash_table_iter_init (&iter, overlay);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+        if ((entry->flags & ENTRY_REMOVED) ||
+            strcmp (entry->path, path) == 0 ||
+            !path_has_prefix (entry->path, path))
+        {
+            continue;
+        }
+
+        relative_path = entry->path + strlen (path);
+        relative_path += *relative_path == '/';
+        if ((!filter->recursive && strchr (relative_path, '/') != NULL) ||
+            (!filter->show_hidden && is_overlay_entry_hidden (entry, path)))
+        {
+            continue;
+        }
+
+        match = search_filter_matches (filter, entry->display_name, entry->content_type,
+                                       entry->mtime, entry->atime);
+        if (match > -1)
+        {
+            hits = g_list_prepend (hits, create_hit (entry->path, match, entry->mtime));
+        }
+    }
+
+    return hits;
+}
+
+/* Returns a copy of @overlay, whose entries stay valid without the mutex */
+static GHashTable *
+overlay_copy (GHashTable *overlay)
+{
+    GHashTable *copy;
+    GHashTableIter iter;
+    OverlayEntry *entry;
+
+    copy = overlay_new ();
+    g_hash_table_iter_init (&iter, overlay);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+        g_hash_table_insert (copy, entry->path, overlay_entry_ref (entry));
+    }
+
+    return copy;
+}
+
+GList *
+nautilus_filename_index_search (NautilusFilenameIndex *index,
+                                GFile                 *location,
+                                NautilusQuery         *query,
+                                NautilusQueryMatcher  *matcher,
+                                GCancellable          *cancellable)
+{
+    g_autoptr (GPtrArray) removed_directories = NULL;
+    g_autoptr (GHashTable) overlay = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *root_path = NULL;
+    IndexSnapshot *snapshot;
+    SearchFilter filter;
+    GHashTableIter iter;
+    OverlayEntry *entry;
+    IndexRoot *root;
+    GList *hits;
+
+    path = g_file_get_path (location);
+    g_return_val_if_fail (path != NULL, NULL);
+
+    filter.matcher = matcher;
+    filter.mime_types = nautilus_query_get_mime_types (query);
+    filter.date_range = nautilus_query_get_date_range (query);
+    filter.search_type = nautilus_query_get_search_type (query);
+    filter.show_hidden = nautilus_query_get_show_hidden_files (query);
+    filter.recursive = is_recursive_search (NAUTILUS_SEARCH_ENGINE_TYPE_NON_INDEXED,
+                                            nautilus_query_get_recursive (query),
+                                            location);
+
+    hits = NULL;
+    snapshot = NULL;
+
+    /* The scan can take a while, it must not hold the changes up */
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, path, FALSE);
+    if (root != NULL && root->snapshot != NULL && root->fresh)
+    {
+        snapshot = index_snapshot_ref (root->snapshot);
+        root_path = g_strdup (root->path);
+        overlay = overlay_copy (root->overlay);
+    }
+    g_mutex_unlock (&index->mutex);
+
+    if (snapshot != NULL)
+    {
+        removed_directories = g_ptr_array_new ();
+        g_hash_table_iter_init (&iter, overlay);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        {
+            if ((entry->flags & ENTRY_REMOVED) && (entry->flags & ENTRY_DIRECTORY))
+            {
+                g_ptr_array_add (removed_directories, entry->path);
+            }
+        }
+
+        hits = index_snapshot_search (snapshot, root_path, overlay, path, &filter,
+                                      removed_directories, cancellable, hits);
+        hits = overlay_search (overlay, path, &filter, hits);
+        index_snapshot_unref (snapshot);
+    }
+
+    g_list_free_full (filter.mime_types, g_free);
+    g_clear_pointer (&filter.date_range, g_ptr_array_unref);
+
+    return hits;
+}
+
+static void
+queue_change (NautilusFilenameIndex *index,
+              IndexTaskType          type,
+              GFile                 *file)
+{
+    g_autofree gchar *path = NULL;
+    gboolean covered = FALSE;
+    guint i;
+
+    if (index == NULL || !g_file_is_native (file))
+    {
+        return;
+    }
+
+    path = g_file_get_path (file);
+    if (path == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (&index->tasks_mutex);
+    for (i = 0; index->root_paths != NULL && index->root_paths[i] != NULL && !covered; i++)
+    {
+        covered = path_has_prefix (path, index->root_paths[i]);
+    }
+    g_mutex_unlock (&index->tasks_mutex);
+
+    if (covered)
+    {
+        queue_task (index, type, path);
+    }
+}
+
+void
+nautilus_filename_index_file_changed (NautilusFilenameIndex *index,
+                                      GFile                 *file)
+{
+    queue_change (index, INDEX_TASK_CHANGED, file);
+}
+
+void
+nautilus_filename_index_file_removed (NautilusFilenameIndex *index,
+                                      GFile                 *file)
+{
+    queue_change (index, INDEX_TASK_REMOVED, file);
+}
+
+void
+nautilus_filename_index_invalidate (NautilusFilenameIndex *index,
+                                    GFile                 *directory)
+{
+    g_autofree gchar *path = NULL;
+    IndexRoot *root;
+
+    if (index == NULL || !g_file_is_native (directory))
+    {
+        return;
+    }
+
+    path = g_file_get_path (directory);
+    if (path == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (&index->mutex);
+    root = find_root (index->roots, path, FALSE);
+    if (root != NULL)
+    {
+        /* The monitors missed changes, walk instead until it is built */
+        root->fresh = FALSE;
+        queue_build (index, root);
+    }
+    g_mutex_unlock (&index->mutex);
+}
+
+static void
+search_index_roots_changed_cb (GSettings   *settings,
+                               const gchar *key,
+                               gpointer     user_data)
+{
+    g_auto (GStrv) roots = NULL;
+
+    roots = g_settings_get_strv (settings, key);
+    nautilus_filename_index_set_roots (default_index, (const gchar * const *) roots);
+}
+
+static gboolean
+check_timeout_cb (gpointer user_data)
+{
+    nautilus_filename_index_check (default_index);
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+nautilus_filename_index_init_default (void)
+{
+    g_autoptr (GFile) cache_directory = NULL;
+    g_auto (GStrv) roots = NULL;
+    g_autofree gchar *path = NULL;
+
+    if (default_index != NULL)
+    {
+        return;
+    }
+
+    nautilus_global_preferences_init ();
+
+    path = g_build_filename (g_get_user_cache_dir (), "nautilus", "filename-index", NULL);
+    cache_directory = g_file_new_for_path (path);
+    roots = g_settings_get_strv (nautilus_preferences, NAUTILUS_PREFERENCES_SEARCH_INDEX_ROOTS);
+    default_index = nautilus_filename_index_new (cache_directory, (const gchar * const *) roots);
+
+    g_signal_connect (nautilus_preferences,
+                      "changed::" NAUTILUS_PREFERENCES_SEARCH_INDEX_ROOTS,
+                      G_CALLBACK (search_index_roots_changed_cb), NULL);
+    g_timeout_add_seconds (CHECK_INTERVAL_SECONDS, check_timeout_cb, NULL);
+}
+
+NautilusFilenameIndex *
+nautilus_filename_index_get_default (void)
+{
+    return default_index;
+}
@@ -0,0 +1,86 @@
+/* nautilus-filename-index.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "nautilus-query.h"
+
+G_BEGIN_DECLS
+
+/* An index of the names of the files below some local folders, so that the
+ * simple search engine does not need to walk them. Each root gets a file in
+ * the user cache folder, which is built on a background thread and memory
+ * mapped. It holds the names, modification and access times, sizes and
+ * content types guessed from the names, plus the trigrams of the names to
+ * look them up.
+ *
+ * Changes seen by the file monitors are kept in memory on top of it. A root
+ * is built again when too many of them pile up, when a monitor can not
+ * follow them anymore, or when one of its folders changed without a
+ * monitor seeing it. That is checked on startup and every few minutes,
+ * the root is not searched from the time the change is found until it is
+ * built again.
+ *
+ * Can be used from any thread.
+ */
+
+typedef struct _NautilusFilenameIndex NautilusFilenameIndex;
+
+/* Creates the index of the search-index-roots preference, from the main
+ * thread on startup.
+ */
+void                   nautilus_filename_index_init_default (void);
+/* Returns NULL unless nautilus_filename_index_init_default() was called. */
+NautilusFilenameIndex *nautilus_filename_index_get_default  (void);
+
+NautilusFilenameIndex *nautilus_filename_index_new          (GFile                 *cache_directory,
+                                                             const gchar * const   *roots);
+void                   nautilus_filename_index_free         (NautilusFilenameIndex *index);
+
+void                   nautilus_filename_index_set_roots    (NautilusFilenameIndex *index,
+                                                             const gchar * const   *roots);
+/* Builds the roots again in the background. */
+void                   nautilus_filename_index_rebuild      (NautilusFilenameIndex *index);
+/* Checks the folders of the roots for changes no monitor saw in the
+ * background, and builds those roots again.
+ */
+void                   nautilus_filename_index_check        (NautilusFilenameIndex *index);
+/* Blocks until the queued builds and changes are done with. */
+void                   nautilus_filename_index_wait         (NautilusFilenameIndex *index);
+
+/* Whether everything below @location can be searched in the index. */
+gboolean               nautilus_filename_index_covers       (NautilusFilenameIndex *index,
+                                                             GFile                 *location);
+/* Returns the NautilusSearchHits below @location, which must be covered,
+ * the same way the simple search engine would find them.
+ */
+GList                 *nautilus_filename_index_search       (NautilusFilenameIndex *index,
+                                                             GFile                 *location,
+                                                             NautilusQuery         *query,
+                                                             NautilusQueryMatcher  *matcher,
+                                                             GCancellable          *cancellable);
+
+void                   nautilus_filename_index_file_changed (NautilusFilenameIndex *index,
+                                                             GFile                 *file);
+void                   nautilus_filename_index_file_removed (NautilusFilenameIndex *index,
+                                                             GFile                 *file);
+/* Too much changed below @directory to follow, its root is built again. */
+void                   nautilus_filename_index_invalidate   (NautilusFilenameIndex *index,
+                                                             GFile                 *directory);
+
+G_END_DECLS
@@ -82,6 +82,7 @@
 #include "nautilus-search-directory.h"
 #include "nautilus-signaller.h"
 #include "nautilus-tag-manager.h"
+#include "nautilus-thumbnails.h"
 #include "nautilus-toolbar.h"
 #include "nautilus-trash-monitor.h"
 #include "nautilus-ui-utilities.h"
@@ -115,6 +116,9 @@
 /* Delay to show the Loading... floating bar */
 #define FLOATING_BAR_LOADING_DELAY 200 /* ms */
 
+/* Delay to tell the model which files are on screen while scrolling */
+#define VISIBLE_FILES_UPDATE_DELAY 50 /* ms */
+
 #define MIN_COMMON_FILENAME_PREFIX_LENGTH 4
 
 enum
@@ -185,6 +189,7 @@ typedef struct
 
     guint display_pending_source_id;
     guint changes_timeout_id;
+    guint update_visible_files_timeout_id;
 
     guint update_interval;
     guint64 last_queued;
@@ -992,6 +997,96 @@ nautilus_files_view_scroll_to_file (NautilusFilesView *view,
     NAUTILUS_FILES_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->scroll_to_file (view, uri);
 }
 
+static void
+remove_update_visible_files_timeout (NautilusFilesView *view)
+{
+    NautilusFilesViewPrivate *priv;
+
+    priv = nautilus_files_view_get_instance_private (view);
+
+    if (priv->update_visible_files_timeout_id != 0)
+    {
+        g_source_remove (priv->update_visible_files_timeout_id);
+        priv->update_visible_files_timeout_id = 0;
+    }
+}
+
+/* Moves the thumbnails of @files to the front of the queue, keeping the
+ * first file first.
+ */
+static void
+prioritize_thumbnailing (GList *files)
+{
+    NautilusFile *file;
+    GList *l;
+    char *uri;
+
+    for (l = g_list_last (files); l != NULL; l = l->prev)
+    {
+        file = NAUTILUS_FILE (l->data);
+        if (nautilus_file_is_thumbnailing (file))
+        {
+            uri = nautilus_file_get_uri (file);
+            nautilus_thumbnail_prioritize (uri);
+            g_free (uri);
+        }
+    }
+}
+
+static gboolean
+update_visible_files_timeout_callback (gpointer data)
+{
+    NautilusFilesView *view;
+    NautilusFilesViewPrivate *priv;
+    GList *files;
+
+    view = NAUTILUS_FILES_VIEW (data);
+    priv = nautilus_files_view_get_instance_private (view);
+
+    priv->update_visible_files_timeout_id = 0;
+
+    if (priv->model != NULL)
+    {
+        files = NAUTILUS_FILES_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->get_visible_files (view);
+        nautilus_directory_file_monitor_set_viewport (priv->model, &priv->model, files);
+        /* The list view has no other way to tell which rows are on screen */
+        prioritize_thumbnailing (files);
+        nautilus_file_list_free (files);
+    }
+
+    return FALSE;
+}
+
+/**
+ * nautilus_files_view_update_visible_files:
+ *
+ * Let the model load the slow attributes of the files on screen first, and
+ * only those, and move their thumbnails to the front of the queue. Call it
+ * when the view scrolls or its contents move.
+ * @view: NautilusFilesView in question.
+ *
+ **/
+void
+nautilus_files_view_update_visible_files (NautilusFilesView *view)
+{
+    NautilusFilesViewPrivate *priv;
+
+    g_return_if_fail (NAUTILUS_IS_FILES_VIEW (view));
+
+    priv = nautilus_files_view_get_instance_private (view);
+
+    if (NAUTILUS_FILES_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->get_visible_files == NULL ||
+        priv->model == NULL ||
+        priv->update_visible_files_timeout_id != 0)
+    {
+        return;
+    }
+
+    priv->update_visible_files_timeout_id =
+        g_timeout_add (VISIBLE_FILES_UPDATE_DELAY,
+                       update_visible_files_timeout_callback, view);
+}
+
 /**
  * nautilus_files_view_get_selection:
  *
@@ -3177,6 +3272,7 @@ nautilus_files_view_destroy (GtkWidget *object)
 
     remove_update_context_menus_timeout_callback (view);
     remove_update_status_idle_callback (view);
+    remove_update_visible_files_timeout (view);
 
     if (priv->display_selection_idle_id != 0)
     {
@@ -4232,6 +4328,9 @@ process_old_files (NautilusFilesView *view)
         file_and_directory_list_free (priv->old_changed_files);
         priv->old_changed_files = NULL;
 
+        /* The views may apply the changes in one go only now */
+        g_signal_emit (view, signals[END_FILE_CHANGES], 0);
+
         if (send_selection_change)
         {
             /* Send a selection change since some file names could
@@ -4239,8 +4338,6 @@ process_old_files (NautilusFilesView *view)
              */
             nautilus_files_view_send_selection_change (view);
         }
-
-        g_signal_emit (view, signals[END_FILE_CHANGES], 0);
     }
 }
 
@@ -4253,6 +4350,9 @@ display_pending_files (NautilusFilesView *view)
     process_new_files (view);
     process_old_files (view);
 
+    /* The files on screen may be different ones now */
+    nautilus_files_view_update_visible_files (view);
+
     priv = nautilus_files_view_get_instance_private (view);
     selection = nautilus_files_view_get_selection (NAUTILUS_VIEW (view));
 
@@ -8634,6 +8734,7 @@ disconnect_model_handlers (NautilusFilesView *view)
                                             &priv->model);
     nautilus_file_monitor_remove (priv->directory_as_file,
                                   &priv->directory_as_file);
+    remove_update_visible_files_timeout (view);
 }
 
 static void
@@ -9513,6 +9614,7 @@ nautilus_files_view_init (NautilusFilesView *view)
     gchar *templates_uri;
     GtkClipboard *clipboard;
     GApplication *app;
+    GtkAdjustment *vadjustment;
     const gchar *open_accels[] =
     {
         "Return",
@@ -9565,10 +9667,10 @@ nautilus_files_view_init (NautilusFilesView *view)
     priv->reload = GTK_WIDGET (gtk_builder_get_object (builder, "reload"));
     priv->stop = GTK_WIDGET (gtk_builder_get_object (builder, "stop"));
 
-    g_signal_connect (view,
-                      "end-file-changes",
-                      G_CALLBACK (on_end_file_changes),
-                      view);
+    g_signal_connect_after (view,
+                            "end-file-changes",
+                            G_CALLBACK (on_end_file_changes),
+                            view);
 
     g_object_unref (builder);
 
@@ -9603,6 +9705,15 @@ nautilus_files_view_init (NautilusFilesView *view)
                               G_CALLBACK (popup_menu_callback),
                               view);
 
+    /* Both the list and the icon view scroll through it */
+    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (priv->scrolled_window));
+    g_signal_connect_object (vadjustment, "value-changed",
+                             G_CALLBACK (nautilus_files_view_update_visible_files),
+                             view, G_CONNECT_SWAPPED);
+    g_signal_connect_object (vadjustment, "changed",
+                             G_CALLBACK (nautilus_files_view_update_visible_files),
+                             view, G_CONNECT_SWAPPED);
+
     gtk_container_add (GTK_CONTAINER (priv->overlay), priv->scrolled_window);
 
     /* Empty states */
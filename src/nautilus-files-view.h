@@ -224,6 +224,9 @@ struct _NautilusFilesViewClass {
            of the view */
         void           (* scroll_to_file)    (NautilusFilesView *view,
                                               const char        *uri);
+        /* Return the files on screen and about a screen worth around
+           them, or NULL to have all the files loaded in full */
+        GList *        (* get_visible_files) (NautilusFilesView *view);
 
         NautilusWindow * (*get_window)       (NautilusFilesView *view);
 
@@ -309,6 +312,7 @@ void              nautilus_files_view_stop_loading               (NautilusFilesV
 char *            nautilus_files_view_get_first_visible_file     (NautilusFilesView      *view);
 void              nautilus_files_view_scroll_to_file             (NautilusFilesView      *view,
                                                                   const char             *uri);
+void              nautilus_files_view_update_visible_files       (NautilusFilesView      *view);
 char *            nautilus_files_view_get_title                  (NautilusFilesView      *view);
 gboolean          nautilus_files_view_supports_zooming           (NautilusFilesView      *view);
 void              nautilus_files_view_bump_zoom_level            (NautilusFilesView      *view,
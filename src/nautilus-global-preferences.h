@@ -31,6 +31,9 @@ G_BEGIN_DECLS
 /* Trash options */
 #define NAUTILUS_PREFERENCES_CONFIRM_TRASH			"confirm-trash"
 
+/* File operations */
+#define NAUTILUS_PREFERENCES_COPY_THREADS			"copy-threads"
+
 /* Display  */
 #define NAUTILUS_PREFERENCES_SHOW_HIDDEN_FILES			"show-hidden"
 
@@ -127,6 +130,8 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_DIRECTORY_ITEM_COUNTS "show-directory-item-counts"
 #define NAUTILUS_PREFERENCES_SHOW_FILE_THUMBNAILS	"show-image-thumbnails"
 #define NAUTILUS_PREFERENCES_FILE_THUMBNAIL_LIMIT	"thumbnail-limit"
+#define NAUTILUS_PREFERENCES_THUMBNAIL_THREADS		"thumbnail-threads"
+#define NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE	"thumbnail-cache-size"
 
 typedef enum
 {
@@ -145,6 +150,8 @@ typedef enum
 
 /* Search behaviour */
 #define NAUTILUS_PREFERENCES_RECURSIVE_SEARCH "recursive-search"
+#define NAUTILUS_PREFERENCES_SEARCH_THREADS "search-threads"
+#define NAUTILUS_PREFERENCES_SEARCH_INDEX_ROOTS "search-index-roots"
 
 /* Context menu options */
 #define NAUTILUS_PREFERENCES_SHOW_DELETE_PERMANENTLY "show-delete-permanently"
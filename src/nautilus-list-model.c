@@ -820,6 +820,45 @@ nautilus_list_model_compare_func (NautilusListModel *model,
     return result;
 }
 
+/* Sorts the entries with nautilus_file_sort_get_new_order(), which uses
+ * several threads for large folders. Returns NULL if the sort attribute
+ * has no NautilusFileSortType, or for the dummy loading row.
+ */
+static int *
+sort_file_entries_by_keys (NautilusListModel  *model,
+                           GSequenceIter     **entries,
+                           int                 length)
+{
+    NautilusListModelPrivate *priv;
+    NautilusFileSortType sort_type;
+    g_autofree NautilusFile **files = NULL;
+    FileEntry *file_entry;
+    int i;
+
+    priv = nautilus_list_model_get_instance_private (model);
+
+    sort_type = nautilus_file_get_sort_type_for_attribute_q (priv->sort_attribute);
+    if (sort_type == NAUTILUS_FILE_SORT_NONE)
+    {
+        return NULL;
+    }
+
+    files = g_new (NautilusFile *, length);
+    for (i = 0; i < length; ++i)
+    {
+        file_entry = g_sequence_get (entries[i]);
+        if (file_entry->file == NULL)
+        {
+            return NULL;
+        }
+        files[i] = file_entry->file;
+    }
+
+    return nautilus_file_sort_get_new_order (files, length, sort_type,
+                                             priv->sort_directories_first,
+                                             (priv->order == GTK_SORT_DESCENDING));
+}
+
 static void
 nautilus_list_model_sort_file_entries (NautilusListModel *model,
                                        GSequence         *files,
@@ -858,14 +897,28 @@ nautilus_list_model_sort_file_entries (NautilusListModel *model,
     }
 
     /* sort */
-    g_sequence_sort (files, nautilus_list_model_file_entry_compare_func, model);
-
-    /* generate new order */
-    new_order = g_new (int, length);
-    /* Note: new_order[newpos] = oldpos */
-    for (i = 0; i < length; ++i)
+    new_order = sort_file_entries_by_keys (model, old_order, length);
+    if (new_order != NULL)
     {
-        new_order[g_sequence_iter_get_position (old_order[i])] = i;
+        /* Moving every entry to the end in the new order leaves them
+         * sorted, and keeps the iters in the reverse maps valid.
+         */
+        for (i = 0; i < length; ++i)
+        {
+            g_sequence_move (old_order[new_order[i]], g_sequence_get_end_iter (files));
+        }
+    }
+    else
+    {
+        g_sequence_sort (files, nautilus_list_model_file_entry_compare_func, model);
+
+        /* generate new order */
+        new_order = g_new (int, length);
+        /* Note: new_order[newpos] = oldpos */
+        for (i = 0; i < length; ++i)
+        {
+            new_order[g_sequence_iter_get_position (old_order[i])] = i;
+        }
     }
 
     /* Let the world know about our new order */
@@ -980,14 +1033,92 @@ add_dummy_row (NautilusListModel *model,
     gtk_tree_path_free (path);
 }
 
+/* Marks @parent_entry as loaded and removes its dummy loading row, if it
+ * still has it. Returns whether the first file added should take the place
+ * of the dummy row.
+ */
+static gboolean
+remove_dummy_row (NautilusListModel *model,
+                  FileEntry         *parent_entry)
+{
+    NautilusListModelPrivate *priv;
+    GSequenceIter *dummy_ptr;
+    FileEntry *dummy_entry;
+
+    priv = nautilus_list_model_get_instance_private (model);
+
+    /* At this point we set loaded. Either we saw
+     * "done" and ignored it waiting for this, or we do this
+     * earlier, but then we replace the dummy row anyway,
+     * so it doesn't matter */
+    parent_entry->loaded = 1;
+    if (g_sequence_get_length (parent_entry->files) != 1)
+    {
+        return FALSE;
+    }
+
+    dummy_ptr = g_sequence_get_iter_at_pos (parent_entry->files, 0);
+    dummy_entry = g_sequence_get (dummy_ptr);
+    if (dummy_entry->file != NULL)
+    {
+        return FALSE;
+    }
+
+    /* replace the dummy loading entry */
+    priv->stamp++;
+    g_sequence_remove (dummy_ptr);
+
+    return TRUE;
+}
+
+/* Inserts @file_entry before @before and tells the tree view about it. */
+static void
+insert_file_entry (NautilusListModel *model,
+                   FileEntry         *file_entry,
+                   GSequenceIter     *before,
+                   GHashTable        *parent_hash,
+                   gboolean           replace_dummy)
+{
+    NautilusListModelPrivate *priv;
+    GtkTreeIter iter;
+    GtkTreePath *path;
+
+    priv = nautilus_list_model_get_instance_private (model);
+
+    file_entry->ptr = g_sequence_insert_before (before, file_entry);
+    g_hash_table_insert (parent_hash, file_entry->file, file_entry->ptr);
+
+    iter.stamp = priv->stamp;
+    iter.user_data = file_entry->ptr;
+
+    path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
+    if (replace_dummy)
+    {
+        gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+    }
+    else
+    {
+        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+    }
+
+    if (nautilus_file_is_directory (file_entry->file))
+    {
+        file_entry->files = g_sequence_new ((GDestroyNotify) file_entry_free);
+
+        add_dummy_row (model, file_entry);
+
+        gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
+                                              path, &iter);
+    }
+    gtk_tree_path_free (path);
+}
+
 gboolean
 nautilus_list_model_add_file (NautilusListModel *model,
                               NautilusFile      *file,
                               NautilusDirectory *directory)
 {
     NautilusListModelPrivate *priv;
-    GtkTreeIter iter;
-    GtkTreePath *path;
     FileEntry *file_entry;
     GSequenceIter *ptr, *parent_ptr;
     GSequence *files;
@@ -1029,59 +1160,141 @@ nautilus_list_model_add_file (NautilusListModel *model,
     if (parent_ptr != NULL)
     {
         file_entry->parent = g_sequence_get (parent_ptr);
-        /* At this point we set loaded. Either we saw
-         * "done" and ignored it waiting for this, or we do this
-         * earlier, but then we replace the dummy row anyway,
-         * so it doesn't matter */
-        file_entry->parent->loaded = 1;
         parent_hash = file_entry->parent->reverse_map;
         files = file_entry->parent->files;
-        if (g_sequence_get_length (files) == 1)
-        {
-            GSequenceIter *dummy_ptr = g_sequence_get_iter_at_pos (files, 0);
-            FileEntry *dummy_entry = g_sequence_get (dummy_ptr);
-            if (dummy_entry->file == NULL)
-            {
-                /* replace the dummy loading entry */
-                priv->stamp++;
-                g_sequence_remove (dummy_ptr);
-
-                replace_dummy = TRUE;
-            }
-        }
+        replace_dummy = remove_dummy_row (model, file_entry->parent);
     }
 
+    ptr = g_sequence_search (files, file_entry,
+                             nautilus_list_model_file_entry_compare_func, model);
+    insert_file_entry (model, file_entry, ptr, parent_hash, replace_dummy);
 
-    file_entry->ptr = g_sequence_insert_sorted (files, file_entry,
-                                                nautilus_list_model_file_entry_compare_func, model);
+    return TRUE;
+}
 
-    g_hash_table_insert (parent_hash, file, file_entry->ptr);
+static int
+file_entry_compare_func_indirect (gconstpointer a,
+                                  gconstpointer b,
+                                  gpointer      user_data)
+{
+    return nautilus_list_model_file_entry_compare_func (*((FileEntry **) a),
+                                                        *((FileEntry **) b),
+                                                        user_data);
+}
 
-    iter.stamp = priv->stamp;
-    iter.user_data = file_entry->ptr;
+/**
+ * nautilus_list_model_add_files:
+ * @model: a #NautilusListModel
+ * @files: (element-type NautilusFile): the files to add
+ * @directory: the directory all of @files are in
+ *
+ * Like nautilus_list_model_add_file(), but sorts the new files among
+ * themselves first and then merges them into the already sorted rows. For
+ * batches that are large compared to the existing rows this walks the rows
+ * once instead of doing a binary search per file. A file that is listed
+ * more than once is only added once.
+ */
+void
+nautilus_list_model_add_files (NautilusListModel *model,
+                               GList             *files,
+                               NautilusDirectory *directory)
+{
+    NautilusListModelPrivate *priv;
+    g_autoptr (GPtrArray) entries = NULL;
+    g_autoptr (GHashTable) added = NULL;
+    FileEntry *file_entry;
+    FileEntry *parent_entry;
+    GSequenceIter *ptr, *parent_ptr;
+    GSequence *sequence;
+    gboolean replace_dummy;
+    gboolean merge;
+    GHashTable *parent_hash;
+    GList *l;
+    guint i;
 
-    path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
-    if (replace_dummy)
+    priv = nautilus_list_model_get_instance_private (model);
+
+    parent_ptr = g_hash_table_lookup (priv->directory_reverse_map,
+                                      directory);
+    if (parent_ptr != NULL)
     {
-        gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+        parent_entry = g_sequence_get (parent_ptr);
+        parent_hash = parent_entry->reverse_map;
+        sequence = parent_entry->files;
     }
     else
     {
-        gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+        parent_entry = NULL;
+        parent_hash = priv->top_reverse_map;
+        sequence = priv->files;
     }
 
-    if (nautilus_file_is_directory (file))
+    entries = g_ptr_array_new ();
+    added = g_hash_table_new (NULL, NULL);
+    for (l = files; l != NULL; l = l->next)
     {
-        file_entry->files = g_sequence_new ((GDestroyNotify) file_entry_free);
+        if (g_hash_table_lookup (parent_hash, l->data) != NULL)
+        {
+            g_warning ("file already in tree (parent_ptr: %p)!!!\n", parent_ptr);
+            continue;
+        }
 
-        add_dummy_row (model, file_entry);
+        if (!g_hash_table_add (added, l->data))
+        {
+            continue;
+        }
 
-        gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
-                                              path, &iter);
+        file_entry = g_new0 (FileEntry, 1);
+        file_entry->file = nautilus_file_ref (l->data);
+        file_entry->parent = parent_entry;
+        g_ptr_array_add (entries, file_entry);
     }
-    gtk_tree_path_free (path);
 
-    return TRUE;
+    if (entries->len == 0)
+    {
+        return;
+    }
+
+    replace_dummy = FALSE;
+    if (parent_entry != NULL)
+    {
+        replace_dummy = remove_dummy_row (model, parent_entry);
+    }
+
+    g_ptr_array_sort_with_data (entries, file_entry_compare_func_indirect, model);
+
+    /* Walking the existing rows costs n comparisons for the whole batch,
+     * searching costs log n per new file.
+     */
+    merge = entries->len * g_bit_storage (g_sequence_get_length (sequence)) >=
+            (guint) g_sequence_get_length (sequence);
+
+    ptr = g_sequence_get_begin_iter (sequence);
+    for (i = 0; i < entries->len; i++)
+    {
+        file_entry = g_ptr_array_index (entries, i);
+
+        if (merge)
+        {
+            /* The new entries are sorted, so the insertion point only
+             * moves forward.
+             */
+            while (!g_sequence_iter_is_end (ptr) &&
+                   nautilus_list_model_file_entry_compare_func (g_sequence_get (ptr),
+                                                                file_entry, model) <= 0)
+            {
+                ptr = g_sequence_iter_next (ptr);
+            }
+        }
+        else
+        {
+            ptr = g_sequence_search (sequence, file_entry,
+                                     nautilus_list_model_file_entry_compare_func, model);
+        }
+
+        insert_file_entry (model, file_entry, ptr, parent_hash, replace_dummy);
+        replace_dummy = FALSE;
+    }
 }
 
 void
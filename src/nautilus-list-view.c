@@ -1325,6 +1325,8 @@ sort_column_changed_callback (GtkTreeSortable  *sortable,
 
     /* Make sure selected item(s) is visible after sort */
     nautilus_list_view_reveal_selection (NAUTILUS_FILES_VIEW (view));
+    /* Sorting by size needs more than the files on screen */
+    nautilus_files_view_update_visible_files (NAUTILUS_FILES_VIEW (view));
 
     view->details->last_sort_attr = sort_attr;
 }
@@ -2407,9 +2409,17 @@ nautilus_list_view_add_files (NautilusFilesView *view,
                               GList             *files)
 {
     NautilusListModel *model;
+    NautilusDirectory *run_directory;
+    GList *run;
     GList *l;
 
     model = NAUTILUS_LIST_VIEW (view)->details->model;
+
+    /* Hand runs of files from the same directory to the model at once,
+     * so it can merge them into the sorted rows.
+     */
+    run_directory = NULL;
+    run = NULL;
     for (l = files; l != NULL; l = l->next)
     {
         NautilusFile *parent;
@@ -2417,11 +2427,32 @@ nautilus_list_view_add_files (NautilusFilesView *view,
 
         parent = nautilus_file_get_parent (NAUTILUS_FILE (l->data));
         directory = nautilus_directory_get_for_file (parent);
-        nautilus_list_model_add_file (model, NAUTILUS_FILE (l->data), directory);
-
         nautilus_file_unref (parent);
+
+        if (directory != run_directory && run != NULL)
+        {
+            run = g_list_reverse (run);
+            nautilus_list_model_add_files (model, run, run_directory);
+            g_clear_pointer (&run, g_list_free);
+        }
+
+        if (directory != run_directory)
+        {
+            nautilus_directory_unref (run_directory);
+            run_directory = nautilus_directory_ref (directory);
+        }
+
+        run = g_list_prepend (run, l->data);
         nautilus_directory_unref (directory);
     }
+
+    if (run != NULL)
+    {
+        run = g_list_reverse (run);
+        nautilus_list_model_add_files (model, run, run_directory);
+        g_list_free (run);
+    }
+    nautilus_directory_unref (run_directory);
 }
 
 static char **
@@ -3750,6 +3781,179 @@ nautilus_list_view_get_first_visible_file (NautilusFilesView *view)
     return NULL;
 }
 
+/* The rows in the order they are shown, going into the expanded folders */
+static gboolean
+get_next_shown_row (GtkTreeView  *tree_view,
+                    GtkTreeModel *model,
+                    GtkTreeIter  *iter)
+{
+    GtkTreePath *path;
+    GtkTreeIter current;
+    GtkTreeIter next;
+    GtkTreeIter parent;
+    gboolean expanded;
+
+    path = gtk_tree_model_get_path (model, iter);
+    expanded = gtk_tree_view_row_expanded (tree_view, path);
+    gtk_tree_path_free (path);
+
+    if (expanded && gtk_tree_model_iter_children (model, &next, iter))
+    {
+        *iter = next;
+        return TRUE;
+    }
+
+    current = *iter;
+    next = current;
+    while (!gtk_tree_model_iter_next (model, &next))
+    {
+        if (!gtk_tree_model_iter_parent (model, &parent, &current))
+        {
+            return FALSE;
+        }
+        current = parent;
+        next = parent;
+    }
+
+    *iter = next;
+    return TRUE;
+}
+
+static gboolean
+get_previous_shown_row (GtkTreeView  *tree_view,
+                        GtkTreeModel *model,
+                        GtkTreeIter  *iter)
+{
+    GtkTreePath *path;
+    GtkTreeIter previous;
+    GtkTreeIter child;
+    GtkTreeIter parent;
+    gboolean expanded;
+    gint n_children;
+
+    previous = *iter;
+    if (!gtk_tree_model_iter_previous (model, &previous))
+    {
+        if (!gtk_tree_model_iter_parent (model, &parent, iter))
+        {
+            return FALSE;
+        }
+        *iter = parent;
+        return TRUE;
+    }
+
+    /* Then the last row shown inside it */
+    do
+    {
+        path = gtk_tree_model_get_path (model, &previous);
+        expanded = gtk_tree_view_row_expanded (tree_view, path);
+        gtk_tree_path_free (path);
+
+        n_children = expanded ? gtk_tree_model_iter_n_children (model, &previous) : 0;
+        expanded = n_children > 0 &&
+                   gtk_tree_model_iter_nth_child (model, &child, &previous, n_children - 1);
+        if (expanded)
+        {
+            previous = child;
+        }
+    }
+    while (expanded);
+
+    *iter = previous;
+    return TRUE;
+}
+
+static GList *
+prepend_row_file (GtkTreeModel *model,
+                  GtkTreeIter  *iter,
+                  GList        *files)
+{
+    NautilusFile *file;
+
+    gtk_tree_model_get (model, iter,
+                        NAUTILUS_LIST_MODEL_FILE_COLUMN, &file,
+                        -1);
+
+    /* The dummy rows of the folders being loaded have none */
+    return file != NULL ? g_list_prepend (files, file) : files;
+}
+
+static GList *
+nautilus_list_view_get_visible_files (NautilusFilesView *view)
+{
+    NautilusListView *list_view;
+    GtkTreeModel *model;
+    GtkTreePath *start_path;
+    GtkTreePath *end_path;
+    GtkTreePath *path;
+    GtkTreeIter start;
+    GtkTreeIter iter;
+    GtkSortType sort_order;
+    gint sort_column_id;
+    GList *visible;
+    GList *around;
+    gboolean at_end;
+    guint n_visible;
+    guint i;
+
+    list_view = NAUTILUS_LIST_VIEW (view);
+    if (list_view->details->model == NULL)
+    {
+        return NULL;
+    }
+    model = GTK_TREE_MODEL (list_view->details->model);
+
+    /* Sorting by size needs the item count of every folder */
+    if (gtk_tree_sortable_get_sort_column_id (GTK_TREE_SORTABLE (model),
+                                              &sort_column_id, &sort_order) &&
+        nautilus_list_model_get_attribute_from_sort_column_id (list_view->details->model,
+                                                               sort_column_id) ==
+        g_quark_from_static_string ("size"))
+    {
+        return NULL;
+    }
+
+    if (!gtk_tree_view_get_visible_range (list_view->details->tree_view,
+                                          &start_path, &end_path))
+    {
+        return NULL;
+    }
+
+    gtk_tree_model_get_iter (model, &start, start_path);
+    gtk_tree_path_free (start_path);
+
+    visible = NULL;
+    n_visible = 0;
+    iter = start;
+    do
+    {
+        visible = prepend_row_file (model, &iter, visible);
+        n_visible++;
+
+        path = gtk_tree_model_get_path (model, &iter);
+        at_end = gtk_tree_path_compare (path, end_path) >= 0;
+        gtk_tree_path_free (path);
+    }
+    while (!at_end && get_next_shown_row (list_view->details->tree_view, model, &iter));
+    gtk_tree_path_free (end_path);
+
+    /* A screen worth below and above, to scroll to */
+    around = NULL;
+    for (i = 0; i < n_visible &&
+         get_next_shown_row (list_view->details->tree_view, model, &iter); i++)
+    {
+        around = prepend_row_file (model, &iter, around);
+    }
+    iter = start;
+    for (i = 0; i < n_visible &&
+         get_previous_shown_row (list_view->details->tree_view, model, &iter); i++)
+    {
+        around = prepend_row_file (model, &iter, around);
+    }
+
+    return g_list_concat (g_list_reverse (visible), around);
+}
+
 static void
 nautilus_list_view_scroll_to_file (NautilusListView *view,
                                    NautilusFile     *file)
@@ -3999,6 +4203,7 @@ nautilus_list_view_class_init (NautilusListViewClass *class)
     nautilus_files_view_class->get_view_id = nautilus_list_view_get_id;
     nautilus_files_view_class->get_first_visible_file = nautilus_list_view_get_first_visible_file;
     nautilus_files_view_class->scroll_to_file = list_view_scroll_to_file;
+    nautilus_files_view_class->get_visible_files = nautilus_list_view_get_visible_files;
     nautilus_files_view_class->compute_rename_popover_pointing_to = nautilus_list_view_compute_rename_popover_pointing_to;
     nautilus_files_view_class->reveal_for_selection_context_menu = nautilus_list_view_reveal_for_selection_context_menu;
 }
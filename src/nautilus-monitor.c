@@ -25,16 +25,50 @@
 
 #include <config.h>
 #include "nautilus-monitor.h"
+#include "nautilus-directory-private.h"
 #include "nautilus-file-changes-queue.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-filename-index.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_MONITOR
+#include "nautilus-debug.h"
 
 #include <gio/gio.h>
 
+/* Events are held back for a short while, so that the ones for the same
+ * file are merged into one change and a file created and deleted again
+ * in the meantime is not reported at all. When more files than
+ * STORM_THRESHOLD change in one interval, the single events are dropped
+ * and the directory is reloaded instead, at most once per
+ * STORM_RESCAN_INTERVAL, until things calm down.
+ */
+#define COALESCE_INTERVAL_MS 100
+#define STORM_RESCAN_INTERVAL_MS 1000
+#define STORM_THRESHOLD 500
+
+/* What is known about a pending file since its first event */
+typedef enum
+{
+    PENDING_EXISTED = 1 << 0,
+    PENDING_PRESENT = 1 << 1,
+    PENDING_CREATED = 1 << 2,
+} PendingFlags;
+
 struct NautilusMonitor
 {
     GFileMonitor *monitor;
     GVolumeMonitor *volume_monitor;
     GFile *location;
+
+    /* GFile -> PendingFlags */
+    GHashTable *pending;
+    guint flush_id;
+    gboolean storm;
+    gboolean rescan_needed;
+
+    NautilusMonitorCounters counters;
+    gint64 rate_start;
+    guint rate_events;
 };
 
 static gboolean call_consume_changes_idle_id = 0;
@@ -76,54 +110,273 @@ mount_removed (GVolumeMonitor *volume_monitor,
     g_object_unref (mount_location);
 }
 
+/* Passes the pending changes on to the changes queue, grouped by kind so
+ * that they are consumed in as few batches as possible.
+ */
+static void
+flush_pending (NautilusMonitor *monitor)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    GList *added = NULL;
+    GList *changed = NULL;
+    GList *removed = NULL;
+    PendingFlags flags;
+    NautilusFilenameIndex *index;
+    GList *l;
+
+    g_hash_table_iter_init (&iter, monitor->pending);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        flags = GPOINTER_TO_UINT (value);
+
+        /* A file that was replaced may be known already, but telling it
+         * was added covers that too.
+         */
+        if ((flags & PENDING_PRESENT) && (flags & PENDING_CREATED))
+        {
+            added = g_list_prepend (added, key);
+        }
+        else if (flags & PENDING_PRESENT)
+        {
+            changed = g_list_prepend (changed, key);
+        }
+        else if (flags & PENDING_EXISTED)
+        {
+            removed = g_list_prepend (removed, key);
+        }
+    }
+
+    index = nautilus_filename_index_get_default ();
+    for (l = removed; l != NULL; l = l->next)
+    {
+        nautilus_file_changes_queue_file_removed (l->data);
+        nautilus_filename_index_file_removed (index, l->data);
+    }
+    for (l = added; l != NULL; l = l->next)
+    {
+        nautilus_file_changes_queue_file_added (l->data);
+        nautilus_filename_index_file_changed (index, l->data);
+    }
+    for (l = changed; l != NULL; l = l->next)
+    {
+        nautilus_file_changes_queue_file_changed (l->data);
+        nautilus_filename_index_file_changed (index, l->data);
+    }
+
+    monitor->counters.n_notified += g_list_length (removed) +
+                                    g_list_length (added) +
+                                    g_list_length (changed);
+
+    if (removed != NULL || added != NULL || changed != NULL)
+    {
+        schedule_call_consume_changes ();
+    }
+
+    g_list_free (removed);
+    g_list_free (added);
+    g_list_free (changed);
+    g_hash_table_remove_all (monitor->pending);
+}
+
+/* Returns whether a reload could be started. It waits for one that is
+ * still going on, a storm is likely to outpace a large directory.
+ */
+static gboolean
+rescan_directory (NautilusMonitor *monitor)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+
+    directory = nautilus_directory_get_existing (monitor->location);
+    if (directory != NULL)
+    {
+        if (!nautilus_directory_are_all_files_seen (directory))
+        {
+            return FALSE;
+        }
+        nautilus_directory_force_reload (directory);
+    }
+
+    /* Too much to follow one by one */
+    nautilus_filename_index_invalidate (nautilus_filename_index_get_default (),
+                                        monitor->location);
+
+    monitor->counters.n_rescans++;
+
+    return TRUE;
+}
+
+static gboolean
+flush_timeout_cb (gpointer user_data)
+{
+    NautilusMonitor *monitor = user_data;
+
+    if (!monitor->storm)
+    {
+        flush_pending (monitor);
+        monitor->flush_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (monitor->rescan_needed)
+    {
+        if (rescan_directory (monitor))
+        {
+            monitor->rescan_needed = FALSE;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* A whole interval without events */
+    if (DEBUGGING)
+    {
+        g_autofree gchar *uri = g_file_get_uri (monitor->location);
+
+        DEBUG ("Storm in %s is over, %u reloads so far", uri, monitor->counters.n_rescans);
+    }
+    monitor->storm = FALSE;
+    monitor->flush_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+update_event_rate (NautilusMonitor *monitor)
+{
+    gint64 now;
+    gint64 elapsed;
+
+    monitor->counters.n_events++;
+    monitor->rate_events++;
+
+    now = g_get_monotonic_time ();
+    elapsed = now - monitor->rate_start;
+    if (elapsed >= G_USEC_PER_SEC)
+    {
+        monitor->counters.event_rate = (double) monitor->rate_events * G_USEC_PER_SEC / elapsed;
+        monitor->rate_start = now;
+        monitor->rate_events = 0;
+    }
+}
+
 static void
-dir_changed (GFileMonitor      *monitor,
+start_storm (NautilusMonitor *monitor)
+{
+    if (DEBUGGING)
+    {
+        g_autofree gchar *uri = g_file_get_uri (monitor->location);
+
+        DEBUG ("Storm in %s, reloading instead of %u changes",
+               uri, g_hash_table_size (monitor->pending));
+    }
+
+    g_hash_table_remove_all (monitor->pending);
+    monitor->storm = TRUE;
+    monitor->rescan_needed = TRUE;
+
+    g_source_remove (monitor->flush_id);
+    monitor->flush_id = g_timeout_add (STORM_RESCAN_INTERVAL_MS, flush_timeout_cb, monitor);
+}
+
+static void
+add_pending (NautilusMonitor   *monitor,
              GFile             *child,
-             GFile             *other_file,
-             GFileMonitorEvent  event_type,
-             gpointer           user_data)
+             GFileMonitorEvent  event_type)
 {
-    char *to_uri;
+    gpointer value;
+    PendingFlags flags;
 
-    to_uri = NULL;
-    if (other_file)
+    if (g_hash_table_lookup_extended (monitor->pending, child, NULL, &value))
     {
-        to_uri = g_file_get_uri (other_file);
+        flags = GPOINTER_TO_UINT (value);
+    }
+    else if (event_type == G_FILE_MONITOR_EVENT_CREATED)
+    {
+        flags = 0;
+    }
+    else
+    {
+        flags = PENDING_EXISTED | PENDING_PRESENT;
     }
 
     switch (event_type)
     {
-        default:
-        case G_FILE_MONITOR_EVENT_CHANGED:
+        case G_FILE_MONITOR_EVENT_CREATED:
         {
-            /* ignore */
+            flags |= PENDING_PRESENT | PENDING_CREATED;
         }
         break;
 
-        case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
-        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_UNMOUNTED:
+        case G_FILE_MONITOR_EVENT_DELETED:
+        {
+            flags &= ~PENDING_PRESENT;
+        }
+        break;
+
+        default:
         {
-            nautilus_file_changes_queue_file_changed (child);
+            /* A change tells nothing new about the file */
         }
         break;
+    }
+
+    /* Created and deleted again, nobody needs to know */
+    if (!(flags & (PENDING_EXISTED | PENDING_PRESENT)))
+    {
+        g_hash_table_remove (monitor->pending, child);
+        return;
+    }
 
+    g_hash_table_insert (monitor->pending, g_object_ref (child), GUINT_TO_POINTER (flags));
+
+    if (monitor->flush_id == 0)
+    {
+        monitor->flush_id = g_timeout_add (COALESCE_INTERVAL_MS, flush_timeout_cb, monitor);
+    }
+    else if (g_hash_table_size (monitor->pending) > STORM_THRESHOLD)
+    {
+        start_storm (monitor);
+    }
+}
+
+static void
+dir_changed (GFileMonitor      *file_monitor,
+             GFile             *child,
+             GFile             *other_file,
+             GFileMonitorEvent  event_type,
+             gpointer           user_data)
+{
+    NautilusMonitor *monitor = user_data;
+
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
         case G_FILE_MONITOR_EVENT_UNMOUNTED:
         case G_FILE_MONITOR_EVENT_DELETED:
+        case G_FILE_MONITOR_EVENT_CREATED:
         {
-            nautilus_file_changes_queue_file_removed (child);
+            update_event_rate (monitor);
+
+            if (monitor->storm)
+            {
+                monitor->rescan_needed = TRUE;
+            }
+            else
+            {
+                add_pending (monitor, child, event_type);
+            }
         }
         break;
 
-        case G_FILE_MONITOR_EVENT_CREATED:
+        default:
+        case G_FILE_MONITOR_EVENT_CHANGED:
         {
-            nautilus_file_changes_queue_file_added (child);
+            /* ignore */
         }
         break;
     }
-
-    g_free (to_uri);
-
-    schedule_call_consume_changes ();
 }
 
 NautilusMonitor *
@@ -133,6 +386,10 @@ nautilus_monitor_directory (GFile *location)
     NautilusMonitor *ret;
 
     ret = g_slice_new0 (NautilusMonitor);
+    ret->location = g_object_ref (location);
+    ret->pending = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                          g_object_unref, NULL);
+    ret->rate_start = g_get_monotonic_time ();
     dir_monitor = g_file_monitor_directory (location, G_FILE_MONITOR_WATCH_MOUNTS, NULL, NULL);
 
     if (dir_monitor != NULL)
@@ -141,7 +398,6 @@ nautilus_monitor_directory (GFile *location)
     }
     else if (!g_file_is_native (location))
     {
-        ret->location = g_object_ref (location);
         ret->volume_monitor = g_volume_monitor_get ();
     }
 
@@ -177,6 +433,35 @@ nautilus_monitor_cancel (NautilusMonitor *monitor)
         g_object_unref (monitor->volume_monitor);
     }
 
+    /* The directory may still be around to take the last changes, but
+     * not reloaded, it is not monitored anymore.
+     */
+    if (monitor->flush_id != 0)
+    {
+        g_source_remove (monitor->flush_id);
+        if (!monitor->storm)
+        {
+            flush_pending (monitor);
+        }
+    }
+    g_hash_table_destroy (monitor->pending);
+
     g_clear_object (&monitor->location);
     g_slice_free (NautilusMonitor, monitor);
 }
+
+void
+nautilus_monitor_get_counters (NautilusMonitor         *monitor,
+                               NautilusMonitorCounters *counters)
+{
+    gint64 elapsed;
+
+    *counters = monitor->counters;
+
+    /* Let the rate fall off when the events stop */
+    elapsed = g_get_monotonic_time () - monitor->rate_start;
+    if (elapsed >= G_USEC_PER_SEC)
+    {
+        counters->event_rate = (double) monitor->rate_events * G_USEC_PER_SEC / elapsed;
+    }
+}
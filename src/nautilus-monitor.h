@@ -29,5 +29,16 @@
 
 typedef struct NautilusMonitor NautilusMonitor;
 
-NautilusMonitor *nautilus_monitor_directory (GFile *location);
-void             nautilus_monitor_cancel    (NautilusMonitor *monitor);
\ No newline at end of file
+typedef struct
+{
+    guint64 n_events;   /* From the file monitor */
+    guint64 n_notified; /* Passed on to the changes queue, once merged */
+    guint n_rescans;    /* Reloads instead of events, in storms */
+    double event_rate;  /* Per second, over the last second or more */
+} NautilusMonitorCounters;
+
+NautilusMonitor *nautilus_monitor_directory    (GFile                   *location);
+void             nautilus_monitor_cancel       (NautilusMonitor         *monitor);
+
+void             nautilus_monitor_get_counters (NautilusMonitor         *monitor,
+                                                NautilusMonitorCounters *counters);
\ No newline at end of file
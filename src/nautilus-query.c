@@ -21,6 +21,7 @@
 
 #include "nautilus-query.h"
 
+#include <string.h>
 #include <eel/eel-glib-extensions.h>
 #include <glib/gi18n.h>
 
@@ -32,6 +33,27 @@
 #define MIN_RANK 10.0
 #define MAX_RANK 50.0
 
+/* File names longer than this are matched through the Unicode path. */
+#define MATCHER_ASCII_BUFFER_SIZE 256
+
+/* Immutable, so it can be shared by search threads without locking. */
+struct _NautilusQueryMatcher
+{
+    gint ref_count;
+
+    /* Normalized and lower cased words of the query, NULL if the query
+     * has no text.
+     */
+    gchar **words;
+    gsize *word_lengths;
+    guint n_words;
+
+    /* Whether lower casing ASCII according to the current locale is the
+     * same as g_ascii_tolower(), which is not the case for Turkic languages.
+     */
+    gboolean ascii_fast_path;
+};
+
 struct _NautilusQuery
 {
     GObject parent;
@@ -46,12 +68,13 @@ struct _NautilusQuery
     NautilusQuerySearchContent search_content;
 
     gboolean searching;
-    char **prepared_words;
-    GMutex prepared_words_mutex;
+    NautilusQueryMatcher *matcher;
+    GMutex matcher_mutex;
 };
 
 static void  nautilus_query_class_init (NautilusQueryClass *class);
 static void  nautilus_query_init (NautilusQuery *query);
+static NautilusQueryMatcher *nautilus_query_matcher_new (const gchar *text);
 
 G_DEFINE_TYPE (NautilusQuery, nautilus_query, G_TYPE_OBJECT);
 
@@ -77,10 +100,10 @@ finalize (GObject *object)
     query = NAUTILUS_QUERY (object);
 
     g_free (query->text);
-    g_strfreev (query->prepared_words);
+    nautilus_query_matcher_unref (query->matcher);
     g_clear_object (&query->location);
     g_clear_pointer (&query->date_range, g_ptr_array_unref);
-    g_mutex_clear (&query->prepared_words_mutex);
+    g_mutex_clear (&query->matcher_mutex);
 
     G_OBJECT_CLASS (nautilus_query_parent_class)->finalize (object);
 }
@@ -341,7 +364,8 @@ nautilus_query_init (NautilusQuery *query)
     query->location = g_file_new_for_path (g_get_home_dir ());
     query->search_type = g_settings_get_enum (nautilus_preferences, "search-filter-time-type");
     query->search_content = NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE;
-    g_mutex_init (&query->prepared_words_mutex);
+    query->matcher = nautilus_query_matcher_new (NULL);
+    g_mutex_init (&query->matcher_mutex);
 }
 
 static gchar *
@@ -356,49 +380,112 @@ prepare_string_for_compare (const gchar *string)
     return res;
 }
 
-gdouble
-nautilus_query_matches_string (NautilusQuery *query,
-                               const gchar   *string)
+static NautilusQueryMatcher *
+nautilus_query_matcher_new (const gchar *text)
 {
-    gchar *prepared_string, *ptr;
-    gboolean found;
-    gdouble retval;
-    gint idx, nonexact_malus;
+    NautilusQueryMatcher *matcher;
+    gchar *prepared_string;
+    gchar *lower_i;
+    guint i;
 
-    if (!query->text)
+    matcher = g_new0 (NautilusQueryMatcher, 1);
+    matcher->ref_count = 1;
+
+    lower_i = g_utf8_strdown ("I", -1);
+    matcher->ascii_fast_path = strcmp (lower_i, "i") == 0;
+    g_free (lower_i);
+
+    if (text == NULL)
     {
-        return -1;
+        return matcher;
     }
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    if (!query->prepared_words)
+    prepared_string = prepare_string_for_compare (text);
+    matcher->words = g_strsplit (prepared_string, " ", -1);
+    g_free (prepared_string);
+
+    matcher->n_words = g_strv_length (matcher->words);
+    matcher->word_lengths = g_new (gsize, matcher->n_words);
+    for (i = 0; i < matcher->n_words; i++)
     {
-        prepared_string = prepare_string_for_compare (query->text);
-        query->prepared_words = g_strsplit (prepared_string, " ", -1);
-        g_free (prepared_string);
+        matcher->word_lengths[i] = strlen (matcher->words[i]);
     }
 
-    prepared_string = prepare_string_for_compare (string);
-    found = TRUE;
-    ptr = NULL;
-    nonexact_malus = 0;
+    return matcher;
+}
+
+NautilusQueryMatcher *
+nautilus_query_matcher_ref (NautilusQueryMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, NULL);
+
+    g_atomic_int_inc (&matcher->ref_count);
+
+    return matcher;
+}
 
-    for (idx = 0; query->prepared_words[idx] != NULL; idx++)
+void
+nautilus_query_matcher_unref (NautilusQueryMatcher *matcher)
+{
+    if (matcher == NULL || !g_atomic_int_dec_and_test (&matcher->ref_count))
     {
-        if ((ptr = strstr (prepared_string, query->prepared_words[idx])) == NULL)
+        return;
+    }
+
+    g_strfreev (matcher->words);
+    g_free (matcher->word_lengths);
+    g_free (matcher);
+}
+
+/* Lower cases @string into @buffer if it is plain ASCII. Such strings are
+ * already in NFD, so this gives the same result as
+ * prepare_string_for_compare() without allocating.
+ */
+static gboolean
+fold_ascii_string (const gchar *string,
+                   gchar       *buffer,
+                   gsize       *length)
+{
+    gsize i;
+
+    for (i = 0; string[i] != '\0'; i++)
+    {
+        if (i == MATCHER_ASCII_BUFFER_SIZE || (guchar) string[i] >= 0x80)
         {
-            found = FALSE;
-            break;
+            return FALSE;
         }
 
-        nonexact_malus += strlen (ptr) - strlen (query->prepared_words[idx]);
+        buffer[i] = g_ascii_tolower (string[i]);
     }
-    g_mutex_unlock (&query->prepared_words_mutex);
 
-    if (!found)
+    *length = i;
+
+    return TRUE;
+}
+
+static gdouble
+match_prepared_string (NautilusQueryMatcher *matcher,
+                       const gchar          *prepared_string,
+                       gsize                 length)
+{
+    const gchar *ptr;
+    gint nonexact_malus;
+    guint i;
+
+    ptr = prepared_string;
+    nonexact_malus = 0;
+
+    for (i = 0; i < matcher->n_words; i++)
     {
-        g_free (prepared_string);
-        return -1;
+        /* memmem() is vectorized in glibc, unlike a byte by byte scan */
+        ptr = memmem (prepared_string, length,
+                      matcher->words[i], matcher->word_lengths[i]);
+        if (ptr == NULL)
+        {
+            return -1;
+        }
+
+        nonexact_malus += (length - (ptr - prepared_string)) - matcher->word_lengths[i];
     }
 
     /* The rank value depends on the numbers of letters before and after the match.
@@ -406,12 +493,108 @@ nautilus_query_matches_string (NautilusQuery *query,
      * after the match is divided by a factor, so that it decreases the rank by a
      * smaller amount.
      */
-    retval = MAX (MIN_RANK, MAX_RANK - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / RANK_SCALE_FACTOR);
+    return MAX (MIN_RANK, MAX_RANK - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / RANK_SCALE_FACTOR);
+}
+
+/**
+ * nautilus_query_matcher_matches_string:
+ * @matcher: a #NautilusQueryMatcher
+ * @string: the string to match, usually a file name
+ *
+ * Can be called from any thread. ASCII strings are matched without
+ * allocating any memory.
+ *
+ * Returns: the rank of the match, or -1 if @string doesn't match.
+ */
+gdouble
+nautilus_query_matcher_matches_string (NautilusQueryMatcher *matcher,
+                                       const gchar          *string)
+{
+    gchar buffer[MATCHER_ASCII_BUFFER_SIZE];
+    gchar *prepared_string;
+    gsize length;
+    gdouble retval;
+
+    if (matcher->words == NULL)
+    {
+        return -1;
+    }
+
+    if (matcher->ascii_fast_path && fold_ascii_string (string, buffer, &length))
+    {
+        return match_prepared_string (matcher, buffer, length);
+    }
+
+    prepared_string = prepare_string_for_compare (string);
+    retval = match_prepared_string (matcher, prepared_string, strlen (prepared_string));
     g_free (prepared_string);
 
     return retval;
 }
 
+/**
+ * nautilus_query_matcher_get_words:
+ * @matcher: a #NautilusQueryMatcher
+ *
+ * Returns: (transfer none): the words a string must contain to match, in
+ * the form nautilus_query_fold_string() gives, or %NULL if nothing matches.
+ */
+const gchar * const *
+nautilus_query_matcher_get_words (NautilusQueryMatcher *matcher)
+{
+    return (const gchar * const *) matcher->words;
+}
+
+/**
+ * nautilus_query_fold_string:
+ * @string: a string to match, usually a file name
+ *
+ * Returns: (transfer full): @string normalized and lower cased the way
+ * matchers compare it.
+ */
+gchar *
+nautilus_query_fold_string (const gchar *string)
+{
+    return prepare_string_for_compare (string);
+}
+
+/**
+ * nautilus_query_get_matcher:
+ * @query: a #NautilusQuery
+ *
+ * Search providers should get the matcher once when starting, rather than
+ * calling nautilus_query_matches_string() for every file.
+ *
+ * Returns: (transfer full): a matcher for the current text of @query.
+ */
+NautilusQueryMatcher *
+nautilus_query_get_matcher (NautilusQuery *query)
+{
+    NautilusQueryMatcher *matcher;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
+
+    g_mutex_lock (&query->matcher_mutex);
+    matcher = nautilus_query_matcher_ref (query->matcher);
+    g_mutex_unlock (&query->matcher_mutex);
+
+    return matcher;
+}
+
+gdouble
+nautilus_query_matches_string (NautilusQuery *query,
+                               const gchar   *string)
+{
+    NautilusQueryMatcher *matcher;
+    gdouble retval;
+
+    matcher = nautilus_query_get_matcher (query);
+    retval = nautilus_query_matcher_matches_string (matcher, string);
+    nautilus_query_matcher_unref (matcher);
+
+    return retval;
+}
+
 NautilusQuery *
 nautilus_query_new (void)
 {
@@ -431,15 +614,20 @@ void
 nautilus_query_set_text (NautilusQuery *query,
                          const char    *text)
 {
+    NautilusQueryMatcher *matcher;
+    NautilusQueryMatcher *old_matcher;
+
     g_return_if_fail (NAUTILUS_IS_QUERY (query));
 
     g_free (query->text);
     query->text = g_strstrip (g_strdup (text));
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    g_strfreev (query->prepared_words);
-    query->prepared_words = NULL;
-    g_mutex_unlock (&query->prepared_words_mutex);
+    matcher = nautilus_query_matcher_new (query->text);
+    g_mutex_lock (&query->matcher_mutex);
+    old_matcher = query->matcher;
+    query->matcher = matcher;
+    g_mutex_unlock (&query->matcher_mutex);
+    nautilus_query_matcher_unref (old_matcher);
 
     g_object_notify (G_OBJECT (query), "text");
 }
@@ -674,3 +862,217 @@ nautilus_query_is_empty (NautilusQuery *query)
 
     return FALSE;
 }
+
+/**
+ * nautilus_query_copy:
+ * @query: a #NautilusQuery
+ *
+ * Copies what @query matches, to keep it while @query changes. The
+ * searching state is not copied.
+ *
+ * Returns: (transfer full): a new #NautilusQuery.
+ */
+NautilusQuery *
+nautilus_query_copy (NautilusQuery *query)
+{
+    NautilusQuery *copy;
+    g_autoptr (GPtrArray) date_range = NULL;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
+
+    copy = nautilus_query_new ();
+
+    g_free (copy->text);
+    copy->text = g_strdup (query->text);
+    nautilus_query_matcher_unref (copy->matcher);
+    copy->matcher = nautilus_query_get_matcher (query);
+
+    g_set_object (&copy->location, query->location);
+    copy->mime_types = nautilus_query_get_mime_types (query);
+    copy->show_hidden = query->show_hidden;
+    date_range = nautilus_query_get_date_range (query);
+    if (date_range != NULL)
+    {
+        copy->date_range = g_ptr_array_ref (date_range);
+    }
+    copy->recursive = query->recursive;
+    copy->search_type = query->search_type;
+    copy->search_content = query->search_content;
+
+    return copy;
+}
+
+/* Every file name that contains all the words of @matcher must contain all
+ * the words of @previous too.
+ */
+static gboolean
+matcher_refines (NautilusQueryMatcher *matcher,
+                 NautilusQueryMatcher *previous)
+{
+    gboolean found;
+    guint i;
+    guint j;
+
+    if (matcher->words == NULL || previous->words == NULL ||
+        matcher->ascii_fast_path != previous->ascii_fast_path)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < previous->n_words; i++)
+    {
+        found = FALSE;
+        for (j = 0; j < matcher->n_words && !found; j++)
+        {
+            found = strstr (matcher->words[j], previous->words[i]) != NULL;
+        }
+
+        if (!found)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+mime_types_refine (GList *mime_types,
+                   GList *previous)
+{
+    GList *l;
+    GList *p;
+    gboolean found;
+
+    if (previous == NULL)
+    {
+        return TRUE;
+    }
+
+    if (mime_types == NULL)
+    {
+        return FALSE;
+    }
+
+    for (l = mime_types; l != NULL; l = l->next)
+    {
+        found = FALSE;
+        for (p = previous; p != NULL && !found; p = p->next)
+        {
+            found = g_content_type_is_a (l->data, p->data);
+        }
+
+        if (!found)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+mime_types_equal (GList *mime_types,
+                  GList *other)
+{
+    for (; mime_types != NULL && other != NULL; mime_types = mime_types->next, other = other->next)
+    {
+        if (g_strcmp0 (mime_types->data, other->data) != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return mime_types == NULL && other == NULL;
+}
+
+static gboolean
+date_range_refines (GPtrArray *date_range,
+                    GPtrArray *previous)
+{
+    if (previous == NULL)
+    {
+        return TRUE;
+    }
+
+    if (date_range == NULL)
+    {
+        return FALSE;
+    }
+
+    return g_date_time_compare (g_ptr_array_index (date_range, 0),
+                                g_ptr_array_index (previous, 0)) >= 0 &&
+           g_date_time_compare (g_ptr_array_index (date_range, 1),
+                                g_ptr_array_index (previous, 1)) <= 0;
+}
+
+static gboolean
+date_range_equal (GPtrArray *date_range,
+                  GPtrArray *other)
+{
+    if (date_range == NULL || other == NULL)
+    {
+        return date_range == other;
+    }
+
+    return g_date_time_equal (g_ptr_array_index (date_range, 0),
+                              g_ptr_array_index (other, 0)) &&
+           g_date_time_equal (g_ptr_array_index (date_range, 1),
+                              g_ptr_array_index (other, 1));
+}
+
+/**
+ * nautilus_query_refines:
+ * @query: a #NautilusQuery
+ * @previous: a query that was searched for before
+ * @text_only: (out) (optional): whether only the text is narrower
+ *
+ * Checks whether @query is narrower than @previous, so that its results can
+ * be found by filtering the results of @previous on their names, and on
+ * their types and dates unless @text_only. Full text searches match what
+ * files contain, so those are never refined.
+ *
+ * Returns: %TRUE if every file that matches @query matches @previous.
+ */
+gboolean
+nautilus_query_refines (NautilusQuery *query,
+                        NautilusQuery *previous,
+                        gboolean      *text_only)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (NautilusQueryMatcher) previous_matcher = NULL;
+    g_autoptr (GPtrArray) date_range = NULL;
+    g_autoptr (GPtrArray) previous_date_range = NULL;
+    gboolean refines;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), FALSE);
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (previous), FALSE);
+
+    if (query->location == NULL || previous->location == NULL ||
+        !g_file_equal (query->location, previous->location) ||
+        query->recursive != previous->recursive ||
+        query->show_hidden != previous->show_hidden ||
+        query->search_type != previous->search_type ||
+        query->search_content != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE ||
+        previous->search_content != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE)
+    {
+        return FALSE;
+    }
+
+    matcher = nautilus_query_get_matcher (query);
+    previous_matcher = nautilus_query_get_matcher (previous);
+    date_range = nautilus_query_get_date_range (query);
+    previous_date_range = nautilus_query_get_date_range (previous);
+
+    refines = matcher_refines (matcher, previous_matcher) &&
+              mime_types_refine (query->mime_types, previous->mime_types) &&
+              date_range_refines (date_range, previous_date_range);
+
+    if (text_only != NULL)
+    {
+        *text_only = mime_types_equal (query->mime_types, previous->mime_types) &&
+                     date_range_equal (date_range, previous_date_range);
+    }
+
+    return refines;
+}
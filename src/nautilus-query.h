@@ -45,6 +45,8 @@ typedef enum {
 
 G_DECLARE_FINAL_TYPE (NautilusQuery, nautilus_query, NAUTILUS, QUERY, GObject)
 
+typedef struct _NautilusQueryMatcher NautilusQueryMatcher;
+
 NautilusQuery* nautilus_query_new      (void);
 
 char *         nautilus_query_get_text           (NautilusQuery *query);
@@ -84,6 +86,21 @@ void           nautilus_query_set_searching      (NautilusQuery *query,
 
 gdouble        nautilus_query_matches_string     (NautilusQuery *query, const gchar *string);
 
+NautilusQueryMatcher * nautilus_query_get_matcher            (NautilusQuery        *query);
+NautilusQueryMatcher * nautilus_query_matcher_ref            (NautilusQueryMatcher *matcher);
+void                   nautilus_query_matcher_unref          (NautilusQueryMatcher *matcher);
+gdouble                nautilus_query_matcher_matches_string (NautilusQueryMatcher *matcher,
+                                                              const gchar          *string);
+const gchar * const *  nautilus_query_matcher_get_words      (NautilusQueryMatcher *matcher);
+gchar *                nautilus_query_fold_string            (const gchar          *string);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusQueryMatcher, nautilus_query_matcher_unref)
+
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 
 gboolean       nautilus_query_is_empty           (NautilusQuery *query);
+
+NautilusQuery *nautilus_query_copy               (NautilusQuery *query);
+gboolean       nautilus_query_refines            (NautilusQuery *query,
+                                                  NautilusQuery *previous,
+                                                  gboolean      *text_only);
@@ -33,7 +33,16 @@
 #include "nautilus-search-directory-file.h"
 #include "nautilus-search-engine-model.h"
 #include "nautilus-search-engine.h"
+#include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
+#include "nautilus-ui-utilities.h"
+
+/* The hits are handed to the clients in chunks, for at most a frame's worth
+ * of time per idle callback, so that the window keeps redrawing while a
+ * search finds tens of thousands of files.
+ */
+#define FILES_ADDED_CHUNK_SIZE 500
+#define FILES_ADDED_TIME_SLICE (8 * G_TIME_SPAN_MILLISECOND)
 
 struct _NautilusSearchDirectory
 {
@@ -60,8 +69,27 @@ struct _NautilusSearchDirectory
      * scheduled timeouts. */
     gboolean search_ready_and_valid;
 
+    /* What the running search was started with, or last refined to */
+    NautilusQuery *search_query;
+    /* The running search was narrowed down by filtering its results, so
+     * the hits still coming must be filtered too. */
+    gboolean refined;
+    /* Keep the filtered results when the clients stop the search to
+     * reload, until they start it again. */
+    gboolean refining;
+
     GList *files;
     GHashTable *files_hash;
+    /* The hit of each result, to rank it again when the search is refined */
+    GHashTable *hits;
+
+    /* Files of the hits not handed to the clients yet */
+    GQueue pending_files;
+    guint add_files_idle_id;
+    /* The search finished while files were still pending */
+    gboolean finish_pending;
+    /* The folders of the files, to follow their changes */
+    GHashTable *directories;
 
     GList *monitor_list;
     GList *callback_list;
@@ -124,37 +152,47 @@ static void search_engine_error (NautilusSearchEngine    *engine,
                                  NautilusSearchDirectory *self);
 static void search_callback_file_ready_callback (NautilusFile *file,
                                                  gpointer      data);
-static void file_changed (NautilusFile            *file,
-                          NautilusSearchDirectory *self);
+static void directory_files_changed (NautilusDirectory       *directory,
+                                     GList                   *files,
+                                     NautilusSearchDirectory *self);
 
 static void
 reset_file_list (NautilusSearchDirectory *self)
 {
-    GList *list, *monitor_list;
-    NautilusFile *file;
-    SearchMonitor *monitor;
+    GList *monitor_list;
+    GHashTableIter iter;
+    gpointer directory;
 
-    /* Remove file connections */
-    for (list = self->files; list != NULL; list = list->next)
+    if (self->add_files_idle_id != 0)
     {
-        file = list->data;
+        g_source_remove (self->add_files_idle_id);
+        self->add_files_idle_id = 0;
+    }
+    self->finish_pending = FALSE;
+    g_queue_foreach (&self->pending_files, (GFunc) nautilus_file_unref, NULL);
+    g_queue_clear (&self->pending_files);
 
-        /* Disconnect change handler */
-        g_signal_handlers_disconnect_by_func (file, file_changed, self);
+    /* Disconnect change handlers */
+    g_hash_table_iter_init (&iter, self->directories);
+    while (g_hash_table_iter_next (&iter, &directory, NULL))
+    {
+        g_signal_handlers_disconnect_by_func (directory, directory_files_changed, self);
+        nautilus_directory_unref (directory);
+    }
+    g_hash_table_remove_all (self->directories);
 
-        /* Remove monitors */
-        for (monitor_list = self->monitor_list; monitor_list;
-             monitor_list = monitor_list->next)
-        {
-            monitor = monitor_list->data;
-            nautilus_file_monitor_remove (file, monitor);
-        }
+    /* Remove monitors */
+    for (monitor_list = self->monitor_list; monitor_list;
+         monitor_list = monitor_list->next)
+    {
+        nautilus_file_list_monitor_remove (self->files, monitor_list->data);
     }
 
     nautilus_file_list_free (self->files);
     self->files = NULL;
 
     g_hash_table_remove_all (self->files_hash);
+    g_hash_table_remove_all (self->hits);
 }
 
 static void
@@ -188,6 +226,17 @@ start_search (NautilusSearchDirectory *self)
         return;
     }
 
+    if (self->refining)
+    {
+        /* The results were filtered for the new query already */
+        self->refining = FALSE;
+        if (self->search_ready_and_valid)
+        {
+            nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (self));
+        }
+        return;
+    }
+
     if (self->search_running)
     {
         return;
@@ -203,6 +252,9 @@ start_search (NautilusSearchDirectory *self)
     self->search_ready_and_valid = FALSE;
 
     set_hidden_files (self);
+    g_clear_object (&self->search_query);
+    self->search_query = nautilus_query_copy (self->query);
+    self->refined = FALSE;
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (self->engine),
                                         self->query);
 
@@ -217,7 +269,7 @@ start_search (NautilusSearchDirectory *self)
 static void
 stop_search (NautilusSearchDirectory *self)
 {
-    if (!self->search_running)
+    if (!self->search_running || self->refining)
     {
         return;
     }
@@ -228,16 +280,30 @@ stop_search (NautilusSearchDirectory *self)
     reset_file_list (self);
 }
 
+/* The results are followed through their folders rather than one by one,
+ * so that a change to many of them reaches the clients at once.
+ */
 static void
-file_changed (NautilusFile            *file,
-              NautilusSearchDirectory *self)
+directory_files_changed (NautilusDirectory       *directory,
+                         GList                   *files,
+                         NautilusSearchDirectory *self)
 {
-    GList list;
+    GList *changed;
+    GList *l;
+
+    changed = NULL;
+    for (l = files; l != NULL; l = l->next)
+    {
+        if (g_hash_table_contains (self->files_hash, l->data))
+        {
+            changed = g_list_prepend (changed, l->data);
+        }
+    }
+    changed = g_list_reverse (changed);
 
-    list.data = file;
-    list.next = NULL;
+    nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (self), changed);
 
-    nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (self), &list);
+    g_list_free (changed);
 }
 
 static void
@@ -248,10 +314,8 @@ search_monitor_add (NautilusDirectory         *directory,
                     NautilusDirectoryCallback  callback,
                     gpointer                   callback_data)
 {
-    GList *list;
     SearchMonitor *monitor;
     NautilusSearchDirectory *self;
-    NautilusFile *file;
 
     self = NAUTILUS_SEARCH_DIRECTORY (directory);
 
@@ -267,13 +331,8 @@ search_monitor_add (NautilusDirectory         *directory,
         (*callback)(directory, self->files, callback_data);
     }
 
-    for (list = self->files; list != NULL; list = list->next)
-    {
-        file = list->data;
-
-        /* Add monitors */
-        nautilus_file_monitor_add (file, monitor, file_attributes);
-    }
+    /* Add monitors */
+    nautilus_file_list_monitor_add (self->files, monitor, file_attributes);
 
     start_search (self);
 }
@@ -282,15 +341,7 @@ static void
 search_monitor_remove_file_monitors (SearchMonitor           *monitor,
                                      NautilusSearchDirectory *self)
 {
-    GList *list;
-    NautilusFile *file;
-
-    for (list = self->files; list != NULL; list = list->next)
-    {
-        file = list->data;
-
-        nautilus_file_monitor_remove (file, monitor);
-    }
+    nautilus_file_list_monitor_remove (self->files, monitor);
 }
 
 static void
@@ -601,55 +652,249 @@ on_search_directory_search_ready_and_valid (NautilusSearchDirectory *self)
     self->search_ready_and_valid = TRUE;
 }
 
-static void
-search_engine_hits_added (NautilusSearchEngine    *engine,
-                          GList                   *hits,
-                          NautilusSearchDirectory *self)
+/* Checks a result of the running search against the narrower current
+ * query. Types and dates are only checked when @query is given, their
+ * file info must be loaded then.
+ */
+static gboolean
+file_matches_query (NautilusFile         *file,
+                    NautilusQueryMatcher *matcher,
+                    NautilusQuery        *query)
 {
-    GList *hit_list;
-    GList *file_list;
-    NautilusFile *file;
-    SearchMonitor *monitor;
-    GList *monitor_list;
-
-    file_list = NULL;
+    g_autofree gchar *name = NULL;
+    g_autofree gchar *mime_type = NULL;
+    g_autoptr (GPtrArray) date_range = NULL;
+    GList *mime_types;
+    GList *l;
+    gboolean found;
+    NautilusDateType date_type;
+    time_t date;
 
-    for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next)
+    name = nautilus_file_get_display_name (file);
+    if (nautilus_query_matcher_matches_string (matcher, name) < 0)
     {
-        NautilusSearchHit *hit = hit_list->data;
-        const char *uri;
+        return FALSE;
+    }
 
-        uri = nautilus_search_hit_get_uri (hit);
+    if (query == NULL)
+    {
+        return TRUE;
+    }
 
-        nautilus_search_hit_compute_scores (hit, self->query);
+    mime_types = nautilus_query_get_mime_types (query);
+    if (mime_types != NULL)
+    {
+        mime_type = nautilus_file_get_mime_type (file);
+        found = FALSE;
+        for (l = mime_types; l != NULL && !found; l = l->next)
+        {
+            found = g_content_type_is_a (mime_type, l->data);
+        }
+        g_list_free_full (mime_types, g_free);
 
-        file = nautilus_file_get_by_uri (uri);
-        nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
-        nautilus_file_set_search_fts_snippet (file, nautilus_search_hit_get_fts_snippet (hit));
+        if (!found)
+        {
+            return FALSE;
+        }
+    }
 
-        for (monitor_list = self->monitor_list; monitor_list; monitor_list = monitor_list->next)
+    date_range = nautilus_query_get_date_range (query);
+    if (date_range != NULL)
+    {
+        if (nautilus_query_get_search_type (query) == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
         {
-            monitor = monitor_list->data;
+            date_type = NAUTILUS_DATE_TYPE_ACCESSED;
+        }
+        else
+        {
+            date_type = NAUTILUS_DATE_TYPE_MODIFIED;
+        }
 
-            /* Add monitors */
-            nautilus_file_monitor_add (file, monitor, monitor->monitor_attributes);
+        if (!nautilus_file_get_date (file, date_type, &date) ||
+            !nautilus_file_date_in_between (date,
+                                            g_ptr_array_index (date_range, 0),
+                                            g_ptr_array_index (date_range, 1)))
+        {
+            return FALSE;
         }
+    }
 
-        g_signal_connect (file, "changed", G_CALLBACK (file_changed), self),
+    return TRUE;
+}
+
+/* Ranks the hit of @file with the narrower current query, rather than the
+ * one the running search was started with. Only the name match changes,
+ * the rank the provider gave is kept. Returns FALSE if its name does not
+ * match anymore.
+ */
+static gboolean
+rank_hit (NautilusSearchDirectory *self,
+          NautilusFile            *file,
+          NautilusSearchHit       *hit,
+          NautilusQueryMatcher    *matcher)
+{
+    g_autofree gchar *name = NULL;
+    gdouble rank;
+
+    name = nautilus_file_get_display_name (file);
+    rank = nautilus_query_matcher_matches_string (matcher, name);
+    if (rank < 0)
+    {
+        return FALSE;
+    }
+
+    nautilus_search_hit_set_fts_rank (hit, nautilus_search_hit_get_provider_rank (hit) + rank);
+    nautilus_search_hit_compute_scores (hit, self->query);
+    nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
+
+    return TRUE;
+}
+
+static void
+add_files_chunk (NautilusSearchDirectory *self)
+{
+    GList *file_list;
+    GList *monitor_list;
+    NautilusFile *file;
+    NautilusDirectory *directory;
+    SearchMonitor *monitor;
+    guint i;
+
+    file_list = NULL;
+    for (i = 0; i < FILES_ADDED_CHUNK_SIZE && !g_queue_is_empty (&self->pending_files); i++)
+    {
+        file = g_queue_pop_head (&self->pending_files);
+
+        directory = nautilus_file_get_directory (file);
+        if (directory != NULL && !g_hash_table_contains (self->directories, directory))
+        {
+            g_hash_table_add (self->directories, nautilus_directory_ref (directory));
+            g_signal_connect (directory, "files-changed",
+                              G_CALLBACK (directory_files_changed), self);
+        }
 
         file_list = g_list_prepend (file_list, file);
         g_hash_table_add (self->files_hash, file);
     }
+    file_list = g_list_reverse (file_list);
+
+    for (monitor_list = self->monitor_list; monitor_list; monitor_list = monitor_list->next)
+    {
+        monitor = monitor_list->data;
+
+        /* Add monitors */
+        nautilus_file_list_monitor_add (file_list, monitor, monitor->monitor_attributes);
+    }
 
-    self->files = g_list_concat (self->files, file_list);
+    /* Prepend, appending would walk all the results for every chunk */
+    self->files = g_list_concat (g_list_copy (file_list), self->files);
 
     nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (self), file_list);
 
+    g_list_free (file_list);
+}
+
+static gboolean
+add_files_idle_callback (gpointer user_data)
+{
+    NautilusSearchDirectory *self;
+    NautilusFile *file;
+    gint64 deadline;
+
+    self = NAUTILUS_SEARCH_DIRECTORY (user_data);
+
+    deadline = g_get_monotonic_time () + FILES_ADDED_TIME_SLICE;
+    do
+    {
+        add_files_chunk (self);
+    }
+    while (!g_queue_is_empty (&self->pending_files) &&
+           g_get_monotonic_time () < deadline);
+
     file = nautilus_directory_get_corresponding_file (NAUTILUS_DIRECTORY (self));
     nautilus_file_emit_changed (file);
     nautilus_file_unref (file);
 
     search_directory_add_pending_files_callbacks (self);
+
+    if (!g_queue_is_empty (&self->pending_files))
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    self->add_files_idle_id = 0;
+
+    if (self->finish_pending)
+    {
+        self->finish_pending = FALSE;
+        on_search_directory_search_ready_and_valid (self);
+        nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (self));
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+search_engine_hits_added (NautilusSearchEngine    *engine,
+                          GList                   *hits,
+                          NautilusSearchDirectory *self)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    GList *uris;
+    GList *files;
+    GList *hit_list;
+    GList *file_list;
+    NautilusFile *file;
+
+    /* Only the text can be narrower, see refine_search() */
+    if (self->refined)
+    {
+        matcher = nautilus_query_get_matcher (self->query);
+    }
+
+    uris = NULL;
+    for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next)
+    {
+        uris = g_list_prepend (uris, (gpointer) nautilus_search_hit_get_uri (hit_list->data));
+    }
+    uris = g_list_reverse (uris);
+
+    files = nautilus_file_get_by_uris (uris);
+
+    for (hit_list = hits, file_list = files;
+         hit_list != NULL && file_list != NULL;
+         hit_list = hit_list->next, file_list = file_list->next)
+    {
+        NautilusSearchHit *hit = hit_list->data;
+
+        file = file_list->data;
+        if (matcher != NULL)
+        {
+            if (!rank_hit (self, file, hit, matcher))
+            {
+                nautilus_file_unref (file);
+                continue;
+            }
+        }
+        else
+        {
+            nautilus_search_hit_compute_scores (hit, self->query);
+            nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
+        }
+
+        g_hash_table_insert (self->hits, nautilus_file_ref (file), g_object_ref (hit));
+        nautilus_file_set_search_fts_snippet (file, nautilus_search_hit_get_fts_snippet (hit));
+
+        g_queue_push_tail (&self->pending_files, file);
+    }
+
+    g_list_free (files);
+    g_list_free (uris);
+
+    if (self->add_files_idle_id == 0 && !g_queue_is_empty (&self->pending_files))
+    {
+        self->add_files_idle_id = g_idle_add (add_files_idle_callback, self);
+    }
 }
 
 static void
@@ -681,6 +926,13 @@ search_engine_finished (NautilusSearchEngine         *engine,
      * happening. */
     if (status == NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL)
     {
+        /* Wait until the clients got all the files */
+        if (self->add_files_idle_id != 0)
+        {
+            self->finish_pending = TRUE;
+            return;
+        }
+
         on_search_directory_search_ready_and_valid (self);
         nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (self));
     }
@@ -706,6 +958,7 @@ search_force_reload (NautilusDirectory *directory)
     }
 
     self->search_ready_and_valid = FALSE;
+    self->refining = FALSE;
 
     /* Remove file monitors */
     reset_file_list (self);
@@ -905,6 +1158,8 @@ search_dispose (GObject *object)
     }
 
     g_clear_object (&self->query);
+    g_clear_object (&self->search_query);
+    self->refining = FALSE;
     stop_search (self);
     search_disconnect_engine (self);
 
@@ -921,6 +1176,8 @@ search_finalize (GObject *object)
     self = NAUTILUS_SEARCH_DIRECTORY (object);
 
     g_hash_table_destroy (self->files_hash);
+    g_hash_table_destroy (self->hits);
+    g_hash_table_destroy (self->directories);
 
     G_OBJECT_CLASS (nautilus_search_directory_parent_class)->finalize (object);
 }
@@ -930,6 +1187,11 @@ nautilus_search_directory_init (NautilusSearchDirectory *self)
 {
     self->query = NULL;
     self->files_hash = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->hits = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        (GDestroyNotify) nautilus_file_unref,
+                                        g_object_unref);
+    g_queue_init (&self->pending_files);
+    self->directories = g_hash_table_new (g_direct_hash, g_direct_equal);
 
     self->engine = nautilus_search_engine_new ();
     search_connect_engine (self);
@@ -1033,6 +1295,96 @@ nautilus_search_directory_generate_new_uri (void)
     return uri;
 }
 
+/* When the new query only narrows the running search down, the results
+ * found so far are filtered instead of walking everything again. The
+ * clients reload the directory after setting the query, the search is
+ * kept running through that.
+ */
+static void
+refine_search (NautilusSearchDirectory *self)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    NautilusQuery *filters;
+    gboolean text_only;
+    GList *l;
+    GList *next;
+    GList *removed;
+    GList *monitor_list;
+    NautilusFile *file;
+
+    if (!self->search_running || self->search_query == NULL ||
+        !nautilus_query_refines (self->query, self->search_query, &text_only))
+    {
+        return;
+    }
+
+    /* Types and dates need the file info, which the hits still to come
+     * don't have yet.
+     */
+    if (!text_only)
+    {
+        if (!self->search_ready_and_valid || !g_queue_is_empty (&self->pending_files))
+        {
+            return;
+        }
+
+        for (l = self->files; l != NULL; l = l->next)
+        {
+            if (!nautilus_file_check_if_ready (l->data, NAUTILUS_FILE_ATTRIBUTE_INFO))
+            {
+                return;
+            }
+        }
+    }
+
+    matcher = nautilus_query_get_matcher (self->query);
+    filters = text_only ? NULL : self->query;
+
+    removed = NULL;
+    for (l = self->files; l != NULL; l = next)
+    {
+        next = l->next;
+        file = l->data;
+
+        if (file_matches_query (file, matcher, filters) &&
+            rank_hit (self, file, g_hash_table_lookup (self->hits, file), matcher))
+        {
+            continue;
+        }
+
+        g_hash_table_remove (self->files_hash, file);
+        g_hash_table_remove (self->hits, file);
+        self->files = g_list_remove_link (self->files, l);
+        removed = g_list_concat (l, removed);
+    }
+
+    for (monitor_list = self->monitor_list; monitor_list != NULL;
+         monitor_list = monitor_list->next)
+    {
+        nautilus_file_list_monitor_remove (removed, monitor_list->data);
+    }
+    nautilus_file_list_free (removed);
+
+    /* Only the text is narrower when files are pending */
+    for (l = self->pending_files.head; l != NULL; l = next)
+    {
+        next = l->next;
+        file = l->data;
+
+        if (!rank_hit (self, file, g_hash_table_lookup (self->hits, file), matcher))
+        {
+            g_hash_table_remove (self->hits, file);
+            g_queue_delete_link (&self->pending_files, l);
+            nautilus_file_unref (file);
+        }
+    }
+
+    g_clear_object (&self->search_query);
+    self->search_query = nautilus_query_copy (self->query);
+    self->refined = TRUE;
+    self->refining = TRUE;
+}
+
 void
 nautilus_search_directory_set_query (NautilusSearchDirectory *self,
                                      NautilusQuery           *query)
@@ -1060,6 +1412,11 @@ nautilus_search_directory_set_query (NautilusSearchDirectory *self,
         g_clear_object (&old_query);
     }
 
+    if (query != NULL)
+    {
+        refine_search (self);
+    }
+
     file = nautilus_directory_get_existing_corresponding_file (NAUTILUS_DIRECTORY (self));
     if (file != NULL)
     {
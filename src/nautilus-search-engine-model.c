@@ -130,6 +130,7 @@ model_directory_ready_cb (NautilusDirectory *directory,
                           gpointer           user_data)
 {
     NautilusSearchEngineModel *model = user_data;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
     gchar *uri, *display_name;
     GList *files, *hits, *mime_types, *l, *m;
     NautilusFile *file;
@@ -141,6 +142,7 @@ model_directory_ready_cb (NautilusDirectory *directory,
     GPtrArray *date_range;
 
     files = nautilus_directory_get_file_list (directory);
+    matcher = nautilus_query_get_matcher (model->query);
     mime_types = nautilus_query_get_mime_types (model->query);
     hits = NULL;
 
@@ -149,7 +151,7 @@ model_directory_ready_cb (NautilusDirectory *directory,
         file = l->data;
 
         display_name = nautilus_file_get_display_name (file);
-        match = nautilus_query_matches_string (model->query, display_name);
+        match = nautilus_query_matcher_matches_string (matcher, display_name);
         found = (match > -1);
 
         if (found && mime_types)
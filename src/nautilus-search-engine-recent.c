@@ -185,6 +185,7 @@ recent_thread_func (gpointer user_data)
     NautilusSearchEngineRecent *self = NAUTILUS_SEARCH_ENGINE_RECENT (user_data);
     g_autoptr (GPtrArray) date_range = NULL;
     g_autoptr (GFile) query_location = NULL;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
     GList *recent_items;
     GList *mime_types;
     GList *hits;
@@ -197,6 +198,7 @@ recent_thread_func (gpointer user_data)
     mime_types = nautilus_query_get_mime_types (self->query);
     date_range = nautilus_query_get_date_range (self->query);
     query_location = nautilus_query_get_location (self->query);
+    matcher = nautilus_query_get_matcher (self->query);
 
     for (l = recent_items; l != NULL; l = l->next)
     {
@@ -242,12 +244,12 @@ recent_thread_func (gpointer user_data)
         }
 
         name = gtk_recent_info_get_display_name (info);
-        rank = nautilus_query_matches_string (self->query, name);
+        rank = nautilus_query_matcher_matches_string (matcher, name);
 
         if (rank <= 0)
         {
             g_autofree char *short_name = gtk_recent_info_get_short_name (info);
-            rank = nautilus_query_matches_string (self->query, short_name);
+            rank = nautilus_query_matcher_matches_string (matcher, short_name);
         }
 
         if (rank > 0)
@@ -22,6 +22,8 @@
 #include <config.h>
 #include "nautilus-search-engine-simple.h"
 
+#include "nautilus-filename-index.h"
+#include "nautilus-global-preferences.h"
 #include "nautilus-search-engine-private.h"
 #include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
@@ -35,6 +37,14 @@
 
 #define BATCH_SIZE 500
 
+/* Upper bound for the number of directory walker threads, to avoid
+ * drowning the disk in concurrent requests on machines with many cores.
+ */
+#define MAX_WALKERS 16
+
+/* How long an idle walker sleeps before checking for cancellation again. */
+#define WALKER_IDLE_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
 enum
 {
     PROP_0,
@@ -42,7 +52,27 @@ enum
     NUM_PROPERTIES
 };
 
+typedef struct _SearchThreadData SearchThreadData;
+
+/* Each walker thread owns a queue of directories still to visit. It pushes
+ * the subdirectories it finds to the tail of its own queue and pops from
+ * there as well, walking depth first. Idle walkers steal from the head of
+ * the other queues, where the biggest remaining subtrees are.
+ */
 typedef struct
+{
+    SearchThreadData *data;
+    GThread *thread;
+    guint index;
+
+    GMutex directories_lock;
+    GQueue directories;     /* GFiles */
+
+    gint n_processed_files;
+    GList *hits;
+} SearchWalker;
+
+struct _SearchThreadData
 {
     NautilusSearchEngineSimple *engine;
     GCancellable *cancellable;
@@ -50,17 +80,28 @@ typedef struct
     GList *mime_types;
     GList *found_list;
 
-    GQueue *directories;     /* GFiles */
+    SearchWalker *walkers;
+    guint n_walkers;
 
+    /* Directories that are either queued or being visited. The search is
+     * done once this drops to zero.
+     */
+    gint n_pending_directories;
+    /* Directories sitting in one of the walker queues. */
+    gint n_queued_directories;
+    gint n_idle_walkers;
+    GMutex idle_lock;
+    GCond idle_cond;
+
+    GMutex visited_lock;
     GHashTable *visited;
 
-    gint n_processed_files;
-    GList *hits;
-
     NautilusQuery *query;
-} SearchThreadData;
-
+    NautilusQueryMatcher *matcher;
 
+    /* Folders it covers are searched there instead of walked */
+    NautilusFilenameIndex *index;
+};
 struct _NautilusSearchEngineSimple
 {
     GObject parent_instance;
@@ -86,23 +127,55 @@ finalize (GObject *object)
     G_OBJECT_CLASS (nautilus_search_engine_simple_parent_class)->finalize (object);
 }
 
+static guint
+get_n_walkers (void)
+{
+    guint n_walkers;
+
+    n_walkers = g_settings_get_uint (nautilus_preferences,
+                                     NAUTILUS_PREFERENCES_SEARCH_THREADS);
+    if (n_walkers == 0)
+    {
+        n_walkers = g_get_num_processors ();
+    }
+
+    return CLAMP (n_walkers, 1, MAX_WALKERS);
+}
+
 static SearchThreadData *
 search_thread_data_new (NautilusSearchEngineSimple *engine,
                         NautilusQuery              *query)
 {
     SearchThreadData *data;
     GFile *location;
+    guint i;
 
     data = g_new0 (SearchThreadData, 1);
 
     data->engine = g_object_ref (engine);
-    data->directories = g_queue_new ();
     data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    g_mutex_init (&data->visited_lock);
+    g_mutex_init (&data->idle_lock);
+    g_cond_init (&data->idle_cond);
     data->query = g_object_ref (query);
+    data->matcher = nautilus_query_get_matcher (query);
+    data->index = nautilus_filename_index_get_default ();
+
+    data->n_walkers = get_n_walkers ();
+    data->walkers = g_new0 (SearchWalker, data->n_walkers);
+    for (i = 0; i < data->n_walkers; i++)
+    {
+        data->walkers[i].data = data;
+        data->walkers[i].index = i;
+        g_mutex_init (&data->walkers[i].directories_lock);
+        g_queue_init (&data->walkers[i].directories);
+    }
 
     location = nautilus_query_get_location (query);
 
-    g_queue_push_tail (data->directories, location);
+    g_queue_push_tail (&data->walkers[0].directories, location);
+    data->n_pending_directories = 1;
+    data->n_queued_directories = 1;
     data->mime_types = nautilus_query_get_mime_types (query);
 
     data->cancellable = g_cancellable_new ();
@@ -113,14 +186,27 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 static void
 search_thread_data_free (SearchThreadData *data)
 {
-    g_queue_foreach (data->directories,
-                     (GFunc) g_object_unref, NULL);
-    g_queue_free (data->directories);
+    SearchWalker *walker;
+    guint i;
+
+    for (i = 0; i < data->n_walkers; i++)
+    {
+        walker = &data->walkers[i];
+        g_queue_foreach (&walker->directories,
+                         (GFunc) g_object_unref, NULL);
+        g_queue_clear (&walker->directories);
+        g_mutex_clear (&walker->directories_lock);
+        g_list_free_full (walker->hits, g_object_unref);
+    }
+    g_free (data->walkers);
     g_hash_table_destroy (data->visited);
+    g_mutex_clear (&data->visited_lock);
+    g_mutex_clear (&data->idle_lock);
+    g_cond_clear (&data->idle_cond);
     g_object_unref (data->cancellable);
     g_object_unref (data->query);
+    nautilus_query_matcher_unref (data->matcher);
     g_list_free_full (data->mime_types, g_free);
-    g_list_free_full (data->hits, g_object_unref);
     g_object_unref (data->engine);
 
     g_free (data);
@@ -177,20 +263,131 @@ search_thread_add_hits_idle (gpointer user_data)
 }
 
 static void
-send_batch (SearchThreadData *thread_data)
+send_batch (SearchWalker *walker)
 {
     SearchHitsData *data;
 
-    thread_data->n_processed_files = 0;
+    walker->n_processed_files = 0;
 
-    if (thread_data->hits)
+    if (walker->hits)
     {
         data = g_new (SearchHitsData, 1);
-        data->hits = thread_data->hits;
-        data->thread_data = thread_data;
+        data->hits = walker->hits;
+        data->thread_data = walker->data;
         g_idle_add (search_thread_add_hits_idle, data);
     }
-    thread_data->hits = NULL;
+    walker->hits = NULL;
+}
+
+/* Returns TRUE if the directory with the given G_FILE_ATTRIBUTE_ID_FILE was
+ * not visited before, and marks it as visited. The set is shared by all
+ * walkers, so that each directory is only walked once even when reachable
+ * through several bind mounts.
+ */
+static gboolean
+mark_visited (SearchThreadData *data,
+              const char       *id)
+{
+    gboolean visited;
+
+    g_mutex_lock (&data->visited_lock);
+    visited = g_hash_table_contains (data->visited, id);
+    if (!visited)
+    {
+        g_hash_table_add (data->visited, g_strdup (id));
+    }
+    g_mutex_unlock (&data->visited_lock);
+
+    return !visited;
+}
+
+static void
+push_directory (SearchWalker *walker,
+                GFile        *dir)
+{
+    SearchThreadData *data = walker->data;
+
+    g_atomic_int_inc (&data->n_pending_directories);
+
+    g_mutex_lock (&walker->directories_lock);
+    g_queue_push_tail (&walker->directories, g_object_ref (dir));
+    g_mutex_unlock (&walker->directories_lock);
+
+    g_atomic_int_inc (&data->n_queued_directories);
+    if (g_atomic_int_get (&data->n_idle_walkers) > 0)
+    {
+        g_mutex_lock (&data->idle_lock);
+        g_cond_signal (&data->idle_cond);
+        g_mutex_unlock (&data->idle_lock);
+    }
+}
+
+static GFile *
+pop_directory (SearchWalker *walker)
+{
+    SearchThreadData *data = walker->data;
+    SearchWalker *victim;
+    GFile *dir;
+    guint i;
+
+    g_mutex_lock (&walker->directories_lock);
+    dir = g_queue_pop_tail (&walker->directories);
+    g_mutex_unlock (&walker->directories_lock);
+
+    for (i = 1; dir == NULL && i < data->n_walkers; i++)
+    {
+        victim = &data->walkers[(walker->index + i) % data->n_walkers];
+
+        g_mutex_lock (&victim->directories_lock);
+        dir = g_queue_pop_head (&victim->directories);
+        g_mutex_unlock (&victim->directories_lock);
+    }
+
+    if (dir != NULL)
+    {
+        g_atomic_int_add (&data->n_queued_directories, -1);
+    }
+
+    return dir;
+}
+
+static void
+directory_done (SearchWalker *walker)
+{
+    SearchThreadData *data = walker->data;
+
+    if (g_atomic_int_dec_and_test (&data->n_pending_directories))
+    {
+        g_mutex_lock (&data->idle_lock);
+        g_cond_broadcast (&data->idle_cond);
+        g_mutex_unlock (&data->idle_lock);
+    }
+}
+
+/* Wait until there is a directory to steal, returns FALSE if the
+ * search is over.
+ */
+static gboolean
+wait_for_directories (SearchWalker *walker)
+{
+    SearchThreadData *data = walker->data;
+    gboolean has_work;
+
+    g_mutex_lock (&data->idle_lock);
+    g_atomic_int_inc (&data->n_idle_walkers);
+    while (g_atomic_int_get (&data->n_queued_directories) == 0 &&
+           g_atomic_int_get (&data->n_pending_directories) > 0 &&
+           !g_cancellable_is_cancelled (data->cancellable))
+    {
+        g_cond_wait_until (&data->idle_cond, &data->idle_lock,
+                           g_get_monotonic_time () + WALKER_IDLE_TIMEOUT);
+    }
+    g_atomic_int_add (&data->n_idle_walkers, -1);
+    has_work = g_atomic_int_get (&data->n_pending_directories) > 0 &&
+               !g_cancellable_is_cancelled (data->cancellable);
+    g_mutex_unlock (&data->idle_lock);
+
+    return has_work;
 }
 
 #define STD_ATTRIBUTES \
@@ -204,9 +401,10 @@ send_batch (SearchThreadData *thread_data)
     G_FILE_ATTRIBUTE_ID_FILE
 
 static void
-visit_directory (GFile            *dir,
-                 SearchThreadData *data)
+visit_directory (GFile        *dir,
+                 SearchWalker *walker)
 {
+    SearchThreadData *data = walker->data;
     g_autoptr (GPtrArray) date_range = NULL;
     NautilusQuerySearchType type;
     NautilusQueryRecursive recursive;
@@ -218,13 +416,23 @@ visit_directory (GFile            *dir,
     gboolean is_hidden, found;
     GList *l;
     const char *id;
-    gboolean visited;
     guint64 atime;
     guint64 mtime;
     GDateTime *initial_date;
     GDateTime *end_date;
     gchar *uri;
 
+    if (nautilus_filename_index_covers (data->index, dir))
+    {
+        walker->hits = g_list_concat (nautilus_filename_index_search (data->index, dir,
+                                                                      data->query,
+                                                                      data->matcher,
+                                                                      data->cancellable),
+                                      walker->hits);
+        send_batch (walker);
+        return;
+    }
+
     enumerator = g_file_enumerate_children (dir,
                                             data->mime_types != NULL ?
                                             STD_ATTRIBUTES ","
@@ -259,7 +467,7 @@ visit_directory (GFile            *dir,
         }
 
         child = g_file_get_child (dir, g_file_info_get_name (info));
-        match = nautilus_query_matches_string (data->query, display_name);
+        match = nautilus_query_matcher_matches_string (data->matcher, display_name);
         found = (match > -1);
 
         if (found && data->mime_types)
@@ -313,13 +521,13 @@ visit_directory (GFile            *dir,
             nautilus_search_hit_set_modification_time (hit, date);
             g_date_time_unref (date);
 
-            data->hits = g_list_prepend (data->hits, hit);
+            walker->hits = g_list_prepend (walker->hits, hit);
         }
 
-        data->n_processed_files++;
-        if (data->n_processed_files > BATCH_SIZE)
+        walker->n_processed_files++;
+        if (walker->n_processed_files > BATCH_SIZE)
         {
-            send_batch (data);
+            send_batch (walker);
         }
 
         if (recursive != NAUTILUS_QUERY_RECURSIVE_NEVER &&
@@ -328,23 +536,9 @@ visit_directory (GFile            *dir,
                                  recursive, child))
         {
             id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-            visited = FALSE;
-            if (id)
-            {
-                if (g_hash_table_lookup_extended (data->visited,
-                                                  id, NULL, NULL))
-                {
-                    visited = TRUE;
-                }
-                else
-                {
-                    g_hash_table_insert (data->visited, g_strdup (id), NULL);
-                }
-            }
-
-            if (!visited)
+            if (id == NULL || mark_visited (data, id))
             {
-                g_queue_push_tail (data->directories, g_object_ref (child));
+                push_directory (walker, child);
             }
         }
 
@@ -357,6 +551,33 @@ next:
 }
 
 
+static gpointer
+search_walker_func (gpointer user_data)
+{
+    SearchWalker *walker = user_data;
+    SearchThreadData *data = walker->data;
+    GFile *dir;
+
+    do
+    {
+        while (!g_cancellable_is_cancelled (data->cancellable) &&
+               (dir = pop_directory (walker)) != NULL)
+        {
+            visit_directory (dir, walker);
+            g_object_unref (dir);
+            directory_done (walker);
+        }
+    }
+    while (wait_for_directories (walker));
+
+    if (!g_cancellable_is_cancelled (data->cancellable))
+    {
+        send_batch (walker);
+    }
+
+    return NULL;
+}
+
 static gpointer
 search_thread_func (gpointer user_data)
 {
@@ -364,34 +585,40 @@ search_thread_func (gpointer user_data)
     GFile *dir;
     GFileInfo *info;
     const char *id;
+    guint i;
 
     data = user_data;
 
     /* Insert id for toplevel directory into visited */
-    dir = g_queue_peek_head (data->directories);
+    dir = g_queue_peek_head (&data->walkers[0].directories);
     info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
     if (info)
     {
         id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
         if (id)
         {
-            g_hash_table_insert (data->visited, g_strdup (id), NULL);
+            g_hash_table_add (data->visited, g_strdup (id));
         }
         g_object_unref (info);
     }
 
-    while (!g_cancellable_is_cancelled (data->cancellable) &&
-           (dir = g_queue_pop_head (data->directories)) != NULL)
+    DEBUG ("Simple engine walking with %u threads", data->n_walkers);
+
+    for (i = 1; i < data->n_walkers; i++)
     {
-        visit_directory (dir, data);
-        g_object_unref (dir);
+        data->walkers[i].thread = g_thread_new ("nautilus-search-simple-walker",
+                                                search_walker_func,
+                                                &data->walkers[i]);
     }
 
-    if (!g_cancellable_is_cancelled (data->cancellable))
+    search_walker_func (&data->walkers[0]);
+
+    for (i = 1; i < data->n_walkers; i++)
     {
-        send_batch (data);
+        g_thread_join (data->walkers[i].thread);
     }
 
+    /* All the hits have been queued by now, so this idle runs after them. */
     g_idle_add (search_thread_done_idle, data);
 
     return NULL;
@@ -207,6 +207,7 @@ cursor_callback (GObject      *object,
 
     hit = nautilus_search_hit_new (uri);
     match = nautilus_query_matches_string (tracker->query, basename);
+    nautilus_search_hit_set_provider_rank (hit, rank);
     nautilus_search_hit_set_fts_rank (hit, rank + match);
     g_free (basename);
 
@@ -36,6 +36,7 @@ struct _NautilusSearchHit
     GDateTime *modification_time;
     GDateTime *access_time;
     gdouble fts_rank;
+    gdouble provider_rank;
     gchar *fts_snippet;
 
     gdouble relevance;
@@ -166,6 +167,12 @@ nautilus_search_hit_get_fts_snippet (NautilusSearchHit *hit)
     return hit->fts_snippet;
 }
 
+gdouble
+nautilus_search_hit_get_provider_rank (NautilusSearchHit *hit)
+{
+    return hit->provider_rank;
+}
+
 static void
 nautilus_search_hit_set_uri (NautilusSearchHit *hit,
                              const char        *uri)
@@ -181,6 +188,16 @@ nautilus_search_hit_set_fts_rank (NautilusSearchHit *hit,
     hit->fts_rank = rank;
 }
 
+/* The part of the rank that comes from the search provider itself rather
+ * than from matching the name, which the rank includes.
+ */
+void
+nautilus_search_hit_set_provider_rank (NautilusSearchHit *hit,
+                                       gdouble            rank)
+{
+    hit->provider_rank = rank;
+}
+
 void
 nautilus_search_hit_set_modification_time (NautilusSearchHit *hit,
                                            GDateTime         *date)
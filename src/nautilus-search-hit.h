@@ -32,6 +32,8 @@ NautilusSearchHit * nautilus_search_hit_new                   (const char
 
 void                nautilus_search_hit_set_fts_rank          (NautilusSearchHit *hit,
 							       gdouble            fts_rank);
+void                nautilus_search_hit_set_provider_rank     (NautilusSearchHit *hit,
+							       gdouble            provider_rank);
 void                nautilus_search_hit_set_modification_time (NautilusSearchHit *hit,
 							       GDateTime         *date);
 void                nautilus_search_hit_set_access_time       (NautilusSearchHit *hit,
@@ -44,5 +46,6 @@ void                nautilus_search_hit_compute_scores        (NautilusSearchHit
 const char *        nautilus_search_hit_get_uri               (NautilusSearchHit *hit);
 gdouble             nautilus_search_hit_get_relevance         (NautilusSearchHit *hit);
 const gchar *       nautilus_search_hit_get_fts_snippet       (NautilusSearchHit *hit);
+gdouble             nautilus_search_hit_get_provider_rank     (NautilusSearchHit *hit);
 
 G_END_DECLS
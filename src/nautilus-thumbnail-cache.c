@@ -0,0 +1,276 @@
+/* nautilus-thumbnail-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-thumbnail-cache.h"
+
+#include <string.h>
+
+#include "nautilus-global-preferences.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_THUMBNAILS
+#include "nautilus-debug.h"
+
+#define MEGA_TO_BASE_RATE 1048576
+
+typedef struct
+{
+    char *path;
+    time_t mtime;
+    int size;
+    int scale;
+} ThumbnailCacheKey;
+
+typedef struct
+{
+    ThumbnailCacheKey key;
+    GdkPixbuf *pixbuf;
+    gsize n_bytes;
+} ThumbnailCacheEntry;
+
+typedef struct
+{
+    /* ThumbnailCacheKey -> link in lru */
+    GHashTable *entries;
+    /* Most recently used first */
+    GQueue lru;
+    gsize size;
+    gsize budget;
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+} ThumbnailCache;
+
+static ThumbnailCache *cache = NULL;
+
+static guint
+thumbnail_cache_key_hash (gconstpointer data)
+{
+    const ThumbnailCacheKey *key = data;
+
+    return g_str_hash (key->path) ^
+           (guint) key->mtime ^
+           (guint) (key->size * 31 + key->scale);
+}
+
+static gboolean
+thumbnail_cache_key_equal (gconstpointer a,
+                           gconstpointer b)
+{
+    const ThumbnailCacheKey *key_a = a;
+    const ThumbnailCacheKey *key_b = b;
+
+    return key_a->mtime == key_b->mtime &&
+           key_a->size == key_b->size &&
+           key_a->scale == key_b->scale &&
+           strcmp (key_a->path, key_b->path) == 0;
+}
+
+static void
+thumbnail_cache_entry_free (ThumbnailCacheEntry *entry)
+{
+    g_free (entry->key.path);
+    g_object_unref (entry->pixbuf);
+    g_free (entry);
+}
+
+static void
+thumbnail_cache_remove_link (GList *link)
+{
+    ThumbnailCacheEntry *entry;
+
+    entry = link->data;
+    g_hash_table_remove (cache->entries, &entry->key);
+    g_queue_delete_link (&cache->lru, link);
+    cache->size -= entry->n_bytes;
+    thumbnail_cache_entry_free (entry);
+}
+
+static void
+thumbnail_cache_evict (void)
+{
+    while (cache->size > cache->budget && !g_queue_is_empty (&cache->lru))
+    {
+        thumbnail_cache_remove_link (g_queue_peek_tail_link (&cache->lru));
+        cache->evictions++;
+    }
+}
+
+static void
+thumbnail_cache_size_changed_callback (gpointer user_data)
+{
+    cache->budget = (gsize) g_settings_get_uint (nautilus_preferences,
+                                                 NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE) * MEGA_TO_BASE_RATE;
+    thumbnail_cache_evict ();
+}
+
+/* The scaled thumbnails are only framed in the old views, don't keep the
+ * other kind around when switching.
+ */
+static void
+use_experimental_views_changed_callback (gpointer user_data)
+{
+    ThumbnailCacheEntry *entry;
+    GList *link, *next;
+
+    for (link = g_queue_peek_head_link (&cache->lru); link != NULL; link = next)
+    {
+        next = link->next;
+        entry = link->data;
+
+        if (entry->key.size != 0)
+        {
+            thumbnail_cache_remove_link (link);
+        }
+    }
+}
+
+static ThumbnailCache *
+get_cache (void)
+{
+    if (cache == NULL)
+    {
+        cache = g_new0 (ThumbnailCache, 1);
+        cache->entries = g_hash_table_new (thumbnail_cache_key_hash,
+                                           thumbnail_cache_key_equal);
+        g_queue_init (&cache->lru);
+
+        thumbnail_cache_size_changed_callback (NULL);
+        g_signal_connect_swapped (nautilus_preferences,
+                                  "changed::" NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE,
+                                  G_CALLBACK (thumbnail_cache_size_changed_callback),
+                                  NULL);
+        g_signal_connect_swapped (nautilus_preferences,
+                                  "changed::" NAUTILUS_PREFERENCES_USE_EXPERIMENTAL_VIEWS,
+                                  G_CALLBACK (use_experimental_views_changed_callback),
+                                  NULL);
+    }
+
+    return cache;
+}
+
+GdkPixbuf *
+nautilus_thumbnail_cache_lookup (const char *path,
+                                 time_t      mtime,
+                                 int         size,
+                                 int         scale)
+{
+    ThumbnailCacheKey key;
+    ThumbnailCacheEntry *entry;
+    GList *link;
+
+    g_return_val_if_fail (path != NULL, NULL);
+
+    get_cache ();
+
+    key.path = (char *) path;
+    key.mtime = mtime;
+    key.size = size;
+    key.scale = scale;
+
+    link = g_hash_table_lookup (cache->entries, &key);
+    if (link == NULL)
+    {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+
+    /* Most recently used */
+    g_queue_unlink (&cache->lru, link);
+    g_queue_push_head_link (&cache->lru, link);
+
+    entry = link->data;
+
+    return g_object_ref (entry->pixbuf);
+}
+
+void
+nautilus_thumbnail_cache_insert (const char *path,
+                                 time_t      mtime,
+                                 int         size,
+                                 int         scale,
+                                 GdkPixbuf  *pixbuf)
+{
+    ThumbnailCacheEntry *entry;
+    ThumbnailCacheKey key;
+    GList *link;
+    gsize n_bytes;
+
+    g_return_if_fail (path != NULL);
+    g_return_if_fail (GDK_IS_PIXBUF (pixbuf));
+
+    get_cache ();
+
+    key.path = (char *) path;
+    key.mtime = mtime;
+    key.size = size;
+    key.scale = scale;
+
+    link = g_hash_table_lookup (cache->entries, &key);
+    if (link != NULL)
+    {
+        thumbnail_cache_remove_link (link);
+    }
+
+    n_bytes = sizeof (ThumbnailCacheEntry) + gdk_pixbuf_get_byte_length (pixbuf);
+    if (n_bytes > cache->budget)
+    {
+        DEBUG ("Not caching thumbnail %s, it is larger than the budget", path);
+        return;
+    }
+
+    entry = g_new0 (ThumbnailCacheEntry, 1);
+    entry->key.path = g_strdup (path);
+    entry->key.mtime = mtime;
+    entry->key.size = size;
+    entry->key.scale = scale;
+    entry->pixbuf = g_object_ref (pixbuf);
+    entry->n_bytes = n_bytes;
+
+    g_queue_push_head (&cache->lru, entry);
+    g_hash_table_insert (cache->entries, &entry->key, g_queue_peek_head_link (&cache->lru));
+    cache->size += n_bytes;
+
+    thumbnail_cache_evict ();
+}
+
+void
+nautilus_thumbnail_cache_clear (void)
+{
+    get_cache ();
+
+    while (!g_queue_is_empty (&cache->lru))
+    {
+        thumbnail_cache_remove_link (g_queue_peek_head_link (&cache->lru));
+    }
+}
+
+void
+nautilus_thumbnail_cache_get_stats (NautilusThumbnailCacheStats *stats)
+{
+    g_return_if_fail (stats != NULL);
+
+    get_cache ();
+
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->n_entries = g_queue_get_length (&cache->lru);
+    stats->size = cache->size;
+    stats->budget = cache->budget;
+}
@@ -0,0 +1,57 @@
+/* nautilus-thumbnail-cache.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <time.h>
+
+G_BEGIN_DECLS
+
+/* The thumbnail pixbufs of all the files, loaded and scaled, live in one
+ * cache for the whole process. It is kept under the thumbnail-cache-size
+ * budget by dropping the least recently used ones. Entries are keyed by
+ * the thumbnail path and mtime, plus the largest dimension and the scale
+ * factor of the scaled versions. The thumbnail as loaded uses a size and
+ * scale of 0.
+ *
+ * Only use it from the main thread.
+ */
+
+typedef struct
+{
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+    guint n_entries;
+    gsize size;
+    gsize budget;
+} NautilusThumbnailCacheStats;
+
+/* Returns a new reference, or NULL if the thumbnail is not in the cache. */
+GdkPixbuf *nautilus_thumbnail_cache_lookup    (const char *path,
+                                               time_t      mtime,
+                                               int         size,
+                                               int         scale);
+void       nautilus_thumbnail_cache_insert    (const char *path,
+                                               time_t      mtime,
+                                               int         size,
+                                               int         scale,
+                                               GdkPixbuf  *pixbuf);
+void       nautilus_thumbnail_cache_clear     (void);
+void       nautilus_thumbnail_cache_get_stats (NautilusThumbnailCacheStats *stats);
+
+G_END_DECLS
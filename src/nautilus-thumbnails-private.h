@@ -0,0 +1,27 @@
+/*
+   nautilus-thumbnails-private.h: Thumbnail hooks for the tests.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Makes the thumbnail threads call @func instead of the thumbnailers, so
+   that the tests don't depend on the ones installed. %NULL goes back to
+   the thumbnailers. */
+typedef GdkPixbuf *(*NautilusThumbnailGenerateFunc) (const char *uri,
+                                                     const char *mime_type);
+void       nautilus_thumbnail_set_generate_func     (NautilusThumbnailGenerateFunc func);
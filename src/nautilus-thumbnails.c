@@ -22,6 +22,7 @@
 
 #include <config.h>
 #include "nautilus-thumbnails.h"
+#include "nautilus-thumbnails-private.h"
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 
@@ -44,6 +45,7 @@
 #define DEBUG_FLAG NAUTILUS_DEBUG_THUMBNAILS
 #include "nautilus-debug.h"
 
+#include "nautilus-directory-private.h"
 #include "nautilus-file-private.h"
 
 /* Should never be a reasonable actual mtime */
@@ -52,10 +54,10 @@
 /* Cool-off period between last file modification time and thumbnail creation */
 #define THUMBNAIL_CREATION_DELAY_SECS 3
 
-static void thumbnail_thread_func (GTask        *task,
-                                   gpointer      source_object,
-                                   gpointer      task_data,
-                                   GCancellable *cancellable);
+/* Upper bound for the number of thumbnail threads, whatever the preference says */
+#define MAX_THUMBNAIL_THREADS 16
+
+static gpointer thumbnail_thread_func (gpointer data);
 
 /* structure used for making thumbnails, associating a uri with where the thumbnail is to be stored */
 
@@ -64,35 +66,60 @@ typedef struct
     char *image_uri;
     char *mime_type;
     time_t original_file_mtime;
+    /* Index in mime_type_limits, or -1 if the mime type has no limit */
+    int mime_type_limit;
+    /* Whether a thumbnail thread is making it. Lock thumbnails_mutex when
+     * accessing this. */
+    gboolean in_progress;
 } NautilusThumbnailInfo;
 
+/* Some thumbnailers are a lot heavier than others, decoding video or
+ *  rendering documents for instance. Don't let them take all the threads,
+ *  so that cheap thumbnails keep coming in meanwhile. */
+typedef struct
+{
+    const char *mime_type_prefix;
+    guint max_threads;
+} ThumbnailMimeTypeLimit;
+
+static const ThumbnailMimeTypeLimit mime_type_limits[] =
+{
+    { "video/", 2 },
+    { "application/", 2 },
+};
+
 /*
  * Thumbnail thread state.
  */
 
-/* The id of the idle handler used to start the thumbnail thread, or 0 if no
+/* The id of the idle handler used to start the thumbnail threads, or 0 if no
  *  idle handler is currently registered. */
 static guint thumbnail_thread_starter_id = 0;
 
 /* Our mutex used when accessing data shared between the main thread and the
- *  thumbnail thread, i.e. the thumbnail_thread_is_running flag and the
- *  thumbnails_to_make list. */
+ *  thumbnail threads, i.e. the thread counts and the thumbnails_to_make
+ *  list. */
 static GMutex thumbnails_mutex;
 
-/* A flag to indicate whether a thumbnail thread is running, so we don't
- *  start more than one. Lock thumbnails_mutex when accessing this. */
-static volatile gboolean thumbnail_thread_is_running = FALSE;
+/* The number of thumbnail threads running, so we don't start more than
+ *  the configured number. Lock thumbnails_mutex when accessing this. */
+static guint n_thumbnail_threads = 0;
+
+/* The number of thumbnail threads making a thumbnail for each of the
+ *  mime_type_limits. Lock thumbnails_mutex when accessing this. */
+static guint mime_type_limit_threads[G_N_ELEMENTS (mime_type_limits)];
 
 /* The list of NautilusThumbnailInfo structs containing information about the
  *  thumbnails we are making. Lock thumbnails_mutex when accessing this. */
 static volatile GQueue thumbnails_to_make = G_QUEUE_INIT;
 
-/* Quickly check if uri is in thumbnails_to_make list */
+/* Quickly check if uri is in thumbnails_to_make list. The thumbnails being
+ *  made stay in the list, with in_progress set, to avoid adding them
+ *  again. */
 static GHashTable *thumbnails_to_make_hash = NULL;
 
-/* The currently thumbnailed icon. it also exists in the thumbnails_to_make list
- * to avoid adding it again. Lock thumbnails_mutex when accessing this. */
-static NautilusThumbnailInfo *currently_thumbnailing = NULL;
+/* Called by the thumbnail threads instead of the thumbnailers, if set. */
+static NautilusThumbnailGenerateFunc thumbnail_generate_func = NULL;
 
 static gboolean
 get_file_mtime (const char *file_uri,
@@ -143,29 +170,100 @@ get_thumbnail_factory (void)
     return thumbnail_factory;
 }
 
+static guint
+get_max_thumbnail_threads (void)
+{
+    guint n_threads;
+
+    n_threads = g_settings_get_uint (nautilus_preferences,
+                                     NAUTILUS_PREFERENCES_THUMBNAIL_THREADS);
+    if (n_threads == 0)
+    {
+        n_threads = g_get_num_processors ();
+    }
+
+    return CLAMP (n_threads, 1, MAX_THUMBNAIL_THREADS);
+}
+
+static int
+get_mime_type_limit (const char *mime_type)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (mime_type_limits); i++)
+    {
+        if (g_str_has_prefix (mime_type, mime_type_limits[i].mime_type_prefix))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* The number of thumbnails no thread is making yet. Lock thumbnails_mutex
+ *  when calling this. */
+static guint
+get_n_thumbnails_waiting (void)
+{
+    guint n_thumbnails;
+
+    n_thumbnails = g_queue_get_length ((GQueue *) &thumbnails_to_make);
+
+    /* Each thread makes at most one thumbnail at a time. */
+    return n_thumbnails > n_thumbnail_threads ? n_thumbnails - n_thumbnail_threads : 0;
+}
 
 /* This function is added as a very low priority idle function to start the
- *  thread to create any needed thumbnails. It is added with a very low priority
+ *  threads to create any needed thumbnails. It is added with a very low priority
  *  so that it doesn't delay showing the directory in the icon/list views.
  *  We want to show the files in the directory as quickly as possible. */
 static gboolean
 thumbnail_thread_starter_cb (gpointer data)
 {
-    GTask *task;
-
-    DEBUG ("(Main Thread) Creating thumbnails thread\n");
-
-    /* We set a flag to indicate the thread is running, so we don't create
-     *  a new one. We don't need to lock a mutex here, as the thumbnail
-     *  thread isn't running yet. And we know we won't create the thread
-     *  twice, as we also check thumbnail_thread_starter_id before
-     *  scheduling this idle function. */
-    thumbnail_thread_is_running = TRUE;
-    task = g_task_new (NULL, NULL, NULL, NULL);
-    g_task_run_in_thread (task, thumbnail_thread_func);
+    GnomeDesktopThumbnailFactory *thumbnail_factory;
+    GThread *thread;
+    guint max_threads;
+    guint n_new_threads;
+    guint i;
+
+    /* Create the factory here, the threads must not race to do it. */
+    thumbnail_factory = get_thumbnail_factory ();
+    max_threads = get_max_thumbnail_threads ();
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    /*********************************
+     * MUTEX LOCKED
+     *********************************/
+
+    n_new_threads = 0;
+    if (n_thumbnail_threads < max_threads)
+    {
+        n_new_threads = MIN (max_threads - n_thumbnail_threads,
+                             get_n_thumbnails_waiting ());
+    }
+    n_thumbnail_threads += n_new_threads;
     thumbnail_thread_starter_id = 0;
 
-    g_object_unref (task);
+    /*********************************
+     * MUTEX UNLOCKED
+     *********************************/
+
+    g_mutex_unlock (&thumbnails_mutex);
+
+    DEBUG ("(Main Thread) Creating %u thumbnail threads\n", n_new_threads);
+
+    /* The threads spend most of their time waiting for thumbnailer
+     *  processes, so give them their own threads instead of holding on to
+     *  the GTask ones that the asynchronous I/O relies on. */
+    for (i = 0; i < n_new_threads; i++)
+    {
+        thread = g_thread_new ("nautilus-thumbnailer",
+                               thumbnail_thread_func,
+                               thumbnail_factory);
+        g_thread_unref (thread);
+    }
 
     return FALSE;
 }
@@ -187,7 +285,7 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
     {
         node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-        if (node && node->data != currently_thumbnailing)
+        if (node && !((NautilusThumbnailInfo *) node->data)->in_progress)
         {
             g_hash_table_remove (thumbnails_to_make_hash, file_uri);
             free_thumbnail_info (node->data);
@@ -221,7 +319,7 @@ nautilus_thumbnail_prioritize (const char *file_uri)
     {
         node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-        if (node && node->data != currently_thumbnailing)
+        if (node && !((NautilusThumbnailInfo *) node->data)->in_progress)
         {
             g_queue_unlink ((GQueue *) &thumbnails_to_make, node);
             g_queue_push_head_link ((GQueue *) &thumbnails_to_make, node);
@@ -237,6 +335,66 @@ nautilus_thumbnail_prioritize (const char *file_uri)
     g_mutex_unlock (&thumbnails_mutex);
 }
 
+void
+nautilus_thumbnail_remove_directory_from_queue (NautilusDirectory *directory)
+{
+    GList *l;
+    GList *node;
+    NautilusFile *file;
+    char *uri;
+
+    DEBUG ("(Remove directory from queue) Locking mutex\n");
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    /*********************************
+     * MUTEX LOCKED
+     *********************************/
+
+    for (l = directory->details->file_list; l != NULL && thumbnails_to_make_hash != NULL; l = l->next)
+    {
+        file = l->data;
+        if (!file->details->is_thumbnailing)
+        {
+            continue;
+        }
+
+        uri = nautilus_file_get_uri (file);
+        node = g_hash_table_lookup (thumbnails_to_make_hash, uri);
+
+        /* The ones being made are left to finish, their threads will
+         *  notify the file as usual. */
+        if (node && !((NautilusThumbnailInfo *) node->data)->in_progress)
+        {
+            g_hash_table_remove (thumbnails_to_make_hash, uri);
+            free_thumbnail_info (node->data);
+            g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+
+            /* Queue it again if the folder is shown again. */
+            nautilus_file_set_is_thumbnailing (file, FALSE);
+        }
+
+        g_free (uri);
+    }
+
+    /*********************************
+     * MUTEX UNLOCKED
+     *********************************/
+
+    DEBUG ("(Remove directory from queue) Unlocking mutex\n");
+
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
+
+void
+nautilus_thumbnail_set_generate_func (NautilusThumbnailGenerateFunc func)
+{
+    g_mutex_lock (&thumbnails_mutex);
+    thumbnail_generate_func = func;
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
 
 /***************************************************************************
  * Thumbnail Thread Functions.
@@ -355,6 +513,7 @@ nautilus_create_thumbnail (NautilusFile *file)
     NautilusThumbnailInfo *info;
     NautilusThumbnailInfo *existing_info;
     GList *existing, *node;
+    guint max_threads;
 
     nautilus_file_set_is_thumbnailing (file, TRUE);
 
@@ -376,7 +535,9 @@ nautilus_create_thumbnail (NautilusFile *file)
     }
 
     info->original_file_mtime = file_mtime;
+    info->mime_type_limit = get_mime_type_limit (info->mime_type);
 
+    max_threads = get_max_thumbnail_threads ();
 
     DEBUG ("(Main Thread) Locking mutex\n");
 
@@ -404,11 +565,12 @@ nautilus_create_thumbnail (NautilusFile *file)
         g_hash_table_insert (thumbnails_to_make_hash,
                              info->image_uri,
                              node);
-        /* If the thumbnail thread isn't running, and we haven't
-         *  scheduled an idle function to start it up, do that now.
-         *  We don't want to start it until all the other work is done,
-         *  so the GUI will be updated as quickly as possible.*/
-        if (thumbnail_thread_is_running == FALSE &&
+        /* If there are fewer thumbnail threads than thumbnails waiting,
+         *  and we haven't scheduled an idle function to start more, do
+         *  that now. We don't want to start them until all the other work
+         *  is done, so the GUI will be updated as quickly as possible.*/
+        if (n_thumbnail_threads < max_threads &&
+            get_n_thumbnails_waiting () > 0 &&
             thumbnail_thread_starter_id == 0)
         {
             thumbnail_thread_starter_id = g_idle_add_full (G_PRIORITY_LOW, thumbnail_thread_starter_cb, NULL, NULL);
@@ -434,12 +596,47 @@ nautilus_create_thumbnail (NautilusFile *file)
     g_mutex_unlock (&thumbnails_mutex);
 }
 
-/* thumbnail_thread is invoked as a separate thread to to make thumbnails. */
-static void
-thumbnail_thread_func (GTask        *task,
-                       gpointer      source_object,
-                       gpointer      task_data,
-                       GCancellable *cancellable)
+/* Takes the first thumbnail in the list that no other thread is making, and
+ *  whose mime type isn't at its limit. Lock thumbnails_mutex when calling
+ *  this. */
+static NautilusThumbnailInfo *
+take_next_thumbnail_to_make (void)
+{
+    NautilusThumbnailInfo *info;
+    GList *l;
+
+    for (l = g_queue_peek_head_link ((GQueue *) &thumbnails_to_make); l != NULL; l = l->next)
+    {
+        info = l->data;
+
+        if (info->in_progress)
+        {
+            continue;
+        }
+
+        if (info->mime_type_limit >= 0 &&
+            mime_type_limit_threads[info->mime_type_limit] >= mime_type_limits[info->mime_type_limit].max_threads)
+        {
+            continue;
+        }
+
+        info->in_progress = TRUE;
+        if (info->mime_type_limit >= 0)
+        {
+            mime_type_limit_threads[info->mime_type_limit]++;
+        }
+
+        return info;
+    }
+
+    return NULL;
+}
+
+/* thumbnail_thread is invoked as a separate thread to to make thumbnails.
+ *  Several of them run at once, each taking the next thumbnail off the
+ *  list until there is nothing left for it to make. */
+static gpointer
+thumbnail_thread_func (gpointer data)
 {
     GnomeDesktopThumbnailFactory *thumbnail_factory;
     NautilusThumbnailInfo *info = NULL;
@@ -447,8 +644,9 @@ thumbnail_thread_func (GTask        *task,
     time_t current_orig_mtime = 0;
     time_t current_time;
     GList *node;
+    NautilusThumbnailGenerateFunc generate_func;
 
-    thumbnail_factory = get_thumbnail_factory ();
+    thumbnail_factory = data;
 
     /* We loop until there are no more thumbails to make, at which point
      *  we exit the thread. */
@@ -462,43 +660,49 @@ thumbnail_thread_func (GTask        *task,
          * MUTEX LOCKED
          *********************************/
 
-        /* Pop the last thumbnail we just made off the head of the
-         *  list and free it. I did this here so we only have to lock
-         *  the mutex once per thumbnail, rather than once before
-         *  creating it and once after.
+        /* Pop the last thumbnail we just made off the list and free it.
+         *  I did this here so we only have to lock the mutex once per
+         *  thumbnail, rather than once before creating it and once after.
          *  Don't pop the thumbnail off the queue if the original file
          *  mtime of the request changed. Then we need to redo the thumbnail.
          */
-        if (currently_thumbnailing &&
-            currently_thumbnailing->original_file_mtime == current_orig_mtime)
+        if (info != NULL)
         {
-            g_assert (info == currently_thumbnailing);
-            node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-            g_assert (node != NULL);
-            g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
-            free_thumbnail_info (info);
-            g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            info->in_progress = FALSE;
+            if (info->mime_type_limit >= 0)
+            {
+                mime_type_limit_threads[info->mime_type_limit]--;
+            }
+
+            if (info->original_file_mtime == current_orig_mtime)
+            {
+                node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
+                g_assert (node != NULL);
+                g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
+                free_thumbnail_info (info);
+                g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            }
         }
-        currently_thumbnailing = NULL;
 
-        /* If there are no more thumbnails to make, reset the
-         *  thumbnail_thread_is_running flag, unlock the mutex, and
-         *  exit the thread. */
-        if (g_queue_is_empty ((GQueue *) &thumbnails_to_make))
+        /* Get the next one to make. We leave it on the list until it
+         *  is created so the main thread doesn't add it again while we
+         *  are creating it. */
+        info = take_next_thumbnail_to_make ();
+
+        /* If there is nothing left for us to make, unlock the mutex and
+         *  exit the thread. Thumbnails held back by their mime type limit
+         *  are picked up by the threads still making the others. */
+        if (info == NULL)
         {
             DEBUG ("(Thumbnail Thread) Exiting\n");
 
-            thumbnail_thread_is_running = FALSE;
+            n_thumbnail_threads--;
             g_mutex_unlock (&thumbnails_mutex);
-            return;
+            return NULL;
         }
 
-        /* Get the next one to make. We leave it on the list until it
-         *  is created so the main thread doesn't add it again while we
-         *  are creating it. */
-        info = g_queue_peek_head ((GQueue *) &thumbnails_to_make);
-        currently_thumbnailing = info;
         current_orig_mtime = info->original_file_mtime;
+        generate_func = thumbnail_generate_func;
         /*********************************
          * MUTEX UNLOCKED
          *********************************/
@@ -527,9 +731,16 @@ thumbnail_thread_func (GTask        *task,
         DEBUG ("(Thumbnail Thread) Creating thumbnail: %s\n",
                  info->image_uri);
 
-        pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
-                                                                     info->image_uri,
-                                                                     info->mime_type);
+        if (generate_func != NULL)
+        {
+            pixbuf = generate_func (info->image_uri, info->mime_type);
+        }
+        else
+        {
+            pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
+                                                                         info->image_uri,
+                                                                         info->mime_type);
+        }
 
         if (pixbuf)
         {
@@ -96,6 +96,17 @@ vfs_file_monitor_remove (NautilusDirectory *directory,
     nautilus_directory_monitor_remove_internal (directory, NULL, client);
 }
 
+static void
+vfs_file_monitor_set_viewport (NautilusDirectory *directory,
+                               gconstpointer      client,
+                               GList             *files)
+{
+    g_assert (NAUTILUS_IS_VFS_DIRECTORY (directory));
+    g_assert (client != NULL);
+
+    nautilus_directory_monitor_set_viewport (directory, client, files);
+}
+
 static void
 vfs_force_reload (NautilusDirectory *directory)
 {
@@ -117,5 +128,6 @@ nautilus_vfs_directory_class_init (NautilusVFSDirectoryClass *klass)
     directory_class->cancel_callback = vfs_cancel_callback;
     directory_class->file_monitor_add = vfs_file_monitor_add;
     directory_class->file_monitor_remove = vfs_file_monitor_remove;
+    directory_class->file_monitor_set_viewport = vfs_file_monitor_set_viewport;
     directory_class->force_reload = vfs_force_reload;
 }
@@ -22,6 +22,11 @@ struct _NautilusViewIconController
     gint zoom_level;
 
     GtkGesture *multi_press_gesture;
+
+    /* File -> whether it is still shown, for the files that changed since
+     * "begin-file-changes". They are applied to the model in one go.
+     */
+    GHashTable *pending_changes;
 };
 
 G_DEFINE_TYPE (NautilusViewIconController, nautilus_view_icon_controller, NAUTILUS_TYPE_FILES_VIEW)
@@ -252,27 +257,56 @@ real_clear (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
 
+    g_hash_table_remove_all (self->pending_changes);
     nautilus_view_model_remove_all_items (self->model);
 }
 
-
 /* FIXME: ideally this should go into the model so there is not need to
  * recreate the model with the new data */
+static void
+apply_pending_changes (NautilusViewIconController *self)
+{
+    g_autoptr (GQueue) removed_items = NULL;
+    g_autoptr (GQueue) added_items = NULL;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    NautilusViewItemModel *item_model;
+
+    removed_items = g_queue_new ();
+    added_items = g_queue_new ();
+    g_hash_table_iter_init (&iter, self->pending_changes);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        item_model = nautilus_view_model_get_item_from_file (self->model, key);
+        if (item_model != NULL)
+        {
+            g_queue_push_tail (removed_items, item_model);
+        }
+
+        if (GPOINTER_TO_INT (value))
+        {
+            g_queue_push_tail (added_items,
+                               nautilus_view_item_model_new (key,
+                                                             get_icon_size_for_zoom_level (self->zoom_level)));
+        }
+    }
+    g_hash_table_remove_all (self->pending_changes);
+
+    nautilus_view_model_remove_items (self->model, removed_items);
+    nautilus_view_model_add_items (self->model, added_items);
+    g_queue_foreach (added_items, (GFunc) g_object_unref, NULL);
+}
+
 static void
 real_file_changed (NautilusFilesView *files_view,
                    NautilusFile      *file,
                    NautilusDirectory *directory)
 {
-    NautilusViewIconController *self;
-    NautilusViewItemModel *item_model;
-    NautilusViewItemModel *new_item_model;
+    NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
 
-    self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    item_model = nautilus_view_model_get_item_from_file (self->model, file);
-    nautilus_view_model_remove_item (self->model, item_model);
-    new_item_model = nautilus_view_item_model_new (file,
-                                                   get_icon_size_for_zoom_level (self->zoom_level));
-    nautilus_view_model_add_item (self->model, new_item_model);
+    g_hash_table_insert (self->pending_changes, nautilus_file_ref (file),
+                         GINT_TO_POINTER (TRUE));
 }
 
 static GList *
@@ -308,6 +342,9 @@ real_is_empty (NautilusFilesView *files_view)
 static void
 real_end_file_changes (NautilusFilesView *files_view)
 {
+    NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
+
+    apply_pending_changes (self);
 }
 
 static void
@@ -316,20 +353,9 @@ real_remove_file (NautilusFilesView *files_view,
                   NautilusDirectory *directory)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    NautilusFile *current_file;
-    NautilusViewItemModel *current_item_model;
-    guint i = 0;
 
-    while ((current_item_model = NAUTILUS_VIEW_ITEM_MODEL (g_list_model_get_item (G_LIST_MODEL (nautilus_view_model_get_g_model (self->model)), i))))
-    {
-        current_file = nautilus_view_item_model_get_file (current_item_model);
-        if (current_file == file)
-        {
-            g_list_store_remove (nautilus_view_model_get_g_model (self->model), i);
-            break;
-        }
-        i++;
-    }
+    g_hash_table_insert (self->pending_changes, nautilus_file_ref (file),
+                         GINT_TO_POINTER (FALSE));
 }
 
 static GQueue *
@@ -958,6 +984,12 @@ dispose (GObject *object)
 static void
 finalize (GObject *object)
 {
+    NautilusViewIconController *self;
+
+    self = NAUTILUS_VIEW_ICON_CONTROLLER (object);
+
+    g_hash_table_destroy (self->pending_changes);
+
     G_OBJECT_CLASS (nautilus_view_icon_controller_parent_class)->finalize (object);
 }
 
@@ -983,6 +1015,9 @@ constructed (GObject *object)
     vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (content_widget));
 
     self->model = nautilus_view_model_new ();
+    self->pending_changes = g_hash_table_new_full (NULL, NULL,
+                                                   (GDestroyNotify) nautilus_file_unref,
+                                                   NULL);
     self->view_ui = nautilus_view_icon_ui_new (self);
     gtk_flow_box_set_hadjustment (GTK_FLOW_BOX (self->view_ui), hadjustment);
     gtk_flow_box_set_vadjustment (GTK_FLOW_BOX (self->view_ui), vadjustment);
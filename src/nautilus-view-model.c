@@ -9,6 +9,13 @@ struct _NautilusViewModel
     GHashTable *map_files_to_model;
     GListStore *internal_model;
     NautilusViewModelSortData *sort_data;
+
+    /* Item -> position in internal_model, so lookups don't need to scan
+     * the store. Only the positions below positions_valid_until are up to
+     * date; the rest is indexed again on the next lookup that needs it.
+     */
+    GHashTable *map_items_to_position;
+    guint positions_valid_until;
 };
 
 G_DEFINE_TYPE (NautilusViewModel, nautilus_view_model, G_TYPE_OBJECT)
@@ -29,6 +36,7 @@ finalize (GObject *object)
     G_OBJECT_CLASS (nautilus_view_model_parent_class)->finalize (object);
 
     g_hash_table_destroy (self->map_files_to_model);
+    g_hash_table_destroy (self->map_items_to_position);
     if (self->sort_data)
     {
         g_free (self->sort_data);
@@ -97,6 +105,7 @@ constructed (GObject *object)
 
     self->internal_model = g_list_store_new (NAUTILUS_TYPE_VIEW_ITEM_MODEL);
     self->map_files_to_model = g_hash_table_new (NULL, NULL);
+    self->map_items_to_position = g_hash_table_new (NULL, NULL);
 }
 
 static void
@@ -133,12 +142,116 @@ compare_data_func (gconstpointer a,
                                            self->sort_data->reversed);
 }
 
+/* Items were inserted or removed at @position, which moves the ones after it. */
+static void
+invalidate_positions (NautilusViewModel *self,
+                      guint              position)
+{
+    self->positions_valid_until = MIN (self->positions_valid_until, position);
+}
+
+static void
+index_positions (NautilusViewModel *self)
+{
+    GListModel *model = G_LIST_MODEL (self->internal_model);
+    guint n_items;
+    guint i;
+
+    n_items = g_list_model_get_n_items (model);
+    for (i = self->positions_valid_until; i < n_items; i++)
+    {
+        g_autoptr (NautilusViewItemModel) item = NULL;
+
+        item = g_list_model_get_item (model, i);
+        g_hash_table_insert (self->map_items_to_position, item, GUINT_TO_POINTER (i));
+    }
+    self->positions_valid_until = n_items;
+}
+
+static gboolean
+get_item_position (NautilusViewModel     *self,
+                   NautilusViewItemModel *item,
+                   guint                 *position)
+{
+    gpointer value;
+
+    if (!g_hash_table_lookup_extended (self->map_items_to_position, item, NULL, &value) ||
+        GPOINTER_TO_UINT (value) >= self->positions_valid_until)
+    {
+        index_positions (self);
+        if (!g_hash_table_lookup_extended (self->map_items_to_position, item, NULL, &value))
+        {
+            return FALSE;
+        }
+    }
+
+    *position = GPOINTER_TO_UINT (value);
+
+    return TRUE;
+}
+
+static gint
+compare_positions (gconstpointer a,
+                   gconstpointer b)
+{
+    guint position_a = *((const guint *) a);
+    guint position_b = *((const guint *) b);
+
+    return position_a < position_b ? 1 : position_a > position_b ? -1 : 0;
+}
+
 NautilusViewModel *
 nautilus_view_model_new ()
 {
     return g_object_new (NAUTILUS_TYPE_VIEW_MODEL, NULL);
 }
 
+/* Sorts by a snapshot of the sort keys, on several threads for large
+ * folders, and replaces the items with a single splice.
+ */
+static void
+sort_items (NautilusViewModel *self)
+{
+    GListModel *model = G_LIST_MODEL (self->internal_model);
+    g_autofree gpointer *items = NULL;
+    g_autofree gpointer *sorted_items = NULL;
+    g_autofree NautilusFile **files = NULL;
+    g_autofree int *new_order = NULL;
+    guint n_items;
+    guint i;
+
+    n_items = g_list_model_get_n_items (model);
+    if (n_items <= 1 || self->sort_data->sort_type == NAUTILUS_FILE_SORT_NONE)
+    {
+        return;
+    }
+
+    items = g_new (gpointer, n_items);
+    files = g_new (NautilusFile *, n_items);
+    for (i = 0; i < n_items; i++)
+    {
+        items[i] = g_list_model_get_item (model, i);
+        files[i] = nautilus_view_item_model_get_file (items[i]);
+    }
+
+    new_order = nautilus_file_sort_get_new_order (files, n_items,
+                                                  self->sort_data->sort_type,
+                                                  self->sort_data->directories_first,
+                                                  self->sort_data->reversed);
+
+    sorted_items = g_new (gpointer, n_items);
+    for (i = 0; i < n_items; i++)
+    {
+        sorted_items[i] = items[new_order[i]];
+    }
+
+    g_list_store_splice (self->internal_model, 0, n_items, sorted_items, n_items);
+    for (i = 0; i < n_items; i++)
+    {
+        g_object_unref (items[i]);
+    }
+}
+
 void
 nautilus_view_model_set_sort_type (NautilusViewModel         *self,
                                    NautilusViewModelSortData *sort_data)
@@ -153,7 +266,8 @@ nautilus_view_model_set_sort_type (NautilusViewModel         *self,
     self->sort_data->reversed = sort_data->reversed;
     self->sort_data->directories_first = sort_data->directories_first;
 
-    g_list_store_sort (self->internal_model, compare_data_func, self);
+    sort_items (self);
+    invalidate_positions (self, 0);
 }
 
 NautilusViewModelSortData *
@@ -179,26 +293,10 @@ nautilus_view_model_get_items_from_files (NautilusViewModel *self,
     item_models = g_queue_new ();
     for (l = g_queue_peek_head_link (files); l != NULL; l = l->next)
     {
-        NautilusFile *file1;
-        gint i = 0;
-
-        file1 = NAUTILUS_FILE (l->data);
-        while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+        item_model = g_hash_table_lookup (self->map_files_to_model, l->data);
+        if (item_model != NULL)
         {
-            NautilusFile *file2;
-            g_autofree gchar *file1_uri = NULL;
-            g_autofree gchar *file2_uri = NULL;
-
-            file2 = nautilus_view_item_model_get_file (item_model);
-            file1_uri = nautilus_file_get_uri (file1);
-            file2_uri = nautilus_file_get_uri (file2);
-            if (g_strcmp0 (file1_uri, file2_uri) == 0)
-            {
-                g_queue_push_tail (item_models, item_model);
-                break;
-            }
-
-            i++;
+            g_queue_push_tail (item_models, item_model);
         }
     }
 
@@ -216,29 +314,74 @@ void
 nautilus_view_model_remove_item (NautilusViewModel     *self,
                                  NautilusViewItemModel *item)
 {
-    NautilusViewItemModel *item_model;
-    gint i;
+    guint position;
 
-    i = 0;
-    item_model = NULL;
-    while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+    if (item == NULL || !get_item_position (self, item, &position))
+    {
+        return;
+    }
+
+    g_hash_table_remove (self->map_files_to_model,
+                         nautilus_view_item_model_get_file (item));
+    g_hash_table_remove (self->map_items_to_position, item);
+    g_list_store_remove (self->internal_model, position);
+    invalidate_positions (self, position);
+}
+
+void
+nautilus_view_model_remove_items (NautilusViewModel *self,
+                                  GQueue            *items)
+{
+    g_autoptr (GArray) positions = NULL;
+    GList *l;
+    guint position;
+    guint i;
+    guint run_length;
+
+    positions = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+                                   g_queue_get_length (items));
+    for (l = g_queue_peek_head_link (items); l != NULL; l = l->next)
     {
-        if (item_model == item)
+        if (get_item_position (self, l->data, &position))
         {
-            break;
+            g_array_append_val (positions, position);
+            g_hash_table_remove (self->map_files_to_model,
+                                 nautilus_view_item_model_get_file (l->data));
         }
+    }
 
-        i++;
+    if (positions->len == 0)
+    {
+        return;
+    }
+
+    /* Only once all positions are known, so they are looked up in one pass */
+    for (l = g_queue_peek_head_link (items); l != NULL; l = l->next)
+    {
+        g_hash_table_remove (self->map_items_to_position, l->data);
     }
 
-    if (item_model != NULL)
+    /* Remove from the back, so the positions stay valid, and coalesce
+     * adjacent items into one splice to keep "items-changed" to a minimum.
+     */
+    g_array_sort (positions, compare_positions);
+    for (i = 0; i < positions->len; i += run_length)
     {
-        NautilusFile *file;
+        position = g_array_index (positions, guint, i);
+        run_length = 1;
+        while (i + run_length < positions->len &&
+               g_array_index (positions, guint, i + run_length) == position - run_length)
+        {
+            run_length++;
+        }
 
-        file = nautilus_view_item_model_get_file (item_model);
-        g_list_store_remove (self->internal_model, i);
-        g_hash_table_remove (self->map_files_to_model, file);
+        g_list_store_splice (self->internal_model,
+                             position - run_length + 1, run_length,
+                             NULL, 0);
     }
+
+    /* The positions are sorted from the back */
+    invalidate_positions (self, g_array_index (positions, guint, positions->len - 1));
 }
 
 void
@@ -246,16 +389,62 @@ nautilus_view_model_remove_all_items (NautilusViewModel *self)
 {
     g_list_store_remove_all (self->internal_model);
     g_hash_table_remove_all (self->map_files_to_model);
+    g_hash_table_remove_all (self->map_items_to_position);
+    self->positions_valid_until = 0;
+}
+
+static gint
+compare_data_func_indirect (gconstpointer a,
+                            gconstpointer b,
+                            gpointer      user_data)
+{
+    return compare_data_func (*((gconstpointer *) a), *((gconstpointer *) b), user_data);
+}
+
+/* Returns the position after all items in [low, high) that sort before or
+ * equal to @item, like g_list_store_insert_sorted() would pick.
+ */
+static guint
+find_insert_position (NautilusViewModel     *self,
+                      NautilusViewItemModel *item,
+                      guint                  low,
+                      guint                  high)
+{
+    GListModel *model = G_LIST_MODEL (self->internal_model);
+    guint middle;
+
+    while (low < high)
+    {
+        g_autoptr (NautilusViewItemModel) middle_item = NULL;
+
+        middle = low + (high - low) / 2;
+        middle_item = g_list_model_get_item (model, middle);
+        if (compare_data_func (item, middle_item, self) < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    return low;
 }
 
 void
 nautilus_view_model_add_item (NautilusViewModel     *self,
                               NautilusViewItemModel *item)
 {
+    guint position;
+
     g_hash_table_insert (self->map_files_to_model,
                          nautilus_view_item_model_get_file (item),
                          item);
-    g_list_store_insert_sorted (self->internal_model, item, compare_data_func, self);
+    position = find_insert_position (self, item, 0,
+                                     g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)));
+    g_list_store_insert (self->internal_model, position, item);
+    invalidate_positions (self, position);
 }
 
 void
@@ -263,11 +452,16 @@ nautilus_view_model_add_items (NautilusViewModel *self,
                                GQueue            *items)
 {
     g_autofree gpointer *array = NULL;
+    GListModel *model = G_LIST_MODEL (self->internal_model);
     GList *l;
-    int i = 0;
+    guint n_new;
+    guint n_items;
+    guint position;
+    guint run_start;
+    guint i = 0;
 
-    array = g_malloc_n (g_queue_get_length (items),
-                        sizeof (NautilusViewItemModel *));
+    n_new = g_queue_get_length (items);
+    array = g_malloc_n (n_new, sizeof (NautilusViewItemModel *));
 
     for (l = g_queue_peek_head_link (items); l != NULL; l = l->next)
     {
@@ -278,9 +472,44 @@ nautilus_view_model_add_items (NautilusViewModel *self,
         i++;
     }
 
-    g_list_store_splice (self->internal_model,
-                         g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)),
-                         0, array, g_queue_get_length (items));
+    /* Only sort the new items, then merge them into the already sorted
+     * store. Each run of new items that ends up between the same two
+     * existing items is inserted with a single splice, so the views get
+     * one "items-changed" per run instead of a reordering of everything.
+     */
+    g_qsort_with_data (array, n_new, sizeof (gpointer),
+                       compare_data_func_indirect, self);
 
-    g_list_store_sort (self->internal_model, compare_data_func, self);
+    position = 0;
+    i = 0;
+    while (i < n_new)
+    {
+        n_items = g_list_model_get_n_items (model);
+        position = find_insert_position (self, array[i], position, n_items);
+        run_start = i;
+        i++;
+
+        if (position < n_items)
+        {
+            g_autoptr (NautilusViewItemModel) next_item = NULL;
+
+            next_item = g_list_model_get_item (model, position);
+            while (i < n_new && compare_data_func (array[i], next_item, self) < 0)
+            {
+                i++;
+            }
+        }
+        else
+        {
+            i = n_new;
+        }
+
+        g_list_store_splice (self->internal_model, position, 0,
+                             array + run_start, i - run_start);
+        if (run_start == 0)
+        {
+            invalidate_positions (self, position);
+        }
+        position += i - run_start;
+    }
 }
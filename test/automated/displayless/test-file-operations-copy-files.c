@@ -1,5 +1,23 @@
 #include "test-utilities.h"
 
+#include <src/nautilus-copy-journal.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define SPARSE_FILE_SIZE (64 * 1024 * 1024)
+#define REFLINK_IMAGE_SIZE (512 * 1024 * 1024)
+#define REFLINK_FILE_SIZE (64 * 1024 * 1024)
+#define RESUME_FILE_SIZE (1024 * 1024)
+
+#define BENCHMARK_DIRECTORIES 10
+#define BENCHMARK_FILES 1000
+#define BENCHMARK_FILE_SIZE 4096
+
 static void
 test_copy_one_file (void)
 {
@@ -1242,6 +1260,514 @@ test_copy_fourth_hierarchy_undo (void)
     empty_directory_by_prefix (root, "copy");
 }
 
+static void
+assert_same_contents (GFile *first,
+                      GFile *second)
+{
+    g_autofree gchar *first_contents = NULL;
+    g_autofree gchar *second_contents = NULL;
+    gsize first_length;
+    gsize second_length;
+
+    g_assert_true (g_file_load_contents (first, NULL, &first_contents, &first_length, NULL, NULL));
+    g_assert_true (g_file_load_contents (second, NULL, &second_contents, &second_length, NULL, NULL));
+    g_assert_cmpuint (first_length, ==, second_length);
+    g_assert_true (memcmp (first_contents, second_contents, first_length) == 0);
+}
+
+/* Some data at the start and in the middle, holes elsewhere */
+static void
+create_sparse_file (const gchar *path)
+{
+    int fd;
+
+    fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    g_assert_cmpint (fd, >=, 0);
+    g_assert_cmpint (pwrite (fd, "start", 5, 0), ==, 5);
+    g_assert_cmpint (pwrite (fd, "middle", 6, SPARSE_FILE_SIZE / 2), ==, 6);
+    g_assert_cmpint (ftruncate (fd, SPARSE_FILE_SIZE), ==, 0);
+    close (fd);
+}
+
+static void
+test_copy_sparse_file (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) first_dir = NULL;
+    g_autoptr (GFile) second_dir = NULL;
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GFile) result_file = NULL;
+    g_autolist (GFile) files = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *result_path = NULL;
+    struct stat file_stat;
+    struct stat result_stat;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    g_assert_true (root != NULL);
+
+    first_dir = g_file_get_child (root, "copy_sparse_first_dir");
+    g_file_make_directory (first_dir, NULL, NULL);
+    file = g_file_get_child (first_dir, "copy_sparse_file");
+    path = g_file_get_path (file);
+    create_sparse_file (path);
+    files = g_list_prepend (files, g_object_ref (file));
+
+    second_dir = g_file_get_child (root, "copy_sparse_second_dir");
+    g_file_make_directory (second_dir, NULL, NULL);
+
+    nautilus_file_operations_copy_sync (files,
+                                        second_dir);
+
+    result_file = g_file_get_child (second_dir, "copy_sparse_file");
+    result_path = g_file_get_path (result_file);
+    g_assert_cmpint (stat (path, &file_stat), ==, 0);
+    g_assert_cmpint (stat (result_path, &result_stat), ==, 0);
+    g_assert_cmpint (result_stat.st_size, ==, SPARSE_FILE_SIZE);
+    g_assert_cmpint (result_stat.st_mode, ==, file_stat.st_mode);
+    assert_same_contents (file, result_file);
+
+    /* Only if the file system has holes to begin with */
+    if (file_stat.st_blocks * 512 < SPARSE_FILE_SIZE / 2)
+    {
+        g_assert_cmpint (result_stat.st_blocks * 512, <, SPARSE_FILE_SIZE / 2);
+    }
+
+    empty_directory_by_prefix (root, "copy_sparse");
+}
+
+static gboolean
+run_command (gchar **argv)
+{
+    gint status;
+
+    if (!g_spawn_sync (NULL, argv, NULL,
+                       G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                       NULL, NULL, NULL, NULL, &status, NULL))
+    {
+        return FALSE;
+    }
+
+    return g_spawn_check_exit_status (status, NULL);
+}
+
+static guint64
+get_free_space (const gchar *path)
+{
+    struct statvfs fs_stat;
+    int fd;
+
+    fd = open (path, O_RDONLY | O_DIRECTORY);
+    g_assert_cmpint (fd, >=, 0);
+    syncfs (fd);
+    close (fd);
+
+    g_assert_cmpint (statvfs (path, &fs_stat), ==, 0);
+
+    return (guint64) fs_stat.f_bavail * fs_stat.f_frsize;
+}
+
+/* Copies a file within a btrfs file system on a loop device, where the
+ * copy should share the data with the source instead of taking space.
+ * Only run with -m thorough.
+ */
+static void
+test_copy_reflink_loopback (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) mount_point = NULL;
+    g_autoptr (GFile) first_dir = NULL;
+    g_autoptr (GFile) second_dir = NULL;
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GFile) result_file = NULL;
+    g_autolist (GFile) files = NULL;
+    g_autofree gchar *mkfs = NULL;
+    g_autofree gchar *image_path = NULL;
+    g_autofree gchar *mount_path = NULL;
+    g_autofree gchar *contents = NULL;
+    gchar *mkfs_argv[] = { "mkfs.btrfs", "-q", NULL, NULL };
+    gchar *mount_argv[] = { "mount", "-o", "loop", NULL, NULL, NULL };
+    gchar *umount_argv[] = { "umount", NULL, NULL };
+    guint64 free_space;
+    int fd;
+
+    mkfs = g_find_program_in_path ("mkfs.btrfs");
+    if (getuid () != 0 || mkfs == NULL)
+    {
+        g_test_skip ("Mounting a loopback btrfs file system needs root and mkfs.btrfs");
+        return;
+    }
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    image_path = g_build_filename (g_get_tmp_dir (), "copy_reflink_image", NULL);
+    mount_point = g_file_get_child (root, "copy_reflink_mount");
+    mount_path = g_file_get_path (mount_point);
+
+    fd = open (image_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    g_assert_cmpint (fd, >=, 0);
+    g_assert_cmpint (ftruncate (fd, REFLINK_IMAGE_SIZE), ==, 0);
+    close (fd);
+    g_file_make_directory (mount_point, NULL, NULL);
+
+    mkfs_argv[2] = image_path;
+    mount_argv[3] = image_path;
+    mount_argv[4] = mount_path;
+    umount_argv[1] = mount_path;
+    if (!run_command (mkfs_argv) || !run_command (mount_argv))
+    {
+        empty_directory_by_prefix (root, "copy_reflink");
+        g_test_skip ("Could not mount a loopback btrfs file system");
+        return;
+    }
+
+    first_dir = g_file_get_child (mount_point, "copy_reflink_first_dir");
+    g_file_make_directory (first_dir, NULL, NULL);
+    file = g_file_get_child (first_dir, "copy_reflink_file");
+    contents = g_malloc (REFLINK_FILE_SIZE);
+    for (gsize i = 0; i < REFLINK_FILE_SIZE; i++)
+    {
+        contents[i] = i % 251;
+    }
+    g_assert_true (g_file_replace_contents (file, contents, REFLINK_FILE_SIZE,
+                                            NULL, FALSE, G_FILE_CREATE_NONE,
+                                            NULL, NULL, NULL));
+    files = g_list_prepend (files, g_object_ref (file));
+
+    second_dir = g_file_get_child (mount_point, "copy_reflink_second_dir");
+    g_file_make_directory (second_dir, NULL, NULL);
+
+    free_space = get_free_space (mount_path);
+    nautilus_file_operations_copy_sync (files,
+                                        second_dir);
+
+    result_file = g_file_get_child (second_dir, "copy_reflink_file");
+    assert_same_contents (file, result_file);
+    g_assert_cmpuint (get_free_space (mount_path) + REFLINK_FILE_SIZE / 2, >, free_space);
+
+    g_clear_object (&file);
+    g_clear_object (&result_file);
+    g_clear_object (&first_dir);
+    g_clear_object (&second_dir);
+    g_assert_true (run_command (umount_argv));
+    empty_directory_by_prefix (root, "copy_reflink");
+}
+
+/* The folder and one of its children are both selected, so the copy gets
+ * to the child twice while it is only scanned once.
+ */
+static void
+test_copy_overlapping_hierarchy (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) first_dir = NULL;
+    g_autoptr (GFile) second_dir = NULL;
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GFile) result_file = NULL;
+    g_autolist (GFile) files = NULL;
+
+    create_first_hierarchy ("copy");
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    g_assert_true (root != NULL);
+
+    first_dir = g_file_get_child (root, "copy_first_dir");
+    g_assert_true (first_dir != NULL);
+
+    file = g_file_get_child (first_dir, "copy_first_child");
+    g_assert_true (file != NULL);
+    files = g_list_prepend (files, g_object_ref (file));
+    files = g_list_prepend (files, g_object_ref (first_dir));
+
+    second_dir = g_file_get_child (root, "copy_second_dir");
+    g_assert_true (second_dir != NULL);
+
+    nautilus_file_operations_copy_sync (files,
+                                        second_dir);
+
+    result_file = g_file_get_child (second_dir, "copy_first_dir");
+    g_assert_true (g_file_query_exists (result_file, NULL));
+    file = g_file_get_child (result_file, "copy_first_child");
+    g_assert_true (g_file_query_exists (file, NULL));
+    file = g_file_get_child (result_file, "copy_second_child");
+    g_assert_true (g_file_query_exists (file, NULL));
+
+    file = g_file_get_child (second_dir, "copy_first_child");
+    g_assert_true (g_file_query_exists (file, NULL));
+
+    empty_directory_by_prefix (root, "copy");
+}
+
+static void
+create_benchmark_hierarchy (GFile *location)
+{
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) file = NULL;
+    g_autofree gchar *contents = NULL;
+    gchar *file_name;
+
+    contents = g_malloc0 (BENCHMARK_FILE_SIZE);
+
+    for (gint i = 0; i < BENCHMARK_DIRECTORIES; i++)
+    {
+        file_name = g_strdup_printf ("copy_benchmark_dir_%i", i);
+        directory = g_file_get_child (location, file_name);
+        g_free (file_name);
+        g_file_make_directory (directory, NULL, NULL);
+
+        for (gint j = 0; j < BENCHMARK_FILES; j++)
+        {
+            file_name = g_strdup_printf ("copy_benchmark_file_%i", j);
+            file = g_file_get_child (directory, file_name);
+            g_free (file_name);
+            g_file_replace_contents (file, contents, BENCHMARK_FILE_SIZE,
+                                     NULL, FALSE, G_FILE_CREATE_NONE,
+                                     NULL, NULL, NULL);
+            g_clear_object (&file);
+        }
+
+        g_clear_object (&directory);
+    }
+}
+
+static guint
+count_benchmark_files (GFile *location)
+{
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    GFileInfo *info;
+    gchar *file_name;
+    guint n_files;
+
+    n_files = 0;
+    for (gint i = 0; i < BENCHMARK_DIRECTORIES; i++)
+    {
+        file_name = g_strdup_printf ("copy_benchmark_dir_%i", i);
+        directory = g_file_get_child (location, file_name);
+        g_free (file_name);
+
+        enumerator = g_file_enumerate_children (directory,
+                                                G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                NULL, NULL);
+        g_assert_true (enumerator != NULL);
+
+        while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL)
+        {
+            g_assert_cmpint (g_file_info_get_size (info), ==, BENCHMARK_FILE_SIZE);
+            n_files++;
+            g_object_unref (info);
+        }
+
+        g_clear_object (&enumerator);
+        g_clear_object (&directory);
+    }
+
+    return n_files;
+}
+
+static void
+test_copy_files_benchmark (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) source = NULL;
+    g_autoptr (GFile) target = NULL;
+    g_autoptr (GFile) result = NULL;
+    g_autolist (GFile) files = NULL;
+    guint thread_counts[] = { 1, 2, 4, 0 };
+    guint n_files;
+    gdouble elapsed;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    source = g_file_get_child (root, "copy_benchmark_source");
+    g_file_make_directory (source, NULL, NULL);
+    create_benchmark_hierarchy (source);
+    files = g_list_prepend (files, g_object_ref (source));
+
+    target = g_file_get_child (root, "copy_benchmark_target");
+
+    for (guint i = 0; i < G_N_ELEMENTS (thread_counts); i++)
+    {
+        g_settings_set_uint (nautilus_preferences,
+                             NAUTILUS_PREFERENCES_COPY_THREADS,
+                             thread_counts[i]);
+        g_file_make_directory (target, NULL, NULL);
+
+        g_test_timer_start ();
+        nautilus_file_operations_copy_sync (files, target);
+        elapsed = g_test_timer_elapsed ();
+
+        result = g_file_get_child (target, "copy_benchmark_source");
+        n_files = count_benchmark_files (result);
+        g_assert_cmpuint (n_files, ==, BENCHMARK_DIRECTORIES * BENCHMARK_FILES);
+        g_test_minimized_result (elapsed,
+                                 "Copied %u files with %u threads (0 is one per processor) in %f seconds, %f files per second",
+                                 n_files, thread_counts[i], elapsed, n_files / elapsed);
+
+        g_clear_object (&result);
+        empty_directory_by_prefix (root, "copy_benchmark_target");
+    }
+
+    empty_directory_by_prefix (root, "copy_benchmark");
+}
+
+/* Resumes a copy that got through one file and half of another one. The
+ * destination has something else in place of what was copied already, to
+ * tell whether it is copied again. The half copied file is kept under a
+ * hidden name until it is complete.
+ */
+static void
+test_copy_resume (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) first_dir = NULL;
+    g_autoptr (GFile) second_dir = NULL;
+    g_autoptr (GFile) result_dir = NULL;
+    g_autoptr (GFile) done_file = NULL;
+    g_autoptr (GFile) partial_file = NULL;
+    g_autoptr (GFile) new_file = NULL;
+    g_autoptr (GFile) result_file = NULL;
+    g_autoptr (GFile) result_partial_file = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    g_autolist (GFile) files = NULL;
+    g_autofree gchar *data = NULL;
+    g_autofree gchar *result_data = NULL;
+    g_autofree gchar *contents = NULL;
+    NautilusCopyJournal *journal;
+    gsize length;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    g_assert_true (root != NULL);
+
+    first_dir = g_file_get_child (root, "copy_resume_first_dir");
+    g_file_make_directory (first_dir, NULL, NULL);
+    files = g_list_prepend (files, g_object_ref (first_dir));
+
+    done_file = g_file_get_child (first_dir, "copy_resume_done_file");
+    g_assert_true (g_file_replace_contents (done_file, "done", 4, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+    new_file = g_file_get_child (first_dir, "copy_resume_new_file");
+    g_assert_true (g_file_replace_contents (new_file, "new", 3, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+    partial_file = g_file_get_child (first_dir, "copy_resume_partial_file");
+    data = g_malloc (RESUME_FILE_SIZE);
+    for (gsize i = 0; i < RESUME_FILE_SIZE; i++)
+    {
+        data[i] = (gchar) (i % 251 + 1);
+    }
+    g_assert_true (g_file_replace_contents (partial_file, data, RESUME_FILE_SIZE, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+
+    second_dir = g_file_get_child (root, "copy_resume_second_dir");
+    g_file_make_directory (second_dir, NULL, NULL);
+    result_dir = g_file_get_child (second_dir, "copy_resume_first_dir");
+    g_file_make_directory (result_dir, NULL, NULL);
+
+    result_file = g_file_get_child (result_dir, "copy_resume_done_file");
+    g_assert_true (g_file_replace_contents (result_file, "old", 3, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+    g_clear_object (&result_file);
+
+    result_file = g_file_get_child (result_dir, "copy_resume_partial_file");
+    result_partial_file = nautilus_copy_journal_get_partial_file (result_file);
+    g_assert_true (result_partial_file != NULL);
+    result_data = g_malloc0 (RESUME_FILE_SIZE / 2);
+    g_assert_true (g_file_replace_contents (result_partial_file, result_data, RESUME_FILE_SIZE / 2, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+
+    info = g_file_query_info (partial_file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    g_assert_true (info != NULL);
+
+    journal = nautilus_copy_journal_new (files, second_dir, FALSE, NULL);
+    g_assert_true (journal != NULL);
+    nautilus_copy_journal_add_done (journal, done_file);
+    nautilus_copy_journal_set_partial (journal, partial_file, result_partial_file,
+                                       RESUME_FILE_SIZE / 2, RESUME_FILE_SIZE,
+                                       g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+    location = nautilus_copy_journal_get_location (journal);
+    nautilus_copy_journal_close (journal, FALSE);
+
+    nautilus_file_operations_resume_sync (location);
+
+    /* Continued from the middle */
+    g_assert_true (g_file_load_contents (result_file, NULL, &contents, &length, NULL, NULL));
+    g_assert_cmpuint (length, ==, RESUME_FILE_SIZE);
+    g_assert_true (memcmp (contents, result_data, RESUME_FILE_SIZE / 2) == 0);
+    g_assert_true (memcmp (contents + RESUME_FILE_SIZE / 2, data + RESUME_FILE_SIZE / 2,
+                           RESUME_FILE_SIZE / 2) == 0);
+    g_assert_false (g_file_query_exists (result_partial_file, NULL));
+    g_clear_pointer (&contents, g_free);
+    g_clear_object (&result_file);
+
+    /* Not copied again */
+    result_file = g_file_get_child (result_dir, "copy_resume_done_file");
+    g_assert_true (g_file_load_contents (result_file, NULL, &contents, &length, NULL, NULL));
+    g_assert_cmpstr (contents, ==, "old");
+    g_clear_pointer (&contents, g_free);
+    g_clear_object (&result_file);
+
+    result_file = g_file_get_child (result_dir, "copy_resume_new_file");
+    g_assert_true (g_file_load_contents (result_file, NULL, &contents, &length, NULL, NULL));
+    g_assert_cmpstr (contents, ==, "new");
+
+    /* Done with */
+    g_assert_false (g_file_query_exists (location, NULL));
+
+    empty_directory_by_prefix (root, "copy_resume");
+}
+
+/* A journal left behind more than a week ago is pruned when the unfinished
+ * ones are listed, along with its partial copy.
+ */
+static void
+test_copy_journal_prune (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) source_file = NULL;
+    g_autoptr (GFile) dest_file = NULL;
+    g_autoptr (GFile) partial_file = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autolist (GFile) files = NULL;
+    g_autolist (GFile) unfinished = NULL;
+    g_autofree gchar *path = NULL;
+    NautilusCopyJournal *journal;
+    struct utimbuf times;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    g_assert_true (root != NULL);
+
+    source_file = g_file_get_child (root, "copy_journal_prune_file");
+    g_assert_true (g_file_replace_contents (source_file, "prune", 5, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+    files = g_list_prepend (files, g_object_ref (source_file));
+
+    dest_file = g_file_get_child (root, "copy_journal_prune_dest");
+    partial_file = nautilus_copy_journal_get_partial_file (dest_file);
+    g_assert_true (g_file_replace_contents (partial_file, "pru", 3, NULL, FALSE,
+                                            G_FILE_CREATE_NONE, NULL, NULL, NULL));
+
+    journal = nautilus_copy_journal_new (files, root, FALSE, NULL);
+    g_assert_true (journal != NULL);
+    nautilus_copy_journal_set_partial (journal, source_file, partial_file, 3, 5, 0);
+    location = nautilus_copy_journal_get_location (journal);
+    nautilus_copy_journal_close (journal, FALSE);
+
+    path = g_file_get_path (location);
+    times.actime = times.modtime = time (NULL) - 8 * 24 * 60 * 60;
+    g_assert_cmpint (utime (path, &times), ==, 0);
+
+    unfinished = nautilus_copy_journal_list_unfinished ();
+    for (GList *l = unfinished; l != NULL; l = l->next)
+    {
+        g_assert_false (g_file_equal (l->data, location));
+    }
+    g_assert_false (g_file_query_exists (location, NULL));
+    g_assert_false (g_file_query_exists (partial_file, NULL));
+
+    empty_directory_by_prefix (root, "copy_journal_prune");
+}
+
 static void
 setup_test_suite (void)
 {
@@ -1297,6 +1823,25 @@ setup_test_suite (void)
                      test_copy_fourth_hierarchy);
     g_test_add_func ("/test-copy-hierarchy-undo/1.4",
                      test_copy_fourth_hierarchy_undo);
+    g_test_add_func ("/test-copy-hierarchy/1.5",
+                     test_copy_overlapping_hierarchy);
+    g_test_add_func ("/test-copy-sparse-file/1.0",
+                     test_copy_sparse_file);
+    /* It makes and mounts a file system image, only when asked for */
+    if (g_test_thorough ())
+    {
+        g_test_add_func ("/test-copy-reflink-loopback/1.0",
+                         test_copy_reflink_loopback);
+    }
+    g_test_add_func ("/test-copy-resume/1.0",
+                     test_copy_resume);
+    g_test_add_func ("/test-copy-journal-prune/1.0",
+                     test_copy_journal_prune);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-copy-files-benchmark/1.0",
+                         test_copy_files_benchmark);
+    }
 }
 
 int
@@ -1304,10 +1849,16 @@ main (int argc, char *argv[])
 {
     g_autoptr (NautilusFileUndoManager) undo_manager = NULL;
 
+    /* The benchmark changes the number of copy threads, don't let
+     * that leak into the user settings.
+     */
+    g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+
     undo_manager = nautilus_file_undo_manager_new ();
     g_test_init (&argc, &argv, NULL);
     g_test_set_nonfatal_assertions ();
     nautilus_ensure_extension_points();
+    nautilus_global_preferences_init ();
 
     setup_test_suite ();
 
@@ -1,5 +1,8 @@
 #include "test-utilities.h"
 
+#include <glib/gstdio.h>
+#include <unistd.h>
+
 static void
 test_trash_one_file (void)
 {
@@ -532,6 +535,83 @@ test_delete_third_hierarchy (void)
     empty_directory_by_prefix (root, "trash_or_delete");
 }
 
+static void
+create_deep_hierarchy (const gchar *path,
+                       gint         depth)
+{
+    g_assert_cmpint (g_mkdir (path, 0755), ==, 0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        g_autofree gchar *file_path = NULL;
+        g_autofree gchar *name = NULL;
+
+        name = g_strdup_printf ("trash_or_delete_file_%i", i);
+        file_path = g_build_filename (path, name, NULL);
+        g_assert_true (g_file_set_contents (file_path, "content", -1, NULL));
+
+        if (depth > 0)
+        {
+            g_autofree gchar *dir_path = NULL;
+
+            g_free (name);
+            name = g_strdup_printf ("trash_or_delete_dir_%i", i);
+            dir_path = g_build_filename (path, name, NULL);
+            create_deep_hierarchy (dir_path, depth - 1);
+        }
+    }
+}
+
+/* We're deleting a folder deeper than the levels walked before handing
+ * the subfolders to other threads, with links to a folder that must be
+ * left alone at the top and at the bottom.
+ */
+static void
+test_delete_deep_hierarchy (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) deep_dir = NULL;
+    g_autoptr (GFile) kept_file = NULL;
+    g_autolist (GFile) files = NULL;
+    g_autofree gchar *deep_path = NULL;
+    g_autofree gchar *kept_path = NULL;
+    g_autofree gchar *kept_file_path = NULL;
+    g_autofree gchar *link_path = NULL;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    deep_path = g_build_filename (g_get_tmp_dir (), "trash_or_delete_deep_dir", NULL);
+    kept_path = g_build_filename (g_get_tmp_dir (), "trash_or_delete_kept_dir", NULL);
+    kept_file_path = g_build_filename (kept_path, "trash_or_delete_kept_file", NULL);
+
+    create_deep_hierarchy (deep_path, 5);
+    g_assert_cmpint (g_mkdir (kept_path, 0755), ==, 0);
+    g_assert_true (g_file_set_contents (kept_file_path, "content", -1, NULL));
+
+    link_path = g_build_filename (deep_path, "trash_or_delete_link", NULL);
+    g_assert_cmpint (symlink (kept_path, link_path), ==, 0);
+    g_free (link_path);
+    link_path = g_build_filename (deep_path,
+                                  "trash_or_delete_dir_0",
+                                  "trash_or_delete_dir_1",
+                                  "trash_or_delete_dir_2",
+                                  "trash_or_delete_dir_0",
+                                  "trash_or_delete_link",
+                                  NULL);
+    g_assert_cmpint (symlink (kept_path, link_path), ==, 0);
+
+    deep_dir = g_file_new_for_path (deep_path);
+    files = g_list_prepend (files, g_object_ref (deep_dir));
+
+    nautilus_file_operations_delete_sync (files);
+
+    g_assert_false (g_file_query_exists (deep_dir, NULL));
+
+    kept_file = g_file_new_for_path (kept_file_path);
+    g_assert_true (g_file_query_exists (kept_file, NULL));
+
+    empty_directory_by_prefix (root, "trash_or_delete");
+}
+
 static void
 setup_test_suite (void)
 {
@@ -563,6 +643,8 @@ setup_test_suite (void)
                      test_delete_first_hierarchy);
     g_test_add_func ("/test-delete-more-full-directories/1.6",
                      test_delete_third_hierarchy);
+    g_test_add_func ("/test-delete-one-full-directory/1.2",
+                     test_delete_deep_hierarchy);
 
 }
 
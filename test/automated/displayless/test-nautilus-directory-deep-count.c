@@ -0,0 +1,161 @@
+#include "test-utilities.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <src/nautilus-file.h>
+#include <src/nautilus-directory.h>
+
+#define N_DIRECTORIES 8
+#define N_SUBDIRECTORIES 4
+#define N_FILES 16
+#define N_LINKS 3
+#define FILE_CONTENTS "0123456789"
+#define LINKED_FILE_SIZE 1000
+
+static goffset
+get_size (GFile *file)
+{
+    g_autoptr (GFileInfo) info = NULL;
+
+    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    g_assert_nonnull (info);
+
+    return g_file_info_get_size (info);
+}
+
+/* Returns the expected deep size of @location. */
+static goffset
+create_deep_count_hierarchy (GFile *location)
+{
+    g_autoptr (GPtrArray) directories = NULL;
+    g_autoptr (GFile) original = NULL;
+    g_autofree gchar *contents = NULL;
+    goffset size;
+
+    directories = g_ptr_array_new_with_free_func (g_object_unref);
+    size = 0;
+
+    for (guint i = 0; i < N_DIRECTORIES; i++)
+    {
+        g_autofree gchar *name = NULL;
+        GFile *directory;
+
+        name = g_strdup_printf ("deep_count_dir_%u", i);
+        directory = g_file_get_child (location, name);
+        g_file_make_directory (directory, NULL, NULL);
+        g_ptr_array_add (directories, directory);
+
+        for (guint j = 0; j < N_SUBDIRECTORIES; j++)
+        {
+            g_autofree gchar *subdirectory_name = NULL;
+            GFile *subdirectory;
+
+            subdirectory_name = g_strdup_printf ("deep_count_subdir_%u", j);
+            subdirectory = g_file_get_child (directory, subdirectory_name);
+            g_file_make_directory (subdirectory, NULL, NULL);
+            g_ptr_array_add (directories, subdirectory);
+
+            for (guint k = 0; k < N_FILES; k++)
+            {
+                g_autofree gchar *file_name = NULL;
+                g_autoptr (GFile) file = NULL;
+
+                file_name = g_strdup_printf ("deep_count_file_%u", k);
+                file = g_file_get_child (subdirectory, file_name);
+                g_file_replace_contents (file, FILE_CONTENTS, strlen (FILE_CONTENTS),
+                                         NULL, FALSE, G_FILE_CREATE_NONE,
+                                         NULL, NULL, NULL);
+                size += strlen (FILE_CONTENTS);
+            }
+        }
+    }
+
+    /* Several links to the same file only count its size once. */
+    contents = g_strnfill (LINKED_FILE_SIZE, 'x');
+    original = g_file_get_child (location, "deep_count_linked_file");
+    g_file_replace_contents (original, contents, LINKED_FILE_SIZE,
+                             NULL, FALSE, G_FILE_CREATE_NONE,
+                             NULL, NULL, NULL);
+    size += LINKED_FILE_SIZE;
+
+    for (guint i = 0; i < N_LINKS; i++)
+    {
+        g_autofree gchar *name = NULL;
+        g_autoptr (GFile) link_file = NULL;
+        g_autofree gchar *original_path = NULL;
+        g_autofree gchar *link_path = NULL;
+
+        name = g_strdup_printf ("deep_count_link_%u", i);
+        link_file = g_file_get_child (g_ptr_array_index (directories, i), name);
+        original_path = g_file_get_path (original);
+        link_path = g_file_get_path (link_file);
+        g_assert_cmpint (link (original_path, link_path), ==, 0);
+    }
+
+    /* Directories are counted with their own size. */
+    for (guint i = 0; i < directories->len; i++)
+    {
+        size += get_size (g_ptr_array_index (directories, i));
+    }
+
+    return size;
+}
+
+static void
+deep_counts_ready (NautilusFile *file,
+                   gpointer      user_data)
+{
+    g_main_loop_quit (user_data);
+}
+
+static void
+test_directory_deep_count (void)
+{
+    g_autoptr (GMainLoop) loop = NULL;
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (NautilusFile) file = NULL;
+    NautilusRequestStatus status;
+    guint directory_count;
+    guint file_count;
+    guint unreadable_count;
+    goffset total_size;
+    goffset expected_size;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    empty_directory_by_prefix (root, "deep_count");
+    location = g_file_get_child (root, "deep_count");
+    g_file_make_directory (location, NULL, NULL);
+    expected_size = create_deep_count_hierarchy (location);
+
+    loop = g_main_loop_new (NULL, FALSE);
+    file = nautilus_file_get (location);
+    nautilus_file_call_when_ready (file, NAUTILUS_FILE_ATTRIBUTE_DEEP_COUNTS,
+                                   deep_counts_ready, loop);
+    g_main_loop_run (loop);
+
+    status = nautilus_file_get_deep_counts (file, &directory_count, &file_count,
+                                            &unreadable_count, &total_size, FALSE);
+    g_assert_cmpint (status, ==, NAUTILUS_REQUEST_DONE);
+    g_assert_cmpuint (directory_count, ==, N_DIRECTORIES + N_DIRECTORIES * N_SUBDIRECTORIES);
+    g_assert_cmpuint (file_count, ==, N_DIRECTORIES * N_SUBDIRECTORIES * N_FILES + 1 + N_LINKS);
+    g_assert_cmpuint (unreadable_count, ==, 0);
+    g_assert_cmpint (total_size, ==, expected_size);
+
+    empty_directory_by_prefix (root, "deep_count");
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    nautilus_ensure_extension_points ();
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-directory-deep-count/1.0",
+                     test_directory_deep_count);
+
+    return g_test_run ();
+}
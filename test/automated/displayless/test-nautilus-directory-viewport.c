@@ -0,0 +1,167 @@
+#include "test-utilities.h"
+
+#include <string.h>
+#include <src/nautilus-file.h>
+#include <src/nautilus-directory.h>
+
+#define N_DIRECTORIES 3
+#define N_FILES 2
+#define WAIT_TIMEOUT (5 * G_TIME_SPAN_SECOND)
+
+typedef gboolean (*FileCheck) (NautilusFile *file);
+
+static gboolean
+has_item_count (NautilusFile *file)
+{
+    return nautilus_file_get_directory_item_count (file, NULL, NULL);
+}
+
+static gboolean
+has_info (NautilusFile *file)
+{
+    return nautilus_file_check_if_ready (file, NAUTILUS_FILE_ATTRIBUTE_INFO);
+}
+
+static gboolean
+keep_waiting (gpointer user_data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+/* Spins the main loop until @check passes for @file, or a while. */
+static gboolean
+wait_for (NautilusFile *file,
+          FileCheck     check)
+{
+    gint64 deadline;
+    guint wakeup_id;
+
+    deadline = g_get_monotonic_time () + WAIT_TIMEOUT;
+    wakeup_id = g_timeout_add (10, keep_waiting, NULL);
+    while (!check (file) && g_get_monotonic_time () < deadline)
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+    g_source_remove (wakeup_id);
+
+    return check (file);
+}
+
+static void
+create_hierarchy (GFile *location)
+{
+    g_file_make_directory (location, NULL, NULL);
+
+    for (guint i = 0; i < N_DIRECTORIES; i++)
+    {
+        g_autofree gchar *name = NULL;
+        g_autoptr (GFile) directory = NULL;
+
+        name = g_strdup_printf ("directory_viewport_dir_%u", i);
+        directory = g_file_get_child (location, name);
+        g_file_make_directory (directory, NULL, NULL);
+
+        for (guint j = 0; j < N_FILES; j++)
+        {
+            g_autofree gchar *file_name = NULL;
+            g_autoptr (GFile) file = NULL;
+
+            file_name = g_strdup_printf ("directory_viewport_file_%u", j);
+            file = g_file_get_child (directory, file_name);
+            g_file_replace_contents (file, file_name, strlen (file_name),
+                                     NULL, FALSE, G_FILE_CREATE_NONE,
+                                     NULL, NULL, NULL);
+        }
+    }
+}
+
+static void
+test_directory_viewport (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (NautilusDirectory) directory = NULL;
+    NautilusFile *files[N_DIRECTORIES];
+    GList viewport;
+    guint client;
+    guint count;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    empty_directory_by_prefix (root, "directory_viewport");
+    location = g_file_get_child (root, "directory_viewport");
+    create_hierarchy (location);
+
+    directory = nautilus_directory_get (location);
+    for (guint i = 0; i < N_DIRECTORIES; i++)
+    {
+        g_autofree gchar *name = NULL;
+        g_autoptr (GFile) child = NULL;
+
+        name = g_strdup_printf ("directory_viewport_dir_%u", i);
+        child = g_file_get_child (location, name);
+        files[i] = nautilus_file_get (child);
+    }
+
+    nautilus_directory_file_monitor_add (directory, &client, TRUE,
+                                         NAUTILUS_FILE_ATTRIBUTE_INFO |
+                                         NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT,
+                                         NULL, NULL);
+
+    /* Only the files on screen get counted */
+    viewport.data = files[0];
+    viewport.next = NULL;
+    viewport.prev = NULL;
+    nautilus_directory_file_monitor_set_viewport (directory, &client, &viewport);
+
+    g_assert_true (wait_for (files[0], has_item_count));
+    g_assert_true (nautilus_file_get_directory_item_count (files[0], &count, NULL));
+    g_assert_cmpuint (count, ==, N_FILES);
+    for (guint i = 1; i < N_DIRECTORIES; i++)
+    {
+        g_assert_true (wait_for (files[i], has_info));
+    }
+    while (g_main_context_iteration (NULL, FALSE))
+    {
+    }
+    g_assert_false (has_item_count (files[1]));
+    g_assert_false (has_item_count (files[2]));
+
+    /* Scrolling brings new ones in */
+    viewport.data = files[1];
+    nautilus_directory_file_monitor_set_viewport (directory, &client, &viewport);
+    g_assert_true (wait_for (files[1], has_item_count));
+    while (g_main_context_iteration (NULL, FALSE))
+    {
+    }
+    g_assert_false (has_item_count (files[2]));
+
+    /* Lifting the restriction gets the rest */
+    nautilus_directory_file_monitor_set_viewport (directory, &client, NULL);
+    g_assert_true (wait_for (files[2], has_item_count));
+
+    nautilus_directory_file_monitor_remove (directory, &client);
+    for (guint i = 0; i < N_DIRECTORIES; i++)
+    {
+        nautilus_file_unref (files[i]);
+    }
+    empty_directory_by_prefix (root, "directory_viewport");
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    nautilus_ensure_extension_points ();
+    /* Needed for the item count preference.
+     * FIXME: tests are not installed, so the system does not
+     * have the gschema. Installed tests is a long term GNOME goal.
+     */
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-directory-viewport/1.0",
+                     test_directory_viewport);
+
+    return g_test_run ();
+}
@@ -0,0 +1,184 @@
+#include "test-utilities.h"
+
+#include <string.h>
+#include <src/nautilus-file.h>
+#include <src/nautilus-file-private.h>
+
+#define SMALL_N_FILES 100
+#define BENCHMARK_N_FILES 100000
+
+static NautilusFile *
+create_file (const char *directory_uri,
+             guint       i,
+             const char *content_type)
+{
+    g_autofree gchar *name = NULL;
+    g_autofree gchar *uri = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    NautilusFile *file;
+
+    name = g_strdup_printf ("file_memory_%u", i);
+    uri = g_strdup_printf ("%s/%s", directory_uri, name);
+    file = nautilus_file_get_by_uri (uri);
+
+    info = g_file_info_new ();
+    g_file_info_set_name (info, name);
+    g_file_info_set_display_name (info, name);
+    g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+    g_file_info_set_content_type (info, content_type);
+    g_file_info_set_size (info, i);
+    g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, 1500000000 + i);
+    g_file_info_set_attribute_string (info, G_FILE_ATTRIBUTE_OWNER_USER, "user");
+    g_file_info_set_attribute_string (info, G_FILE_ATTRIBUTE_OWNER_GROUP, "group");
+    g_file_info_set_attribute_string (info, G_FILE_ATTRIBUTE_SELINUX_CONTEXT,
+                                      "unconfined_u:object_r:user_home_t:s0");
+    nautilus_file_update_info (file, info);
+
+    return file;
+}
+
+static gsize
+get_string_size (const char *string)
+{
+    return string != NULL ? strlen (string) + 1 : 0;
+}
+
+/* What a file costs on its own, leaving out the strings it shares with
+ * other files.
+ */
+static gsize
+get_file_footprint (NautilusFile *file)
+{
+    NautilusFileDetails *details;
+    gsize size;
+
+    details = file->details;
+    size = sizeof (NautilusFile) + sizeof (NautilusFileDetails);
+    size += get_string_size (details->name);
+    if (details->display_name != details->name)
+    {
+        size += get_string_size (details->display_name);
+    }
+    size += get_string_size (details->display_name_collation_key);
+    size += get_string_size (details->symlink_name);
+    size += get_string_size (details->description);
+
+    if (details->extra != NULL)
+    {
+        size += sizeof (NautilusFileExtraDetails);
+        size += get_string_size (details->extra->thumbnail_path);
+        size += get_string_size (details->extra->trash_orig_path);
+        size += get_string_size (details->extra->fts_snippet);
+    }
+
+    return size;
+}
+
+static void
+test_file_memory_extra_details (void)
+{
+    g_autoptr (NautilusFile) file = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    g_autofree gchar *name = NULL;
+
+    file = create_file ("file:///tmp/file_memory", 0, "text/plain");
+    g_assert_null (file->details->extra);
+    g_assert_cmpint (nautilus_file_get_trash_time (file), ==, 0);
+    g_assert_null (nautilus_file_get_search_fts_snippet (file));
+    g_assert_null (nautilus_file_get_thumbnail_path (file));
+    g_assert_null (file->details->extra);
+
+    name = nautilus_file_get_name (file);
+    info = g_file_info_new ();
+    g_file_info_set_name (info, name);
+    g_file_info_set_display_name (info, name);
+    g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+    g_file_info_set_attribute_byte_string (info, "trash::orig-path", "/tmp/file_memory/original");
+    g_file_info_set_attribute_string (info, "trash::deletion-date", "2017-07-14T02:40:00");
+    nautilus_file_update_info (file, info);
+
+    g_assert_nonnull (file->details->extra);
+    g_assert_cmpstr (nautilus_file_peek_extra_details (file)->trash_orig_path, ==,
+                     "/tmp/file_memory/original");
+    g_assert_cmpint (nautilus_file_get_trash_time (file), !=, 0);
+
+    /* Clearing the info must not leave stale trash details behind. */
+    nautilus_file_clear_info (file);
+    g_assert_cmpint (nautilus_file_get_trash_time (file), ==, 0);
+}
+
+static void
+test_file_memory_shared_strings (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    NautilusFile *first;
+    NautilusFile *file;
+
+    files = g_ptr_array_new_with_free_func ((GDestroyNotify) nautilus_file_unref);
+    for (guint i = 0; i < SMALL_N_FILES; i++)
+    {
+        g_ptr_array_add (files, create_file ("file:///tmp/file_memory", i, "text/plain"));
+    }
+
+    first = g_ptr_array_index (files, 0);
+    for (guint i = 1; i < files->len; i++)
+    {
+        file = g_ptr_array_index (files, i);
+
+        g_assert_true (file->details->mime_type == first->details->mime_type);
+        g_assert_true (file->details->owner == first->details->owner);
+        g_assert_true (file->details->group == first->details->group);
+        g_assert_true (file->details->selinux_context == first->details->selinux_context);
+        g_assert_true (file->details->directory_name_collation_key ==
+                       first->details->directory_name_collation_key);
+        g_assert_null (file->details->extra);
+    }
+}
+
+static void
+test_file_memory_benchmark (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    const char *content_types[] = { "text/plain", "image/png", "application/pdf" };
+    gsize total;
+    gdouble bytes_per_file;
+
+    files = g_ptr_array_new_with_free_func ((GDestroyNotify) nautilus_file_unref);
+    for (guint i = 0; i < BENCHMARK_N_FILES; i++)
+    {
+        g_ptr_array_add (files, create_file ("file:///tmp/file_memory_benchmark", i,
+                                             content_types[i % G_N_ELEMENTS (content_types)]));
+    }
+
+    total = 0;
+    for (guint i = 0; i < files->len; i++)
+    {
+        total += get_file_footprint (g_ptr_array_index (files, i));
+    }
+
+    bytes_per_file = (gdouble) total / files->len;
+    g_test_minimized_result (bytes_per_file,
+                             "%f bytes per file for %u files, of which %" G_GSIZE_FORMAT " for the file details",
+                             bytes_per_file, files->len, sizeof (NautilusFileDetails));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    nautilus_ensure_extension_points ();
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-file-memory-extra-details/1.0",
+                     test_file_memory_extra_details);
+    g_test_add_func ("/test-file-memory-shared-strings/1.0",
+                     test_file_memory_shared_strings);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-file-memory-benchmark/1.0",
+                         test_file_memory_benchmark);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,313 @@
+#include "test-utilities.h"
+
+#include <src/nautilus-file.h>
+#include <src/nautilus-file-private.h>
+
+#define SMALL_N_FILES 1000
+/* Above the threshold for sorting on several threads. */
+#define PARALLEL_N_FILES 50000
+#define BENCHMARK_N_FILES 500000
+
+static const char *content_types[] =
+{
+    "text/plain",
+    "image/png",
+    "image/jpeg",
+    "application/pdf",
+    "audio/ogg",
+    "video/webm",
+    "application/x-tar",
+    "application/octet-stream",
+};
+
+static GPtrArray *
+create_files (guint n_files)
+{
+    GPtrArray *files;
+
+    files = g_ptr_array_new_with_free_func ((GDestroyNotify) nautilus_file_unref);
+    for (guint i = 0; i < n_files; i++)
+    {
+        g_autofree gchar *name = NULL;
+        g_autofree gchar *uri = NULL;
+        g_autoptr (GFileInfo) info = NULL;
+        NautilusFile *file;
+
+        name = g_strdup_printf ("file_sort_%u", i);
+        uri = g_strdup_printf ("file:///tmp/file_sort/%s", name);
+        file = nautilus_file_get_by_uri (uri);
+
+        /* Spread out sizes and times, with plenty of ties, so that the
+         * tie breaking is exercised too.
+         */
+        info = g_file_info_new ();
+        g_file_info_set_name (info, name);
+        g_file_info_set_display_name (info, name);
+        g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+        g_file_info_set_content_type (info, content_types[(i * 7) % G_N_ELEMENTS (content_types)]);
+        g_file_info_set_size (info, (i * 2654435761u) % 4096);
+        g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          1500000000 + (i * 40503u) % 100000);
+        g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS,
+                                          1500000000 + (i * 9973u) % 100000);
+        nautilus_file_update_info (file, info);
+
+        g_ptr_array_add (files, file);
+    }
+
+    return files;
+}
+
+static NautilusFileSortType sort_type;
+static gboolean directories_first = TRUE;
+static gboolean reversed = FALSE;
+
+static gint
+compare_files (gconstpointer a,
+               gconstpointer b)
+{
+    return nautilus_file_compare_for_sort (*((NautilusFile **) a),
+                                           *((NautilusFile **) b),
+                                           sort_type, directories_first, reversed);
+}
+
+static void
+assert_sorted (GPtrArray *files)
+{
+    for (guint i = 1; i < files->len; i++)
+    {
+        g_assert_cmpint (compare_files (&g_ptr_array_index (files, i - 1),
+                                        &g_ptr_array_index (files, i)), <, 0);
+    }
+}
+
+static void
+test_file_sort_by_size (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    NautilusFile *file_1;
+    NautilusFile *file_2;
+
+    files = create_files (SMALL_N_FILES);
+    sort_type = NAUTILUS_FILE_SORT_BY_SIZE;
+    g_ptr_array_sort (files, compare_files);
+    assert_sorted (files);
+
+    for (guint i = 1; i < files->len; i++)
+    {
+        file_1 = g_ptr_array_index (files, i - 1);
+        file_2 = g_ptr_array_index (files, i);
+        g_assert_cmpint (nautilus_file_get_size (file_1), <=, nautilus_file_get_size (file_2));
+    }
+}
+
+static void
+test_file_sort_by_time (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    NautilusFile *file_1;
+    NautilusFile *file_2;
+
+    files = create_files (SMALL_N_FILES);
+    sort_type = NAUTILUS_FILE_SORT_BY_MTIME;
+    g_ptr_array_sort (files, compare_files);
+    assert_sorted (files);
+
+    for (guint i = 1; i < files->len; i++)
+    {
+        file_1 = g_ptr_array_index (files, i - 1);
+        file_2 = g_ptr_array_index (files, i);
+        g_assert_cmpint (nautilus_file_get_mtime (file_1), <=, nautilus_file_get_mtime (file_2));
+    }
+}
+
+static void
+test_file_sort_by_type (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    g_autofree gchar *name = NULL;
+    NautilusFile *file;
+    guint first;
+    guint last;
+    guint position;
+
+    files = create_files (SMALL_N_FILES);
+    sort_type = NAUTILUS_FILE_SORT_BY_TYPE;
+    g_ptr_array_sort (files, compare_files);
+    assert_sorted (files);
+
+    /* Changing the mime type must not leave a stale key behind, the file
+     * has to move in among the other videos.
+     */
+    file = g_ptr_array_index (files, 0);
+    g_assert_false (nautilus_file_is_mime_type (file, "video/webm"));
+    name = nautilus_file_get_name (file);
+    info = g_file_info_new ();
+    g_file_info_set_name (info, name);
+    g_file_info_set_display_name (info, name);
+    g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+    g_file_info_set_content_type (info, "video/webm");
+    nautilus_file_update_info (file, info);
+
+    g_ptr_array_sort (files, compare_files);
+    assert_sorted (files);
+
+    first = files->len;
+    last = 0;
+    for (guint i = 0; i < files->len; i++)
+    {
+        if (nautilus_file_is_mime_type (g_ptr_array_index (files, i), "video/webm"))
+        {
+            first = MIN (first, i);
+            last = i;
+        }
+    }
+    for (guint i = first; i <= last; i++)
+    {
+        g_assert_true (nautilus_file_is_mime_type (g_ptr_array_index (files, i), "video/webm"));
+    }
+    g_assert_true (g_ptr_array_find (files, file, &position));
+    g_assert_cmpuint (position, >=, first);
+    g_assert_cmpuint (position, <=, last);
+    g_assert_cmpuint (last - first + 1, >, 1);
+}
+
+/* The parallel sort has its own copy of the comparisons, it must give the
+ * same order as nautilus_file_compare_for_sort() for every sort type.
+ */
+static void
+test_file_sort_get_new_order (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GPtrArray) sorted = NULL;
+    g_autofree int *new_order = NULL;
+    NautilusFile *file;
+
+    files = create_files (PARALLEL_N_FILES);
+
+    /* Some folders for directories_first, and relevances with ties */
+    for (guint i = 0; i < files->len; i++)
+    {
+        file = g_ptr_array_index (files, i);
+        file->details->search_relevance = i % 5;
+
+        if (i % 10 == 0)
+        {
+            g_autoptr (GFileInfo) info = NULL;
+            g_autofree gchar *name = NULL;
+
+            name = nautilus_file_get_name (file);
+            info = g_file_info_new ();
+            g_file_info_set_name (info, name);
+            g_file_info_set_display_name (info, name);
+            g_file_info_set_file_type (info, G_FILE_TYPE_DIRECTORY);
+            g_file_info_set_content_type (info, "inode/directory");
+            nautilus_file_update_info (file, info);
+        }
+    }
+
+    for (sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
+         sort_type <= NAUTILUS_FILE_SORT_BY_RECENCY;
+         sort_type++)
+    {
+        for (guint i = 0; i < 4; i++)
+        {
+            directories_first = i & 1;
+            reversed = (i & 2) != 0;
+
+            g_clear_pointer (&new_order, g_free);
+            new_order = nautilus_file_sort_get_new_order ((NautilusFile **) files->pdata,
+                                                          files->len, sort_type,
+                                                          directories_first, reversed);
+
+            g_clear_pointer (&sorted, g_ptr_array_unref);
+            sorted = g_ptr_array_sized_new (files->len);
+            for (guint j = 0; j < files->len; j++)
+            {
+                g_ptr_array_add (sorted, g_ptr_array_index (files, j));
+            }
+            g_ptr_array_sort (sorted, compare_files);
+
+            for (guint j = 0; j < files->len; j++)
+            {
+                g_assert_true (g_ptr_array_index (files, new_order[j]) ==
+                               g_ptr_array_index (sorted, j));
+            }
+        }
+    }
+
+    directories_first = TRUE;
+    reversed = FALSE;
+}
+
+static void
+test_file_sort_benchmark (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    NautilusFileSortType sort_types[] =
+    {
+        NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
+        NAUTILUS_FILE_SORT_BY_SIZE,
+        NAUTILUS_FILE_SORT_BY_TYPE,
+        NAUTILUS_FILE_SORT_BY_MTIME,
+        NAUTILUS_FILE_SORT_BY_ATIME,
+    };
+    gdouble elapsed;
+
+    files = create_files (BENCHMARK_N_FILES);
+
+    for (guint i = 0; i < G_N_ELEMENTS (sort_types); i++)
+    {
+        /* Start from the same order every time. */
+        sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
+        g_ptr_array_sort (files, compare_files);
+
+        sort_type = sort_types[i];
+        g_test_timer_start ();
+        g_ptr_array_sort (files, compare_files);
+        elapsed = g_test_timer_elapsed ();
+
+        assert_sorted (files);
+        g_test_minimized_result (elapsed,
+                                 "Sorted %u files by sort type %u in %f seconds",
+                                 files->len, sort_types[i], elapsed);
+
+        sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
+        g_ptr_array_sort (files, compare_files);
+
+        g_test_timer_start ();
+        g_free (nautilus_file_sort_get_new_order ((NautilusFile **) files->pdata,
+                                                  files->len, sort_types[i],
+                                                  TRUE, FALSE));
+        elapsed = g_test_timer_elapsed ();
+        g_test_minimized_result (elapsed,
+                                 "Sorted %u files by sort type %u in parallel in %f seconds",
+                                 files->len, sort_types[i], elapsed);
+    }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    nautilus_ensure_extension_points ();
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-file-sort-by-size/1.0",
+                     test_file_sort_by_size);
+    g_test_add_func ("/test-file-sort-by-time/1.0",
+                     test_file_sort_by_time);
+    g_test_add_func ("/test-file-sort-by-type/1.0",
+                     test_file_sort_by_type);
+    g_test_add_func ("/test-file-sort-get-new-order/1.0",
+                     test_file_sort_get_new_order);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-file-sort-benchmark/1.0",
+                         test_file_sort_benchmark);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,438 @@
+#include "test-utilities.h"
+
+#include <glib/gstdio.h>
+#include <utime.h>
+#include <src/nautilus-filename-index.h>
+#include <src/nautilus-search-hit.h>
+
+#define N_DIRECTORIES 4
+#define N_FILES 25
+#define BENCHMARK_DIRECTORIES 500
+#define BENCHMARK_FILES 1000
+
+static void
+write_file (GFile       *directory,
+            const gchar *name)
+{
+    g_autoptr (GFile) file = NULL;
+    g_autofree gchar *path = NULL;
+
+    file = g_file_get_child (directory, name);
+    path = g_file_get_path (file);
+    g_assert_true (g_file_set_contents (path, name, -1, NULL));
+}
+
+/* N_DIRECTORIES folders of N_FILES files, plus a hidden folder and a hidden
+ * file with the same kind of names.
+ */
+static void
+create_hierarchy (GFile *location,
+                  guint  n_directories,
+                  guint  n_files)
+{
+    g_autoptr (GFile) hidden = NULL;
+
+    g_file_make_directory (location, NULL, NULL);
+
+    for (guint i = 0; i < n_directories; i++)
+    {
+        g_autoptr (GFile) directory = NULL;
+        g_autofree gchar *directory_name = NULL;
+
+        directory_name = g_strdup_printf ("index_dir_%03u", i);
+        directory = g_file_get_child (location, directory_name);
+        g_file_make_directory (directory, NULL, NULL);
+
+        for (guint j = 0; j < n_files; j++)
+        {
+            g_autofree gchar *file_name = NULL;
+
+            file_name = g_strdup_printf ("index_file_%06u.txt", i * n_files + j);
+            write_file (directory, file_name);
+        }
+    }
+
+    hidden = g_file_get_child (location, ".index_hidden");
+    g_file_make_directory (hidden, NULL, NULL);
+    write_file (hidden, "index_file_hidden.txt");
+    write_file (location, ".index_file_hidden.txt");
+}
+
+static GFile *
+get_test_location (const gchar *name)
+{
+    g_autoptr (GFile) root = NULL;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+
+    return g_file_get_child (root, name);
+}
+
+static NautilusFilenameIndex *
+create_index (GFile *location)
+{
+    g_autoptr (GFile) cache_directory = NULL;
+    g_autofree gchar *path = NULL;
+    const gchar *roots[2];
+
+    cache_directory = get_test_location ("filename_index_cache");
+    path = g_file_get_path (location);
+    roots[0] = path;
+    roots[1] = NULL;
+
+    return nautilus_filename_index_new (cache_directory, roots);
+}
+
+static void
+set_directory_time (GFile  *directory,
+                    time_t  modification_time)
+{
+    g_autofree gchar *path = NULL;
+    struct utimbuf times;
+
+    path = g_file_get_path (directory);
+    times.actime = times.modtime = modification_time;
+    g_assert_cmpint (utime (path, &times), ==, 0);
+}
+
+/* Makes the folders below @directory look older than any index of them,
+ * as if the index was built a while after they were last changed.
+ */
+static void
+backdate_directories (GFile *directory)
+{
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    GFileInfo *info;
+    GFile *child;
+
+    enumerator = g_file_enumerate_children (directory, G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            NULL, NULL);
+    while (enumerator != NULL &&
+           g_file_enumerator_iterate (enumerator, &info, &child, NULL, NULL) &&
+           child != NULL)
+    {
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            backdate_directories (child);
+        }
+    }
+
+    set_directory_time (directory, time (NULL) - 60);
+}
+
+/* Tells whether the index of @location was written again */
+static guint64
+get_index_file_inode (GFile *location)
+{
+    g_autoptr (GFile) cache_directory = NULL;
+    g_autofree gchar *location_path = NULL;
+    g_autofree gchar *checksum = NULL;
+    g_autofree gchar *name = NULL;
+    g_autofree gchar *directory = NULL;
+    g_autofree gchar *path = NULL;
+    GStatBuf stat_buf;
+
+    cache_directory = get_test_location ("filename_index_cache");
+    location_path = g_file_get_path (location);
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, location_path, -1);
+    name = g_strconcat (checksum, ".idx", NULL);
+    directory = g_file_get_path (cache_directory);
+    path = g_build_filename (directory, name, NULL);
+    g_assert_cmpint (g_stat (path, &stat_buf), ==, 0);
+
+    return stat_buf.st_ino;
+}
+
+static guint
+count_hits (NautilusFilenameIndex *index,
+            GFile                 *location,
+            const gchar           *text,
+            gboolean               show_hidden)
+{
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    GList *hits;
+    guint n_hits;
+
+    query = nautilus_query_new ();
+    nautilus_query_set_text (query, text);
+    nautilus_query_set_location (query, location);
+    nautilus_query_set_recursive (query, NAUTILUS_QUERY_RECURSIVE_ALWAYS);
+    nautilus_query_set_show_hidden_files (query, show_hidden);
+    matcher = nautilus_query_get_matcher (query);
+
+    hits = nautilus_filename_index_search (index, location, query, matcher, NULL);
+    n_hits = g_list_length (hits);
+    g_list_free_full (hits, g_object_unref);
+
+    return n_hits;
+}
+
+static void
+delete_recursively (GFile *file)
+{
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    GFile *child;
+
+    enumerator = g_file_enumerate_children (file, G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            NULL, NULL);
+    while (enumerator != NULL &&
+           g_file_enumerator_iterate (enumerator, NULL, &child, NULL, NULL) &&
+           child != NULL)
+    {
+        delete_recursively (child);
+    }
+
+    g_file_delete (file, NULL, NULL);
+}
+
+static void
+delete_test_files (void)
+{
+    const gchar *names[] =
+    {
+        "filename_index_root", "filename_index_benchmark", "filename_index_cache", NULL
+    };
+    g_autoptr (GFile) root = NULL;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    for (const gchar * const *name = names; *name != NULL; name++)
+    {
+        g_autoptr (GFile) file = NULL;
+
+        file = g_file_get_child (root, *name);
+        delete_recursively (file);
+    }
+}
+
+static void
+test_filename_index_search (void)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) parent = NULL;
+    NautilusFilenameIndex *index;
+
+    location = get_test_location ("filename_index_root");
+    create_hierarchy (location, N_DIRECTORIES, N_FILES);
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+
+    parent = g_file_get_parent (location);
+    directory = g_file_get_child (location, "index_dir_001");
+    g_assert_true (nautilus_filename_index_covers (index, location));
+    g_assert_true (nautilus_filename_index_covers (index, directory));
+    g_assert_false (nautilus_filename_index_covers (index, parent));
+
+    g_assert_cmpuint (count_hits (index, location, "index_file", FALSE), ==, N_DIRECTORIES * N_FILES);
+    g_assert_cmpuint (count_hits (index, location, "index_file", TRUE), ==, N_DIRECTORIES * N_FILES + 2);
+    g_assert_cmpuint (count_hits (index, location, "INDEX_DIR", FALSE), ==, N_DIRECTORIES);
+    g_assert_cmpuint (count_hits (index, location, "file_000042", FALSE), ==, 1);
+    g_assert_cmpuint (count_hits (index, location, "dir file", FALSE), ==, 0);
+    g_assert_cmpuint (count_hits (index, location, "no_such_file", FALSE), ==, 0);
+    g_assert_cmpuint (count_hits (index, directory, "index_file", FALSE), ==, N_FILES);
+    g_assert_cmpuint (count_hits (index, directory, "file_000001", FALSE), ==, 0);
+
+    nautilus_filename_index_free (index);
+    delete_test_files ();
+}
+
+static void
+test_filename_index_changes (void)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GFile) new_directory = NULL;
+    NautilusFilenameIndex *index;
+
+    location = get_test_location ("filename_index_root");
+    create_hierarchy (location, N_DIRECTORIES, N_FILES);
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+
+    directory = g_file_get_child (location, "index_dir_000");
+    write_file (directory, "index_new_file");
+    file = g_file_get_child (directory, "index_new_file");
+    nautilus_filename_index_file_changed (index, file);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (count_hits (index, location, "index_new_file", FALSE), ==, 1);
+
+    g_assert_true (g_file_delete (file, NULL, NULL));
+    nautilus_filename_index_file_removed (index, file);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (count_hits (index, location, "index_new_file", FALSE), ==, 0);
+
+    /* A folder moved in brings its contents along */
+    new_directory = g_file_get_child (location, "index_new_dir");
+    g_file_make_directory (new_directory, NULL, NULL);
+    write_file (new_directory, "index_new_file_1");
+    write_file (new_directory, "index_new_file_2");
+    nautilus_filename_index_file_changed (index, new_directory);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (count_hits (index, location, "index_new", FALSE), ==, 3);
+
+    /* A removed folder takes its contents along */
+    delete_recursively (directory);
+    nautilus_filename_index_file_removed (index, directory);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (count_hits (index, location, "index_file", FALSE), ==, (N_DIRECTORIES - 1) * N_FILES);
+
+    /* Building again gives the same */
+    nautilus_filename_index_rebuild (index);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (count_hits (index, location, "index_new", FALSE), ==, 3);
+    g_assert_cmpuint (count_hits (index, location, "index_file", FALSE), ==, (N_DIRECTORIES - 1) * N_FILES);
+
+    nautilus_filename_index_free (index);
+    delete_test_files ();
+}
+
+static void
+test_filename_index_reload (void)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFile) directory = NULL;
+    NautilusFilenameIndex *index;
+    guint64 inode;
+
+    location = get_test_location ("filename_index_root");
+    create_hierarchy (location, N_DIRECTORIES, N_FILES);
+    backdate_directories (location);
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+    nautilus_filename_index_free (index);
+    inode = get_index_file_inode (location);
+
+    /* Loaded from the cache, without building it again */
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+    g_assert_true (nautilus_filename_index_covers (index, location));
+    g_assert_cmpuint (count_hits (index, location, "index_file", FALSE), ==, N_DIRECTORIES * N_FILES);
+    g_assert_cmpuint (get_index_file_inode (location), ==, inode);
+    nautilus_filename_index_free (index);
+
+    /* Unless one of the folders changed meanwhile */
+    directory = g_file_get_child (location, "index_dir_002");
+    set_directory_time (directory, time (NULL) + 60);
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (count_hits (index, location, "index_file", FALSE), ==, N_DIRECTORIES * N_FILES);
+    g_assert_cmpuint (get_index_file_inode (location), !=, inode);
+
+    nautilus_filename_index_free (index);
+    delete_test_files ();
+}
+
+/* Changes no monitor told about are found by checking the folders */
+static void
+test_filename_index_check (void)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) subdirectory = NULL;
+    g_autoptr (GFile) file = NULL;
+    NautilusFilenameIndex *index;
+    guint64 inode;
+
+    location = get_test_location ("filename_index_root");
+    create_hierarchy (location, N_DIRECTORIES, N_FILES);
+    directory = g_file_get_child (location, "index_dir_001");
+    subdirectory = g_file_get_child (directory, "index_subdir");
+    g_file_make_directory (subdirectory, NULL, NULL);
+    backdate_directories (location);
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+    inode = get_index_file_inode (location);
+
+    /* Told about, nothing to build again */
+    write_file (subdirectory, "index_seen_file");
+    file = g_file_get_child (subdirectory, "index_seen_file");
+    nautilus_filename_index_file_changed (index, file);
+    nautilus_filename_index_wait (index);
+    nautilus_filename_index_check (index);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (get_index_file_inode (location), ==, inode);
+    g_assert_cmpuint (count_hits (index, location, "index_seen_file", FALSE), ==, 1);
+
+    /* Two levels below the root, not told about. The second granularity
+     * of the times needs the folder to look changed later.
+     */
+    write_file (subdirectory, "index_unseen_file");
+    set_directory_time (subdirectory, time (NULL) + 60);
+    nautilus_filename_index_check (index);
+    nautilus_filename_index_wait (index);
+    g_assert_cmpuint (get_index_file_inode (location), !=, inode);
+    g_assert_true (nautilus_filename_index_covers (index, location));
+    g_assert_cmpuint (count_hits (index, location, "index_unseen_file", FALSE), ==, 1);
+
+    /* Not searched until built again when the monitors gave up */
+    nautilus_filename_index_invalidate (index, directory);
+    g_assert_false (nautilus_filename_index_covers (index, location));
+    nautilus_filename_index_wait (index);
+    g_assert_true (nautilus_filename_index_covers (index, location));
+
+    nautilus_filename_index_free (index);
+    delete_test_files ();
+}
+
+static void
+test_filename_index_benchmark (void)
+{
+    g_autoptr (GFile) location = NULL;
+    NautilusFilenameIndex *index;
+    guint n_hits;
+    gdouble elapsed;
+
+    location = get_test_location ("filename_index_benchmark");
+    create_hierarchy (location, BENCHMARK_DIRECTORIES, BENCHMARK_FILES);
+
+    g_test_timer_start ();
+    index = create_index (location);
+    nautilus_filename_index_wait (index);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "Indexed %u files in %f seconds",
+                             BENCHMARK_DIRECTORIES * BENCHMARK_FILES, elapsed);
+
+    g_test_timer_start ();
+    n_hits = count_hits (index, location, "file_0123", FALSE);
+    elapsed = g_test_timer_elapsed ();
+    g_assert_cmpuint (n_hits, ==, 100);
+    g_test_minimized_result (elapsed, "Searched %u files in %f seconds",
+                             BENCHMARK_DIRECTORIES * BENCHMARK_FILES, elapsed);
+
+    nautilus_filename_index_free (index);
+    delete_test_files ();
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    nautilus_ensure_extension_points ();
+    /* Needed for nautilus-query.c.
+     * FIXME: tests are not installed, so the system does not
+     * have the gschema. Installed tests is a long term GNOME goal.
+     */
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-filename-index-search/1.0",
+                     test_filename_index_search);
+    g_test_add_func ("/test-filename-index-changes/1.0",
+                     test_filename_index_changes);
+    g_test_add_func ("/test-filename-index-reload/1.0",
+                     test_filename_index_reload);
+    g_test_add_func ("/test-filename-index-check/1.0",
+                     test_filename_index_check);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-filename-index-benchmark/1.0",
+                         test_filename_index_benchmark);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,160 @@
+#include "test-utilities.h"
+
+#include <glib/gstdio.h>
+#include <src/nautilus-monitor.h>
+
+/* More than the storm threshold of the monitor */
+#define N_STORM_FILES 600
+
+static gboolean
+quit_loop_timeout_cb (gpointer user_data)
+{
+    g_main_loop_quit (user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Long enough for the events to come in and be passed on, or for a storm
+ * to be noticed and rescanned.
+ */
+static void
+run_main_loop (guint interval)
+{
+    g_autoptr (GMainLoop) loop = NULL;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_timeout_add (interval, quit_loop_timeout_cb, loop);
+    g_main_loop_run (loop);
+}
+
+static GFile *
+create_monitored_directory (void)
+{
+    g_autofree gchar *path = NULL;
+
+    path = g_build_filename (g_get_tmp_dir (), "monitor_directory", NULL);
+    g_mkdir_with_parents (path, 0700);
+
+    return g_file_new_for_path (path);
+}
+
+static void
+write_file (GFile       *directory,
+            const gchar *name)
+{
+    g_autoptr (GFile) file = NULL;
+    g_autofree gchar *path = NULL;
+
+    file = g_file_get_child (directory, name);
+    path = g_file_get_path (file);
+    g_assert_true (g_file_set_contents (path, name, -1, NULL));
+}
+
+static void
+delete_monitored_directory (void)
+{
+    g_autoptr (GFile) root = NULL;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    empty_directory_by_prefix (root, "monitor");
+}
+
+static void
+test_monitor_created_then_deleted (void)
+{
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) file = NULL;
+    NautilusMonitor *monitor;
+    NautilusMonitorCounters counters;
+
+    directory = create_monitored_directory ();
+    monitor = nautilus_monitor_directory (directory);
+
+    write_file (directory, "monitor_file");
+    file = g_file_get_child (directory, "monitor_file");
+    g_assert_true (g_file_delete (file, NULL, NULL));
+
+    run_main_loop (500);
+
+    nautilus_monitor_get_counters (monitor, &counters);
+    g_assert_cmpuint (counters.n_events, >=, 2);
+    g_assert_cmpuint (counters.n_notified, ==, 0);
+    g_assert_cmpuint (counters.n_rescans, ==, 0);
+
+    nautilus_monitor_cancel (monitor);
+    delete_monitored_directory ();
+}
+
+static void
+test_monitor_replaced (void)
+{
+    g_autoptr (GFile) directory = NULL;
+    NautilusMonitor *monitor;
+    NautilusMonitorCounters counters;
+
+    directory = create_monitored_directory ();
+    write_file (directory, "monitor_file");
+    monitor = nautilus_monitor_directory (directory);
+
+    /* Written to a temporary file and renamed over, several times */
+    for (guint i = 0; i < 5; i++)
+    {
+        write_file (directory, "monitor_file");
+    }
+
+    run_main_loop (500);
+
+    nautilus_monitor_get_counters (monitor, &counters);
+    g_assert_cmpuint (counters.n_events, >, 5);
+    g_assert_cmpuint (counters.n_notified, <, 5);
+
+    nautilus_monitor_cancel (monitor);
+    delete_monitored_directory ();
+}
+
+static void
+test_monitor_storm (void)
+{
+    g_autoptr (GFile) directory = NULL;
+    NautilusMonitor *monitor;
+    NautilusMonitorCounters counters;
+
+    directory = create_monitored_directory ();
+    monitor = nautilus_monitor_directory (directory);
+
+    for (guint i = 0; i < N_STORM_FILES; i++)
+    {
+        g_autofree gchar *name = NULL;
+
+        name = g_strdup_printf ("monitor_file_%u", i);
+        write_file (directory, name);
+    }
+
+    run_main_loop (1500);
+
+    nautilus_monitor_get_counters (monitor, &counters);
+    g_assert_cmpuint (counters.n_events, >=, N_STORM_FILES);
+    g_assert_cmpuint (counters.n_notified, <, N_STORM_FILES);
+    g_assert_cmpuint (counters.n_rescans, >=, 1);
+    g_assert_cmpfloat (counters.event_rate, >, 0);
+
+    nautilus_monitor_cancel (monitor);
+    delete_monitored_directory ();
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    nautilus_ensure_extension_points ();
+
+    g_test_add_func ("/test-monitor-created-then-deleted/1.0",
+                     test_monitor_created_then_deleted);
+    g_test_add_func ("/test-monitor-replaced/1.0",
+                     test_monitor_replaced);
+    g_test_add_func ("/test-monitor-storm/1.0",
+                     test_monitor_storm);
+
+    return g_test_run ();
+}
@@ -0,0 +1,400 @@
+#include "test-utilities.h"
+
+#include <string.h>
+#include <src/nautilus-directory.h>
+#include <src/nautilus-file.h>
+#include <src/nautilus-file-private.h>
+#include <src/nautilus-search-directory.h>
+
+#define N_DIRECTORIES 4
+#define N_FILES 50
+#define BENCHMARK_DIRECTORIES 500
+#define BENCHMARK_FILES 1000
+/* Typed one character at a time, matches the files 12000 to 12999 */
+#define BENCHMARK_QUERY "refine_012"
+
+static void
+create_hierarchy (GFile *location,
+                  guint  n_directories,
+                  guint  n_files)
+{
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) file = NULL;
+    GFileOutputStream *out;
+    gchar *file_name;
+
+    g_file_make_directory (location, NULL, NULL);
+
+    for (guint i = 0; i < n_directories; i++)
+    {
+        file_name = g_strdup_printf ("search_refine_dir_%03u", i);
+        directory = g_file_get_child (location, file_name);
+        g_free (file_name);
+        g_file_make_directory (directory, NULL, NULL);
+
+        for (guint j = 0; j < n_files; j++)
+        {
+            file_name = g_strdup_printf ("refine_%06u", i * n_files + j);
+            file = g_file_get_child (directory, file_name);
+            g_free (file_name);
+            out = g_file_create (file, G_FILE_CREATE_NONE, NULL, NULL);
+            g_object_unref (out);
+            g_clear_object (&file);
+        }
+
+        g_clear_object (&directory);
+    }
+}
+
+static NautilusQuery *
+create_query (GFile       *location,
+              const gchar *text)
+{
+    NautilusQuery *query;
+
+    query = nautilus_query_new ();
+    nautilus_query_set_text (query, text);
+    nautilus_query_set_location (query, location);
+    nautilus_query_set_recursive (query, NAUTILUS_QUERY_RECURSIVE_ALWAYS);
+
+    return query;
+}
+
+static NautilusDirectory *
+create_search_directory (void)
+{
+    g_autofree gchar *uri = NULL;
+    g_autoptr (GFile) location = NULL;
+
+    uri = nautilus_search_directory_generate_new_uri ();
+    location = g_file_new_for_uri (uri);
+
+    return nautilus_directory_get (location);
+}
+
+static void
+done_loading_cb (NautilusDirectory *directory,
+                 gpointer           user_data)
+{
+    g_main_loop_quit (user_data);
+}
+
+/* Reloads the search the way the view does when the query changes, and
+ * waits for the results.
+ */
+static void
+load_search (NautilusDirectory *directory,
+             NautilusQuery     *query)
+{
+    g_autoptr (GMainLoop) loop = NULL;
+    gulong handler_id;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    handler_id = g_signal_connect (directory, "done-loading",
+                                   G_CALLBACK (done_loading_cb), loop);
+
+    nautilus_search_directory_set_query (NAUTILUS_SEARCH_DIRECTORY (directory), query);
+    nautilus_directory_file_monitor_remove (directory, directory);
+    nautilus_directory_file_monitor_add (directory, directory, TRUE, 0, NULL, NULL);
+
+    if (!nautilus_directory_are_all_files_seen (directory))
+    {
+        g_main_loop_run (loop);
+    }
+
+    g_signal_handler_disconnect (directory, handler_id);
+}
+
+static guint
+count_files (NautilusDirectory *directory)
+{
+    GList *files;
+    guint n_files;
+
+    files = nautilus_directory_get_file_list (directory);
+    n_files = g_list_length (files);
+    nautilus_file_list_free (files);
+
+    return n_files;
+}
+
+/* The relevance of each result, which is kept on the file */
+static GHashTable *
+get_relevances (NautilusDirectory *directory)
+{
+    GHashTable *relevances;
+    GList *files;
+
+    relevances = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        (GDestroyNotify) nautilus_file_unref, g_free);
+    files = nautilus_directory_get_file_list (directory);
+    for (GList *l = files; l != NULL; l = l->next)
+    {
+        NautilusFile *file = l->data;
+
+        g_hash_table_insert (relevances, nautilus_file_ref (file),
+                             g_memdup (&file->details->search_relevance, sizeof (gdouble)));
+    }
+    nautilus_file_list_free (files);
+
+    return relevances;
+}
+
+static void
+test_query_refines (void)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFile) other_location = NULL;
+    g_autoptr (NautilusQuery) previous = NULL;
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (NautilusQuery) copy = NULL;
+    gboolean text_only;
+
+    location = g_file_new_for_path (g_get_tmp_dir ());
+    other_location = g_file_new_for_path (g_get_home_dir ());
+    previous = create_query (location, "repo");
+    query = create_query (location, "repor");
+
+    g_assert_true (nautilus_query_refines (query, previous, &text_only));
+    g_assert_true (text_only);
+    g_assert_false (nautilus_query_refines (previous, query, NULL));
+
+    /* Any word of the new text may contain an old one */
+    nautilus_query_set_text (query, "new repos");
+    g_assert_true (nautilus_query_refines (query, previous, NULL));
+    nautilus_query_set_text (query, "rep");
+    g_assert_false (nautilus_query_refines (query, previous, NULL));
+
+    /* The copy keeps the old text */
+    nautilus_query_set_text (query, "repor");
+    copy = nautilus_query_copy (query);
+    nautilus_query_set_text (query, "reports");
+    g_assert_true (nautilus_query_refines (query, copy, NULL));
+    g_assert_false (nautilus_query_refines (copy, query, NULL));
+
+    nautilus_query_add_mime_type (query, "text/plain");
+    g_assert_true (nautilus_query_refines (query, previous, &text_only));
+    g_assert_false (text_only);
+    g_assert_false (nautilus_query_refines (previous, query, NULL));
+
+    nautilus_query_set_location (query, other_location);
+    g_assert_false (nautilus_query_refines (query, previous, NULL));
+
+    nautilus_query_set_location (query, location);
+    nautilus_query_set_search_content (query, NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT);
+    g_assert_false (nautilus_query_refines (query, previous, NULL));
+}
+
+static void
+test_search_directory_refine (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (NautilusQuery) fresh_query = NULL;
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusDirectory) fresh_directory = NULL;
+    g_autoptr (GHashTable) relevances = NULL;
+    GHashTableIter iter;
+    gpointer file;
+    gpointer relevance;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    location = g_file_get_child (root, "search_refine");
+    create_hierarchy (location, N_DIRECTORIES, N_FILES);
+
+    query = create_query (location, "refine_0000");
+    directory = create_search_directory ();
+    load_search (directory, query);
+    g_assert_cmpuint (count_files (directory), ==, 100);
+
+    /* Typing on changes the same query, the results are filtered without
+     * searching again.
+     */
+    nautilus_query_set_text (query, "refine_00001");
+    nautilus_search_directory_set_query (NAUTILUS_SEARCH_DIRECTORY (directory), query);
+    nautilus_directory_file_monitor_remove (directory, directory);
+    nautilus_directory_file_monitor_add (directory, directory, TRUE, 0, NULL, NULL);
+    g_assert_true (nautilus_directory_are_all_files_seen (directory));
+    g_assert_cmpuint (count_files (directory), ==, 10);
+    relevances = get_relevances (directory);
+
+    /* Same as searching from scratch, ranked with the new text too */
+    fresh_query = create_query (location, "refine_00001");
+    fresh_directory = create_search_directory ();
+    load_search (fresh_directory, fresh_query);
+    g_assert_cmpuint (count_files (fresh_directory), ==, 10);
+    g_hash_table_iter_init (&iter, relevances);
+    while (g_hash_table_iter_next (&iter, &file, &relevance))
+    {
+        g_assert_cmpfloat (*(gdouble *) relevance, ==,
+                           ((NautilusFile *) file)->details->search_relevance);
+    }
+
+    /* Going back needs a new search */
+    nautilus_query_set_text (query, "refine_000");
+    load_search (directory, query);
+    g_assert_cmpuint (count_files (directory), ==, N_DIRECTORIES * N_FILES);
+
+    nautilus_directory_file_monitor_remove (directory, directory);
+    nautilus_directory_file_monitor_remove (fresh_directory, fresh_directory);
+    empty_directory_by_prefix (root, "search_refine");
+}
+
+static void
+files_added_cb (NautilusDirectory *directory,
+                GList             *files,
+                gpointer           user_data)
+{
+    GHashTable *added = user_data;
+
+    for (GList *l = files; l != NULL; l = l->next)
+    {
+        g_assert_true (g_hash_table_add (added, l->data));
+    }
+}
+
+static void
+test_search_directory_files_added (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (GHashTable) added = NULL;
+    GList *files;
+    GList *uris;
+    GList *batch;
+    GList *l;
+    GList *b;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    location = g_file_get_child (root, "search_refine");
+    create_hierarchy (location, N_DIRECTORIES, N_FILES);
+
+    added = g_hash_table_new (NULL, NULL);
+    query = create_query (location, "refine_");
+    directory = create_search_directory ();
+    g_signal_connect (directory, "files-added", G_CALLBACK (files_added_cb), added);
+    load_search (directory, query);
+
+    /* Every result was handed out once */
+    files = nautilus_directory_get_file_list (directory);
+    g_assert_cmpuint (g_list_length (files), ==, N_DIRECTORIES * N_FILES);
+    g_assert_cmpuint (g_hash_table_size (added), ==, N_DIRECTORIES * N_FILES);
+
+    /* Looking the files up together gives the same files */
+    uris = NULL;
+    for (l = files; l != NULL; l = l->next)
+    {
+        g_assert_true (g_hash_table_contains (added, l->data));
+        uris = g_list_prepend (uris, nautilus_file_get_uri (l->data));
+    }
+    uris = g_list_reverse (uris);
+    batch = nautilus_file_get_by_uris (uris);
+    for (l = files, b = batch; l != NULL && b != NULL; l = l->next, b = b->next)
+    {
+        g_assert_true (l->data == b->data);
+    }
+    g_assert_null (l);
+    g_assert_null (b);
+
+    nautilus_file_list_free (batch);
+    g_list_free_full (uris, g_free);
+    nautilus_file_list_free (files);
+    g_signal_handlers_disconnect_by_func (directory, files_added_cb, added);
+    nautilus_directory_file_monitor_remove (directory, directory);
+    empty_directory_by_prefix (root, "search_refine");
+}
+
+/* Types BENCHMARK_QUERY one character at a time, either reloading the
+ * search from scratch or letting it be refined.
+ */
+static gdouble
+run_typing_benchmark (GFile    *location,
+                      gboolean  refine,
+                      guint    *n_files)
+{
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autofree gchar *text = NULL;
+    gsize length;
+
+    query = create_query (location, "");
+    directory = create_search_directory ();
+
+    g_test_timer_start ();
+    for (length = 1; length <= strlen (BENCHMARK_QUERY); length++)
+    {
+        text = g_strndup (BENCHMARK_QUERY, length);
+        nautilus_query_set_text (query, text);
+        g_free (text);
+        text = NULL;
+
+        if (!refine)
+        {
+            nautilus_directory_force_reload (directory);
+        }
+        load_search (directory, query);
+    }
+    *n_files = count_files (directory);
+
+    nautilus_directory_file_monitor_remove (directory, directory);
+
+    return g_test_timer_elapsed ();
+}
+
+static void
+test_search_directory_refine_benchmark (void)
+{
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) location = NULL;
+    guint n_files;
+    gdouble elapsed;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    location = g_file_get_child (root, "search_refine_benchmark");
+    create_hierarchy (location, BENCHMARK_DIRECTORIES, BENCHMARK_FILES);
+
+    elapsed = run_typing_benchmark (location, FALSE, &n_files);
+    g_assert_cmpuint (n_files, ==, BENCHMARK_FILES);
+    g_test_minimized_result (elapsed,
+                             "Typed \"%s\" over %u files, searching again, in %f seconds",
+                             BENCHMARK_QUERY, BENCHMARK_DIRECTORIES * BENCHMARK_FILES, elapsed);
+
+    elapsed = run_typing_benchmark (location, TRUE, &n_files);
+    g_assert_cmpuint (n_files, ==, BENCHMARK_FILES);
+    g_test_minimized_result (elapsed,
+                             "Typed \"%s\" over %u files, refining, in %f seconds",
+                             BENCHMARK_QUERY, BENCHMARK_DIRECTORIES * BENCHMARK_FILES, elapsed);
+
+    empty_directory_by_prefix (root, "search_refine");
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    nautilus_ensure_extension_points ();
+    /* Needed for nautilus-query.c.
+     * FIXME: tests are not installed, so the system does not
+     * have the gschema. Installed tests is a long term GNOME goal.
+     */
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-query-refines/1.0",
+                     test_query_refines);
+    g_test_add_func ("/test-search-directory-refine/1.0",
+                     test_search_directory_refine);
+    g_test_add_func ("/test-search-directory-files-added/1.0",
+                     test_search_directory_files_added);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-search-directory-refine-benchmark/1.0",
+                         test_search_directory_refine_benchmark);
+    }
+
+    return g_test_run ();
+}
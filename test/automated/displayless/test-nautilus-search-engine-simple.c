@@ -1,5 +1,11 @@
 #include "test-utilities.h"
 
+#include <src/nautilus-search-engine-simple.h>
+
+#define BENCHMARK_DIRECTORIES 32
+#define BENCHMARK_SUBDIRECTORIES 32
+#define BENCHMARK_FILES 32
+
 static void
 hits_added_cb (NautilusSearchEngine *engine,
                GSList               *hits)
@@ -25,9 +31,8 @@ finished_cb (NautilusSearchEngine         *engine,
     g_main_loop_quit (user_data);
 }
 
-int
-main (int   argc,
-      char *argv[])
+static void
+test_search_engine_simple (void)
 {
     g_autoptr (GMainLoop) loop = NULL;
     NautilusSearchEngine *engine;
@@ -37,13 +42,6 @@ main (int   argc,
 
     loop = g_main_loop_new (NULL, FALSE);
 
-    nautilus_ensure_extension_points ();
-    /* Needed for nautilus-query.c. 
-     * FIXME: tests are not installed, so the system does not
-     * have the gschema. Installed tests is a long term GNOME goal.
-     */
-    nautilus_global_preferences_init ();
-
     engine = nautilus_search_engine_new ();
     g_signal_connect (engine, "hits-added",
                       G_CALLBACK (hits_added_cb), NULL);
@@ -64,5 +62,152 @@ main (int   argc,
                                             NAUTILUS_SEARCH_ENGINE_SIMPLE_ENGINE);
 
     g_main_loop_run (loop);
-    return 0;
+}
+
+static void
+benchmark_hits_added_cb (NautilusSearchProvider *provider,
+                         GList                  *hits,
+                         gpointer                user_data)
+{
+    guint *n_hits = user_data;
+
+    *n_hits += g_list_length (hits);
+}
+
+static void
+benchmark_finished_cb (NautilusSearchProvider       *provider,
+                       NautilusSearchProviderStatus  status,
+                       gpointer                      user_data)
+{
+    g_main_loop_quit (user_data);
+}
+
+static void
+create_benchmark_hierarchy (GFile *location)
+{
+    g_autoptr (GFile) directory = NULL;
+    g_autoptr (GFile) subdirectory = NULL;
+    g_autoptr (GFile) file = NULL;
+    GFileOutputStream *out;
+    gchar *file_name;
+
+    for (gint i = 0; i < BENCHMARK_DIRECTORIES; i++)
+    {
+        file_name = g_strdup_printf ("search_benchmark_dir_%i", i);
+        directory = g_file_get_child (location, file_name);
+        g_free (file_name);
+        g_file_make_directory (directory, NULL, NULL);
+
+        for (gint j = 0; j < BENCHMARK_SUBDIRECTORIES; j++)
+        {
+            file_name = g_strdup_printf ("search_benchmark_subdir_%i", j);
+            subdirectory = g_file_get_child (directory, file_name);
+            g_free (file_name);
+            g_file_make_directory (subdirectory, NULL, NULL);
+
+            for (gint k = 0; k < BENCHMARK_FILES; k++)
+            {
+                file_name = g_strdup_printf ("search_benchmark_file_%i", k);
+                file = g_file_get_child (subdirectory, file_name);
+                g_free (file_name);
+                out = g_file_create (file, G_FILE_CREATE_NONE, NULL, NULL);
+                g_object_unref (out);
+                g_clear_object (&file);
+            }
+
+            g_clear_object (&subdirectory);
+        }
+
+        g_clear_object (&directory);
+    }
+}
+
+static gdouble
+run_benchmark_search (NautilusQuery *query,
+                      guint          n_threads,
+                      guint         *n_hits)
+{
+    g_autoptr (GMainLoop) loop = NULL;
+    g_autoptr (NautilusSearchEngineSimple) engine = NULL;
+
+    g_settings_set_uint (nautilus_preferences,
+                         NAUTILUS_PREFERENCES_SEARCH_THREADS,
+                         n_threads);
+
+    loop = g_main_loop_new (NULL, FALSE);
+    engine = nautilus_search_engine_simple_new ();
+    g_signal_connect (engine, "hits-added",
+                      G_CALLBACK (benchmark_hits_added_cb), n_hits);
+    g_signal_connect (engine, "finished",
+                      G_CALLBACK (benchmark_finished_cb), loop);
+
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine), query);
+
+    *n_hits = 0;
+    g_test_timer_start ();
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (engine));
+    g_main_loop_run (loop);
+
+    return g_test_timer_elapsed ();
+}
+
+static void
+test_search_engine_simple_benchmark (void)
+{
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (GFile) root = NULL;
+    g_autoptr (GFile) location = NULL;
+    guint thread_counts[] = { 1, 2, 4, 0 };
+    guint n_hits;
+    gdouble elapsed;
+
+    root = g_file_new_for_path (g_get_tmp_dir ());
+    location = g_file_get_child (root, "search_benchmark");
+    g_file_make_directory (location, NULL, NULL);
+    create_benchmark_hierarchy (location);
+
+    query = nautilus_query_new ();
+    nautilus_query_set_text (query, "benchmark_file");
+    nautilus_query_set_location (query, location);
+
+    for (guint i = 0; i < G_N_ELEMENTS (thread_counts); i++)
+    {
+        elapsed = run_benchmark_search (query, thread_counts[i], &n_hits);
+
+        g_assert_cmpuint (n_hits, ==, BENCHMARK_DIRECTORIES * BENCHMARK_SUBDIRECTORIES * BENCHMARK_FILES);
+        g_test_minimized_result (elapsed,
+                                 "Searched %u files with %u threads (0 is one per processor) in %f seconds",
+                                 n_hits, thread_counts[i], elapsed);
+    }
+
+    empty_directory_by_prefix (root, "search_benchmark");
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    /* The benchmark changes the number of search threads, don't let
+     * that leak into the user settings.
+     */
+    g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+
+    nautilus_ensure_extension_points ();
+    /* Needed for nautilus-query.c.
+     * FIXME: tests are not installed, so the system does not
+     * have the gschema. Installed tests is a long term GNOME goal.
+     */
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-search-engine-simple/1.0",
+                     test_search_engine_simple);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-search-engine-simple-benchmark/1.0",
+                         test_search_engine_simple_benchmark);
+    }
+
+    return g_test_run ();
 }
@@ -0,0 +1,444 @@
+#include "test-utilities.h"
+
+#include <src/nautilus-file.h>
+#include <src/nautilus-file-private.h>
+#include <src/nautilus-thumbnail-cache.h>
+#include <src/nautilus-thumbnails.h>
+#include <src/nautilus-thumbnails-private.h>
+
+#define GNOME_DESKTOP_USE_UNSTABLE_API
+#include <src/gnome-desktop/gnome-desktop-thumbnail.h>
+
+#define N_FILES 100
+#define BENCHMARK_N_THUMBNAILS 10000
+#define THUMBNAIL_MTIME 1500000000
+/* In megabytes, the smallest allowed */
+#define CACHE_SIZE 1
+/* 256 KB each, so only three fit in the cache */
+#define CACHED_THUMBNAIL_SIZE 256
+#define N_THREADS 4
+/* Of each kind */
+#define N_WORKER_FILES 6
+/* How long the stub thumbnailer takes, so that the threads overlap */
+#define STUB_THUMBNAILER_DELAY (100 * G_TIME_SPAN_MILLISECOND)
+#define WAIT_TIMEOUT (20 * G_TIME_SPAN_SECOND)
+
+/* What the stub thumbnailer saw, kind by kind */
+enum
+{
+    STUB_ALL,
+    STUB_VIDEO,
+    STUB_APPLICATION,
+    N_STUB_KINDS
+};
+
+static gint stub_running[N_STUB_KINDS];
+static gint stub_max_running[N_STUB_KINDS];
+static gint stub_n_thumbnails;
+
+static NautilusFile *
+create_file_with_type (const char *directory_uri,
+                       guint       i,
+                       const char *content_type)
+{
+    g_autofree gchar *name = NULL;
+    g_autofree gchar *uri = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    NautilusFile *file;
+
+    name = g_strdup_printf ("thumbnails_file_%u.png", i);
+    uri = g_strdup_printf ("%s/%s", directory_uri, name);
+    file = nautilus_file_get_by_uri (uri);
+
+    info = g_file_info_new ();
+    g_file_info_set_name (info, name);
+    g_file_info_set_display_name (info, name);
+    g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+    g_file_info_set_content_type (info, content_type);
+    g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, 1500000000 + i);
+    nautilus_file_update_info (file, info);
+
+    return file;
+}
+
+static NautilusFile *
+create_file (const char *directory_uri,
+             guint       i)
+{
+    return create_file_with_type (directory_uri, i,
+                                  i % 2 == 0 ? "image/png" : "video/webm");
+}
+
+static void
+test_thumbnails_remove_directory_from_queue (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (NautilusFile) other_file = NULL;
+    g_autofree gchar *uri = NULL;
+    g_autofree gchar *other_uri = NULL;
+    NautilusFile *file;
+
+    /* The main loop never runs, so no thread picks up the thumbnails and
+     * they all stay in the queue.
+     */
+    files = g_ptr_array_new_with_free_func ((GDestroyNotify) nautilus_file_unref);
+    for (guint i = 0; i < N_FILES; i++)
+    {
+        file = create_file ("file:///tmp/thumbnails", i);
+        nautilus_create_thumbnail (file);
+        g_assert_true (nautilus_file_is_thumbnailing (file));
+        g_ptr_array_add (files, file);
+    }
+
+    other_file = create_file ("file:///tmp/thumbnails_other", 0);
+    nautilus_create_thumbnail (other_file);
+
+    /* Showing a file moves it ahead, it must stay queued. */
+    file = g_ptr_array_index (files, N_FILES - 1);
+    uri = nautilus_file_get_uri (file);
+    nautilus_thumbnail_prioritize (uri);
+    g_assert_true (nautilus_file_is_thumbnailing (file));
+
+    file = g_ptr_array_index (files, 0);
+    nautilus_thumbnail_remove_directory_from_queue (file->details->directory);
+
+    for (guint i = 0; i < files->len; i++)
+    {
+        g_assert_false (nautilus_file_is_thumbnailing (g_ptr_array_index (files, i)));
+    }
+    g_assert_true (nautilus_file_is_thumbnailing (other_file));
+
+    /* The files can be queued again when the folder is shown again. */
+    nautilus_create_thumbnail (file);
+    g_assert_true (nautilus_file_is_thumbnailing (file));
+    nautilus_thumbnail_remove_directory_from_queue (file->details->directory);
+    g_assert_false (nautilus_file_is_thumbnailing (file));
+
+    other_uri = nautilus_file_get_uri (other_file);
+    nautilus_thumbnail_remove_from_queue (other_uri);
+    nautilus_file_set_is_thumbnailing (other_file, FALSE);
+}
+
+static void
+save_thumbnail (GnomeDesktopThumbnailFactory *factory,
+                const char                   *uri)
+{
+    g_autoptr (GdkPixbuf) pixbuf = NULL;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 128, 96);
+    gdk_pixbuf_fill (pixbuf, 0x336699ff);
+    gnome_desktop_thumbnail_factory_save_thumbnail (factory, pixbuf, uri, THUMBNAIL_MTIME);
+}
+
+static void
+delete_thumbnail_cache (void)
+{
+    g_autoptr (GFile) cache = NULL;
+
+    cache = g_file_new_for_path (g_get_user_cache_dir ());
+    empty_directory_by_prefix (cache, "");
+}
+
+static void
+test_thumbnails_lookup (void)
+{
+    g_autoptr (GnomeDesktopThumbnailFactory) factory = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *expected_path = NULL;
+    const char *uri = "file:///tmp/thumbnails_lookup/image.png";
+    const char *failed_uri = "file:///tmp/thumbnails_lookup/broken.png";
+
+    factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+
+    g_assert_null (gnome_desktop_thumbnail_factory_lookup (factory, uri, THUMBNAIL_MTIME));
+
+    save_thumbnail (factory, uri);
+    path = gnome_desktop_thumbnail_factory_lookup (factory, uri, THUMBNAIL_MTIME);
+    expected_path = gnome_desktop_thumbnail_path_for_uri (uri, GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+    g_assert_cmpstr (path, ==, expected_path);
+
+    /* The file changed since the thumbnail was made. */
+    g_assert_null (gnome_desktop_thumbnail_factory_lookup (factory, uri, THUMBNAIL_MTIME + 1));
+
+    /* Not a PNG at all. */
+    g_assert_true (g_file_set_contents (expected_path, "GIF89a", -1, NULL));
+    g_assert_null (gnome_desktop_thumbnail_factory_lookup (factory, uri, THUMBNAIL_MTIME));
+
+    g_assert_false (gnome_desktop_thumbnail_factory_has_valid_failed_thumbnail (factory, failed_uri,
+                                                                                THUMBNAIL_MTIME));
+    gnome_desktop_thumbnail_factory_create_failed_thumbnail (factory, failed_uri, THUMBNAIL_MTIME);
+    g_assert_true (gnome_desktop_thumbnail_factory_has_valid_failed_thumbnail (factory, failed_uri,
+                                                                               THUMBNAIL_MTIME));
+    g_assert_false (gnome_desktop_thumbnail_factory_has_valid_failed_thumbnail (factory, failed_uri,
+                                                                                THUMBNAIL_MTIME + 1));
+
+    delete_thumbnail_cache ();
+}
+
+static void
+stub_enter (guint kind)
+{
+    gint running;
+    gint max_running;
+
+    running = g_atomic_int_add (&stub_running[kind], 1) + 1;
+    do
+    {
+        max_running = g_atomic_int_get (&stub_max_running[kind]);
+    }
+    while (running > max_running &&
+           !g_atomic_int_compare_and_exchange (&stub_max_running[kind], max_running, running));
+}
+
+static GdkPixbuf *
+stub_thumbnailer (const char *uri,
+                  const char *mime_type)
+{
+    guint kind;
+    GdkPixbuf *pixbuf;
+
+    kind = g_str_has_prefix (mime_type, "video/") ? STUB_VIDEO :
+           g_str_has_prefix (mime_type, "application/") ? STUB_APPLICATION :
+           STUB_ALL;
+
+    stub_enter (STUB_ALL);
+    if (kind != STUB_ALL)
+    {
+        stub_enter (kind);
+    }
+
+    g_usleep (STUB_THUMBNAILER_DELAY);
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 16, 16);
+    gdk_pixbuf_fill (pixbuf, 0x336699ff);
+    g_atomic_int_inc (&stub_n_thumbnails);
+
+    if (kind != STUB_ALL)
+    {
+        g_atomic_int_add (&stub_running[kind], -1);
+    }
+    g_atomic_int_add (&stub_running[STUB_ALL], -1);
+
+    return pixbuf;
+}
+
+static gboolean
+keep_waiting (gpointer user_data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+is_any_thumbnailing (GPtrArray *files)
+{
+    for (guint i = 0; i < files->len; i++)
+    {
+        if (nautilus_file_is_thumbnailing (g_ptr_array_index (files, i)))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+test_thumbnails_worker_threads (void)
+{
+    g_autoptr (GPtrArray) files = NULL;
+    const char *content_types[] =
+    {
+        "video/webm", "application/pdf", "image/png",
+    };
+    gint64 deadline;
+    guint wakeup_id;
+
+    g_settings_set_uint (nautilus_preferences,
+                         NAUTILUS_PREFERENCES_THUMBNAIL_THREADS,
+                         N_THREADS);
+    nautilus_thumbnail_set_generate_func (stub_thumbnailer);
+
+    /* The heavy ones first, so that they would take all the threads if
+     * nothing held them back.
+     */
+    files = g_ptr_array_new_with_free_func ((GDestroyNotify) nautilus_file_unref);
+    for (guint i = 0; i < G_N_ELEMENTS (content_types); i++)
+    {
+        for (guint j = 0; j < N_WORKER_FILES; j++)
+        {
+            NautilusFile *file;
+
+            file = create_file_with_type ("file:///tmp/thumbnails_workers",
+                                          i * N_WORKER_FILES + j, content_types[i]);
+            nautilus_create_thumbnail (file);
+            g_ptr_array_add (files, file);
+        }
+    }
+
+    deadline = g_get_monotonic_time () + WAIT_TIMEOUT;
+    wakeup_id = g_timeout_add (10, keep_waiting, NULL);
+    while (is_any_thumbnailing (files) && g_get_monotonic_time () < deadline)
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+    g_source_remove (wakeup_id);
+
+    g_assert_false (is_any_thumbnailing (files));
+    g_assert_cmpint (g_atomic_int_get (&stub_n_thumbnails), ==, (gint) files->len);
+    g_assert_cmpint (stub_max_running[STUB_ALL], <=, N_THREADS);
+    g_assert_cmpint (stub_max_running[STUB_VIDEO], <=, 2);
+    g_assert_cmpint (stub_max_running[STUB_APPLICATION], <=, 2);
+    /* More than one kind was being made at once */
+    g_assert_cmpint (stub_max_running[STUB_ALL], >, 2);
+
+    nautilus_thumbnail_set_generate_func (NULL);
+    g_settings_reset (nautilus_preferences, NAUTILUS_PREFERENCES_THUMBNAIL_THREADS);
+    delete_thumbnail_cache ();
+}
+
+static void
+test_thumbnails_lookup_benchmark (void)
+{
+    g_autoptr (GnomeDesktopThumbnailFactory) factory = NULL;
+    g_autoptr (GPtrArray) uris = NULL;
+    gdouble elapsed;
+
+    factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+    uris = g_ptr_array_new_with_free_func (g_free);
+    for (guint i = 0; i < BENCHMARK_N_THUMBNAILS; i++)
+    {
+        gchar *uri;
+
+        uri = g_strdup_printf ("file:///tmp/thumbnails_benchmark/image_%u.png", i);
+        save_thumbnail (factory, uri);
+        g_ptr_array_add (uris, uri);
+    }
+
+    g_test_timer_start ();
+    for (guint i = 0; i < uris->len; i++)
+    {
+        g_autofree gchar *path = NULL;
+
+        path = gnome_desktop_thumbnail_factory_lookup (factory, g_ptr_array_index (uris, i),
+                                                       THUMBNAIL_MTIME);
+        g_assert_nonnull (path);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed,
+                             "Looked up %u cached thumbnails in %f seconds",
+                             uris->len, elapsed);
+
+    /* What it costs to decode them instead, for comparison. */
+    g_test_timer_start ();
+    for (guint i = 0; i < uris->len; i++)
+    {
+        g_autofree gchar *path = NULL;
+        g_autoptr (GdkPixbuf) pixbuf = NULL;
+
+        path = gnome_desktop_thumbnail_path_for_uri (g_ptr_array_index (uris, i),
+                                                     GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+        pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+        g_assert_true (gnome_desktop_thumbnail_is_valid (pixbuf, g_ptr_array_index (uris, i),
+                                                         THUMBNAIL_MTIME));
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_message ("Decoded %u cached thumbnails in %f seconds", uris->len, elapsed);
+
+    delete_thumbnail_cache ();
+}
+
+static void
+test_thumbnail_cache_eviction (void)
+{
+    g_autoptr (GdkPixbuf) pixbuf = NULL;
+    g_autoptr (GdkPixbuf) cached = NULL;
+    NautilusThumbnailCacheStats before;
+    NautilusThumbnailCacheStats after;
+    const char *paths[] =
+    {
+        "/tmp/thumbnails_cache/a.png",
+        "/tmp/thumbnails_cache/b.png",
+        "/tmp/thumbnails_cache/c.png",
+        "/tmp/thumbnails_cache/d.png",
+    };
+
+    nautilus_thumbnail_cache_clear ();
+    nautilus_thumbnail_cache_get_stats (&before);
+    g_assert_cmpuint (before.budget, ==, CACHE_SIZE * 1024 * 1024);
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                             CACHED_THUMBNAIL_SIZE, CACHED_THUMBNAIL_SIZE);
+    for (guint i = 0; i < 3; i++)
+    {
+        nautilus_thumbnail_cache_insert (paths[i], THUMBNAIL_MTIME, 0, 0, pixbuf);
+    }
+
+    /* The first one is now the most recently used, so the second one is
+     * dropped to make room for the fourth. */
+    cached = nautilus_thumbnail_cache_lookup (paths[0], THUMBNAIL_MTIME, 0, 0);
+    g_assert_true (cached == pixbuf);
+    g_clear_object (&cached);
+    nautilus_thumbnail_cache_insert (paths[3], THUMBNAIL_MTIME, 0, 0, pixbuf);
+
+    g_assert_null (nautilus_thumbnail_cache_lookup (paths[1], THUMBNAIL_MTIME, 0, 0));
+    for (guint i = 0; i < G_N_ELEMENTS (paths); i++)
+    {
+        if (i != 1)
+        {
+            cached = nautilus_thumbnail_cache_lookup (paths[i], THUMBNAIL_MTIME, 0, 0);
+            g_assert_nonnull (cached);
+            g_clear_object (&cached);
+        }
+    }
+
+    /* Another mtime, or another size, is another thumbnail. */
+    g_assert_null (nautilus_thumbnail_cache_lookup (paths[0], THUMBNAIL_MTIME + 1, 0, 0));
+    g_assert_null (nautilus_thumbnail_cache_lookup (paths[0], THUMBNAIL_MTIME, 64, 1));
+
+    nautilus_thumbnail_cache_get_stats (&after);
+    g_assert_cmpuint (after.hits - before.hits, ==, 4);
+    g_assert_cmpuint (after.misses - before.misses, ==, 3);
+    g_assert_cmpuint (after.evictions - before.evictions, ==, 1);
+    g_assert_cmpuint (after.n_entries, ==, 3);
+    g_assert_cmpuint (after.size, <=, after.budget);
+
+    nautilus_thumbnail_cache_clear ();
+    nautilus_thumbnail_cache_get_stats (&after);
+    g_assert_cmpuint (after.n_entries, ==, 0);
+    g_assert_cmpuint (after.size, ==, 0);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_autofree gchar *cache_dir = NULL;
+
+    /* Keep the thumbnails made by the tests away from the user ones. */
+    cache_dir = g_build_filename (g_get_tmp_dir (), "thumbnails_cache", NULL);
+    g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+    /* Don't let the cache size set below leak into the user settings. */
+    g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+
+    g_test_init (&argc, &argv, NULL);
+    nautilus_ensure_extension_points ();
+    nautilus_global_preferences_init ();
+    g_settings_set_uint (nautilus_preferences,
+                         NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE,
+                         CACHE_SIZE);
+
+    g_test_add_func ("/test-thumbnails-remove-directory-from-queue/1.0",
+                     test_thumbnails_remove_directory_from_queue);
+    g_test_add_func ("/test-thumbnails-lookup/1.0",
+                     test_thumbnails_lookup);
+    g_test_add_func ("/test-thumbnail-cache-eviction/1.0",
+                     test_thumbnail_cache_eviction);
+    g_test_add_func ("/test-thumbnails-worker-threads/1.0",
+                     test_thumbnails_worker_threads);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-thumbnails-lookup-benchmark/1.0",
+                         test_thumbnails_lookup_benchmark);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,272 @@
+#include "test-utilities.h"
+
+#include <src/nautilus-view-model.h>
+#include <src/nautilus-view-item-model.h>
+
+#define SMALL_MODEL_SIZE 1000
+#define BENCHMARK_MODEL_SIZE 100000
+#define BENCHMARK_SELECTION_SIZE 10000
+
+static NautilusViewModel *
+create_model (guint       n_items,
+              GPtrArray **files)
+{
+    NautilusViewModel *model;
+    NautilusViewModelSortData sort_data;
+    g_autoptr (GQueue) items = NULL;
+
+    model = nautilus_view_model_new ();
+    sort_data.sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
+    sort_data.reversed = FALSE;
+    sort_data.directories_first = FALSE;
+    nautilus_view_model_set_sort_type (model, &sort_data);
+
+    *files = g_ptr_array_new_with_free_func (g_object_unref);
+    items = g_queue_new ();
+    for (guint i = 0; i < n_items; i++)
+    {
+        g_autofree gchar *uri = NULL;
+        NautilusFile *file;
+
+        uri = g_strdup_printf ("file:///tmp/view_model/view_model_file_%u", i);
+        file = nautilus_file_get_by_uri (uri);
+        g_ptr_array_add (*files, file);
+        g_queue_push_tail (items, nautilus_view_item_model_new (file, 64));
+    }
+
+    nautilus_view_model_add_items (model, items);
+    g_queue_foreach (items, (GFunc) g_object_unref, NULL);
+
+    return model;
+}
+
+/* Every other file, starting at @offset. */
+static GQueue *
+get_files_subset (GPtrArray *files,
+                  guint      offset,
+                  guint      n_files)
+{
+    GQueue *subset;
+
+    subset = g_queue_new ();
+    for (guint i = offset; i < files->len && g_queue_get_length (subset) < n_files; i += 2)
+    {
+        g_queue_push_tail (subset, g_ptr_array_index (files, i));
+    }
+
+    return subset;
+}
+
+static void
+test_view_model_get_items_from_files (void)
+{
+    g_autoptr (NautilusViewModel) model = NULL;
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GQueue) subset = NULL;
+    g_autoptr (GQueue) items = NULL;
+    GList *l;
+    GList *m;
+
+    model = create_model (SMALL_MODEL_SIZE, &files);
+    subset = get_files_subset (files, 0, SMALL_MODEL_SIZE);
+    items = nautilus_view_model_get_items_from_files (model, subset);
+
+    g_assert_cmpuint (g_queue_get_length (items), ==, g_queue_get_length (subset));
+    for (l = g_queue_peek_head_link (subset), m = g_queue_peek_head_link (items);
+         l != NULL && m != NULL;
+         l = l->next, m = m->next)
+    {
+        g_assert_true (nautilus_view_item_model_get_file (m->data) == l->data);
+    }
+}
+
+static void
+test_view_model_remove_items (void)
+{
+    g_autoptr (NautilusViewModel) model = NULL;
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GQueue) subset = NULL;
+    g_autoptr (GQueue) items = NULL;
+    GListModel *g_model;
+    GList *l;
+
+    model = create_model (SMALL_MODEL_SIZE, &files);
+    g_model = G_LIST_MODEL (nautilus_view_model_get_g_model (model));
+    subset = get_files_subset (files, 1, SMALL_MODEL_SIZE);
+    items = nautilus_view_model_get_items_from_files (model, subset);
+
+    nautilus_view_model_remove_items (model, items);
+
+    g_assert_cmpuint (g_list_model_get_n_items (g_model), ==,
+                      SMALL_MODEL_SIZE - g_queue_get_length (subset));
+    for (l = g_queue_peek_head_link (subset); l != NULL; l = l->next)
+    {
+        g_assert_null (nautilus_view_model_get_item_from_file (model, l->data));
+    }
+
+    /* The remaining items must still be found, at the right place. */
+    for (guint i = 0; i < g_list_model_get_n_items (g_model); i++)
+    {
+        g_autoptr (NautilusViewItemModel) item = NULL;
+        NautilusFile *file;
+
+        item = g_list_model_get_item (g_model, i);
+        file = nautilus_view_item_model_get_file (item);
+        g_assert_true (nautilus_view_model_get_item_from_file (model, file) == item);
+    }
+
+    nautilus_view_model_remove_item (model,
+                                     nautilus_view_model_get_item_from_file (model,
+                                                                             g_ptr_array_index (files, 0)));
+    g_assert_cmpuint (g_list_model_get_n_items (g_model), ==,
+                      SMALL_MODEL_SIZE - g_queue_get_length (subset) - 1);
+}
+
+static void
+test_view_model_remove_item_add_item (void)
+{
+    g_autoptr (NautilusViewModel) model = NULL;
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GQueue) all_files = NULL;
+    g_autoptr (GQueue) items = NULL;
+    GListModel *g_model;
+    guint n_items;
+
+    model = create_model (SMALL_MODEL_SIZE, &files);
+    g_model = G_LIST_MODEL (nautilus_view_model_get_g_model (model));
+
+    /* Remove and add back one at a time, alternating between the ends, so
+     * that the positions known to the model keep moving.
+     */
+    n_items = SMALL_MODEL_SIZE;
+    for (guint i = 0; i < SMALL_MODEL_SIZE / 2; i++)
+    {
+        NautilusFile *file;
+        NautilusViewItemModel *item;
+
+        file = g_ptr_array_index (files, i % 2 == 0 ? i : SMALL_MODEL_SIZE - i);
+        nautilus_view_model_remove_item (model,
+                                         nautilus_view_model_get_item_from_file (model, file));
+        n_items--;
+        g_assert_cmpuint (g_list_model_get_n_items (g_model), ==, n_items);
+        g_assert_null (nautilus_view_model_get_item_from_file (model, file));
+
+        if (i % 4 == 0)
+        {
+            item = nautilus_view_item_model_new (file, 64);
+            nautilus_view_model_add_item (model, item);
+            g_object_unref (item);
+            n_items++;
+            g_assert_cmpuint (g_list_model_get_n_items (g_model), ==, n_items);
+        }
+    }
+
+    /* Every item left must still be found at its place */
+    all_files = g_queue_new ();
+    for (guint i = 0; i < files->len; i++)
+    {
+        g_queue_push_tail (all_files, g_ptr_array_index (files, i));
+    }
+    items = nautilus_view_model_get_items_from_files (model, all_files);
+    g_assert_cmpuint (g_queue_get_length (items), ==, n_items);
+    nautilus_view_model_remove_items (model, items);
+    g_assert_cmpuint (g_list_model_get_n_items (g_model), ==, 0);
+}
+
+static void
+test_view_model_add_items_sorted (void)
+{
+    g_autoptr (NautilusViewModel) model = NULL;
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GQueue) items = NULL;
+    GListModel *g_model;
+
+    model = create_model (SMALL_MODEL_SIZE, &files);
+    g_model = G_LIST_MODEL (nautilus_view_model_get_g_model (model));
+
+    /* A second batch that interleaves with the first one. */
+    items = g_queue_new ();
+    for (guint i = 0; i < SMALL_MODEL_SIZE; i++)
+    {
+        g_autofree gchar *uri = NULL;
+        NautilusFile *file;
+
+        uri = g_strdup_printf ("file:///tmp/view_model/view_model_file_%u_added", SMALL_MODEL_SIZE - i);
+        file = nautilus_file_get_by_uri (uri);
+        g_ptr_array_add (files, file);
+        g_queue_push_tail (items, nautilus_view_item_model_new (file, 64));
+    }
+    nautilus_view_model_add_items (model, items);
+    g_queue_foreach (items, (GFunc) g_object_unref, NULL);
+
+    g_assert_cmpuint (g_list_model_get_n_items (g_model), ==, 2 * SMALL_MODEL_SIZE);
+    for (guint i = 1; i < g_list_model_get_n_items (g_model); i++)
+    {
+        g_autoptr (NautilusViewItemModel) previous = NULL;
+        g_autoptr (NautilusViewItemModel) item = NULL;
+
+        previous = g_list_model_get_item (g_model, i - 1);
+        item = g_list_model_get_item (g_model, i);
+        g_assert_cmpint (nautilus_file_compare_for_sort (nautilus_view_item_model_get_file (previous),
+                                                         nautilus_view_item_model_get_file (item),
+                                                         NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
+                                                         FALSE, FALSE), <=, 0);
+        g_assert_true (nautilus_view_model_get_item_from_file (model,
+                                                               nautilus_view_item_model_get_file (item)) == item);
+    }
+}
+
+static void
+test_view_model_benchmark (void)
+{
+    g_autoptr (NautilusViewModel) model = NULL;
+    g_autoptr (GPtrArray) files = NULL;
+    g_autoptr (GQueue) subset = NULL;
+    g_autoptr (GQueue) items = NULL;
+    gdouble elapsed;
+
+    model = create_model (BENCHMARK_MODEL_SIZE, &files);
+    subset = get_files_subset (files, 0, BENCHMARK_SELECTION_SIZE);
+
+    g_test_timer_start ();
+    items = nautilus_view_model_get_items_from_files (model, subset);
+    elapsed = g_test_timer_elapsed ();
+    g_assert_cmpuint (g_queue_get_length (items), ==, BENCHMARK_SELECTION_SIZE);
+    g_test_minimized_result (elapsed,
+                             "Selected %u of %u items in %f seconds",
+                             BENCHMARK_SELECTION_SIZE, BENCHMARK_MODEL_SIZE, elapsed);
+
+    g_test_timer_start ();
+    nautilus_view_model_remove_items (model, items);
+    elapsed = g_test_timer_elapsed ();
+    g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (nautilus_view_model_get_g_model (model))),
+                      ==, BENCHMARK_MODEL_SIZE - BENCHMARK_SELECTION_SIZE);
+    g_test_minimized_result (elapsed,
+                             "Removed %u of %u items in %f seconds",
+                             BENCHMARK_SELECTION_SIZE, BENCHMARK_MODEL_SIZE, elapsed);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    nautilus_ensure_extension_points ();
+    nautilus_global_preferences_init ();
+
+    g_test_add_func ("/test-view-model-get-items-from-files/1.0",
+                     test_view_model_get_items_from_files);
+    g_test_add_func ("/test-view-model-remove-items/1.0",
+                     test_view_model_remove_items);
+    g_test_add_func ("/test-view-model-remove-item-add-item/1.0",
+                     test_view_model_remove_item_add_item);
+    g_test_add_func ("/test-view-model-add-items-sorted/1.0",
+                     test_view_model_add_items_sorted);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/test-view-model-benchmark/1.0",
+                         test_view_model_benchmark);
+    }
+
+    return g_test_run ();
+}